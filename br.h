@@ -22,7 +22,8 @@
 
 // Check ID
 #define BR_CHECKID_SHA256 0         // use SHA256 (32 bytes)
-#define BR_CHECKID_UNKNOWN 1        // id's >= this are unknown
+#define BR_CHECKID_XXH3_64 1        // use XXH3-64 (8 bytes)
+#define BR_CHECKID_UNKNOWN 2        // id's >= this are unknown
 
 // Extra mask (high bit is parity)
 #define BR_EXTRA_MOD 1              // modification time present
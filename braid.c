@@ -11,9 +11,23 @@
 // have a total uncompressed size, then the output trailer contains a total
 // uncompressed size.  If there is more than one embedded brotli stream, then
 // the output trailer contains a check value of the individual check values.
+//
+// The backward scan reads the end of each file in large blocks, and the
+// brotli streams are copied in large blocks.  On Linux, the streams are copied
+// by the kernel from the input file to the output with copy_file_range() or
+// sendfile(), without passing through user space.
 
+#ifdef __linux__
+#  define _GNU_SOURCE
+#endif
 #include <stdio.h>
 #include <stdint.h>
+#ifdef __linux__
+#  include <errno.h>
+#  include <unistd.h>
+#  include <sys/sendfile.h>
+#  define KERNEL_COPY
+#endif
 #include "br.h"
 #include "xxhash.h"
 #include "try.h"
@@ -26,22 +40,48 @@ local inline unsigned parity(unsigned n) {
     return (0x34cb00 >> ((n ^ (n >> 4)) & 0xf)) & 0x80;
 }
 
+// Window of a file for reading backwards.  buf[0..have-1] holds the bytes at
+// file offsets base..base+have-1, and pos is the current position.
+#define WINDOW 65536
+typedef struct {
+    FILE *in;               // file being read
+    off_t pos;              // offset after the next byte to return
+    off_t base;             // offset of buf[0]
+    size_t have;            // number of bytes in buf
+    unsigned char buf[WINDOW];
+} back_t;
+
+// Start reading in backwards from its end.  Throw an error if the end of the
+// file cannot be found.
+local void back_init(back_t *back, FILE *in) {
+    back->in = in;
+    if (fseeko(in, 0, SEEK_END) || (back->pos = ftello(in)) == -1)
+        throw(1, "input/output error");
+    back->base = back->pos;
+    back->have = 0;
+}
+
 // Read bytes from a file backwards.  The byte returned is the one that
-// precedes the current file position.  The file position is left pointing at
-// the byte returned, so that the next call returns the byte before that.
-// Throw an error if at the start of the file or if there is an I/O error.
-local inline unsigned rget1(FILE *in) {
-    int ch;
-    if (ftello(in) == 0 ||
-        fseeko(in, -1, SEEK_CUR) ||
-        (ch = getc(in)) == EOF ||
-        fseeko(in, -1, SEEK_CUR))
-        throw(1, "premature arrival at start of file");
-    return ch;
+// precedes the current position.  The position is left pointing at the byte
+// returned, so that the next call returns the byte before that.  The window
+// is refilled with up to WINDOW bytes before the position when needed.  Throw
+// an error if at the start of the file or if there is an I/O error.
+local inline unsigned rget1(back_t *back) {
+    if (back->pos <= back->base || back->pos > back->base + (off_t)back->have) {
+        if (back->pos <= 0)
+            throw(1, "premature arrival at start of file");
+        back->base = back->pos > WINDOW ? back->pos - WINDOW : 0;
+        back->have = back->pos - back->base;
+        if (fseeko(back->in, back->base, SEEK_SET) ||
+            fread(back->buf, 1, back->have, back->in) != back->have)
+            throw(1, "input/output error");
+    }
+    back->pos--;
+    return back->buf[back->pos - back->base];
 }
 
 // Get a bidirectional variable-length number from in, reading backwards.
-local inline uintmax_t getrbvar(FILE *in) {
+local inline uintmax_t getrbvar(back_t *in) {
     unsigned ch = rget1(in);
     if ((ch & 0x80) == 0)
         throw(3, "high bit not set (end of bidirectional variable length)");
@@ -156,24 +196,28 @@ local void scan(FILE *in, pos_t **pos) {
     // file offset of the last header.
     off_t at;
     {
-        fseeko(in, 0, SEEK_END);
+        back_t back;
+        back_init(&back, in);
         unsigned trail;
-        while ((trail = rget1(in)) == 0)    // get final trailer mask
+        while ((trail = rget1(&back)) == 0) // get final trailer mask
             ;                               // bypass any zero padding
         if (parity(trail) || (trail & BR_CONTENT_TRAIL) == 0 ||
             (trail & BR_CONTENT_EXTRA_MASK))
             throw(3, "invalid final trailer");
-        if ((trail & BR_CONTENT_CHECK) != 7)
-            fseeko(in, -(1 << (trail & 3)), SEEK_CUR);  // skip check of checks
+        if ((trail & BR_CONTENT_CHECK) != 7) {
+            back.pos -= 1 << (trail & 3);   // skip check of checks
+            if (back.pos < 0)
+                throw(1, "premature arrival at start of file");
+        }
         if (trail & BR_CONTENT_LEN)
-            getrbvar(in);                   // skip total uncompressed length
+            getrbvar(&back);                // skip total uncompressed length
         off_t dist = 0;
         if (trail & BR_CONTENT_OFF)
-            dist = getrbvar(in);            // get distance to last header
+            dist = getrbvar(&back);         // get distance to last header
         if (trail != (BR_CONTENT_TRAIL | 7))
-            if (rget1(in) != trail)         // get leading trailer mask
+            if (rget1(&back) != trail)      // get leading trailer mask
                 throw(3, "invalid trailer mask");
-        at = ftello(in);                    // file offset of start of trailer
+        at = back.pos;                      // file offset of start of trailer
         if (at > 4 && (trail & BR_CONTENT_OFF) == 0)
             throw(4, "no final distance to previous header");
         *pos = NULL;                        // empty the stack
@@ -224,11 +268,58 @@ local inline void putvar(uintmax_t n, FILE *out, off_t *off,
     put1(n | 0x80, out, off, check);
 }
 
-// Copy len bytes from in to out, updating off and check.
+#ifdef KERNEL_COPY
+// Copy len bytes from in to out in the kernel, first with copy_file_range(),
+// which can share or copy the data within the file system, and if that is not
+// supported for these files, with sendfile(), which can write to a pipe.  The
+// stdio positions and buffers of in and out are kept in sync.  Return the
+// number of bytes not copied, which will be len if neither is supported here.
+// Throw an error if the input ends prematurely or on any other error.
+local uintmax_t kernel(FILE *in, uintmax_t len, FILE *out) {
+    if (fflush(out))
+        throw(1, "input/output error");
+    off_t from = ftello(in);
+    if (from == -1)
+        return len;
+    int ifd = fileno(in), ofd = fileno(out);
+    int range = 1;
+    while (len) {
+        size_t n = len > (1 << 30) ? 1 << 30 : len;
+        ssize_t got = range ? copy_file_range(ifd, &from, ofd, NULL, n, 0) :
+                              sendfile(ofd, ifd, &from, n);
+        if (got == -1 && range && (errno == EXDEV || errno == EINVAL ||
+                                   errno == ENOSYS || errno == EBADF ||
+                                   errno == EOPNOTSUPP)) {
+            range = 0;                  // try sendfile() instead
+            continue;
+        }
+        if (got == -1 && !range && (errno == EINVAL || errno == ENOSYS))
+            break;                      // let stdio do the rest
+        if (got == -1)
+            throw(1, "input/output error");
+        if (got == 0)
+            throw(1, "premature end of file");
+        len -= got;
+    }
+    if (fseeko(in, from, SEEK_SET))
+        throw(1, "input/output error");
+    return len;
+}
+
+// Don't bother the kernel with copies shorter than this.
+#define KERNEL_MIN 65536
+#endif
+
+// Copy len bytes from in to out, updating off and check.  Large copies that
+// don't need a check are done in the kernel, if possible.
 local void copyn(FILE *in, uintmax_t len, FILE *out, off_t *off,
                  XXH32_state_t *check) {
     *off += len;
-    unsigned char buf[16384];
+#ifdef KERNEL_COPY
+    if (check == NULL && len >= KERNEL_MIN)
+        len = kernel(in, len, out);
+#endif
+    static unsigned char buf[WINDOW];
     while (len) {
         size_t n = len > sizeof(buf) ? sizeof(buf) : len;
         fread(buf, 1, n, in);
@@ -332,7 +423,8 @@ local void copy(FILE *in, FILE *out, off_t *off, off_t *last, pos_t **pos,
         // length of remainder
         uintmax_t len = (*pos)->off - ftello(in);
         // length of check value
-        unsigned n = (mask & BR_CONTENT_CHECK) == 7 ? 32 : 1 << (mask & 3);
+        unsigned n = (mask & BR_CONTENT_CHECK) != 7 ? 1U << (mask & 3) :
+                     id == BR_CHECKID_XXH3_64 ? 8 : 32;
         copyn(in, len - n, out, off, NULL); // copy brotli stream
         copyn(in, n, out, off, check);      // copy check value
     }
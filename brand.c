@@ -5,8 +5,9 @@
 // Wrap a raw brotli stream from stdin with the framing format, writing the
 // result to stdout.  The stream is decoded in order to generate a check value.
 // This code is to illustrate and test the use of the .br framing format.  The
-// entire input is loaded into memory, so it is not intended for production
-// use.
+// entire input is in memory (mapped if stdin is a file), so it is not intended
+// for production use.  The check value is computed as the stream is decoded,
+// so the uncompressed data is not kept.
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -20,6 +21,7 @@
 #include "br.h"
 #include "xxhash.h"
 #include "crc32c.h"
+#include "xxh3.h"
 
 #define local static
 
@@ -75,8 +77,78 @@ local size_t var(uintmax_t num, FILE *out) {
     return n;
 }
 
-// Write the compressed stream br[0..len-1] wrapped with check value check.
-// opt provides these options to use for wrapping (any order):
+// Check value types.
+enum check {
+    xxh32, xxh64, crc32, sha256, xxh3_64
+};
+
+// Option letter for each check value type.
+local char const letter[] = "xxcsh";
+
+// Running check value of the uncompressed data.
+typedef struct {
+    enum check type;
+    XXH32_state_t xxh32;
+    XXH64_state_t xxh64;
+    uint32_t crc;
+    SHA256_CTX sha;
+    xxh3_t xxh3;
+} sum_t;
+
+// Update the check value at arg with buf[0..len-1].  This is the yeast_check()
+// callback, called as the uncompressed data is decoded.
+local void sum_update(void *arg, void const *buf, size_t len) {
+    sum_t *sum = arg;
+    switch (sum->type) {
+        case xxh32:
+            XXH32_update(&sum->xxh32, buf, len);
+            break;
+        case xxh64:
+            XXH64_update(&sum->xxh64, buf, len);
+            break;
+        case crc32:
+            sum->crc = crc32c(sum->crc, buf, len);
+            break;
+        case sha256:
+            SHA256_Update(&sum->sha, buf, len);
+            break;
+        case xxh3_64:
+            xxh3_update(&sum->xxh3, buf, len);
+    }
+}
+
+// Decode the brotli stream brotli[0..len-1], which must use all of the input,
+// computing the check value of type in *sum, and the uncompressed length in
+// *got.  The uncompressed data is discarded once checked.  Return zero on
+// success, or non-zero if the stream is invalid or there is not enough memory.
+local int decode(void const *brotli, size_t len, enum check type, sum_t *sum,
+                 size_t *got) {
+    sum->type = type;
+    XXH32_reset(&sum->xxh32, 0);
+    XXH64_reset(&sum->xxh64, 0);
+    sum->crc = 0;
+    SHA256_Init(&sum->sha);
+    xxh3_init(&sum->xxh3);
+    yeast_t *y = yeast_init(NULL, 0);
+    if (y == NULL)
+        return 1;
+    yeast_check(y, sum_update, sum);
+    void const *un;
+    size_t n;
+    int ret = yeast_feed(y, brotli, len, 1, &un, &n);
+    *got = n;
+    while (ret == -1 && n) {
+        ret = yeast_feed(y, NULL, 0, 1, &un, &n);
+        *got += n;
+    }
+    if (ret == 0 && yeast_used(y) != len)
+        ret = 3;
+    yeast_end(y);
+    return ret;
+}
+
+// Write the compressed stream br[0..len-1] wrapped with a check value of the
+// uncompressed data.  opt provides these options to use for wrapping (any order):
 //
 //   1 - 1-byte check value
 //   2 - 2-byte check value
@@ -85,17 +157,17 @@ local size_t var(uintmax_t num, FILE *out) {
 //   x - XXH32 (1, 2, or 4) or XXH64 (8)
 //   c - CRC-32C (1, 2, or 4)
 //   s - SHA-256 (32)
+//   h - XXH3-64 (8)
 //   n - include nothing in the trailer (one byte)
 //   u - include uncompressed length in trailer
 //   r - include reverse offset in trailer
 //   b - include both length and offset in trailer
 //
-local void wrap(void const *brotli, size_t len, void const *un, size_t got,
-                char *opt, char *name, FILE *out) {
+// Return zero on success, or non-zero if the stream could not be decoded.
+local int wrap(void const *brotli, size_t len, char *opt, char *name,
+               FILE *out) {
     // defaults
-    enum {
-        xxh32, xxh64, crc32, sha256
-    } check_type = xxh64;               // use xxh64
+    enum check check_type = xxh64;      // use xxh64
     size_t check_len = 8;               // all 8 bytes (required for xxh64)
     int set = 0;                        // true if base check type option seen
     int tail = BR_CONTENT_LEN | BR_CONTENT_OFF; // tail has length and offset
@@ -129,6 +201,12 @@ local void wrap(void const *brotli, size_t len, void const *un, size_t got,
                     case sha256:
                         check_len = 32;
                         warn("%c ignored -- using 32-byte SHA-256", *opt);
+                        break;
+                    case xxh3_64:
+                        if (check_len != 8) {
+                            check_len = 8;
+                            warn("%c ignored -- using 8-byte XXH3-64", *opt);
+                        }
                 }
                 break;
             case 'c':
@@ -136,14 +214,14 @@ local void wrap(void const *brotli, size_t len, void const *un, size_t got,
                     check_len = 4;
                 if (set && check_type != crc32)
                     warn("%c discarded -- using %d-byte CRC-32C",
-                         check_type == sha256 ? 's' : 'x', check_len);
+                         letter[check_type], check_len);
                 check_type = crc32;
                 set = 1;
                 break;
             case 's':
                 if (set && check_type != sha256)
                     warn("%c discarded -- using 32-byte SHA-256",
-                         check_type == crc32 ? 'c' : 'x');
+                         letter[check_type]);
                 check_type = sha256;
                 check_len = 32;
                 set = 1;
@@ -153,11 +231,19 @@ local void wrap(void const *brotli, size_t len, void const *un, size_t got,
                     check_len = 8;
                 if (set && check_type != xxh32 && check_type != xxh64)
                     warn("%c discarded -- using %d-byte XXH%s",
-                         check_type == crc32 ? 'c' : 's', check_len,
+                         letter[check_type], check_len,
                          check_len < 8 ? "32" : "64");
                 check_type = check_len < 8 ? xxh32 : xxh64;
                 set = 1;
                 break;
+            case 'h':
+                if (set && check_type != xxh3_64)
+                    warn("%c discarded -- using 8-byte XXH3-64",
+                         letter[check_type]);
+                check_type = xxh3_64;
+                check_len = 8;
+                set = 1;
+                break;
             case 'n':
                 tail = 0;
                 break;
@@ -181,6 +267,12 @@ local void wrap(void const *brotli, size_t len, void const *un, size_t got,
         opt++;
     }
 
+    // decode the stream to get the uncompressed length and check value
+    sum_t sum;
+    size_t got;
+    if (decode(brotli, len, check_type, &sum, &got))
+        return 1;
+
     // write signature
     fwrite("\xce\xb2\xcf\x81", 1, 4, out);
 
@@ -202,6 +294,7 @@ local void wrap(void const *brotli, size_t len, void const *un, size_t got,
                     BR_CHECK_CRC32_1;
             break;
         case sha256:
+        case xxh3_64:
             mask |= BR_CHECK_ID;
     }
     if (mod || name)
@@ -209,7 +302,8 @@ local void wrap(void const *brotli, size_t len, void const *un, size_t got,
     putc(mask ^ parity(mask), out);                 // write content mask byte
     writ++;
     if ((mask & 7) == BR_CHECK_ID) {
-        putc(0, out);                               // write SHA-256 id byte
+        putc(check_type == xxh3_64 ? BR_CHECKID_XXH3_64 :
+             BR_CHECKID_SHA256, out);               // write check id byte
         writ++;
     }
     if (mask & BR_CONTENT_EXTRA_MASK) {
@@ -238,14 +332,15 @@ local void wrap(void const *brotli, size_t len, void const *un, size_t got,
     // write check value
     if (check_type == sha256) {
         unsigned char sha[SHA256_DIGEST_LENGTH];
-        SHA256(un, got, sha);
+        SHA256_Final(sha, &sum.sha);
         fwrite(sha, 1, SHA256_DIGEST_LENGTH, out);
     }
     else {
         uint64_t check =
-            check_type == xxh64 ? XXH64(un, got, 0) :
-            check_type == xxh32 ? XXH32(un, got, 0) :
-            check_type == crc32 ? crc32c(0, un, got) : 0;
+            check_type == xxh64 ? XXH64_digest(&sum.xxh64) :
+            check_type == xxh32 ? XXH32_digest(&sum.xxh32) :
+            check_type == crc32 ? sum.crc :
+            check_type == xxh3_64 ? xxh3_digest(&sum.xxh3) : 0;
         little(check, check_len, out);              // write check value
     }
     writ += check_len;
@@ -260,6 +355,7 @@ local void wrap(void const *brotli, size_t len, void const *un, size_t got,
         bvar(got, stdout);                          // uncompressed length
     if (tail & (BR_CONTENT_OFF | BR_CONTENT_LEN))
         putc(tail, out);                            // repeat mask byte
+    return 0;
 }
 
 // Wrap brotli stream from stdin, writing the result to stdout.  If there is
@@ -270,10 +366,11 @@ local void wrap(void const *brotli, size_t len, void const *un, size_t got,
 //  x - use XXH32 or XXH64 -- default
 //  c - use CRC-32C
 //  s - use SHA-256
+//  h - use XXH3-64
 //  1 - use a 1-byte check value (XXH32 or CRC-32C)
 //  2 - use a 2-byte check value (XXH32 or CRC-32C)
 //  4 - use a 4-byte check value (XXH32 or CRC-32C)
-//  8 - use an 8-byte check value (XXH64 only) -- default
+//  8 - use an 8-byte check value (XXH64 or XXH3-64) -- default
 //  n - do not include uncompressed size or reverse offset at end
 //  u - include just the uncompressed size (no reverse offset)
 //  r - include just the reverse offset (no uncompressed size)
@@ -285,30 +382,22 @@ local void wrap(void const *brotli, size_t len, void const *un, size_t got,
 // second argument is stored as the file name.
 int main(int argc, char **argv) {
     // read in compressed data
-    void *brotli = NULL;
-    size_t len, size;
-    int ret = load(stdin, 0, &brotli, &size, &len);
+    void *brotli;
+    size_t len;
+    int mapped;
+    int ret = load_map(stdin, 0, &brotli, &len, &mapped);
     if (ret) {
         fputs("wrap: could not load stream from stdin -- aborting\n", stderr);
         return 1;
     }
 
-    // decompress
-    void *un;
-    size_t got, used = len;
-    ret = yeast(&un, &got, brotli, &used, 0);
-    if (ret || used != len) {
-        free(un);
+    // decompress to check, and write out wrapped compressed data
+    ret = wrap(brotli, len, argc > 1 ? argv[1] : "",
+               argc > 2 ? argv[2] : "filename", stdout);
+    load_free(brotli, len, mapped);
+    if (ret) {
         fputs("wrap: error decompressing stream -- aborting\n", stderr);
         return 1;
     }
-
-    // write out wrapped compressed data using defaults
-    wrap(brotli, len, un, got,
-         argc > 1 ? argv[1] : "", argc > 2 ? argv[2] : "filename", stdout);
-
-    // clean up
-    free(un);
-    free(brotli);
     return 0;
 }
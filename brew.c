@@ -0,0 +1,536 @@
+// brew.c
+// Copyright (C) 2016 Mark Adler
+// For conditions of distribution and use, see the accompanying LICENSE file.
+//
+// Compress stdin to a multiple-chunk .br stream on stdout.  The input is split
+// into fixed-size chunks, each of which is compressed to an independent brotli
+// stream by one of several worker threads.  The chunks are framed and written
+// in order as they are completed, each with a check value and a reverse offset
+// to the previous header, and the trailer is written as braid does.  The
+// result can then be decoded in parallel with broad -j, and read randomly
+// with brseek.
+//
+// The compression method is pluggable.  The built-in methods are "mash", which
+// uses the compressor in mash.c, and "stored", which writes uncompressed
+// meta-blocks.  If compiled with -DUSE_BROTLIENC and linked with -lbrotlienc,
+// then the "brotli" method is added, which uses the brotli library encoder,
+// and is the default.  Otherwise mash is the default.  The options are:
+//
+//  -j N  - use N worker threads (default 1)
+//  -b N  - use chunks of N bytes of input, with an optional K, M, or G suffix
+//          for multiples of 1024 (default 4M)
+//  -m name - compression method (mash, stored, or brotli)
+//  -q N  - compression quality, 0..11 (default 11), where mash uses 9 for
+//          10 and 11
+//  -c opts - check value options as for brand: x for XXH32 or XXH64, c for
+//          CRC-32C, s for SHA-256, h for XXH3-64, and 1, 2, 4, or 8 for the
+//          size (default x8)
+//  -t    - verify each compressed chunk by decoding it with yeast
+//  -v    - write the number of chunks and the sizes to stderr
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <openssl/sha.h>
+#ifdef USE_BROTLIENC
+#  include <brotli/encode.h>
+#endif
+#include "yeast.h"
+#include "mash.h"
+#include "br.h"
+#include "xxhash.h"
+#include "xxh3.h"
+#include "crc32c.h"
+#include "try.h"
+
+#define local static
+
+// Compress in[0..len-1] at quality level to a complete brotli stream in the
+// allocated buffer *out, with its length in *got.  Throw an error on failure.
+typedef void squeeze_t(void const *in, size_t len, int level,
+                       unsigned char **out, size_t *got);
+
+// Bits being written to a buffer, least significant bit first.
+typedef struct {
+    unsigned char *buf;     // destination, with enough room (allocated)
+    size_t len;             // number of bytes written to buf
+    uint32_t bits;          // bits not yet written
+    unsigned left;          // number of bits in bits (less than 8)
+} bits_t;
+
+// Write the low n bits of val, where n is at most 24.
+local inline void put(bits_t *b, uint32_t val, unsigned n) {
+    b->bits |= val << b->left;
+    b->left += n;
+    while (b->left >= 8) {
+        b->buf[b->len++] = b->bits;
+        b->bits >>= 8;
+        b->left -= 8;
+    }
+}
+
+// Fill out the last byte with zero bits, if it is partially written.
+local inline void align(bits_t *b) {
+    if (b->left)
+        put(b, 0, 8 - b->left);
+}
+
+// Compress using stored meta-blocks.  The maximum meta-block length is 2^24.
+// The last meta-block is an empty one, since an uncompressed meta-block
+// cannot be the last.  The window size does not matter, since there are no
+// distances, so the smallest code for it is used.
+local void stored(void const *in, size_t len, int level,
+                  unsigned char **out, size_t *got) {
+    (void)level;
+    bits_t b;
+    b.buf = malloc(len + 5 * (len >> 24) + 8);
+    if (b.buf == NULL)
+        throw(1, "out of memory");
+    b.len = 0;
+    b.bits = 0;
+    b.left = 0;
+    put(&b, 0, 1);                      // WBITS = 16
+    unsigned char const *next = in;
+    while (len) {
+        size_t m = len > ((size_t)1 << 24) ? (size_t)1 << 24 : len;
+        unsigned nibs = m - 1 < (1 << 16) ? 4 : m - 1 < (1 << 20) ? 5 : 6;
+        put(&b, 0, 1);                  // ISLAST = 0
+        put(&b, nibs - 4, 2);           // MNIBBLES
+        put(&b, m - 1, nibs << 2);      // MLEN - 1
+        put(&b, 1, 1);                  // ISUNCOMPRESSED = 1
+        align(&b);
+        memcpy(b.buf + b.len, next, m);
+        b.len += m;
+        next += m;
+        len -= m;
+    }
+    put(&b, 3, 2);                      // ISLAST = 1, ISLASTEMPTY = 1
+    align(&b);
+    *out = b.buf;
+    *got = b.len;
+}
+
+// Compress using mash, with the default window size and optimal prefix
+// codes.  mash() clamps the level to 0..9.
+local void mashed(void const *in, size_t len, int level,
+                  unsigned char **out, size_t *got) {
+    mash(in, len, level, MASH_WBITS, 1, out, got);
+}
+
+#ifdef USE_BROTLIENC
+// Compress using the brotli library encoder.
+local void brotli(void const *in, size_t len, int level,
+                  unsigned char **out, size_t *got) {
+    size_t size = BrotliEncoderMaxCompressedSize(len);
+    *out = malloc(size ? size : 16);
+    if (*out == NULL)
+        throw(1, "out of memory");
+    *got = size ? size : 16;
+    if (!BrotliEncoderCompress(level, BROTLI_DEFAULT_WINDOW,
+                               BROTLI_MODE_GENERIC, len, in, got, *out)) {
+        free(*out);
+        throw(3, "brotli encoder failed");
+    }
+}
+#endif
+
+// The compression methods, the first being the default.
+local struct {
+    char const *name;
+    squeeze_t *squeeze;
+} const methods[] = {
+#ifdef USE_BROTLIENC
+    {"brotli", brotli},
+#endif
+    {"mash", mashed},
+    {"stored", stored}
+};
+
+// Return the parity of the low 8 bits of n in the 8th bit.  If this is
+// exclusive-or'ed with n, then the result has even (zero) parity.
+local inline unsigned parity(unsigned n) {
+    return (0x34cb00 >> ((n ^ (n >> 4)) & 0xf)) & 0x80;
+}
+
+// Write out k bytes of an integer in little-endian order.  k must be at least
+// one.
+local void little(uintmax_t num, size_t k, FILE *out) {
+    do {
+        putc(num, out);
+        num >>= 8;
+    } while (--k);
+}
+
+// Write out a bi-directional variable sized integer, where the first and last
+// bytes have a high bit of 1, and the intermediate bytes have a high bit of 0.
+// Return the number of bytes written.
+local size_t bvar(uintmax_t num, FILE *out) {
+    size_t n = 2;
+    putc(0x80 | (num & 0x7f), out);
+    while ((num >>= 7) > 0x7f) {
+        putc(num & 0x7f, out);
+        n++;
+    }
+    putc(0x80 | num, out);
+    return n;
+}
+
+// Write out a variable size integer, where the last byte has a high bit of
+// 1.  Return the number of bytes written.
+local size_t var(uintmax_t num, FILE *out) {
+    size_t n = 1;
+    while (num > 0x7f) {
+        putc(num & 0x7f, out);
+        num >>= 7;
+        n++;
+    }
+    putc(0x80 | num, out);
+    return n;
+}
+
+// A chunk to be compressed by a worker thread.
+typedef struct {
+    unsigned char *in;      // uncompressed data (allocated)
+    size_t len;             // length of the uncompressed data
+    unsigned char *out;     // brotli stream (allocated)
+    size_t got;             // length of the brotli stream
+    unsigned char check[32];    // check value as stored
+    int code;               // zero, or the error code
+    char *why;              // error message if code is not zero (allocated)
+    int done;               // true when the chunk has been processed
+} job_t;
+
+// Work shared by the worker threads and the thread reading the input and
+// writing the output.  Job number k is in slot k % ahead.
+typedef struct {
+    pthread_mutex_t lock;   // lock for posted, next, stop, and done's
+    pthread_cond_t cond;    // signaled when a job is posted or done
+    squeeze_t *squeeze;     // compression method
+    int level;              // compression quality
+    unsigned mask;          // check type in the low three bits
+    unsigned id;            // check id if the check type is BR_CHECK_ID
+    unsigned n;             // length of the check value
+    int test;               // true to verify the compressed data
+    job_t *job;             // ahead job slots
+    size_t ahead;           // maximum number of jobs not yet written
+    size_t posted;          // number of jobs read in
+    size_t next;            // next job to take
+    int stop;               // true to take no more jobs
+    pthread_t *tid;         // worker threads (allocated)
+    int threads;            // number of worker threads started
+} pool_t;
+
+// Compress and compute the check value for job.
+local void run(pool_t *pool, job_t *job) {
+    ball_t err;
+    try {
+        pool->squeeze(job->in, job->len, pool->level, &job->out, &job->got);
+        if (pool->test) {
+            void *un = job->in;
+            size_t got = job->len, used = job->got;
+            if (yeast(&un, &got, job->out, &used, 1) || used != job->got)
+                throw(4, "compressed chunk does not decode to the input");
+        }
+        unsigned type = pool->mask & BR_CONTENT_CHECK;
+        if (type == BR_CHECK_ID && pool->id == BR_CHECKID_SHA256)
+            SHA256(job->in, job->len, job->check);
+        else {
+            uint64_t check =
+                type == BR_CHECK_ID ? xxh3(job->in, job->len) :
+                type == BR_CHECK_XXH64_8 ? XXH64(job->in, job->len, 0) :
+                type >= BR_CHECK_CRC32_1 ? crc32c(0, job->in, job->len) :
+                XXH32(job->in, job->len, 0);
+            for (unsigned i = 0; i < pool->n; i++, check >>= 8)
+                job->check[i] = check;
+        }
+    }
+    catch (err) {
+        job->code = err.code;
+        job->why = strdup(err.why);
+        drop(err);
+    }
+}
+
+// Worker thread: take jobs in order as they are posted and run them.
+local void *worker(void *arg) {
+    pool_t *pool = arg;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->stop && pool->next == pool->posted)
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        if (pool->stop && pool->next == pool->posted)
+            break;
+        job_t *job = pool->job + pool->next++ % pool->ahead;
+        pthread_mutex_unlock(&pool->lock);
+        run(pool, job);
+        pthread_mutex_lock(&pool->lock);
+        job->done = 1;
+        pthread_cond_broadcast(&pool->cond);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+// Read up to size bytes from in into an allocated buffer in job.  Return the
+// number of bytes read.
+local size_t take(FILE *in, size_t size, job_t *job) {
+    job->in = malloc(size ? size : 1);
+    if (job->in == NULL)
+        throw(1, "out of memory");
+    job->len = fread(job->in, 1, size, in);
+    if (ferror(in))
+        throw(1, "read error");
+    return job->len;
+}
+
+// Compress in to out as a .br stream in chunks of size bytes, using jobs
+// threads.  The method, quality, check type, and test option are provided in
+// pool.  Return 0 on success, or an error code on failure.
+local int brew(FILE *in, FILE *out, size_t size, int jobs, pool_t *pool,
+               int verbose) {
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    pool->ahead = 2 * (size_t)jobs;
+    pool->job = calloc(pool->ahead, sizeof(job_t));
+    pool->posted = 0;
+    pool->next = 0;
+    pool->stop = 0;
+    pool->tid = malloc(jobs * sizeof(pthread_t));
+    pool->threads = 0;
+    if (pool->job != NULL && pool->tid != NULL)
+        while (pool->threads < jobs &&
+               pthread_create(pool->tid + pool->threads, NULL, worker,
+                              pool) == 0)
+            pool->threads++;
+
+    // read the chunks and post them, keeping ahead of the workers, and write
+    // the completed chunks in order, followed by the trailer
+    ball_t err;
+    try {
+        if (pool->threads == 0)
+            throw(1, "could not start threads");
+        fwrite(BR_SIG, 1, 4, out);
+        uintmax_t off = 4;          // current output offset
+        uintmax_t last = 0;         // offset of the last header, or zero
+        uintmax_t total = 0;        // total uncompressed length
+        XXH32_state_t check;        // check of the check values
+        XXH32_reset(&check, 0);
+        size_t written = 0;
+        int eof = 0;
+        while (!eof || written < pool->posted) {
+            // read and post as many chunks as there are free slots for -- an
+            // empty input gets one empty chunk
+            while (!eof && pool->posted - written < pool->ahead) {
+                job_t *job = pool->job + pool->posted % pool->ahead;
+                if (take(in, size, job) < size)
+                    eof = 1;
+                if (job->len == 0 && pool->posted) {
+                    free(job->in);
+                    job->in = NULL;
+                    break;
+                }
+                pthread_mutex_lock(&pool->lock);
+                pool->posted++;
+                pthread_cond_broadcast(&pool->cond);
+                pthread_mutex_unlock(&pool->lock);
+            }
+            if (written == pool->posted)
+                break;
+
+            // wait for the oldest chunk and write it
+            job_t *job = pool->job + written % pool->ahead;
+            pthread_mutex_lock(&pool->lock);
+            while (!job->done)
+                pthread_cond_wait(&pool->cond, &pool->lock);
+            pthread_mutex_unlock(&pool->lock);
+            if (job->code)
+                throw(job->code, "%s", job->why);
+            unsigned mask = pool->mask | BR_CONTENT_LEN;
+            if (last)
+                mask |= BR_CONTENT_OFF;
+            putc(mask ^ parity(mask), out);
+            uintmax_t here = off++;
+            if (last)
+                off += var(here - last, out);
+            if ((mask & BR_CONTENT_CHECK) == BR_CHECK_ID) {
+                putc(pool->id, out);
+                off++;
+            }
+            off += fwrite(job->out, 1, job->got, out);
+            off += var(job->len, out);
+            off += fwrite(job->check, 1, pool->n, out);
+            if (ferror(out))
+                throw(6, "write error");
+            XXH32_update(&check, job->check, pool->n);
+            if (verbose)
+                fprintf(stderr, "chunk %zu: %zu -> %zu\n", written, job->len,
+                        job->got);
+            last = here;
+            total += job->len;
+            free(job->in);
+            free(job->out);
+            memset(job, 0, sizeof(job_t));
+            written++;
+        }
+
+        // write the trailer
+        unsigned trail = BR_CONTENT_TRAIL | BR_CONTENT_LEN | BR_CONTENT_OFF |
+                         (written > 1 ? BR_CHECK_XXH32_4 : 7);
+        trail ^= parity(trail);
+        putc(trail, out);
+        bvar(off - last, out);
+        bvar(total, out);
+        if (written > 1)
+            little(XXH32_digest(&check), 4, out);
+        putc(trail, out);
+        if (fflush(out) || ferror(out))
+            throw(6, "write error");
+        if (verbose)
+            fprintf(stderr, "%zu chunk%s: %ju -> %ju\n", written,
+                    written == 1 ? "" : "s", total, (uintmax_t)ftello(out));
+    }
+    always {
+        pthread_mutex_lock(&pool->lock);
+        pool->stop = 1;
+        pthread_cond_broadcast(&pool->cond);
+        pthread_mutex_unlock(&pool->lock);
+        for (int i = 0; i < pool->threads; i++)
+            pthread_join(pool->tid[i], NULL);
+        free(pool->tid);
+        if (pool->job != NULL)
+            for (size_t i = 0; i < pool->ahead; i++) {
+                free(pool->job[i].in);
+                free(pool->job[i].out);
+                free(pool->job[i].why);
+            }
+        free(pool->job);
+        pthread_cond_destroy(&pool->cond);
+        pthread_mutex_destroy(&pool->lock);
+    }
+    catch (err) {
+        fprintf(stderr, "brew: %s\n", err.why);
+        drop(err);
+        return err.code;
+    }
+    return 0;
+}
+
+// Set the check type and length in pool from the brand-style options in opt.
+local void checks(char const *opt, pool_t *pool) {
+    int type = 'x';
+    unsigned n = 8;
+    for (; *opt; opt++)
+        switch (*opt) {
+            case 'x':
+            case 'c':
+            case 's':
+            case 'h':
+                type = *opt;
+                break;
+            case '1':
+            case '2':
+            case '4':
+            case '8':
+                n = *opt - '0';
+                break;
+            default:
+                fprintf(stderr, "brew: unknown check option %c\n", *opt);
+        }
+    if (type == 's')
+        n = 32;
+    else if (type == 'h')
+        n = 8;
+    else if (type == 'c' && n == 8)
+        n = 4;
+    pool->n = n;
+    pool->id = type == 'h' ? BR_CHECKID_XXH3_64 : BR_CHECKID_SHA256;
+    pool->mask = type == 's' || type == 'h' ? BR_CHECK_ID :
+                 n == 8 ? BR_CHECK_XXH64_8 :
+                 (type == 'c' ? BR_CHECK_CRC32_1 : BR_CHECK_XXH32_1) +
+                 (n == 4 ? 2 : n == 2 ? 1 : 0);
+}
+
+// Get the argument for the option at *opt, either the rest of the option or
+// the next argument.  Update *opt, *argc, and *argv to skip over it.
+local char *arg(char **opt, int *argc, char ***argv) {
+    char *val = *opt + 1;
+    if (*val == 0 && *argc > 1) {
+        (*argc)--;
+        val = *++*argv;
+    }
+    *opt = val + strlen(val) - 1;
+    return val;
+}
+
+int main(int argc, char **argv) {
+    pool_t pool;
+    pool.squeeze = methods[0].squeeze;
+    pool.level = 11;
+    pool.test = 0;
+    checks("", &pool);
+    int jobs = 1, verbose = 0;
+    size_t size = (size_t)4 << 20;
+    while (--argc) {
+        char *opt = *++argv;
+        if (*opt != '-') {
+            fprintf(stderr, "brew: %s ignored (not an option)\n", opt);
+            continue;
+        }
+        while (*++opt)
+            switch (*opt) {
+                case 'j':                   // -jN or -j N
+                    jobs = (int)strtol(arg(&opt, &argc, &argv), NULL, 10);
+                    if (jobs < 1)
+                        jobs = 1;
+                    break;
+                case 'b': {                 // -bN or -b N, with K, M, or G
+                    char *end;
+                    unsigned long long n = strtoull(arg(&opt, &argc, &argv),
+                                                    &end, 10);
+                    int shift = *end == 'K' || *end == 'k' ? 10 :
+                                *end == 'M' || *end == 'm' ? 20 :
+                                *end == 'G' || *end == 'g' ? 30 : 0;
+                    size = (size_t)n << shift;
+                    if (size == 0 || size >> shift != n) {
+                        fputs("brew: invalid chunk size\n", stderr);
+                        return 1;
+                    }
+                    break;
+                }
+                case 'm': {                 // -mname or -m name
+                    char *name = arg(&opt, &argc, &argv);
+                    size_t i = 0, k = sizeof(methods) / sizeof(methods[0]);
+                    while (i < k && strcmp(name, methods[i].name))
+                        i++;
+                    if (i == k) {
+                        fprintf(stderr, "brew: unknown method %s\n", name);
+                        return 1;
+                    }
+                    pool.squeeze = methods[i].squeeze;
+                    break;
+                }
+                case 'q':                   // -qN or -q N
+                    pool.level = (int)strtol(arg(&opt, &argc, &argv), NULL,
+                                             10);
+                    if (pool.level < 0 || pool.level > 11) {
+                        fputs("brew: quality must be 0..11\n", stderr);
+                        return 1;
+                    }
+                    break;
+                case 'c':                   // -copts or -c opts
+                    checks(arg(&opt, &argc, &argv), &pool);
+                    break;
+                case 't':
+                    pool.test = 1;
+                    break;
+                case 'v':
+                    verbose = 1;
+                    break;
+                default:
+                    fprintf(stderr, "brew: unknown option %c\n", *opt);
+            }
+    }
+    return brew(stdin, stdout, size, jobs, &pool, verbose) ? 1 : 0;
+}
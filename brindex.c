@@ -0,0 +1,543 @@
+// brindex.c
+// Copyright (C) 2016 Mark Adler
+// For conditions of distribution and use, see the accompanying LICENSE file.
+//
+// Random access to the uncompressed content of .br files using a chunk index.
+// See brindex.h for the interface.
+//
+// The index is the offset of each chunk header in the .br file and the offset
+// of the start of its uncompressed data in the content.  The header offsets
+// come from the chain of reverse offsets, scanned as braid does.  The same
+// can't be done for the uncompressed lengths, since the forward length field
+// after a brotli stream can't be found without finding the end of that stream,
+// so each chunk is decoded once to get its length, which is then checked
+// against the length field if present.  The index is saved as a sidecar file
+// so that this is only done once.
+//
+// The sidecar file is the signature "brix", followed by forward variable-
+// length integers as in the .br format: the size of the .br file, the XXH32
+// of the .br trailer, the number of chunks, and for each chunk the compressed
+// and uncompressed lengths.  That is followed by the four-byte little-endian
+// XXH32 of the sidecar contents before it.  A sidecar file is used only if the
+// size and trailer of the .br file match.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "brindex.h"
+#include "load.h"
+#include "yeast.h"
+#include "br.h"
+#include "xxhash.h"
+#include "try.h"
+
+#define local static
+
+// Size of the pieces of compressed data fed to the decoder.
+#define CHUNK 65536
+
+// Index of a .br file.  Chunk i has its header at off[i] in the .br file, and
+// its uncompressed data at pos[i] in the content.  off[num] is the offset of
+// the trailer, and pos[num] is the total uncompressed length.
+struct brindex_s {
+    FILE *in;               // .br file
+    uintmax_t size;         // size of the .br file
+    uint32_t print;         // XXH32 of the trailer
+    size_t num;             // number of chunks
+    uintmax_t *off;         // offsets of the headers and trailer (allocated)
+    uintmax_t *pos;         // offsets in the uncompressed data (allocated)
+};
+
+// Return the parity of the low 8 bits of n in the 8th bit.  If this is
+// exclusive-or'ed with n, then the result has even (zero) parity.
+local inline unsigned parity(unsigned n) {
+    return (0x34cb00 >> ((n ^ (n >> 4)) & 0xf)) & 0x80;
+}
+
+// Read bytes from a file backwards.  The byte returned is the one that
+// precedes the current file position.  The file position is left pointing at
+// the byte returned, so that the next call returns the byte before that.
+// Throw an error if at the start of the file or if there is an I/O error.
+local inline unsigned rget1(FILE *in) {
+    int ch;
+    if (ftello(in) == 0 ||
+        fseeko(in, -1, SEEK_CUR) ||
+        (ch = getc(in)) == EOF ||
+        fseeko(in, -1, SEEK_CUR))
+        throw(2, "premature arrival at start of file");
+    return ch;
+}
+
+// Get a bidirectional variable-length number from in, reading backwards.
+local inline uintmax_t getrbvar(FILE *in) {
+    unsigned ch = rget1(in);
+    if ((ch & 0x80) == 0)
+        throw(3, "invalid bidirectional integer");
+    uintmax_t val = ch & 0x7f;
+    do {
+        ch = rget1(in);
+        val = (val << 7) | (ch & 0x7f);
+    } while ((ch & 0x80) == 0);
+    return val;
+}
+
+// Get a forward variable-length unsigned integer from in.
+local inline uintmax_t fgetvar(FILE *in) {
+    uintmax_t val = 0;
+    int ch;
+    unsigned shift = 0;
+    do {
+        ch = getc(in);
+        if (ch == EOF)
+            throw(2, "premature eof");
+        val |= (uintmax_t)(ch & 0x7f) << shift;
+        shift += 7;
+    } while ((ch & 0x80) == 0);
+    return val;
+}
+
+// Type for access to a sequence of bytes in memory with a current pointer.
+typedef struct {
+    unsigned char const *buf;   // bytes
+    size_t next;                // next index to fetch from buffer
+    size_t len;                 // number of bytes in the buffer
+} seq_t;
+
+// Skip n bytes in the sequence.  If there are less than n bytes left, throw an
+// error.
+local inline void skip(seq_t *seq, uintmax_t n) {
+    if (n > seq->len - seq->next)
+        throw(2, "premature eof");
+    seq->next += n;
+}
+
+// Get one byte from the sequence.  Throw an error if there are no more bytes.
+local inline unsigned get1(seq_t *seq) {
+    if (seq->next == seq->len)
+        throw(2, "premature eof");
+    return seq->buf[seq->next++];
+}
+
+// Get a forward variable-length unsigned integer from the sequence.
+local inline uintmax_t getvar(seq_t *seq) {
+    uintmax_t val = 0;
+    unsigned ch;
+    unsigned shift = 0;
+    do {
+        ch = get1(seq);
+        val |= (uintmax_t)(ch & 0x7f) << shift;
+        shift += 7;
+    } while ((ch & 0x80) == 0);
+    return val;
+}
+
+// Append the forward variable-length integer n to buf[], which must have room
+// for ten more bytes, updating *len.
+local void putvar(unsigned char *buf, size_t *len, uintmax_t n) {
+    while (n > 0x7f) {
+        buf[(*len)++] = n & 0x7f;
+        n >>= 7;
+    }
+    buf[(*len)++] = n | 0x80;
+}
+
+// Read len bytes at offset off in the .br file into an allocated buffer.
+local unsigned char *pull(brindex_t *idx, uintmax_t off, uintmax_t len) {
+    if (len != (size_t)len)
+        throw(1, "chunk too large");
+    unsigned char *buf = malloc(len ? len : 1);
+    if (buf == NULL)
+        throw(1, "out of memory");
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = pread(fileno(idx->in), buf + got, len - got, off + got);
+        if (n <= 0) {
+            free(buf);
+            throw(1, "read error");
+        }
+        got += n;
+    }
+    return buf;
+}
+
+// Return the XXH32 of the trailer, from off[num] to the end of the file.
+local uint32_t fingerprint(brindex_t *idx) {
+    unsigned char *buf = pull(idx, idx->off[idx->num],
+                              idx->size - idx->off[idx->num]);
+    uint32_t print = XXH32(buf, idx->size - idx->off[idx->num], 0);
+    free(buf);
+    return print;
+}
+
+// Add the offset at to the list idx->off of idx->num offsets.
+local void add(brindex_t *idx, uintmax_t at) {
+    size_t num = idx->num;
+    if ((num & (num - 1)) == 0) {       // grow at powers of two
+        void *mem = realloc(idx->off, (num ? num << 1 : 1) * sizeof(uintmax_t));
+        if (mem == NULL)
+            throw(1, "out of memory");
+        idx->off = mem;
+    }
+    idx->off[idx->num++] = at;
+}
+
+// Scan the .br file backwards for the offsets of the headers and the trailer,
+// as done by braid, putting them in idx->off[] in increasing order, and
+// setting idx->num to the number of chunks.  Return the total uncompressed
+// length from the trailer, or UINTMAX_MAX if it is not there.  Any errors,
+// including missing reverse offsets, are thrown.
+local uintmax_t scan(brindex_t *idx) {
+    // get the offset of the trailer and the distance to the last header
+    FILE *in = idx->in;
+    fseeko(in, 0, SEEK_END);
+    unsigned trail;
+    while ((trail = rget1(in)) == 0)    // get final trailer mask
+        ;                               // bypass any zero padding
+    if (parity(trail) || (trail & BR_CONTENT_TRAIL) == 0 ||
+        (trail & BR_CONTENT_EXTRA_MASK))
+        throw(3, "invalid format -- bad final trailer mask");
+    if ((trail & BR_CONTENT_CHECK) != 7)
+        fseeko(in, -(1 << (trail & 3)), SEEK_CUR);  // skip check of checks
+    uintmax_t total = UINTMAX_MAX;
+    if (trail & BR_CONTENT_LEN)
+        total = getrbvar(in);           // get total uncompressed length
+    uintmax_t dist = 0;
+    if (trail & BR_CONTENT_OFF)
+        dist = getrbvar(in);            // get distance to last header
+    if (trail != (BR_CONTENT_TRAIL | 7))
+        if (rget1(in) != trail)         // get leading trailer mask
+            throw(3, "invalid format -- trailer mask mismatch");
+    uintmax_t at = ftello(in);          // offset of the trailer
+    if (at > 4 && dist == 0)
+        throw(3, "no final distance to previous header");
+    add(idx, at);
+
+    // go through the string of distances back to the first header
+    while (at > 4) {
+        if (dist > at - 4)
+            throw(3, "invalid format -- incorrect reverse offset");
+        at -= dist;
+        add(idx, at);
+        if (at == 4)
+            break;
+        fseeko(in, at, SEEK_SET);
+        unsigned mask = getc(in);       // header content mask
+        if (parity(mask) || (mask & BR_CONTENT_TRAIL))
+            throw(3, "invalid format -- bad content mask parity");
+        if ((mask & BR_CONTENT_OFF) == 0)
+            throw(3, "missing intermediate distance");
+        dist = fgetvar(in);
+    }
+
+    // put the offsets in increasing order
+    for (size_t i = 0, j = idx->num - 1; i < j; i++, j--) {
+        uintmax_t tmp = idx->off[i];
+        idx->off[i] = idx->off[j];
+        idx->off[j] = tmp;
+    }
+    idx->num--;
+    return total;
+}
+
+// Skip over the chunk header at the start of seq, leaving seq->next at the
+// start of the brotli stream.  Return the content mask.
+local unsigned header(seq_t *seq) {
+    unsigned mask = get1(seq);
+    if (parity(mask) || (mask & BR_CONTENT_TRAIL))
+        throw(3, "invalid format -- bad content mask parity");
+    if (mask & BR_CONTENT_OFF)
+        getvar(seq);                    // reverse offset (already followed)
+    if ((mask & BR_CONTENT_CHECK) == BR_CHECK_ID)
+        get1(seq);                      // check id
+    if (mask & BR_CONTENT_EXTRA_MASK) {
+        unsigned extra = get1(seq);     // extra mask
+        if (parity(extra) || (extra & BR_EXTRA_RESERVED))
+            throw(3, "invalid format -- extra parity");
+        if (extra & BR_EXTRA_MOD)
+            getvar(seq);                // modification time
+        if (extra & BR_EXTRA_NAME)
+            skip(seq, getvar(seq));     // file name
+        if (extra & BR_EXTRA_EXTRA)
+            skip(seq, getvar(seq));     // extra field
+        if (extra & BR_EXTRA_COMPRESSION_MASK)
+            get1(seq);                  // method mask
+        if (extra & BR_EXTRA_CHECK)
+            skip(seq, 2);               // header check
+    }
+    return mask;
+}
+
+// Decode chunk k, writing the bytes at offsets from..to-1 of its uncompressed
+// data to out, stopping once to is reached.  If out is NULL, then the whole
+// chunk is decoded, its length is checked against the length field if there
+// is one, and the length is returned.  Otherwise the number of bytes decoded
+// is returned.
+local uintmax_t decode(brindex_t *idx, size_t k, uintmax_t from,
+                       uintmax_t to, FILE *out) {
+    uintmax_t size = idx->off[k + 1] - idx->off[k];
+    unsigned char *buf = pull(idx, idx->off[k], size);
+    seq_t seq;
+    seq.buf = buf;
+    seq.next = 0;
+    seq.len = size;
+    yeast_t *y = NULL;
+    uintmax_t got = 0;
+    ball_t err;
+    try {
+        unsigned mask = header(&seq);
+        y = yeast_init(NULL, 0);
+        if (y == NULL)
+            throw(1, "out of memory");
+        int ret;
+        do {
+            size_t n = seq.len - seq.next;
+            if (n > CHUNK)
+                n = CHUNK;
+            void const *un;
+            size_t len;
+            do {
+                ret = yeast_feed(y, seq.buf + seq.next, n,
+                                 seq.next + n == seq.len, &un, &len);
+                seq.next += n;
+                n = 0;
+                if (out != NULL && got + len > from && got < to) {
+                    uintmax_t a = got < from ? from - got : 0;
+                    uintmax_t b = got + len > to ? to - got : len;
+                    fwrite((unsigned char const *)un + a, 1, b - a, out);
+                    if (ferror(out))
+                        throw(6, "write error");
+                }
+                got += len;
+            } while (ret == -1 && len && (out == NULL || got < to));
+        } while (ret == -1 && (out == NULL || got < to));
+        if (ret > 0)
+            throw(4, "invalid compressed data");
+        if (out == NULL && (mask & BR_CONTENT_LEN)) {
+            // compare uncompressed length with the length field
+            seq_t rest;
+            rest.buf = yeast_rest(y, &rest.len);
+            rest.next = 0;
+            if (got != getvar(&rest))
+                throw(5, "uncompressed length mismatch");
+        }
+    }
+    always {
+        yeast_end(y);
+        free(buf);
+    }
+    catch (err)
+        punt(err);
+    return got;
+}
+
+// Write the index to the sidecar file at name.  Return 0 on success, or -1 if
+// the file could not be written.
+local int save(brindex_t *idx, char const *name) {
+    unsigned char *buf = malloc(24 + (idx->num + 1) * 20 + 4);
+    if (buf == NULL)
+        return -1;
+    size_t len = 0;
+    memcpy(buf, "brix", 4);
+    len = 4;
+    putvar(buf, &len, idx->size);
+    putvar(buf, &len, idx->print);
+    putvar(buf, &len, idx->num);
+    for (size_t i = 0; i < idx->num; i++) {
+        putvar(buf, &len, idx->off[i + 1] - idx->off[i]);
+        putvar(buf, &len, idx->pos[i + 1] - idx->pos[i]);
+    }
+    uint32_t check = XXH32(buf, len, 0);
+    for (int k = 0; k < 4; k++)
+        buf[len++] = check >> (k << 3);
+    FILE *out = fopen(name, "wb");
+    int ret = out == NULL ? -1 : 0;
+    if (out != NULL) {
+        fwrite(buf, 1, len, out);
+        if (fclose(out) || ret)
+            ret = -1;
+    }
+    free(buf);
+    if (ret)
+        remove(name);
+    return ret;
+}
+
+// Read the index from the sidecar file at name into idx, which has idx->in
+// and idx->size set.  Return 0 on success, or -1 if the file does not exist,
+// is not valid, or does not match the .br file.
+local int restore(brindex_t *idx, char const *name) {
+    FILE *in = fopen(name, "rb");
+    if (in == NULL)
+        return -1;
+    void *dat = NULL;
+    size_t len = 0;
+    int ret = load(in, 0, &dat, NULL, &len);
+    fclose(in);
+    seq_t seq;
+    seq.buf = dat;
+    seq.next = 0;
+    seq.len = len;
+    ball_t err;
+    try {
+        if (ret)
+            throw(1, "could not load index");
+        if (len < 8 || memcmp(seq.buf, "brix", 4))
+            throw(3, "not an index");
+        uint32_t check = seq.buf[len - 4] | (seq.buf[len - 3] << 8) |
+                         (seq.buf[len - 2] << 16) |
+                         ((uint32_t)seq.buf[len - 1] << 24);
+        if (XXH32(seq.buf, len - 4, 0) != check)
+            throw(3, "index check mismatch");
+        seq.len -= 4;
+        seq.next = 4;
+        if (getvar(&seq) != idx->size)
+            throw(3, "index is for a different file");
+        uintmax_t print = getvar(&seq);
+        uintmax_t num = getvar(&seq);
+        if (num > (seq.len - seq.next) / 2)
+            throw(3, "invalid index");
+        idx->num = num;
+        idx->off = malloc((num + 1) * sizeof(uintmax_t));
+        idx->pos = malloc((num + 1) * sizeof(uintmax_t));
+        if (idx->off == NULL || idx->pos == NULL)
+            throw(1, "out of memory");
+        idx->off[0] = 4;
+        idx->pos[0] = 0;
+        for (size_t i = 0; i < num; i++) {
+            idx->off[i + 1] = idx->off[i] + getvar(&seq);
+            idx->pos[i + 1] = idx->pos[i] + getvar(&seq);
+        }
+        if (seq.next != seq.len || idx->off[num] >= idx->size)
+            throw(3, "invalid index");
+        idx->print = fingerprint(idx);
+        if (idx->print != print)
+            throw(3, "index is for a different file");
+        ret = 0;
+    }
+    catch (err) {
+        drop(err);
+        free(idx->off);
+        free(idx->pos);
+        idx->off = NULL;
+        idx->pos = NULL;
+        idx->num = 0;
+        ret = -1;
+    }
+    free(dat);
+    return ret;
+}
+
+// Build the index of the .br file by scanning the reverse offsets for the
+// chunks and decoding each chunk to get its uncompressed length.
+local void build(brindex_t *idx) {
+    uintmax_t total = scan(idx);
+    idx->print = fingerprint(idx);
+    idx->pos = malloc((idx->num + 1) * sizeof(uintmax_t));
+    if (idx->pos == NULL)
+        throw(1, "out of memory");
+    idx->pos[0] = 0;
+    for (size_t i = 0; i < idx->num; i++)
+        idx->pos[i + 1] = idx->pos[i] + decode(idx, i, 0, UINTMAX_MAX, NULL);
+    if (total != UINTMAX_MAX && total != idx->pos[idx->num])
+        throw(5, "uncompressed total length mismatch");
+}
+
+// Open the .br file at path and get its index into idx, either from the
+// sidecar file at name or by building it.  Return 0 on success or an error
+// code on failure.
+local int get(brindex_t *idx, char const *path, char const *name) {
+    ball_t err;
+    try {
+        idx->in = fopen(path, "rb");
+        if (idx->in == NULL)
+            throw(1, "could not open %s", path);
+        unsigned char sig[4];
+        if (fread(sig, 1, 4, idx->in) != 4 || memcmp(sig, BR_SIG, 4))
+            throw(3, "invalid format -- bad signature");
+        fseeko(idx->in, 0, SEEK_END);
+        idx->size = ftello(idx->in);
+        if (restore(idx, name)) {
+            build(idx);
+            save(idx, name);
+        }
+    }
+    catch (err)
+        drop(err);
+    return err.code;
+}
+
+// Open a .br file and get its index.  See brindex.h for description.
+brindex_t *brindex_open(char const *path, int *ret) {
+    brindex_t *idx = malloc(sizeof(brindex_t));
+    char *name = malloc(strlen(path) + sizeof(BRINDEX_SUFFIX));
+    if (idx == NULL || name == NULL) {
+        free(idx);
+        free(name);
+        *ret = 1;
+        return NULL;
+    }
+    strcpy(name, path);
+    strcat(name, BRINDEX_SUFFIX);
+    idx->in = NULL;
+    idx->num = 0;
+    idx->off = NULL;
+    idx->pos = NULL;
+    *ret = get(idx, path, name);
+    free(name);
+    if (*ret) {
+        brindex_close(idx);
+        idx = NULL;
+    }
+    return idx;
+}
+
+// Return the total uncompressed length.  See brindex.h for description.
+uintmax_t brindex_total(brindex_t *idx) {
+    return idx->pos[idx->num];
+}
+
+// Write a range of the uncompressed content.  See brindex.h for description.
+int brindex_read(brindex_t *idx, uintmax_t start, uintmax_t end, FILE *out) {
+    if (end > idx->pos[idx->num])
+        end = idx->pos[idx->num];
+    if (start >= end)
+        return 0;
+
+    ball_t err;
+    try {
+        // find the first chunk that overlaps the range, the last one that
+        // starts at or before start
+        size_t lo = 0, hi = idx->num;
+        while (hi - lo > 1) {
+            size_t mid = (lo + hi) >> 1;
+            if (idx->pos[mid] <= start)
+                lo = mid;
+            else
+                hi = mid;
+        }
+
+        // decode the chunks that overlap the range
+        for (size_t k = lo; k < idx->num && idx->pos[k] < end; k++)
+            decode(idx, k, start > idx->pos[k] ? start - idx->pos[k] : 0,
+                   end - idx->pos[k], out);
+    }
+    catch (err) {
+        int ret = err.code;
+        drop(err);
+        return ret;
+    }
+    return 0;
+}
+
+// Close the .br file and free the index.  See brindex.h for description.
+void brindex_close(brindex_t *idx) {
+    if (idx == NULL)
+        return;
+    if (idx->in != NULL)
+        fclose(idx->in);
+    free(idx->off);
+    free(idx->pos);
+    free(idx);
+}
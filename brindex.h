@@ -0,0 +1,42 @@
+// brindex.h -- header for brindex.c
+// Copyright (C) 2016 Mark Adler
+// For conditions of distribution and use, see the accompanying LICENSE file.
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Random access to the uncompressed content of a .br file, using an index of
+// its chunks.  The chunks are found by following the reverse offsets back
+// from the trailer, so the .br file must have a complete set of them, as
+// written by brand and braid.  Each chunk is an independent brotli stream, so
+// a range of the uncompressed content can be read by decoding only the chunks
+// that overlap the range.
+//
+// brindex_open() opens the .br file at path and gets its index, returning
+// NULL on failure with the reason in *ret, which is 1 for out of memory or an
+// I/O error, 2 for a premature end of the file, 3 for an invalid .br file or
+// missing reverse offsets, 4 for invalid compressed data, or 5 for an
+// uncompressed length that does not match the one in the .br file.  Getting
+// the index the first time requires decoding every chunk to find their
+// uncompressed lengths.  The index is then saved in a sidecar file with the
+// suffix BRINDEX_SUFFIX added to path, which is used by later opens as long
+// as it matches the .br file.  If the sidecar file can't be written, then the
+// index is still returned.
+//
+// brindex_total() returns the total length of the uncompressed content.
+//
+// brindex_read() writes the uncompressed bytes at offsets start..end-1 to out,
+// where end is limited to the total length.  Only the chunks that overlap the
+// range are decoded, and decoding stops once end is reached, so the check
+// values of the chunks are not verified.  brindex_read() returns 0 on success,
+// or one of the error codes above, or 6 for a write error.
+//
+// brindex_close() closes the .br file and frees the index.
+
+#define BRINDEX_SUFFIX ".idx"
+
+typedef struct brindex_s brindex_t;
+brindex_t *brindex_open(char const *path, int *ret);
+uintmax_t brindex_total(brindex_t *idx);
+int brindex_read(brindex_t *idx, uintmax_t start, uintmax_t end, FILE *out);
+void brindex_close(brindex_t *idx);
@@ -0,0 +1,129 @@
+// brine.c
+// Copyright (C) 2016 Mark Adler
+// For conditions of distribution and use, see the accompanying LICENSE file.
+//
+// Compress stdin to a raw brotli stream on stdout using mash.  The entire
+// input is in memory (mapped if stdin is a file).  The result can be wrapped
+// with the framing format by brand, or brew -m mash can be used instead to
+// compress directly to a multiple-chunk .br stream.  The options are:
+//
+//  -q N  - compression level, 0..9, from fastest to smallest (default 6)
+//  -w N  - maximum window bits, 10..24 (default 22)
+//  -g    - make the prefix codes with huffman() and flatten() instead of the
+//          slower, but optimal, pack()
+//  -t    - verify the compressed stream by decoding it with yeast
+//  -v    - write the sizes and the compression time to stderr
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "load.h"
+#include "yeast.h"
+#include "mash.h"
+#include "try.h"
+
+#define local static
+
+// Get the numeric argument for the option at *opt, either the rest of the
+// option or the next argument.  Update *opt, *argc, and *argv to skip over
+// it.
+local int arg(char **opt, int *argc, char ***argv) {
+    char *val = *opt + 1;
+    if (*val == 0 && *argc > 1) {
+        (*argc)--;
+        val = *++*argv;
+    }
+    *opt = val + strlen(val) - 1;
+    return (int)strtol(val, NULL, 10);
+}
+
+// Compress in[0..len-1] to stdout, verifying the result if test is true.
+// Return true on success.
+local int brine(void const *in, size_t len, int level, int wbits, int optimal,
+                int test, int verbose) {
+    unsigned char *out = NULL;
+    size_t got = 0;
+    int ok = 1;
+    ball_t err;
+    try {
+        clock_t start = clock();
+        mash(in, len, level, wbits, optimal, &out, &got);
+        double secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+        if (test) {
+            void *un = (void *)(uintptr_t)in;
+            size_t size = len, used = got;
+            if (yeast(&un, &size, out, &used, 1) || used != got)
+                throw(4, "compressed stream does not decode to the input");
+        }
+        fwrite(out, 1, got, stdout);
+        if (fflush(stdout) || ferror(stdout))
+            throw(6, "write error");
+        if (verbose)
+            fprintf(stderr, "%zu -> %zu (%.2f%%) in %.3f s\n", len, got,
+                    len ? 100. * got / len : 0., secs);
+    }
+    catch (err) {
+        fprintf(stderr, "brine: %s\n", err.why);
+        ok = 0;
+        drop(err);
+    }
+    free(out);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    int level = MASH_LEVEL, wbits = MASH_WBITS, optimal = 1, test = 0,
+        verbose = 0;
+    while (--argc) {
+        char *opt = *++argv;
+        if (*opt != '-') {
+            fprintf(stderr, "brine: %s ignored (not an option)\n", opt);
+            continue;
+        }
+        while (*++opt)
+            switch (*opt) {
+                case 'q':                   // -qN or -q N
+                    level = arg(&opt, &argc, &argv);
+                    if (level < 0 || level > 9) {
+                        fputs("brine: level must be 0..9\n", stderr);
+                        return 1;
+                    }
+                    break;
+                case 'w':                   // -wN or -w N
+                    wbits = arg(&opt, &argc, &argv);
+                    if (wbits < 10 || wbits > 24) {
+                        fputs("brine: window bits must be 10..24\n", stderr);
+                        return 1;
+                    }
+                    break;
+                case 'g':
+                    optimal = 0;
+                    break;
+                case 't':
+                    test = 1;
+                    break;
+                case 'v':
+                    verbose = 1;
+                    break;
+                default:
+                    fprintf(stderr, "brine: unknown option %c\n", *opt);
+            }
+    }
+
+    // load the input
+    void *in;
+    size_t len;
+    int mapped;
+    if (load_map(stdin, 0, &in, &len, &mapped)) {
+        fputs("brine: could not read the input\n", stderr);
+        load_free(in, len, mapped);
+        return 1;
+    }
+
+    // compress, and verify if requested
+    int ok = brine(in, len, level, wbits, optimal, test, verbose);
+    load_free(in, len, mapped);
+    return ok ? 0 : 1;
+}
@@ -4,60 +4,139 @@
 //
 // Decompress and check a wrapped (.br) brotli stream from stdin to stdout.
 // This code is to illustrate and test the use of the .br framing format.  The
-// entire input is loaded into memory, so it is not intended for production
-// use.
+// input is read through a window that is refilled as it is used, and the
+// uncompressed data is checked and written as it is generated, so the memory
+// used depends on the brotli window and meta-block sizes, not on the size of
+// the input.  With -j N, the chunks of a seekable input are found from the
+// reverse offsets and decoded on N threads, and the data of each chunk is
+// written in order once it has been checked.
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <openssl/sha.h>
-#include "load.h"
 #include "yeast.h"
 #include "br.h"
 #include "xxhash.h"
 #include "crc32c.h"
+#include "xxh3.h"
 #include "try.h"
 
 #define local static
 
-// Type for access to a sequence of bytes in memory with a current pointer and
-// an accumulated check value.
+// Size of the pieces of input read, and of compressed data fed to the decoder.
+#define CHUNK 65536
+
+// Type for access to a sequence of bytes from a file through a window in
+// memory, with a current pointer and an accumulated check value.
 typedef struct {
-    unsigned char *buf;     // allocated buffer
+    FILE *in;               // input file
+    int eof;                // true if the end of the input has been reached
+    unsigned char *buf;     // allocated window
     size_t next;            // next index to fetch from buffer
     size_t len;             // number of bytes in the buffer
     size_t size;            // allocated size of buffer for resizing
+    uintmax_t pos;          // offset in the input of buf[0]
     XXH32_state_t check;    // check value state
 } seq_t;
 
 // Initialize a sequence type.
-local inline void seq_init(seq_t *seq) {
+local inline void seq_init(seq_t *seq, FILE *in) {
+    seq->in = in;
+    seq->eof = 0;
     seq->buf = NULL;
     seq->next = 0;
     seq->len = 0;
     seq->size = 0;
+    seq->pos = 0;
     XXH32_reset(&seq->check, 0);
 }
 
+// Make room in the window for at least want bytes from seq->next, dropping
+// the bytes before seq->next.
+local void room(seq_t *seq, size_t want) {
+    size_t have = seq->len - seq->next;
+    if (seq->next) {
+        memmove(seq->buf, seq->buf + seq->next, have);
+        seq->pos += seq->next;
+        seq->len = have;
+        seq->next = 0;
+    }
+    if (want < CHUNK)
+        want = CHUNK;
+    if (seq->size < want) {
+        void *mem = realloc(seq->buf, want);
+        if (mem == NULL)
+            throw(1, "out of memory");
+        seq->buf = mem;
+        seq->size = want;
+    }
+}
+
+// Read more input into the window until there are at least want bytes from
+// seq->next, or the input runs out.  Return the number of bytes available
+// from seq->next.  The last want bytes or more are then contiguous at
+// seq->buf + seq->next.
+local size_t fill(seq_t *seq, size_t want) {
+    if (seq->len - seq->next >= want || seq->eof)
+        return seq->len - seq->next;
+    room(seq, want);
+    while (seq->len < want && !seq->eof) {
+        size_t got = fread(seq->buf + seq->len, 1, seq->size - seq->len,
+                           seq->in);
+        seq->len += got;
+        if (got == 0) {
+            if (ferror(seq->in))
+                throw(1, "read error");
+            seq->eof = 1;
+        }
+    }
+    return seq->len - seq->next;
+}
+
+// Put buf[0..len-1] back in front of seq->next, to be read again.  This is
+// for the input after the end of a brotli stream that was taken by the
+// decoder.  If those bytes are still in the window just before next, then they
+// are simply backed up over.
+local void unget(seq_t *seq, void const *buf, size_t len) {
+    if (len > seq->next) {
+        room(seq, seq->len + len);
+        memmove(seq->buf + len, seq->buf, seq->len);
+        seq->len += len;
+        seq->pos -= len;
+    }
+    else
+        seq->next -= len;
+    memmove(seq->buf + seq->next, buf, len);
+}
+
 // Skip n bytes in the sequence.  If there are less than n bytes left, throw an
 // error and put the pointer at the end.  If check is true, then update
-// seq->check with the skipped bytes.
-local inline void skip(seq_t *seq, size_t n, int check) {
-    size_t pass = seq->len - seq->next;
-    if (pass > n)
-        pass = n;
-    if (check)
-        XXH32_update(&seq->check, seq->buf + seq->next, pass);
-    seq->next += pass;
-    if (pass < n)
-        throw(2, "premature eof");
+// seq->check with the skipped bytes.  If echo is not NULL, then write the
+// skipped bytes to echo.
+local inline void skip(seq_t *seq, uintmax_t n, int check, FILE *echo) {
+    while (n) {
+        size_t pass = fill(seq, 1);
+        if (pass == 0)
+            throw(2, "premature eof");
+        if (pass > n)
+            pass = n;
+        if (check)
+            XXH32_update(&seq->check, seq->buf + seq->next, pass);
+        if (echo != NULL)
+            fwrite(seq->buf + seq->next, 1, pass, echo);
+        seq->next += pass;
+        n -= pass;
+    }
 }
 
 // Get one byte from the sequence.  Throw an error if there are no more bytes.
 // Update the check value with the byte.
 local inline unsigned get1(seq_t *seq) {
-    if (seq->next == seq->len)
+    if (seq->next == seq->len && fill(seq, 1) == 0)
         throw(2, "premature eof");
     XXH32_update(&seq->check, seq->buf + seq->next, 1);
     return seq->buf[seq->next++];
@@ -132,217 +211,706 @@ local uintmax_t get_check(check_t *state, unsigned type) {
            state->crc & mask;
 }
 
+// Running check value of a chunk's uncompressed data, of the type given by
+// the content mask and check id.
+typedef struct {
+    unsigned type;          // content mask check type
+    unsigned id;            // check id if type is BR_CHECK_ID
+    XXH32_state_t xxh32;
+    XXH64_state_t xxh64;
+    uint32_t crc;
+    SHA256_CTX sha;
+    xxh3_t xxh3;
+} sum_t;
+
+// Initialize a check value of type mask & BR_CONTENT_CHECK, and if that is
+// BR_CHECK_ID, of check id id.
+local void sum_init(sum_t *sum, unsigned mask, unsigned id) {
+    sum->type = mask & BR_CONTENT_CHECK;
+    sum->id = id;
+    if (sum->type == 7 && id == BR_CHECKID_XXH3_64)
+        xxh3_init(&sum->xxh3);
+    else if (sum->type == 7)
+        SHA256_Init(&sum->sha);
+    else if (sum->type < 3)
+        XXH32_reset(&sum->xxh32, 0);
+    else if (sum->type == 3)
+        XXH64_reset(&sum->xxh64, 0);
+    else
+        sum->crc = 0;
+}
+
+// Update the check value at arg with buf[0..len-1].  This is the yeast_check()
+// callback, called as the uncompressed data is decoded.
+local void sum_update(void *arg, void const *buf, size_t len) {
+    sum_t *sum = arg;
+    if (sum->type == 7 && sum->id == BR_CHECKID_XXH3_64)
+        xxh3_update(&sum->xxh3, buf, len);
+    else if (sum->type == 7)
+        SHA256_Update(&sum->sha, buf, len);
+    else if (sum->type < 3)
+        XXH32_update(&sum->xxh32, buf, len);
+    else if (sum->type == 3)
+        XXH64_update(&sum->xxh64, buf, len);
+    else
+        sum->crc = crc32c(sum->crc, buf, len);
+}
+
 // Return the parity of the low 8 bits of n in the 8th bit.  If this is
 // exclusive-or'ed with n, then the result has even (zero) parity.
 local inline unsigned parity(unsigned n) {
     return (0x34cb00 >> ((n ^ (n >> 4)) & 0xf)) & 0x80;
 }
 
+// Destination for uncompressed data.  The data is either written to a file as
+// it is generated, or saved in memory to be written later, or if neither,
+// discarded after it is checked.
+typedef struct {
+    FILE *file;             // file to write to, or NULL
+    int save;               // true to save the data in memory if no file
+    unsigned char *buf;     // allocated memory for the saved data
+    size_t len;             // number of bytes saved
+    size_t size;            // allocated size of buf
+} sink_t;
+
+// Initialize a sink.
+local void sink_init(sink_t *sink, FILE *file, int save) {
+    sink->file = file;
+    sink->save = save;
+    sink->buf = NULL;
+    sink->len = 0;
+    sink->size = 0;
+}
+
+// Deliver data[0..len-1] to the sink.
+local void put(sink_t *sink, void const *data, size_t len) {
+    if (sink->file != NULL) {
+        fwrite(data, 1, len, sink->file);
+        if (ferror(sink->file))
+            throw(6, "write error");
+    }
+    else if (sink->save && len) {
+        if (sink->len + len > sink->size) {
+            size_t size = sink->size ? sink->size << 1 : CHUNK;
+            while (size < sink->len + len)
+                size <<= 1;
+            void *mem = realloc(sink->buf, size);
+            if (mem == NULL)
+                throw(1, "out of memory");
+            sink->buf = mem;
+            sink->size = size;
+        }
+        memcpy(sink->buf + sink->len, data, len);
+        sink->len += len;
+    }
+}
+
+// Process the rest of a chunk whose content mask has just been read from seq.
+// curr is the offset of the chunk header, and last is the offset of the
+// previous header, or zero if this is the first one.  The uncompressed data
+// is delivered to sink.  If msg is not NULL, then a description of the chunk
+// is written to msg.  The uncompressed length is returned in *got, and the
+// check value as stored in the chunk is copied to check[], which must have
+// room for 32 bytes.  The length of the check value is returned.
+local unsigned chunk(seq_t *seq, unsigned mask, uintmax_t curr,
+                     uintmax_t last, sink_t *sink, FILE *msg, uintmax_t *got,
+                     unsigned char *check) {
+    if (last == 0 && (mask & BR_CONTENT_OFF))
+        throw(3, "invalid format -- reverse offset in first header");
+    if (msg)
+        fputs("header\n", msg);
+    if (mask & BR_CONTENT_OFF) {        // reverse offset
+        if (curr - last != getvar(seq))
+            throw(3, "invalid format -- incorrect reverse offset");
+        if (msg)
+            fprintf(msg, "  offset %ju to previous header\n", curr - last);
+    }
+    unsigned id = 0;
+    if ((mask & BR_CONTENT_CHECK) == BR_CHECK_ID) {
+        id = get1(seq);                 // check id
+        if (id >= BR_CHECKID_UNKNOWN)
+            throw(3, "invalid format -- unknown check id");
+        if (msg)
+            fprintf(msg, "  check id %u\n", id);
+    }
+    if (mask & BR_CONTENT_EXTRA_MASK) {
+        unsigned extra = get1(seq);     // extra mask
+        if (parity(extra) || (extra & BR_EXTRA_RESERVED))
+            throw(3, "invalid format -- extra parity");
+        if (msg)
+            fputs( "  extra\n", msg);
+        if (extra & BR_EXTRA_MOD) {     // modified time (discard)
+            time_t mod = getvar(seq);
+            if (msg) {
+                mod = mod & 1 ? -(mod >> 1) - 35 : (mod >> 1) - 35;
+                fprintf(msg, "    modification time %s", ctime(&mod));
+            }
+        }
+        if (extra & BR_EXTRA_NAME) {    // file name (discard)
+            uintmax_t n = getvar(seq);
+            if (msg)
+                fputs("    name ", msg);
+            skip(seq, n, 1, msg);
+            if (msg)
+                putc('\n', msg);
+        }
+        if (extra & BR_EXTRA_EXTRA) {   // extra field (discard)
+            uintmax_t n = getvar(seq);
+            if (msg)
+                fprintf(msg, "    extra field of %ju bytes\n", n);
+            skip(seq, n, 1, NULL);
+        }
+        if (extra & BR_EXTRA_COMPRESSION_MASK) {    // method mask
+            unsigned method = get1(seq);
+            if (parity(method) ||
+                (method & (BR_COMPRESSION_METHOD |  // only 0 defined
+                           BR_COMPRESSION_RESERVED)))
+                throw(3, "invalid format -- method parity");
+            if (msg)
+                fprintf(msg, "    method %u, constraints %u\n",
+                        method & 7, (method >> 3) & 7);
+        }
+        if (extra & BR_EXTRA_CHECK) {       // header check
+            unsigned check = XXH32_digest(&seq->check) & 0xffff;
+            if (check != getn(seq, 2))
+                throw(3, "invalid format -- header check mismatch");
+            if (msg)
+                fprintf(msg, "    header check 0x%04x\n", check);
+        }
+    }
+
+    // decompress, check, and deliver, as the uncompressed data is generated
+    yeast_t *y = yeast_init(NULL, 0);
+    if (y == NULL)
+        throw(1, "out of memory");
+    sum_t sum;
+    sum_init(&sum, mask, id);
+    yeast_check(y, sum_update, &sum);
+    unsigned n = (mask & BR_CONTENT_CHECK) != 7 ? 1U << (mask & 3) :
+                 id == BR_CHECKID_XXH3_64 ? 8 : SHA256_DIGEST_LENGTH;
+    ball_t err;
+    try {
+        int ret;
+        size_t used;
+        *got = 0;
+        do {
+            size_t n = fill(seq, 1);
+            if (n > CHUNK)
+                n = CHUNK;
+            void const *un;
+            size_t len;
+            do {
+                ret = yeast_feed(y, seq->buf + seq->next, n,
+                                 seq->eof && seq->next + n == seq->len,
+                                 &un, &len);
+                seq->next += n;
+                n = 0;
+                *got += len;
+                put(sink, un, len);
+            } while (ret == -1 && len);
+        } while (ret == -1);
+        used = yeast_used(y);
+        if (ret)
+            throw(4, "invalid compressed data");
+        {
+            // return the input after the stream to the sequence
+            size_t len;
+            void const *rest = yeast_rest(y, &len);
+            unget(seq, rest, len);
+        }
+        if (msg)
+            fprintf(msg, "  brotli %ju compressed, %ju uncompressed\n",
+                    used, *got);
+
+        // compare uncompressed length with stream
+        if (mask & BR_CONTENT_LEN) {
+            if (*got != getvar(seq))
+                throw(5, "uncompressed length mismatch");
+        }
+
+        // compare check value of uncompressed data with stream
+        if ((mask & BR_CONTENT_CHECK) == 7 && id == BR_CHECKID_SHA256) {
+            unsigned char sha[n];
+            SHA256_Final(sha, &sum.sha);
+            fill(seq, n);
+            skip(seq, n, 0, NULL);
+            if (memcmp(sha, seq->buf + seq->next - n, n))
+                throw(5, "uncompressed check mismatch (SHA-256)");
+            if (msg) {
+                fputs("  SHA-256 0x", msg);
+                for (unsigned k = 0; k < n; k++)
+                    fprintf(msg, "%02x", sha[k]);
+                putc('\n', msg);
+            }
+        }
+        else {
+            uintmax_t check =
+                (mask & BR_CONTENT_CHECK) == 7 ?
+                    xxh3_digest(&sum.xxh3) :
+                (mask & BR_CONTENT_CHECK) < 3 ?
+                    XXH32_digest(&sum.xxh32) :
+                (mask & BR_CONTENT_CHECK) == 3 ?
+                    XXH64_digest(&sum.xxh64) :
+                    sum.crc;
+            if (n < 4)
+                check &= n == 2 ? 0xffff : 0xff;
+            fill(seq, n);                   // contiguous for below
+            if (check != getn(seq, n))
+                throw(5, "uncompressed check mismatch");
+            if (msg)
+                fprintf(msg, "  %s %0*jx\n",
+                        (mask & BR_CONTENT_CHECK) == 7 ? "XXH3-64" :
+                        (mask & BR_CONTENT_CHECK) >= 4 ? "CRC-32C" :
+                        (mask & BR_CONTENT_CHECK) == 3 ? "XXH64" :
+                                                         "XXH32",
+                        2 * n, check);
+        }
+        memcpy(check, seq->buf + seq->next - n, n);
+    }
+    always
+        yeast_end(y);
+    catch (err)
+        punt(err);
+    return n;
+}
+
+// Process the rest of the trailer whose content mask has just been read from
+// seq.  curr is the offset of the trailer, last is the offset of the last
+// header, total is the total uncompressed length, and double_check has the
+// check of the check values of all of the chunks.  If msg is not NULL, then a
+// description of the trailer is written to msg.
+local void trailer(seq_t *seq, unsigned mask, uintmax_t curr, uintmax_t last,
+                   uintmax_t total, check_t *double_check, FILE *msg) {
+    if (mask & BR_CONTENT_EXTRA_MASK)       // no extra on trailer
+        throw(3, "invalid format -- extra on trailer");
+    if (msg)
+        fputs("trailer\n", msg);
+    if (mask & BR_CONTENT_OFF) {            // reverse offset
+        if (curr - last != getbvar(seq))
+            throw(3, "invalid format -- incorrect final reverse offset");
+        if (msg)
+            fprintf(msg, "  offset %ju to previous header\n", curr - last);
+    }
+    if (mask & BR_CONTENT_LEN) {            // uncompressed length
+        if (total != getbvar(seq))
+            throw(5, "uncompressed total length mismatch");
+        if (msg)
+            fprintf(msg, "  total length %ju\n", total);
+    }
+    if ((mask & BR_CONTENT_CHECK) != 7) {   // trailer check of checks
+        uintmax_t check = getn(seq, 1 << (mask & 3));
+        if (get_check(double_check, mask) != check)
+            throw(5, "uncompressed double-check mismatch");
+        if (msg)
+            fprintf(msg, "  total %s %0*jx\n",
+                    (mask & BR_CONTENT_CHECK) >= 4 ? "CRC-32C" :
+                    (mask & BR_CONTENT_CHECK) == 3 ? "XXH64" :
+                                                     "XXH32",
+                    2 << (mask & 3), check);
+    }
+    if ((mask & BR_CONTENT_CHECK) != 7 ||
+        (mask & (BR_CONTENT_LEN | BR_CONTENT_OFF)))
+        if (get1(seq) != mask)              // final trailer content mask
+            throw(3, "invalid format -- trailer mask mismatch");
+}
+
 // Process framed brotli input from in, writing decompressed data to out.
 int broad(FILE *in, FILE *out, int verbose, int write) {
     ball_t err;
     seq_t seq;
-    seq_init(&seq);
+    seq_init(&seq, in);
+    sink_t sink;
+    sink_init(&sink, write ? out : NULL, 0);
+    FILE *msg = verbose ? stderr : NULL;
     uintmax_t total = 0;            // total uncompressed length
     check_t double_check;           // check of individual check values
     update_check(&double_check, NULL, 0);
-    int ret = load(in, 0, (void **)&seq.buf, &seq.size, &seq.len);
     try {
-        if (ret)
-            throw(1, "could not load input");
-
         // check .br signature
         if (getn(&seq, 4) != 0x81cfb2ce)
             throw(3, "invalid format -- bad signature");
 
         // go through sequence of chunks
         unsigned mask;
-        size_t last;                            // offset of last header
-        size_t curr = 0;                        // offset of current header
+        uintmax_t last;                         // offset of last header
+        uintmax_t curr = 0;                     // offset of current header
         for (;;) {
             // update offsets of headers
             last = curr;
-            curr = seq.next;
+            curr = seq.pos + seq.next;
 
-            // process chunk header
+            // process chunk header, or fall out of the loop with a trailer
             XXH32_reset(&seq.check, 0);         // in case of header check
             mask = get1(&seq);                  // content mask
             if (parity(mask))
                 throw(3, "invalid format -- bad content mask parity");
             if (mask & BR_CONTENT_TRAIL)        // trailer
                 break;
-            if (last == 0 && (mask & BR_CONTENT_OFF))
-                throw(3, "invalid format -- reverse offset in first header");
-            if (verbose)
-                fputs("header\n", stderr);
-            if (mask & BR_CONTENT_OFF) {        // reverse offset
-                if (curr - last != getvar(&seq))
-                    throw(3, "invalid format -- incorrect reverse offset");
-                if (verbose)
-                    fprintf(stderr, "  offset %ju to previous header\n",
-                            curr - last);
-            }
-            if ((mask & BR_CONTENT_CHECK) == BR_CHECK_ID) {
-                unsigned id = get1(&seq);       // check id
-                if (id != BR_CHECKID_SHA256)    // only SHA256 defined for now
-                    throw(3, "invalid format -- unknown check id");
-                if (verbose)
-                    fprintf(stderr, "  check id %u\n", id);
-            }
-            if (mask & BR_CONTENT_EXTRA_MASK) {
-                unsigned extra = get1(&seq);    // extra mask
-                if (parity(extra) || (extra & BR_EXTRA_RESERVED))
-                    throw(3, "invalid format -- extra parity");
-                if (verbose)
-                    fputs( "  extra\n", stderr);
-                if (extra & BR_EXTRA_MOD) {     // modified time (discard)
-                    time_t mod = getvar(&seq);
-                    if (verbose) {
-                        mod = mod & 1 ? -(mod >> 1) - 35 : (mod >> 1) - 35;
-                        fprintf(stderr, "    modification time %s",
-                                ctime(&mod));
-                    }
-                }
-                if (extra & BR_EXTRA_NAME) {    // file name (discard)
-                    uintmax_t n = getvar(&seq);
-                    skip(&seq, n, 1);
-                    if (verbose) {
-                        fputs("    name ", stderr);
-                        fwrite(seq.buf + seq.next - n, 1, n, stderr);
-                        putc('\n', stderr);
-                    }
-                }
-                if (extra & BR_EXTRA_EXTRA) {   // extra field (discard)
-                    uintmax_t n = getvar(&seq);
-                    if (verbose)
-                        fprintf(stderr, "    extra field of %ju bytes\n", n);
-                    skip(&seq, n, 1);
-                }
-                if (extra & BR_EXTRA_COMPRESSION_MASK) {    // method mask
-                    unsigned method = get1(&seq);
-                    if (parity(method) ||
-                        (method & (BR_COMPRESSION_METHOD |  // only 0 defined
-                                   BR_COMPRESSION_RESERVED)))
-                        throw(3, "invalid format -- method parity");
-                    if (verbose)
-                        fprintf(stderr, "    method %u, constraints %u\n",
-                                method & 7, (method >> 3) & 7);
-                }
-                if (extra & BR_EXTRA_CHECK) {       // header check
-                    unsigned check = XXH32_digest(&seq.check) & 0xffff;
-                    if (check != getn(&seq, 2))
-                        throw(3, "invalid format -- header check mismatch");
-                    if (verbose)
-                        fprintf(stderr, "    header check 0x%04x\n", check);
-                }
-            }
-
-            // decompress, check, and write
-            void *un = NULL;
-            size_t got, used = seq.len;
-            ret = yeast(&un, &got, seq.buf + seq.next, &used, 0);
-            seq.next += used;
+            uintmax_t got;
+            unsigned char check[32];
+            unsigned n = chunk(&seq, mask, curr, last, &sink, msg, &got,
+                               check);
             total += got;
-            ball_t err;
-            try {
-                if (ret)
-                    throw(4, "invalid compressed data");
-                if (verbose)
-                    fprintf(stderr,
-                            "  brotli %ju compressed, %ju uncompressed\n",
-                            used, got);
-
-                // compare uncompressed length with stream
-                if (mask & BR_CONTENT_LEN) {
-                    if (got != getvar(&seq))
-                        throw(5, "uncompressed length mismatch");
-                }
-
-                // compare check value of uncompressed data with stream
-                unsigned n;
-                if ((mask & BR_CONTENT_CHECK) == 7) {   // SHA-256
-                    n = SHA256_DIGEST_LENGTH;
-                    unsigned char sha[n];
-                    SHA256(un, got, sha);
-                    skip(&seq, n, 0);
-                    if (memcmp(sha, seq.buf + seq.next - n, n))
-                        throw(5, "uncompressed check mismatch (SHA-256)");
-                    if (verbose) {
-                        fputs("  SHA-256 0x", stderr);
-                        for (unsigned k = 0; k < n; k++)
-                            fprintf(stderr, "%02x", sha[k]);
-                        putc('\n', stderr);
-                    }
-                }
-                else {
-                    uintmax_t check =
-                        (mask & BR_CONTENT_CHECK) < 3 ? XXH32(un, got, 0) :
-                        (mask & BR_CONTENT_CHECK) == 3 ? XXH64(un, got, 0) :
-                        crc32c(0, un, got);
-                    n = 1 << (mask & 3);
-                    if (n < 4)
-                        check &= n == 2 ? 0xffff : 0xff;
-                    if (check != getn(&seq, n))
-                        throw(5, "uncompressed check mismatch");
-                    if (verbose)
-                        fprintf(stderr, "  %s %0*jx\n",
-                                (mask & BR_CONTENT_CHECK) >= 4 ? "CRC-32C" :
-                                (mask & BR_CONTENT_CHECK) == 3 ? "XXH64" :
-                                                                 "XXH32",
-                                2 << (mask & 3), check);
-                }
-                update_check(&double_check, seq.buf + seq.next - n, n);
-
-                // write out uncompressed data
-                if (write) {
-                    fwrite(un, 1, got, out);
-                    if (ferror(out))
-                        throw(6, "write error");
-                }
-            }
-            always
-                free(un);
-            catch (err)
-                punt(err);
+            update_check(&double_check, check, n);
+        }
+
+        // process trailer
+        trailer(&seq, mask, curr, last, total, &double_check, msg);
+    }
+    always {
+        free(seq.buf);
+        seq_init(&seq, in);
+    }
+    catch (err) {
+        fprintf(stderr, "broad() error: %s\n", err.why);
+        drop(err);
+        return err.code;
+    }
+    return 0;
+}
+
+// Read bytes from a file backwards.  The byte returned is the one that
+// precedes the current file position.  The file position is left pointing at
+// the byte returned, so that the next call returns the byte before that.
+// Throw an error if at the start of the file or if there is an I/O error.
+local inline unsigned rget1(FILE *in) {
+    int ch;
+    if (ftello(in) == 0 ||
+        fseeko(in, -1, SEEK_CUR) ||
+        (ch = getc(in)) == EOF ||
+        fseeko(in, -1, SEEK_CUR))
+        throw(2, "premature arrival at start of file");
+    return ch;
+}
+
+// Get a bidirectional variable-length number from in, reading backwards.
+local inline uintmax_t getrbvar(FILE *in) {
+    unsigned ch = rget1(in);
+    if ((ch & 0x80) == 0)
+        throw(3, "invalid bidirectional integer");
+    uintmax_t val = ch & 0x7f;
+    do {
+        ch = rget1(in);
+        val = (val << 7) | (ch & 0x7f);
+    } while ((ch & 0x80) == 0);
+    return val;
+}
+
+// Get a forward variable-length unsigned integer from in.
+local inline uintmax_t fgetvar(FILE *in) {
+    uintmax_t val = 0;
+    int ch;
+    unsigned shift = 0;
+    do {
+        ch = getc(in);
+        if (ch == EOF)
+            throw(2, "premature eof");
+        val |= (uintmax_t)(ch & 0x7f) << shift;
+        shift += 7;
+    } while ((ch & 0x80) == 0);
+    return val;
+}
+
+// Add the offset at to the list *off of *num offsets.
+local void add(uintmax_t **off, size_t *num, uintmax_t at) {
+    if ((*num & (*num - 1)) == 0) {     // grow at powers of two
+        void *mem = realloc(*off, (*num ? *num << 1 : 1) * sizeof(uintmax_t));
+        if (mem == NULL)
+            throw(1, "out of memory");
+        *off = mem;
+    }
+    (*off)[(*num)++] = at;
+}
+
+// Scan the .br stream in, which must be seekable, backwards for the offsets
+// of the headers and the trailer, as done by braid.  Return the number of
+// offsets in *num and the offsets in the allocated array *off, in increasing
+// order, where the first is that of the first header (4), and the last is
+// that of the trailer.  If there are no headers, then the trailer offset is
+// the only one.  *off must be NULL and *num zero on entry.  Any errors,
+// including missing reverse offsets, are thrown, with *off left to be freed.
+local void scan(FILE *in, uintmax_t **off, size_t *num) {
+    // get the offset of the trailer and the distance to the last header
+    fseeko(in, 0, SEEK_END);
+    unsigned trail;
+    while ((trail = rget1(in)) == 0)    // get final trailer mask
+        ;                               // bypass any zero padding
+    if (parity(trail) || (trail & BR_CONTENT_TRAIL) == 0 ||
+        (trail & BR_CONTENT_EXTRA_MASK))
+        throw(3, "invalid format -- bad final trailer mask");
+    if ((trail & BR_CONTENT_CHECK) != 7)
+        fseeko(in, -(1 << (trail & 3)), SEEK_CUR);  // skip check of checks
+    if (trail & BR_CONTENT_LEN)
+        getrbvar(in);                   // skip total uncompressed length
+    uintmax_t dist = 0;
+    if (trail & BR_CONTENT_OFF)
+        dist = getrbvar(in);            // get distance to last header
+    if (trail != (BR_CONTENT_TRAIL | 7))
+        if (rget1(in) != trail)         // get leading trailer mask
+            throw(3, "invalid format -- trailer mask mismatch");
+    uintmax_t at = ftello(in);          // offset of the trailer
+    if (at > 4 && dist == 0)
+        throw(3, "no final distance to previous header");
+    add(off, num, at);
+
+    // go through the string of distances back to the first header
+    while (at > 4) {
+        if (dist > at - 4)
+            throw(3, "invalid format -- incorrect reverse offset");
+        at -= dist;
+        add(off, num, at);
+        if (at == 4)
+            break;
+        fseeko(in, at, SEEK_SET);
+        unsigned mask = getc(in);       // header content mask
+        if (parity(mask) || (mask & BR_CONTENT_TRAIL))
+            throw(3, "invalid format -- bad content mask parity");
+        if ((mask & BR_CONTENT_OFF) == 0)
+            throw(3, "missing intermediate distance");
+        dist = fgetvar(in);
+    }
+
+    // put the offsets in increasing order
+    for (size_t i = 0, j = *num - 1; i < j; i++, j--) {
+        uintmax_t tmp = (*off)[i];
+        (*off)[i] = (*off)[j];
+        (*off)[j] = tmp;
+    }
+}
+
+// A chunk to be decoded by a worker thread.
+typedef struct {
+    uintmax_t off;          // offset of the chunk header
+    uintmax_t end;          // offset of the next header or the trailer
+    uintmax_t last;         // offset of the previous header, or zero
+    sink_t sink;            // saved uncompressed data
+    char *msg;              // description of the chunk (allocated), or NULL
+    size_t msg_len;         // length of the description
+    uintmax_t got;          // uncompressed length
+    unsigned char check[32];    // check value as stored
+    unsigned n;             // length of the check value
+    int code;               // zero, or the error code
+    char *why;              // error message if code is not zero (allocated)
+    int done;               // true when the chunk has been processed
+} job_t;
+
+// Work shared by the worker threads and the thread writing the output.
+typedef struct {
+    pthread_mutex_t lock;   // lock for next, written, stop, and done's
+    pthread_cond_t cond;    // signaled when a job is done or written
+    int fd;                 // input file descriptor
+    int verbose;            // true to describe the chunks
+    job_t *job;             // the jobs, in order
+    size_t num;             // number of jobs
+    size_t next;            // next job to take
+    size_t written;         // number of jobs written out
+    size_t ahead;           // maximum number of jobs not yet written
+    int stop;               // true to take no more jobs
+    pthread_t *tid;         // worker threads (allocated)
+    int threads;            // number of worker threads started
+} pool_t;
+
+// Read and decode the chunk for job, saving the results in job.
+local void run(pool_t *pool, job_t *job) {
+    seq_t seq;
+    seq_init(&seq, NULL);
+    FILE *msg = NULL;
+    ball_t err;
+    try {
+        // load the chunk
+        uintmax_t len = job->end - job->off;
+        if (len != (size_t)len)
+            throw(1, "chunk too large");
+        seq.buf = malloc(len);
+        if (seq.buf == NULL)
+            throw(1, "out of memory");
+        seq.size = len;
+        while (seq.len < len) {
+            ssize_t got = pread(pool->fd, seq.buf + seq.len, len - seq.len,
+                                job->off + seq.len);
+            if (got <= 0)
+                throw(1, "read error");
+            seq.len += got;
+        }
+        seq.pos = job->off;
+        seq.eof = 1;
+        if (pool->verbose) {
+            msg = open_memstream(&job->msg, &job->msg_len);
+            if (msg == NULL)
+                throw(1, "out of memory");
         }
+    }
+    preserve {
+        // decode the chunk, which must end exactly at the next header
+        unsigned mask = get1(&seq);
+        if (parity(mask) || (mask & BR_CONTENT_TRAIL))
+            throw(3, "invalid format -- bad content mask parity");
+        job->n = chunk(&seq, mask, job->off, job->last, &job->sink, msg,
+                       &job->got, job->check);
+        if (seq.next != seq.len)
+            throw(3, "invalid format -- incorrect reverse offset");
+    }
+    always {
+        free(seq.buf);
+        if (msg != NULL)
+            fclose(msg);
+    }
+    catch (err) {
+        job->code = err.code;
+        job->why = strdup(err.why);
+        drop(err);
+    }
+}
+
+// Worker thread: take jobs in order and run them, staying no more than
+// pool->ahead jobs ahead of the output.
+local void *worker(void *arg) {
+    pool_t *pool = arg;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->stop && pool->next < pool->num &&
+               pool->next >= pool->written + pool->ahead)
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        if (pool->stop || pool->next == pool->num)
+            break;
+        job_t *job = pool->job + pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+        run(pool, job);
+        pthread_mutex_lock(&pool->lock);
+        job->done = 1;
+        pthread_cond_broadcast(&pool->cond);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
 
-        // fell out of the loop above with a trailer mask -- process trailer
-        if (mask & BR_CONTENT_EXTRA_MASK)       // no extra on trailer
-            throw(3, "invalid format -- extra on trailer");
+// Process framed brotli input from in, writing decompressed data to out, as
+// for broad(), but decoding the chunks on jobs threads.  The chunks are found
+// by following the reverse offsets back from the trailer, so in must be a
+// seekable file with a complete set of reverse offsets.  If it isn't, then
+// the input is processed serially by broad().  The uncompressed data of each
+// chunk is held in memory until it is written, with up to twice jobs chunks
+// in progress at a time.
+int broad_jobs(FILE *in, FILE *out, int verbose, int write, int jobs) {
+    // find the chunks, or if that can't be done, decode serially
+    if (fseeko(in, 0, SEEK_END)) {
         if (verbose)
-            fputs("trailer\n", stderr);
-        if (mask & BR_CONTENT_OFF) {            // reverse offset
-            if (curr - last != getbvar(&seq))
-                throw(3, "invalid format -- incorrect final reverse offset");
-            if (verbose)
-                fprintf(stderr, "  offset %ju to previous header\n",
-                        curr - last);
+            fputs("broad: input not seekable -- decoding serially\n", stderr);
+        return broad(in, out, verbose, write);
+    }
+    uintmax_t *off = NULL;
+    size_t num = 0;
+    {
+        ball_t err;
+        try {
+            scan(in, &off, &num);
         }
-        if (mask & BR_CONTENT_LEN) {            // uncompressed length
-            if (total != getbvar(&seq))
-                throw(5, "uncompressed total length mismatch");
+        catch (err) {
             if (verbose)
-                fprintf(stderr, "  total length %ju\n", total);
+                fprintf(stderr, "broad: %s -- decoding serially\n", err.why);
+            drop(err);
+            free(off);
+            if (fseeko(in, 0, SEEK_SET)) {
+                fputs("broad() error: could not rewind input\n", stderr);
+                return 1;
+            }
+            return broad(in, out, verbose, write);
         }
-        if ((mask & BR_CONTENT_CHECK) != 7) {   // trailer check of checks
-            uintmax_t check = getn(&seq, 1 << (mask & 3));
-            if (get_check(&double_check, mask) != check)
-                throw(5, "uncompressed double-check mismatch");
-            if (verbose)
-                fprintf(stderr, "  total %s %0*jx\n",
-                        (mask & BR_CONTENT_CHECK) >= 4 ? "CRC-32C" :
-                        (mask & BR_CONTENT_CHECK) == 3 ? "XXH64" :
-                                                         "XXH32",
-                        2 << (mask & 3), check);
+    }
+
+    // set up the jobs and start the threads
+    pool_t pool;
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.cond, NULL);
+    pool.fd = fileno(in);
+    pool.verbose = verbose;
+    pool.num = num - 1;
+    pool.job = calloc(pool.num ? pool.num : 1, sizeof(job_t));
+    pool.next = 0;
+    pool.written = 0;
+    pool.ahead = 2 * (size_t)jobs;
+    pool.stop = 0;
+    if (pool.job == NULL) {
+        free(off);
+        fputs("broad() error: out of memory\n", stderr);
+        return 1;
+    }
+    for (size_t i = 0; i < pool.num; i++) {
+        pool.job[i].off = off[i];
+        pool.job[i].end = off[i + 1];
+        pool.job[i].last = i ? off[i - 1] : 0;
+        sink_init(&pool.job[i].sink, NULL, write);
+    }
+    pool.tid = malloc(jobs * sizeof(pthread_t));
+    pool.threads = 0;
+    if (pool.tid != NULL)
+        while (pool.threads < jobs &&
+               pthread_create(pool.tid + pool.threads, NULL, worker,
+                              &pool) == 0)
+            pool.threads++;
+
+    // write the chunks in order as they are completed, then process the
+    // trailer
+    seq_t seq;
+    seq_init(&seq, in);
+    ball_t err;
+    try {
+        uintmax_t total = 0;        // total uncompressed length
+        check_t double_check;       // check of individual check values
+        update_check(&double_check, NULL, 0);
+        if (pool.threads == 0)
+            throw(1, "could not start threads");
+        for (size_t i = 0; i < pool.num; i++) {
+            job_t *job = pool.job + i;
+            pthread_mutex_lock(&pool.lock);
+            while (!job->done)
+                pthread_cond_wait(&pool.cond, &pool.lock);
+            pthread_mutex_unlock(&pool.lock);
+            if (job->msg != NULL)
+                fwrite(job->msg, 1, job->msg_len, stderr);
+            if (job->code)
+                throw(job->code, "%s", job->why);
+            if (write && job->sink.len) {
+                fwrite(job->sink.buf, 1, job->sink.len, out);
+                if (ferror(out))
+                    throw(6, "write error");
+            }
+            total += job->got;
+            update_check(&double_check, job->check, job->n);
+            free(job->sink.buf);
+            job->sink.buf = NULL;
+            pthread_mutex_lock(&pool.lock);
+            pool.written++;
+            pthread_cond_broadcast(&pool.cond);
+            pthread_mutex_unlock(&pool.lock);
         }
-        if ((mask & BR_CONTENT_CHECK) != 7 ||
-            (mask & (BR_CONTENT_LEN | BR_CONTENT_OFF)))
-            if (get1(&seq) != mask)             // final trailer content mask
-                throw(3, "invalid format -- trailer mask mismatch");
+        if (fseeko(in, off[pool.num], SEEK_SET))
+            throw(1, "could not seek to trailer");
+        seq.pos = off[pool.num];
+        unsigned mask = get1(&seq);
+        if (parity(mask) || (mask & BR_CONTENT_TRAIL) == 0)
+            throw(3, "invalid format -- bad content mask parity");
+        trailer(&seq, mask, off[pool.num], pool.num ? off[pool.num - 1] : 0,
+                total, &double_check, verbose ? stderr : NULL);
     }
     always {
+        pthread_mutex_lock(&pool.lock);
+        pool.stop = 1;
+        pthread_cond_broadcast(&pool.cond);
+        pthread_mutex_unlock(&pool.lock);
+        for (int i = 0; i < pool.threads; i++)
+            pthread_join(pool.tid[i], NULL);
+        free(pool.tid);
+        for (size_t i = 0; i < pool.num; i++) {
+            free(pool.job[i].sink.buf);
+            free(pool.job[i].msg);
+            free(pool.job[i].why);
+        }
+        free(pool.job);
+        free(off);
         free(seq.buf);
-        seq_init(&seq);
+        pthread_cond_destroy(&pool.cond);
+        pthread_mutex_destroy(&pool.lock);
     }
     catch (err) {
         fprintf(stderr, "broad() error: %s\n", err.why);
@@ -355,6 +923,7 @@ int broad(FILE *in, FILE *out, int verbose, int write) {
 int main(int argc, char **argv) {
     int verbose = 0;
     int write = 1;
+    int jobs = 1;
     while (--argc) {
         char *opt = *++argv;
         if (*opt != '-') {
@@ -369,10 +938,23 @@ int main(int argc, char **argv) {
                 case 't':
                     write = 0;
                     break;
+                case 'j':                   // -jN or -j N
+                    if (opt[1] == 0 && argc > 1) {
+                        argc--;
+                        opt = *++argv - 1;
+                    }
+                    jobs = (int)strtol(opt + 1, &opt, 10);
+                    opt--;
+                    if (jobs < 1)
+                        jobs = 1;
+                    break;
                 default:
                     fprintf(stderr, "broad: unknown option %c\n", *opt);
             }
     }
-    broad(stdin, stdout, verbose, write);
+    if (jobs > 1)
+        broad_jobs(stdin, stdout, verbose, write, jobs);
+    else
+        broad(stdin, stdout, verbose, write);
     return 0;
 }
@@ -0,0 +1,767 @@
+/*
+ * brofuzz.cc
+ * Copyright (C) 2016 Mark Adler
+ * For conditions of distribution and use, see the accompanying LICENSE file.
+ *
+ * brofuzz is a differential fuzzer for brotli decoders.  Random brotli
+ * streams are made in memory with brolib and decoded in the same process by
+ * yeast() in write mode, by yeast() in compare mode against its own output
+ * and against that output with one byte changed, by the reference brotli
+ * decoder when compiled with BROTLIDEC, and by the yeast-02.c decoder, linked
+ * here as yeast02().  yeast() and the reference decoder must agree on whether
+ * each stream is valid, and on the output when it is.  yeast-02.c decodes
+ * the earlier draft 02 of the format, so half of the streams are made from
+ * the subset of the format that draft 02 decodes the same way, and those must
+ * decode with yeast02() to the same output if they are not damaged.  That
+ * subset has no window sizes less than 16 or equal to 17, no metadata, an
+ * ignored copy length of 4 for a command that completes a meta-block, and no
+ * run lengths longer than a context map, or complex codes for four or fewer
+ * symbols, which could have a code length code with just one length.  The
+ * streams for yeast02() also avoid the insert and copy symbol 703, which trips
+ * an assert() in yeast-02.c.  A stream on which they do not agree is written
+ * to brofuzz-<seed>-<n>.br for examination with brogen's decoder tools, e.g.
+ * deb -v.
+ *
+ * The reference decoder rejects simple prefix codes with repeated symbols,
+ * which the specification permits and yeast() accepts.  That difference can
+ * appear in damaged streams, and is counted separately as a known difference.
+ *
+ * Most of the streams are valid, made by tracking the output and all of the
+ * decoder state that determines which codes and distances are used: block
+ * types and counts, context maps, literal and distance contexts, and the last
+ * distances.  The lengths, distances, codes, and headers are all random.  A
+ * quarter of the streams are then damaged by flipping bits, truncating, or
+ * appending to them, and some are random bits after the WBITS header, in
+ * order to exercise the detection of invalid streams.
+ *
+ * brofuzz [-n count] [-s seed] does count streams (default 10000) starting
+ * with the given seed (default 1).  The exit status is 1 if there were any
+ * disagreements.
+ */
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+using namespace std;
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "brolib.h"         // Brotli stream generator
+#include "huff.h"           // Huffman algorithm to make an optimal prefix code
+#include "flatten.h"        // Flatten a prefix code to a maximum bit length
+extern "C" {
+#include "yeast.h"          // yeast()
+int yeast02(void **dest, size_t *got, void const *source, size_t *len,
+            int cmp);
+}
+#ifdef BROTLIDEC
+#  include <brotli/decode.h>
+#endif
+
+#define local static
+#include "context.h"        // context[][], literal context lookup
+#include "dict.h"           // dict[], the static dictionary
+
+// Pseudo-random number generator (xorshift64*), so that a run can be repeated
+// from its seed.
+class rng {
+public:
+    rng(uint64_t seed = 1) : x(seed ? seed : 1) {}
+    uint64_t next() {
+        x ^= x >> 12;
+        x ^= x << 25;
+        x ^= x >> 27;
+        return x * 2685821657736338717ULL;
+    }
+
+    // Return a random integer in 0..n-1 (n > 0).
+    uint64_t below(uint64_t n) { return (next() >> 11) % n; }
+
+    // Return a random integer in lo..hi.
+    uint64_t range(uint64_t lo, uint64_t hi) {
+        return lo + below(hi - lo + 1);
+    }
+
+    // Return true with probability pct/100.
+    bool chance(unsigned pct) { return below(100) < pct; }
+
+    // Return a random integer in 1..n, usually small.
+    uint64_t small(uint64_t n) {
+        uint64_t m = chance(70) ? 16 : chance(70) ? 512 : n;
+        return range(1, m < n ? m : n);
+    }
+
+private:
+    uint64_t x;
+};
+
+// Insert lengths, copy lengths, and block lengths codes.
+local unsigned const ins_base[] = {
+    0, 1, 2, 3, 4, 5, 6, 8, 10, 14, 18, 26, 34, 50, 66, 98, 130, 194, 322,
+    578, 1090, 2114, 6210, 22594};
+local unsigned char const ins_extra[] = {
+    0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 7, 8, 9, 10, 12, 14,
+    24};
+local unsigned const copy_base[] = {
+    2, 3, 4, 5, 6, 7, 8, 9, 10, 12, 14, 18, 22, 30, 38, 54, 70, 102, 134, 198,
+    326, 582, 1094, 2118};
+local unsigned char const copy_extra[] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 7, 8, 9, 10, 24};
+local unsigned const blen_base[] = {
+    1, 5, 9, 13, 17, 25, 33, 41, 49, 65, 81, 97, 113, 145, 177, 209, 241, 305,
+    369, 497, 753, 1265, 2289, 4337, 8433, 16625};
+local unsigned char const blen_extra[] = {
+    2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 7, 8, 9, 10, 11, 12,
+    13, 24};
+
+// Insert and copy code cells of 64 symbols: insert and copy code offsets.
+local unsigned char const cell_ins[] = {0, 0, 0, 0, 8, 8, 0, 16, 8, 16, 16};
+local unsigned char const cell_copy[] = {0, 8, 0, 8, 0, 8, 16, 0, 16, 8, 16};
+
+// Number of bits in the word index for each dictionary word length.
+local unsigned char const ndbits[] = {
+    0, 0, 0, 0, 10, 10, 11, 11, 10, 10, 10, 10, 10, 9, 9, 8, 7, 7, 8, 7, 7, 6,
+    6, 5, 5};
+
+// Maximum length of a generated meta-block.
+#define MAXMETA 70000
+
+// Random stream maker, tracking the output and decoder state as it goes.
+class maker {
+public:
+    // Make a random stream in gen, and put the expected output in result.
+    // If draft is true, use only the draft 02 subset of the format.  Return
+    // false if the stream is not intended to be valid.
+    bool make(rng& r, brogen& gen, vector<uint8_t>& result, bool draft);
+
+private:
+    // State for one of the three categories of block types.
+    struct category {
+        unsigned num;                   // number of block types
+        unsigned type, prev;            // current and previous block types
+        size_t left;                    // symbols left in this block
+        long types, counts;             // ids of the type and count codes
+        vector<unsigned short> tsyms, csyms;    // symbols in those codes
+    };
+
+    rng *rnd;
+    brogen *g;
+    vector<uint8_t> *out;               // output so far
+    bool draft;                         // true for the draft 02 subset
+    long next_id;                       // next prefix code id
+    unsigned wbits;                     // window bits
+    unsigned ring[4];                   // last distances, ring[0] most recent
+    category lit, iac, dist;            // block type categories
+    unsigned postfix, direct, dists;    // distance parameters
+    unsigned char mode[256];            // literal context modes
+    vector<unsigned char> lit_map, dist_map;
+    vector<long> lit_ids, iac_ids, dist_ids;
+    vector<vector<unsigned short> > lit_syms, iac_syms;
+    vector<unsigned short> syms;        // work space for symbols
+
+    void code(vector<unsigned short>& set, unsigned num, long id);
+    void pick(vector<unsigned short>& set, unsigned num, unsigned k);
+    long define(vector<unsigned short>& set, unsigned num);
+    void sym(long id, vector<unsigned short> const& set, unsigned *val);
+    void count(category& c);
+    void header(category& c);
+    void next(category& c);
+    void context_map(vector<unsigned char>& map, size_t len, unsigned trees);
+    void dist_code(size_t d, unsigned *code, uint64_t *extra,
+                   unsigned *nbits);
+    void compressed(size_t mlen);
+    void distance(unsigned len, size_t limit, bool implicit);
+};
+
+// Write a random description of a prefix code with id for the distinct
+// symbols in set, each less than num.
+void maker::code(vector<unsigned short>& set, unsigned num, long id) {
+    unsigned abits = 1;
+    while ((1U << abits) < num)
+        abits++;
+    size_t k = set.size();
+    if (k == 1 || (k <= 4 && (draft || rnd->chance(70)))) {
+        unsigned short s[4];
+        copy(set.begin(), set.end(), s);
+        g->simple(id, k == 4 && rnd->chance(50) ? 5 : k, abits, s);
+        return;
+    }
+
+    // make a complex code from random frequencies
+    vector<unsigned short> len(k);
+    for (auto& f : len)
+        f = rnd->chance(20) ? rnd->range(1, 1000) : rnd->range(1, 20);
+    sort(len.begin(), len.end());
+    huffman(len.data(), len.data(), k);
+    if (len[0] > 15)
+        flatten(len.data(), k, 15);
+    brogen::desc_t desc;
+    for (size_t n = 0; n < k; n++)
+        desc.push_back(make_pair(len[n], set[n]));
+    g->complex(id, desc);
+}
+
+// Set set to k random distinct symbols less than num, or all of them if k is
+// num or more.
+void maker::pick(vector<unsigned short>& set, unsigned num, unsigned k) {
+    syms.resize(num);
+    for (unsigned n = 0; n < num; n++)
+        syms[n] = n;
+    if (k > num)
+        k = num;
+    for (unsigned n = 0; n < k; n++)
+        swap(syms[n], syms[n + rnd->below(num - n)]);
+    set.assign(syms.begin(), syms.begin() + k);
+}
+
+// Write a code for set with symbols less than num and return its id.
+long maker::define(vector<unsigned short>& set, unsigned num) {
+    long id = next_id++;
+    code(set, num, id);
+    return id;
+}
+
+// Write a random symbol from set using code id, and return it in *val.
+void maker::sym(long id, vector<unsigned short> const& set, unsigned *val) {
+    *val = set[rnd->below(set.size())];
+    g->prefix(id, *val);
+}
+
+// Write a block count for category c and set its left.
+void maker::count(category& c) {
+    unsigned s;
+    sym(c.counts, c.csyms, &s);
+    uint64_t extra = rnd->below((uint64_t)1 << blen_extra[s]);
+    g->bits(blen_extra[s], extra);
+    c.left = blen_base[s] + extra;
+}
+
+// Write the block types header for category c.
+void maker::header(category& c) {
+    c.num = rnd->chance(75) ? 1 : rnd->range(2, 4);
+    c.type = 0;
+    c.prev = 1;
+    c.left = (size_t)0 - 1;
+    g->types(c.num);
+    if (c.num > 1) {
+        pick(c.tsyms, c.num + 2, rnd->range(1, c.num + 2));
+        c.types = define(c.tsyms, c.num + 2);
+        pick(c.csyms, rnd->chance(80) ? 8 : 26, rnd->range(1, 4));
+        c.counts = define(c.csyms, 26);
+        count(c);
+    }
+}
+
+// Switch to the next block type for category c if its block is used up.
+void maker::next(category& c) {
+    if (c.left == 0) {
+        unsigned s, type;
+        sym(c.types, c.tsyms, &s);
+        type = s == 0 ? c.prev : s == 1 ? (c.type + 1) % c.num : s - 2;
+        c.prev = c.type;
+        c.type = type;
+        count(c);
+    }
+    c.left--;
+}
+
+// Write a random context map of len entries for trees codes, and save it in
+// map.  Runs of zeros are coded when the map has them.
+void maker::context_map(vector<unsigned char>& map, size_t len,
+                        unsigned trees) {
+    map.assign(len, 0);
+    g->types(trees);
+    if (trees == 1)
+        return;
+    for (auto& m : map)
+        m = rnd->chance(50) ? 0 : rnd->below(trees);
+
+    unsigned rlemax = rnd->chance(50) ? 0 : rnd->range(1, 4);
+    while (draft && ((size_t)1 << rlemax) > len)
+        rlemax--;
+    g->bits(1, rlemax != 0);
+    if (rlemax)
+        g->bits(4, rlemax - 1);
+    vector<unsigned short> set;
+    pick(set, rlemax + trees, rlemax + trees);
+    long id = define(set, rlemax + trees);
+    for (size_t n = 0; n < len;) {
+        if (map[n] || rlemax == 0) {
+            g->prefix(id, map[n] ? map[n] + rlemax : 0);
+            n++;
+            continue;
+        }
+        size_t run = 1;
+        while (n + run < len && map[n + run] == 0 &&
+               run < ((size_t)2 << rlemax) - 1)
+            run++;
+        if (run == 1)
+            g->prefix(id, 0);
+        else {
+            unsigned s = 1;
+            while (((size_t)2 << s) <= run)
+                s++;
+            g->prefix(id, s);
+            g->bits(s, run - ((size_t)1 << s));
+        }
+        n += run;
+    }
+    g->bits(1, 0);                      // no inverse move-to-front
+}
+
+// Set *code, *extra, and *nbits to the distance code and the extra bits that
+// code the distance d, without using the last distances.
+void maker::dist_code(size_t d, unsigned *code, uint64_t *extra,
+                      unsigned *nbits) {
+    if (d <= direct) {
+        *code = 15 + d;
+        *extra = 0;
+        *nbits = 0;
+        return;
+    }
+    d -= direct + 1;
+    unsigned lcode = d & ((1U << postfix) - 1);
+    uint64_t y = (d >> postfix) + 4;
+    unsigned top = 63 - __builtin_clzll(y);
+    *nbits = top - 1;
+    unsigned hcode = (y >> *nbits) & 1;
+    *extra = y & (((uint64_t)1 << *nbits) - 1);
+    *code = 16 + direct + (((2 * (*nbits - 1) + hcode) << postfix) + lcode);
+}
+
+// Write a distance for a copy of len bytes, where the maximum back reference
+// distance is limit, and then do the copy.  If implicit, then use the last
+// distance without writing anything.
+void maker::distance(unsigned len, size_t limit, bool implicit) {
+    size_t d = 0;
+    unsigned code = 0;
+    bool last = false, word = false;
+    if (implicit)
+        d = ring[0];
+    else {
+        // pick a distance
+        next(dist);
+        unsigned tree = dist_map[(dist.type << 2) + (len > 4 ? 3 : len - 2)];
+        if (rnd->chance(25)) {
+            // try one of the last distance codes
+            unsigned c = rnd->below(16);
+            long v = c < 4 ? ring[c] :
+                     (long)ring[c < 10 ? 0 : 1] +
+                     ((c - 4) % 6 & 1 ? 1 : -1) * (long)((c - 4) % 6 / 2 + 1);
+            if (v >= 1 && (size_t)v <= limit) {
+                d = v;
+                code = c;
+                last = true;
+            }
+        }
+        if (d == 0 && len >= 4 && len <= 24 && rnd->chance(10)) {
+            // dictionary word with the identity transform
+            size_t id = rnd->below((size_t)1 << ndbits[len]);
+            d = limit + 1 + id;
+            word = true;
+        }
+        if (d == 0)
+            d = rnd->chance(70) ? rnd->range(1, limit < 64 ? limit : 64) :
+                                  rnd->range(1, limit);
+
+        // write it
+        uint64_t extra = 0;
+        unsigned nbits = 0;
+        if (!last)
+            dist_code(d, &code, &extra, &nbits);
+        g->prefix(dist_ids[tree], code);
+        g->bits(nbits, extra);
+        if (code != 0 && !word) {
+            ring[3] = ring[2];
+            ring[2] = ring[1];
+            ring[1] = ring[0];
+            ring[0] = d;
+        }
+    }
+
+    // do the copy
+    if (word) {
+        size_t off = 0;
+        for (unsigned n = 4; n < len; n++)
+            off += (size_t)n << ndbits[n];
+        off += (d - limit - 1) * len;
+        out->insert(out->end(), dict + off, dict + off + len);
+    }
+    else
+        for (unsigned n = 0; n < len; n++)
+            out->push_back((*out)[out->size() - d]);
+}
+
+// Write a compressed meta-block of mlen bytes after its lead-in.
+void maker::compressed(size_t mlen) {
+    header(lit);
+    header(iac);
+    header(dist);
+    postfix = rnd->chance(70) ? 0 : rnd->below(4);
+    direct = rnd->chance(70) ? 0 : rnd->below(16);
+    g->bits(2, postfix);
+    g->bits(4, direct);
+    direct <<= postfix;
+    dists = 16 + direct + (48 << postfix);
+    for (unsigned n = 0; n < lit.num; n++) {
+        mode[n] = rnd->below(4);
+        g->bits(2, mode[n]);
+    }
+    unsigned trees = rnd->chance(60) ? 1 : rnd->range(2, 5);
+    context_map(lit_map, lit.num << 6, trees);
+    unsigned dtrees = rnd->chance(70) ? 1 : rnd->range(2, 3);
+    context_map(dist_map, dist.num << 2, dtrees);
+
+    // literal, insert and copy, and distance codes
+    lit_ids.resize(trees);
+    lit_syms.resize(trees);
+    for (unsigned n = 0; n < trees; n++) {
+        pick(lit_syms[n], 256, rnd->chance(30) ? 256 : rnd->range(1, 40));
+        lit_ids[n] = define(lit_syms[n], 256);
+    }
+    iac_ids.resize(iac.num);
+    iac_syms.resize(iac.num);
+    for (unsigned n = 0; n < iac.num; n++) {
+        // always have the commands 136 (insert 1, copy 2) and 144 (insert 2,
+        // copy 2), and 138 and 146 with copy 4 for draft 02, so that any
+        // remaining length can be done
+        auto& set = iac_syms[n];
+        pick(set, draft ? 703 : 704, rnd->range(1, 30));
+        for (unsigned short s : {136, 144, 138, 146})
+            if ((draft || s == 136 || s == 144) &&
+                find(set.begin(), set.end(), s) == set.end())
+                set.push_back(s);
+        iac_ids[n] = define(set, 704);
+    }
+    dist_ids.resize(dtrees);
+    vector<unsigned short> all;
+    for (unsigned n = 0; n < dtrees; n++) {
+        pick(all, dists, dists);
+        dist_ids[n] = define(all, dists);
+    }
+
+    // commands
+    size_t left = mlen;
+    size_t maxd = ((size_t)1 << wbits) - 16;
+    while (left) {
+        // pick a command that fits
+        next(iac);
+        auto const& set = iac_syms[iac.type];
+        unsigned s = 0, ic = 0, cc = 0;
+        bool end = false, fit = false;
+        for (int tries = 0; tries < 8 && !fit; tries++) {
+            s = set[rnd->below(set.size())];
+            unsigned cell = s >> 6;
+            ic = cell_ins[cell] + ((s >> 3) & 7);
+            cc = cell_copy[cell] + (s & 7);
+            size_t lo = ins_base[ic], hi = lo + ((1U << ins_extra[ic]) - 1);
+            size_t pos = out->size() + lo;
+            bool copy = lo + copy_base[cc] <= left &&
+                        (cell >= 2 ? pos > 0 : ring[0] <= (pos < maxd ?
+                                                           pos : maxd));
+            bool stop = lo <= left && hi >= left && (!draft || cc == 2);
+            if (copy || stop) {
+                fit = true;
+                end = !copy || (stop && rnd->chance(10));
+            }
+        }
+        if (!fit) {
+            end = left <= 2;
+            ic = left == 2 ? 2 : 1;
+            cc = end && draft ? 2 : 0;
+            s = 128 + (ic << 3) + cc;
+        }
+        g->prefix(iac_ids[iac.type], s);
+
+        // pick the lengths and write them
+        size_t ins, cpy;
+        if (end) {
+            ins = left;
+            cpy = copy_base[cc] + rnd->below((uint64_t)1 << copy_extra[cc]);
+        }
+        else {
+            size_t most = left - copy_base[cc] - ins_base[ic];
+            size_t room = ((size_t)1 << ins_extra[ic]) - 1;
+            ins = ins_base[ic] + rnd->below((room < most ? room : most) + 1);
+            most = left - ins - copy_base[cc];
+            room = ((size_t)1 << copy_extra[cc]) - 1;
+            cpy = copy_base[cc] + rnd->below((room < most ? room : most) + 1);
+        }
+        g->bits(ins_extra[ic], ins - ins_base[ic]);
+        g->bits(copy_extra[cc], cpy - copy_base[cc]);
+
+        // literals
+        for (size_t n = 0; n < ins; n++) {
+            next(lit);
+            size_t at = out->size();
+            unsigned p1 = at ? (*out)[at - 1] : 0;
+            unsigned p2 = at > 1 ? (*out)[at - 2] : 0;
+            unsigned m = mode[lit.type];
+            unsigned id = context[m][p1] | context[m][256 + p2];
+            unsigned tree = lit_map[(lit.type << 6) + id];
+            unsigned val;
+            sym(lit_ids[tree], lit_syms[tree], &val);
+            out->push_back(val);
+        }
+        left -= ins;
+
+        // copy
+        if (!end) {
+            size_t pos = out->size();
+            distance(cpy, pos < maxd ? pos : maxd, (s >> 6) < 2);
+            left -= cpy;
+        }
+    }
+}
+
+bool maker::make(rng& r, brogen& gen, vector<uint8_t>& result, bool sub) {
+    rnd = &r;
+    draft = sub;
+    g = &gen;
+    out = &result;
+    next_id = 0;
+    ring[0] = 4;
+    ring[1] = 11;
+    ring[2] = 15;
+    ring[3] = 16;
+    gen.clear();
+    result.clear();
+
+    do {
+        wbits = r.chance(50) ? r.range(16, 22) : r.range(10, 24);
+    } while (draft && (wbits < 16 || wbits == 17));
+    gen.wbits(wbits);
+    if (r.chance(5)) {
+        // random bits
+        for (unsigned n = r.range(1, 64); n; n--)
+            gen.bits(32, r.next());
+        return false;
+    }
+
+    // meta-blocks
+    for (unsigned blocks = r.range(1, 4); blocks; blocks--) {
+        bool last = blocks == 1;
+        unsigned kind = r.below(100);
+        if (draft && kind >= 90)
+            kind = last ? 80 : 0;
+        if (last && kind >= 75) {
+            if (kind < 90)
+                gen.empty(-1);
+            else {
+                gen.last(1);
+                gen.empty(0);
+                gen.lit(NULL, 0);
+            }
+            break;
+        }
+        gen.last(last);
+        if (kind < 75 || last) {
+            size_t mlen = r.small(MAXMETA);
+            gen.meta(mlen);
+            compressed(mlen);
+        }
+        else if (kind < 90) {
+            size_t n = r.small(MAXMETA);
+            gen.uncmeta(n);
+            size_t at = result.size();
+            for (size_t k = 0; k < n; k++)
+                result.push_back(r.next() >> 56);
+            gen.lit(result.data() + at, n);
+        }
+        else {
+            size_t n = r.below(100);
+            uint8_t meta[100];
+            for (size_t k = 0; k < n; k++)
+                meta[k] = r.next() >> 56;
+            gen.empty(n);
+            gen.lit(meta, n);
+        }
+    }
+    return true;
+}
+
+// Full decoding result.
+struct result {
+    int ret;                    // return code, zero for success
+    bool same;                  // reference: rejected repeated simple symbols
+    vector<uint8_t> data;       // decompressed data if successful
+};
+
+// Decode comp with yeast(), and check that it compares equal to its output,
+// and not to that output with a byte changed.  Return a description of a
+// problem, or NULL if none.
+local char const *yeast_decode(vector<uint8_t> const& comp, result& res,
+                               rng& r) {
+    void *dest = NULL;
+    size_t got = 0, len = comp.size();
+    res.ret = yeast(&dest, &got, comp.data(), &len, 0);
+    res.data.assign((uint8_t *)dest, (uint8_t *)dest + (res.ret ? 0 : got));
+    char const *why = NULL;
+    if (res.ret == 0) {
+        len = comp.size();
+        size_t have = got;
+        if (yeast(&dest, &have, comp.data(), &len, 1) != 0)
+            why = "yeast compare of its own output failed";
+        else if (got) {
+            size_t at = r.below(got);
+            ((uint8_t *)dest)[at] ^= 1 + r.below(255);
+            have = got;
+            len = comp.size();
+            if (yeast(&dest, &have, comp.data(), &len, 1) != 4)
+                why = "yeast compare of a changed output did not mismatch";
+        }
+    }
+    free(dest);
+    return why;
+}
+
+// Decode comp with yeast02().
+local void yeast02_decode(vector<uint8_t> const& comp, result& res) {
+    void *dest = NULL;
+    size_t got = 0, len = comp.size();
+    res.ret = yeast02(&dest, &got, comp.data(), &len, 0);
+    res.data.assign((uint8_t *)dest, (uint8_t *)dest + (res.ret ? 0 : got));
+    free(dest);
+}
+
+#ifdef BROTLIDEC
+// Decode comp with the reference decoder.
+local void ref_decode(vector<uint8_t> const& comp, result& res) {
+    BrotliDecoderState *s = BrotliDecoderCreateInstance(NULL, NULL, NULL);
+    size_t avail_in = comp.size(), avail_out, total;
+    uint8_t const *next_in = comp.data();
+    uint8_t buf[16384], *next_out;
+    BrotliDecoderResult ret;
+    res.data.clear();
+    do {
+        next_out = buf;
+        avail_out = sizeof(buf);
+        ret = BrotliDecoderDecompressStream(s, &avail_in, &next_in, &avail_out,
+                                            &next_out, &total);
+        res.data.insert(res.data.end(), buf, next_out);
+    } while (ret == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT);
+    res.ret = ret != BROTLI_DECODER_RESULT_SUCCESS;
+    res.same = BrotliDecoderGetErrorCode(s) ==
+               BROTLI_DECODER_ERROR_FORMAT_SIMPLE_HUFFMAN_SAME;
+    if (res.ret)
+        res.data.clear();
+    BrotliDecoderDestroyInstance(s);
+}
+#endif
+
+// Damage the stream in comp.
+local void damage(vector<uint8_t>& comp, rng& r) {
+    switch (r.below(4)) {
+        case 0:
+        case 1:
+            if (comp.size())
+                for (unsigned n = r.range(1, 3); n; n--)
+                    comp[r.below(comp.size())] ^= 1 << r.below(8);
+            break;
+        case 2:
+            comp.resize(r.below(comp.size() + 1));
+            break;
+        case 3:
+            for (unsigned n = r.range(1, 8); n; n--)
+                comp.push_back(r.next() >> 56);
+    }
+}
+
+// Save the stream in comp as brofuzz-seed-n.br.
+local void save(vector<uint8_t> const& comp, uint64_t seed, unsigned long n) {
+    char name[64];
+    snprintf(name, sizeof(name), "brofuzz-%llu-%lu.br",
+             (unsigned long long)seed, n);
+    FILE *f = fopen(name, "wb");
+    if (f == NULL || fwrite(comp.data(), 1, comp.size(), f) != comp.size())
+        cerr << "could not write " << name << '\n';
+    if (f != NULL)
+        fclose(f);
+    cerr << "  saved as " << name << '\n';
+}
+
+int main(int argc, char **argv) {
+    // interpret the options
+    unsigned long count = 10000;
+    uint64_t seed = 1;
+    while (++argv, --argc) {
+        if (strcmp(*argv, "-n") == 0 && argc > 1) {
+            count = strtoul(*++argv, NULL, 0);
+            argc--;
+        }
+        else if (strcmp(*argv, "-s") == 0 && argc > 1) {
+            seed = strtoull(*++argv, NULL, 0);
+            argc--;
+        }
+        else {
+            cerr << "usage: brofuzz [-n count] [-s seed]\n";
+            return 1;
+        }
+    }
+
+    // make and decode the streams
+    rng r(seed);
+    brogen gen;
+    maker make;
+    vector<uint8_t> expect, comp;
+    result ours, old, ref;
+    unsigned long valid = 0, invalid = 0, drafts = 0, known = 0, bad = 0;
+    for (unsigned long n = 0; n < count; n++) {
+        bool draft = r.chance(50);
+        bool made = make.make(r, gen, expect, draft);
+        comp = gen.stream();
+        bool damaged = r.chance(25);
+        if (damaged)
+            damage(comp, r);
+
+        // decode and compare
+        char const *why = yeast_decode(comp, ours, r);
+        if (why == NULL && made && !damaged &&
+            (ours.ret || ours.data != expect))
+            why = "yeast did not decode an undamaged stream as made";
+#ifdef BROTLIDEC
+        ref_decode(comp, ref);
+        if (why == NULL && ref.ret && ours.ret == 0 && ref.same)
+            known++;
+        else if (why == NULL && ref.ret != (ours.ret != 0))
+            why = ours.ret ?
+                "reference accepted a stream that yeast rejected" :
+                "reference rejected a stream that yeast accepted";
+        else if (why == NULL && ours.ret == 0 && ref.data != ours.data)
+            why = "yeast and reference output differ";
+#endif
+        old.ret = -1;
+        if (draft && made && !damaged) {
+            yeast02_decode(comp, old);
+            drafts++;
+            if (why == NULL && old.ret)
+                why = "yeast-02 rejected a draft 02 stream";
+            if (why == NULL && old.data != ours.data)
+                why = "yeast and yeast-02 output differ";
+        }
+        if (ours.ret)
+            invalid++;
+        else
+            valid++;
+        if (why != NULL) {
+            cerr << "stream " << n << " (yeast " << ours.ret << ", yeast-02 "
+                 << old.ret;
+#ifdef BROTLIDEC
+            cerr << ", reference " << ref.ret;
+#endif
+            cerr << "): " << why << '\n';
+            save(comp, seed, n);
+            bad++;
+        }
+    }
+    cout << count << " streams (" << valid << " valid, " << invalid <<
+            " invalid, " << drafts << " also decoded by yeast-02), ";
+    if (known)
+        cout << known << " known difference" << (known == 1 ? "" : "s") <<
+                ", ";
+    cout << bad << " disagreement" << (bad == 1 ? "" : "s") << '\n';
+    return bad != 0;
+}
@@ -4,7 +4,13 @@
  * For conditions of distribution and use, see the accompanying LICENSE file.
  *
  * brogen.cc is a command-driven generator of brotli streams for the purpose of
- * testing brotli decompressors.
+ * testing brotli decompressors.  The streams are made by brolib, which can be
+ * used directly to make streams without parsing commands.
+ *
+ * brogen -p makes the code length codes of complex prefix codes with the
+ * optimal length-limited pack() instead of huffman() and flatten().  The
+ * streams can then be shorter, though they will differ from those with the
+ * default.
  */
 
 #include <iostream>
@@ -12,14 +18,14 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <limits>
 using namespace std;
 
 #include <ctype.h>
 #include <limits.h>
 #include <assert.h>
 
-#include "huff.h"           // Huffman algorithm to make an optimal prefix code
-#include "flatten.h"        // Flatten a prefix code to a maximum bit length
+#include "brolib.h"         // Brotli stream generator
 
 // Command numbers for switch statement.
 enum command {
@@ -82,6 +88,12 @@ const char help[] =
     "# - starts a comment (ignore the rest of the line)\n"
     "help; - Show this help (semicolon makes it execute immediately)\n";
 
+// Return the value of the hexadecimal digit ch (digittoint() is not available
+// everywhere).
+int hexval(int ch) {
+    return isdigit(ch) ? ch - '0' : tolower(ch) - 'a' + 10;
+}
+
 // Return true if ch could be the first character of a natural number.
 int isnum(int ch) {
     return isdigit(ch) || ch == '-' || ch == '+';
@@ -163,18 +175,18 @@ vector<long> getlit(bool ok) {
                         {
                             int val = 0;
                             while (ch = cin.peek(), isxdigit(ch))
-                                val = (val << 4) + digittoint(cin.get());
+                                val = (val << 4) + hexval(cin.get());
                             // no limit on hex digits in C standard (go figure)
                             ch = val & 0xff;
                             break;
                         }
                         default:
                             if (ch >= '0' && ch <= '7') {   // octal
-                                int val = digittoint(ch);
+                                int val = hexval(ch);
                                 int count = 1;
                                 while (ch = cin.peek(),
                                        ch >= '0' && ch <= '7') {
-                                    val = (val << 3) + digittoint(cin.get());
+                                    val = (val << 3) + hexval(cin.get());
                                     if (++count == 3)
                                         break;  // limit of three octal digits
                                 }
@@ -214,311 +226,6 @@ int getparm(vector<long>& vec, long& parm, long def, long low, long high,
     return 0;
 }
 
-// Output n bits from val.  If n is negative (or there are no arguments), write
-// out any remaining bits in the buffer followed by the low bits of val, if
-// needed, clearing the buffer.  Between calls there are never more than seven
-// bits in the bit buffer.
-inline void bout(int n = -1, unsigned val = 0) {
-    static unsigned bitbuf = 0;     // unwritten bits
-    static int bits = 0;            // number of bits in bitbuf
-
-    // if requested, write out any remaining bits
-    if (n < 0) {
-        if (bits) {
-            bitbuf += val << bits;
-            cout << (unsigned char)bitbuf;
-            bitbuf = 0;
-            bits = 0;
-        }
-        return;
-    }
-
-    // append and write whole bytes
-    while (n >= 8) {
-        bitbuf += (val & 0xff) << bits;
-        val >>= 8;
-        n -= 8;
-        cout << (unsigned char)bitbuf;
-        bitbuf >>= 8;
-    }
-
-    // append any remaining bits, write a byte if we have one
-    if (n) {
-        bitbuf += (val & ((1U << n) - 1)) << bits;
-        bits += n;
-        if (bits >= 8) {
-            cout << (unsigned char)bitbuf;
-            bitbuf >>= 8;
-            bits -= 8;
-        }
-    }
-}
-
-// Prefix code map type for encoding.
-typedef pair <
-    unsigned short,     // number of bits in the code (0..15)
-    unsigned short      // code in reversed order for ready placement in stream
-> code_t;
-typedef map <
-    unsigned short,     // the key is the symbol value (0..703)
-    code_t              // code for that symbol
-> prefix_t;
-
-// Create an encoding from a canonical description, assumed to be complete and
-// not empty, and where the longest code is assumed to fit in an unsigned
-// short.  count[k] is the number of codes with k bits.  *symbol is the list of
-// symbols in order from the shortest code to the longest code, sorted by
-// symbol value within each code length.  This does not check for repeated
-// symbols -- if a symbol is repeated, then only the last (longest) will be
-// found when looking up that symbol.
-prefix_t encode(unsigned short *count, unsigned short const *symbol) {
-    prefix_t encoding;
-    unsigned n = 0;
-    code_t code(0, 0);
-    do {
-        while (count[code.first] == 0)
-            code.first++;
-        encoding[symbol[n++]] = code;
-        count[code.first]--;
-        unsigned bit = 1U << code.first;    // increment code backwards
-        while (bit >>= 1) {
-            code.second ^= bit;
-            if (code.second & bit)
-                break;
-        }
-    } while (code.second);
-    return encoding;
-}
-
-// Write a simple code description to cout and return the encoding.  The type
-// is in 1..5 and bits is the number of bits required to represent the alphabet
-// of symbols (implied by the context in which the code appears).  symbol[] is
-// the list of symbols to code, with type symbols unless type is 5, in which
-// case there are four symbols.
-prefix_t simple(unsigned type, unsigned bits, unsigned short *symbol) {
-    // implied number of symbols
-    unsigned num = type == 5 ? 4 : type;
-
-    // write out code description
-    bout(2, 1);
-    bout(2, num - 1);
-    for (unsigned n = 0; n < num; n++)
-        bout(bits, symbol[n]);
-    if (num >= 4)
-        bout(1, type - 4);
-
-    // build and return encoding table for this code -- the sorting is required
-    // to make the code canonical (the symbols may not be provided in sorted
-    // order)
-    unsigned short count[4] = {0};
-    switch (type) {
-        case 1:
-            count[0] = 1;
-            break;
-        case 2:
-            count[1] = 2;
-            sort(symbol, symbol + 2);
-            break;
-        case 3:
-            count[1] = 1;
-            count[2] = 2;
-            sort(symbol + 1, symbol + 3);
-            break;
-        case 4:
-            count[2] = 4;
-            sort(symbol, symbol + 4);
-            break;
-        case 5:
-            count[1] = 1;
-            count[2] = 1;
-            count[3] = 2;
-            sort(symbol + 2, symbol + 4);
-    }
-    return encode(count, symbol);
-}
-
-// Description of a code, where each pair is a bit length and a symbol value.
-typedef pair<unsigned short, unsigned short> sym_t;
-typedef vector<sym_t> desc_t;
-
-// Write a complex code description to cout and return the encoding.  The code
-// is assumed to be complete with all lengths in the range 1..15.
-prefix_t complex(desc_t& desc) {
-    // sort by symbols
-    sort(desc.begin(), desc.end(),
-         [] (sym_t& a, sym_t& b) {
-             return a.second < b.second;
-         });
-
-    // make a list of instructions to describe the code, making use of
-    // run-length encoding where possible
-    vector<pair<unsigned char, unsigned char> > inst;
-    {
-        unsigned rep = 0;       // number of times len repeated
-        unsigned len = 0;       // length repeated if rep > 0
-        unsigned last = 8;      // last non-zero length emitted
-
-        // function to emit a run of rep len's (brings rep to 0)
-        auto emit = [&] () {
-            while (rep) {
-                if (rep < 3 || len != last) {
-                    inst.push_back(make_pair(len, 0));
-                    last = len;
-                    rep--;
-                }
-                if (rep >= 3) {
-                    // nested coding of repeat of last length
-                    unsigned dig[8];        // enough for 15-bit codes
-                    unsigned num = 0;
-                    rep -= 2;
-                    do {
-                        dig[num++] = --rep & 3;
-                        rep >>= 2;
-                    } while (rep);
-                    do {
-                        inst.push_back(make_pair(16, dig[--num]));
-                    } while (num);
-                }
-            }
-        };
-
-        // go through sorted symbols, generating lengths and runs (make use of
-        // runs greedily)
-        unsigned next = 0;          // next symbol after last encountered
-        for (auto& x : desc) {
-            // if skipping symbols, then code zeros
-            if (next < x.second) {
-                emit();             // emit last length run, if any
-                auto zeros = x.second - next;
-                if (zeros < 3)
-                    do {
-                        inst.push_back(make_pair(0, 0));
-                    } while (--zeros);
-                else {
-                    // nested codings of repeats of zeros
-                    unsigned dig[5];    // enough for 15-bit codes
-                    unsigned num = 0;
-                    zeros -= 2;
-                    do {
-                        dig[num++] = --zeros & 7;
-                        zeros >>= 3;
-                    } while (zeros);
-                    do {
-                        inst.push_back(make_pair(17, dig[--num]));
-                    } while (num);
-                }
-                next = x.second;
-            }
-
-            // accumulate this length, emitting the last one if different
-            if (rep && len != x.first)
-                emit();             // brings rep to zero
-            len = x.first;
-            rep++;
-            next++;
-        }
-        emit();                     // emit final length run
-    }
-
-    // create a code for the instructions in inst (0..17)
-    desc_t instdesc;
-    prefix_t instcode;
-    {
-        // count the occurrences of each instruction
-        unsigned short freq[18] = {0};
-        for (auto& x : inst)
-            freq[x.first]++;
-
-        // make a list of instructions that appear at least once
-        for (int n = 0; n < 18; n++)
-            if (freq[n])
-                instdesc.push_back(make_pair(freq[n], n));
-
-        // make the instructions code
-        if (instdesc.size() > 1) {
-            // make a Huffman code for the instructions from the frequencies,
-            // limiting the longest code to five bits
-            sort(instdesc.begin(), instdesc.end()); // sort frequencies
-            unsigned syms = 0;
-            for (auto& x : instdesc)
-                freq[syms++] = x.first;
-            huffman(freq, freq, syms);              // in place, freq -> length
-            int ret = flatten(freq, syms, 5);       // limit codes to length 5
-            assert(ret == 0);
-            for (unsigned n = 0; n < syms; n++)
-                instdesc[n].first = freq[n];
-            sort(instdesc.begin(), instdesc.end()); // canonicalize
-            unsigned short count[6] = {0};          // counts for each length
-            vector<unsigned short> symbol;          // symbols in length order
-            for (auto& x : instdesc) {
-                count[x.first]++;
-                symbol.push_back(x.second);
-            }
-            instcode = encode(count, symbol.data());
-        }
-        else {
-            // a single symbol encoded with zero bits
-            instdesc[0].first = 3;              // shortest code (that or 4)
-            instcode[instdesc[0].second] = make_pair(0, 0);
-        }
-    }
-
-    // write out the description of the instructions code
-    {
-        // make the list of lengths to send in permuted order
-        unsigned char const order[] = {
-            4, 0, 1, 2, 3, 5, 7, 9, 10, 11, 12, 13, 14, 15, 16, 17, 8, 6
-        };
-        unsigned char list[18] = {0};
-        for (auto& x : instdesc)
-            list[order[x.second]] = x.first;
-
-        // determine start and end of list to send -- start becomes the lead-in
-        // to the complex code description (0, 2, or 3)
-        unsigned start = list[0] || list[1] ? 0 : list[2] ? 2 : 3;
-        bout(2, start);
-        unsigned end = 17;
-        if (instdesc.size() > 1)            // entire list if only one symbol
-            while (end && list[end] == 0)
-                end--;                      // else drop zeros off the end
-
-        // generate fixed encoding for lengths of instruction codes
-        unsigned short count[] = {0, 0, 3, 1, 2};
-        unsigned short const symbol[] = {0, 3, 4, 2, 1, 5};
-        auto lencode = encode(count, symbol);
-
-        // write out instruction code bit lengths using the code
-        for (unsigned n = start; n <= end; n++) {
-            auto code = lencode.find(list[n]);
-            assert(code != lencode.end());
-            bout(code->second.first, code->second.second);
-        }
-    }
-
-    // write out instructions for the code using the code lengths code
-    for (auto& x : inst) {
-        auto code = instcode.find(x.first);
-        assert(code != instcode.end());
-        bout(code->second.first, code->second.second);
-        if (x.first > 15)
-            bout(x.first - 14, x.second);   // extra bits for 16 or 17
-    }
-
-    // generate and return the encoding for this code
-    {
-        sort(desc.begin(), desc.end());     // canonicalize
-        unsigned short count[16] = {0};     // counts for each length
-        vector<unsigned short> symbol;      // symbols in length order
-        for (auto& x : desc) {
-            count[x.first]++;
-            symbol.push_back(x.second);
-        }
-        return encode(count, symbol.data());
-    }
-}
-
-#define MAXSYMS 704     // symbol values must be in 0..703
-
 // Process commands from stdin, write resulting bit stream to stdout.  Each
 // command consists of a command name optionally followed by a series of
 // literal values which can be numbers (decimal, hexadecimal, or octal), or
@@ -528,9 +235,16 @@ prefix_t complex(desc_t& desc) {
 // file is encountered.  If desired, a semicolon can be used to complete a
 // command and execute it.  A hash mark (#) starts a comment, which goes to the
 // end of that line.
-int main() {
+int main(int argc, char **argv) {
     auto decode = commands();               // build map for command decoding
-    map <long, prefix_t> codes;             // to save defined prefix codes
+    brogen gen;                             // stream being generated
+    while (--argc) {
+        string opt = *++argv;
+        if (opt == "-p")
+            gen.optimal(true);
+        else
+            cerr << "! unknown option " << opt << " (ignored)\n";
+    }
     long last = 0;                          // true for the last block
     string token, rest;
     while (token = rest, rest.resize(0), !token.empty() || cin >> token) {
@@ -571,100 +285,53 @@ int main() {
                 if (getparm(lit, p, 1, 0, LONG_BIT-1, "bits count") |
                     getparm(lit, q, 0, 0, (1 << p) - 1, "bits value"))
                     break;  // (deliberate use of |, to get both parameters)
-                bout(p, (unsigned)q);
+                gen.bits(p, (unsigned)q);
                 break;
             case BOUND:
                 p = 0;
                 getparm(lit, p, 0, 0, 127, "bound fill bits");
-                bout(-1, p);
+                gen.bound(p);
                 break;
             case WBITS:                     // WBITS
                 if (getparm(lit, p, 16, 10, 24, "wbits"))
                     break;
-                bout(1, p == 16 ? 0 : 1);
-                if (p != 16) {
-                    bout(3, p < 18 ? 0 : p - 17);
-                    if (p < 18)
-                        bout(3, p == 17 ? 0 : p - 8);
-                }
+                gen.wbits(p);
                 break;
             case LAST:                      // set last for next block
                 getparm(lit, last, 1, 0, 1, "last");
+                gen.last(last);
                 break;
             case META:
                 if (getparm(lit, p, 1, 1, 1L << 24, "meta-block length"))
                     break;
-                if (last)
-                    bout(2, 1);             // ISLAST, not empty
-                else
-                    bout(1, 0);             // not last
-                q = p > (1 << 16) ? p > (1 << 20) ? 6 : 5 : 4;
-                bout(2, q - 4);             // MNIBBLES (0..2)
-                bout(q << 2, p - 1);        // MLEN
-                if (!last)
-                    bout(1, 0);             // compressed
+                gen.meta(p);
                 break;
             case UNCMETA:
                 if (getparm(lit, p, 1, 1, 1L << 24, "meta-block length"))
                     break;
-                if (last) {
+                if (!gen.uncmeta(p))
                     cerr << "last block cannot be uncompressed\n";
-                    break;
-                }
-                bout(1, 0);                 // not last
-                q = p > (1 << 16) ? p > (1 << 20) ? 6 : 5 : 4;
-                bout(2, q - 4);             // MNIBBLES (0..2)
-                bout(q << 2, p - 1);        // MLEN
-                bout(1, 1);                 // ISUNCOMPRESSED
                 break;
             case EMPTY:
                 if (getparm(lit, p, 0, -1, 1L << 24, "meta-data length"))
                     break;
-                if (last || p == -1) {
-                    if (p == -1) {
-                        bout(2, 3);         // ISLAST, ISLASTEMPTY
-                        break;
-                    }
-                    bout(2, 1);             // ISLAST, not empty (though it is)
-                }
-                else
-                    bout(1, 0);             // not last
-                bout(2, 3);                 // MNIBBLES: meta-data follows
-                bout(1, 0);                 // reserved bit
-                q = p > 0 ? p > (1 << 8) ? p > (1L << 16) ? 3 : 2 : 1 : 0;
-                bout(2, q);                 // MSKIPBYTES
-                bout(q << 3, p - 1);        // MSKIPLEN
+                gen.empty(p);
                 break;
-            case LIT:
-                bout();                     // go to byte boundary
-                for (auto& x : lit)
-                    cout << (char)x;        // write out the given bytes
+            case LIT: {
+                vector<uint8_t> data(lit.begin(), lit.end());
+                gen.lit(data.data(), data.size());  // at a byte boundary
                 lit.clear();
                 break;
+            }
             case TYPES:                     // NBLTYPESx
                 if (getparm(lit, p, 1, 1, 256, "number of block types"))
                     break;
-                bout(1, p > 1 ? 1 : 0);
-                if (p > 1) {
-                    q = 0;
-                    while ((1 << (q + 1)) < p)
-                        q++;
-                    bout(3, q);
-                    if (q)
-                        bout(q, p - 1 - (1 << q));
-                }
+                gen.types(p);
                 break;
             case LEN:
                 if (getparm(lit, p, 0, 0, 5, "code length"))
                     break;
-                switch (p) {
-                    case 0:  bout(2, 0);  break;
-                    case 1:  bout(4, 7);  break;
-                    case 2:  bout(3, 3);  break;
-                    case 3:  bout(2, 2);  break;
-                    case 4:  bout(2, 1);  break;
-                    case 5:  bout(4, 0xf);  break;
-                }
+                gen.len(p);
                 break;
             case SIMPLE: {
                 long id, type, bits;
@@ -701,7 +368,7 @@ int main() {
                 lit.clear();
 
                 // write code description and save encoding
-                codes[id] = simple(type, bits, syms.data());
+                gen.simple(id, type, bits, syms.data());
                 break;
             }
             case COMPLEX: {
@@ -711,7 +378,7 @@ int main() {
 
                     // get code description as length/symbol pairs, check
                     // content
-                    desc_t desc;
+                    brogen::desc_t desc;
                     {
                         vector<bool> have (MAXSYMS, false);
                         bool bad = false;
@@ -747,7 +414,7 @@ int main() {
                     }
 
                     // write out the code description and return its encoding
-                    codes[id] = complex(desc);
+                    gen.complex(id, desc);
                 }
                 else {
                     cerr << "invalid code id or missing symbol -- skipping\n";
@@ -758,16 +425,11 @@ int main() {
             case PREFIX: {
                 long id;
                 if (getparm(lit, id, 0, LONG_MIN, LONG_MAX, "id") == 0) {
-                    auto encoding = codes.find(id);
-                    if (encoding != codes.end()) {
-                        for (auto& sym : lit) {
-                            auto code = encoding->second.find(sym);
-                            if (code != encoding->second.end())
-                                bout(code->second.first, code->second.second);
-                            else
+                    if (gen.defined(id)) {
+                        for (auto& sym : lit)
+                            if (!gen.prefix(id, sym))
                                 cerr << "symbol " << sym <<
                                 " not found in code " << id << "\n";
-                        }
                     }
                     else
                         cerr << "code " << id << " not found\n";
@@ -788,5 +450,6 @@ int main() {
             cerr << lit.size() << " extraneous parameters for " <<
                     token << " ignored\n";
     }
-    bout();                                 // flush out the last bits, if any
+    auto& out = gen.stream();               // flush out the last bits, if any
+    cout.write((char const *)out.data(), out.size());
 }
@@ -0,0 +1,387 @@
+/*
+ * brolib.cc
+ * Copyright (C) 2016 Mark Adler
+ * For conditions of distribution and use, see the accompanying LICENSE file.
+ *
+ * Brotli stream generator library -- see brolib.h for the interface.
+ */
+
+#include <algorithm>
+using namespace std;
+
+#include <assert.h>
+
+#include "brolib.h"
+#include "huff.h"           // Huffman algorithm to make an optimal prefix code
+#include "flatten.h"        // Flatten a prefix code to a maximum bit length
+#include "pack.h"           // Optimal length-limited prefix code
+
+// Definition of the constant, which is odr-used when passed by reference.
+unsigned short const brogen::NOCODE;
+
+void bitout::bits(int n, uint64_t val) {
+    assert(n >= 0 && n <= 64);
+    while (n) {
+        // append up to 56 bits at a time, so that buf does not overflow
+        int k = n < 56 ? n : 56;
+        buf += (val & (((uint64_t)1 << k) - 1)) << have;
+        have += k;
+        val >>= k;
+        n -= k;
+        while (have >= 8) {
+            out.push_back((uint8_t)buf);
+            buf >>= 8;
+            have -= 8;
+        }
+    }
+}
+
+void bitout::bound(unsigned fill) {
+    if (have) {
+        buf += (uint64_t)fill << have;
+        out.push_back((uint8_t)buf);
+        buf = 0;
+        have = 0;
+    }
+}
+
+void bitout::bytes(uint8_t const *data, size_t len) {
+    bound();
+    out.insert(out.end(), data, data + len);
+}
+
+// Create an encoding in enc from a canonical description, assumed to be
+// complete and not empty, and where the longest code is assumed to fit in an
+// unsigned short.  count[k] is the number of codes with k bits.  *symbol is
+// the list of symbols in order from the shortest code to the longest code,
+// sorted by symbol value within each code length.  This does not check for
+// repeated symbols -- if a symbol is repeated, then only the last (longest)
+// will be found when looking up that symbol.
+static void encode(brogen::prefix_t& enc, unsigned short *count,
+                   unsigned short const *symbol) {
+    enc.assign(MAXSYMS, brogen::code_t(brogen::NOCODE, 0));
+    unsigned n = 0;
+    brogen::code_t code(0, 0);
+    do {
+        while (count[code.first] == 0)
+            code.first++;
+        enc[symbol[n++]] = code;
+        count[code.first]--;
+        unsigned bit = 1U << code.first;    // increment code backwards
+        while (bit >>= 1) {
+            code.second ^= bit;
+            if (code.second & bit)
+                break;
+        }
+    } while (code.second);
+}
+
+void brogen::wbits(unsigned n) {
+    assert(n >= 10 && n <= 24);
+    bits(1, n == 16 ? 0 : 1);
+    if (n != 16) {
+        bits(3, n < 18 ? 0 : n - 17);
+        if (n < 18)
+            bits(3, n == 17 ? 0 : n - 8);
+    }
+}
+
+void brogen::meta(long n) {
+    assert(n >= 1 && n <= 1L << 24);
+    if (islast)
+        bits(2, 1);                 // ISLAST, not empty
+    else
+        bits(1, 0);                 // not last
+    unsigned q = n > (1 << 16) ? n > (1 << 20) ? 6 : 5 : 4;
+    bits(2, q - 4);                 // MNIBBLES (0..2)
+    bits(q << 2, n - 1);            // MLEN
+    if (!islast)
+        bits(1, 0);                 // compressed
+}
+
+bool brogen::uncmeta(long n) {
+    assert(n >= 1 && n <= 1L << 24);
+    if (islast)
+        return false;
+    bits(1, 0);                     // not last
+    unsigned q = n > (1 << 16) ? n > (1 << 20) ? 6 : 5 : 4;
+    bits(2, q - 4);                 // MNIBBLES (0..2)
+    bits(q << 2, n - 1);            // MLEN
+    bits(1, 1);                     // ISUNCOMPRESSED
+    return true;
+}
+
+void brogen::empty(long n) {
+    assert(n >= -1 && n <= 1L << 24);
+    if (islast || n == -1) {
+        if (n == -1) {
+            bits(2, 3);             // ISLAST, ISLASTEMPTY
+            return;
+        }
+        bits(2, 1);                 // ISLAST, not empty (though it is)
+    }
+    else
+        bits(1, 0);                 // not last
+    bits(2, 3);                     // MNIBBLES: meta-data follows
+    bits(1, 0);                     // reserved bit
+    unsigned q = n > 0 ? n > (1 << 8) ? n > (1L << 16) ? 3 : 2 : 1 : 0;
+    bits(2, q);                     // MSKIPBYTES
+    bits(q << 3, n - 1);            // MSKIPLEN
+}
+
+void brogen::types(unsigned n) {
+    assert(n >= 1 && n <= 256);
+    bits(1, n > 1 ? 1 : 0);
+    if (n > 1) {
+        unsigned q = 0;
+        while ((1U << (q + 1)) < n)
+            q++;
+        bits(3, q);
+        if (q)
+            bits(q, n - 1 - (1 << q));
+    }
+}
+
+void brogen::len(unsigned n) {
+    assert(n <= 5);
+    switch (n) {
+        case 0:  bits(2, 0);  break;
+        case 1:  bits(4, 7);  break;
+        case 2:  bits(3, 3);  break;
+        case 3:  bits(2, 2);  break;
+        case 4:  bits(2, 1);  break;
+        case 5:  bits(4, 0xf);  break;
+    }
+}
+
+void brogen::simple(long id, unsigned type, unsigned abits,
+                    unsigned short *symbol) {
+    assert(type >= 1 && type <= 5 && abits >= 1 && abits <= 10);
+
+    // implied number of symbols
+    unsigned num = type == 5 ? 4 : type;
+
+    // write out code description
+    bits(2, 1);
+    bits(2, num - 1);
+    for (unsigned n = 0; n < num; n++)
+        bits(abits, symbol[n]);
+    if (num >= 4)
+        bits(1, type - 4);
+
+    // build and save the encoding for this code -- the sorting is required
+    // to make the code canonical (the symbols may not be provided in sorted
+    // order)
+    unsigned short count[4] = {0};
+    switch (type) {
+        case 1:
+            count[0] = 1;
+            break;
+        case 2:
+            count[1] = 2;
+            sort(symbol, symbol + 2);
+            break;
+        case 3:
+            count[1] = 1;
+            count[2] = 2;
+            sort(symbol + 1, symbol + 3);
+            break;
+        case 4:
+            count[2] = 4;
+            sort(symbol, symbol + 4);
+            break;
+        case 5:
+            count[1] = 1;
+            count[2] = 1;
+            count[3] = 2;
+            sort(symbol + 2, symbol + 4);
+    }
+    encode(codes[id], count, symbol);
+}
+
+void brogen::complex(long id, desc_t& desc) {
+    // sort by symbols
+    sort(desc.begin(), desc.end(),
+         [] (sym_t const& a, sym_t const& b) {
+             return a.second < b.second;
+         });
+
+    // make a list of instructions to describe the code, making use of
+    // run-length encoding where possible
+    inst.clear();
+    {
+        unsigned rep = 0;       // number of times len repeated
+        unsigned len = 0;       // length repeated if rep > 0
+        unsigned last = 8;      // last non-zero length emitted
+
+        // function to emit a run of rep len's (brings rep to 0)
+        auto emit = [&] () {
+            while (rep) {
+                if (rep < 3 || len != last) {
+                    inst.push_back(make_pair(len, 0));
+                    last = len;
+                    rep--;
+                }
+                if (rep >= 3) {
+                    // nested coding of repeat of last length
+                    unsigned dig[8];        // enough for 15-bit codes
+                    unsigned num = 0;
+                    rep -= 2;
+                    do {
+                        dig[num++] = --rep & 3;
+                        rep >>= 2;
+                    } while (rep);
+                    do {
+                        inst.push_back(make_pair(16, dig[--num]));
+                    } while (num);
+                }
+            }
+        };
+
+        // go through sorted symbols, generating lengths and runs (make use of
+        // runs greedily)
+        unsigned next = 0;          // next symbol after last encountered
+        for (auto& x : desc) {
+            // if skipping symbols, then code zeros
+            if (next < x.second) {
+                emit();             // emit last length run, if any
+                auto zeros = x.second - next;
+                if (zeros < 3)
+                    do {
+                        inst.push_back(make_pair(0, 0));
+                    } while (--zeros);
+                else {
+                    // nested codings of repeats of zeros
+                    unsigned dig[5];    // enough for 15-bit codes
+                    unsigned num = 0;
+                    zeros -= 2;
+                    do {
+                        dig[num++] = --zeros & 7;
+                        zeros >>= 3;
+                    } while (zeros);
+                    do {
+                        inst.push_back(make_pair(17, dig[--num]));
+                    } while (num);
+                }
+                next = x.second;
+            }
+
+            // accumulate this length, emitting the last one if different
+            if (rep && len != x.first)
+                emit();             // brings rep to zero
+            len = x.first;
+            rep++;
+            next++;
+        }
+        emit();                     // emit final length run
+    }
+
+    // create a code for the instructions in inst (0..17)
+    desc_t instdesc;
+    prefix_t instcode;
+    {
+        // count the occurrences of each instruction
+        unsigned short freq[18] = {0};
+        for (auto& x : inst)
+            freq[x.first]++;
+
+        // make a list of instructions that appear at least once
+        for (int n = 0; n < 18; n++)
+            if (freq[n])
+                instdesc.push_back(make_pair(freq[n], n));
+
+        // make the instructions code
+        if (instdesc.size() > 1) {
+            // make a prefix code for the instructions from the frequencies,
+            // limiting the longest code to five bits -- either a Huffman code
+            // flattened to five bits, or the optimal five-bit limited code
+            sort(instdesc.begin(), instdesc.end()); // sort frequencies
+            unsigned syms = 0;
+            for (auto& x : instdesc)
+                freq[syms++] = x.first;
+            int ret;
+            if (packed) {
+                uint32_t weight[18];
+                for (unsigned n = 0; n < syms; n++)
+                    weight[n] = freq[n];
+                ret = pack(freq, weight, syms, 5);  // freq -> length
+            }
+            else {
+                huffman(freq, freq, syms);          // in place, freq -> length
+                ret = flatten(freq, syms, 5);       // limit codes to length 5
+            }
+            assert(ret == 0);
+            (void)ret;
+            for (unsigned n = 0; n < syms; n++)
+                instdesc[n].first = freq[n];
+            sort(instdesc.begin(), instdesc.end()); // canonicalize
+            unsigned short count[6] = {0};          // counts for each length
+            unsigned short symbol[18];              // symbols in length order
+            unsigned n = 0;
+            for (auto& x : instdesc) {
+                count[x.first]++;
+                symbol[n++] = x.second;
+            }
+            encode(instcode, count, symbol);
+        }
+        else {
+            // a single symbol encoded with zero bits
+            instdesc[0].first = 3;              // shortest code (that or 4)
+            instcode.assign(MAXSYMS, code_t(NOCODE, 0));
+            instcode[instdesc[0].second] = make_pair(0, 0);
+        }
+    }
+
+    // write out the description of the instructions code
+    {
+        // make the list of lengths to send in permuted order
+        unsigned char const order[] = {
+            4, 0, 1, 2, 3, 5, 7, 9, 10, 11, 12, 13, 14, 15, 16, 17, 8, 6
+        };
+        unsigned char list[18] = {0};
+        for (auto& x : instdesc)
+            list[order[x.second]] = x.first;
+
+        // determine start and end of list to send -- start becomes the lead-in
+        // to the complex code description (0, 2, or 3)
+        unsigned start = list[0] || list[1] ? 0 : list[2] ? 2 : 3;
+        bits(2, start);
+        unsigned end = 17;
+        if (instdesc.size() > 1)            // entire list if only one symbol
+            while (end && list[end] == 0)
+                end--;                      // else drop zeros off the end
+
+        // write out instruction code bit lengths using the fixed code
+        for (unsigned n = start; n <= end; n++)
+            len(list[n]);
+    }
+
+    // write out instructions for the code using the code lengths code
+    for (auto& x : inst) {
+        code_t code = instcode[x.first];
+        assert(code.first != NOCODE);
+        bits(code.first, code.second);
+        if (x.first > 15)
+            bits(x.first - 14, x.second);   // extra bits for 16 or 17
+    }
+
+    // generate and save the encoding for this code
+    sort(desc.begin(), desc.end());         // canonicalize
+    unsigned short count[16] = {0};         // counts for each length
+    unsigned short symbol[MAXSYMS];         // symbols in length order
+    unsigned n = 0;
+    for (auto& x : desc) {
+        count[x.first]++;
+        symbol[n++] = x.second;
+    }
+    encode(codes[id], count, symbol);
+}
+
+bool brogen::prefix(long id, long sym) {
+    auto enc = codes.find(id);
+    if (enc == codes.end() || sym < 0 || sym >= MAXSYMS ||
+        enc->second[sym].first == NOCODE)
+        return false;
+    bits(enc->second[sym].first, enc->second[sym].second);
+    return true;
+}
@@ -0,0 +1,146 @@
+/*
+ * brolib.h
+ * Copyright (C) 2016 Mark Adler
+ * For conditions of distribution and use, see the accompanying LICENSE file.
+ *
+ * brolib is the brotli stream generator of brogen as a library, so that
+ * streams can be made at a high rate in the same process as the decoders
+ * being tested.  The stream is accumulated in a byte vector that is reused
+ * from one stream to the next after clear().
+ */
+
+#ifndef BROLIB_H
+#define BROLIB_H
+
+#include <map>
+#include <vector>
+#include <utility>
+#include <stdint.h>
+#include <stddef.h>
+
+#define MAXSYMS 704     // symbol values must be in 0..703
+
+// Bit writer, appending bits to a byte vector starting with the least
+// significant bit of each byte.  Between calls there are never more than
+// seven bits in the bit buffer.
+class bitout {
+public:
+    bitout() : buf(0), have(0) {}
+
+    // Discard the stream, keeping the allocated memory for the next one.
+    void clear() {
+        out.clear();
+        buf = 0;
+        have = 0;
+    }
+
+    // Append the low n bits of val, n in 0..64.
+    void bits(int n, uint64_t val);
+
+    // Write out any remaining bits in the buffer followed by the low bits of
+    // fill, if needed, to get to a byte boundary.
+    void bound(unsigned fill = 0);
+
+    // Go to a byte boundary and append the bytes at data[0..len-1].
+    void bytes(uint8_t const *data, size_t len);
+
+    // Complete the last byte with zero bits and return the stream.
+    std::vector<uint8_t> const& stream() {
+        bound();
+        return out;
+    }
+
+private:
+    std::vector<uint8_t> out;   // the stream so far
+    uint64_t buf;               // unwritten bits
+    int have;                   // number of bits in buf (0..7)
+};
+
+// Brotli stream builder, with one function for each of the brogen commands.
+// The parameters are assumed to be valid, as checked by brogen -- how the
+// resulting stream decodes is up to the stream.  The prefix codes defined by
+// simple() and complex() are saved by id for use by prefix().
+class brogen : public bitout {
+public:
+    // A code is the number of bits in the code (0..15) and the code in
+    // reversed order for ready placement in stream.  An encoding is the code
+    // for each symbol (0..MAXSYMS-1), with NOCODE bits for symbols not coded.
+    typedef std::pair<unsigned short, unsigned short> code_t;
+    typedef std::vector<code_t> prefix_t;
+    static unsigned short const NOCODE = 0xffff;
+
+    // Description of a code, where each pair is a bit length and a symbol.
+    typedef std::pair<unsigned short, unsigned short> sym_t;
+    typedef std::vector<sym_t> desc_t;
+
+    brogen() : islast(0), packed(false) {}
+
+    // Make the code length codes for complex() with pack() if on is true, or
+    // else with huffman() and flatten() (the default).  This persists across
+    // clear().
+    void optimal(bool on) { packed = on; }
+
+    // Start a new stream, forgetting the prefix codes.
+    void clear() {
+        bitout::clear();
+        codes.clear();
+        islast = 0;
+    }
+
+    // w n -- Emit the WBITS header for n bits, n in 10..24.
+    void wbits(unsigned n);
+
+    // last n -- The next meta-block is the last one, or not if n is false.
+    void last(int n) { islast = n; }
+
+    // m n -- Compressed meta-block lead-in with n bytes of data, n in
+    // 1..1 << 24.
+    void meta(long n);
+
+    // u n -- Uncompressed meta-block lead-in with n bytes of data, n in
+    // 1..1 << 24.  Return false without writing anything if the next
+    // meta-block is the last one, which cannot be uncompressed.
+    bool uncmeta(long n);
+
+    // e n -- Empty meta-block lead-in with n bytes of metadata, n in
+    // 0..1 << 24, or -1 which gives a last empty block with no metadata
+    // length.
+    void empty(long n);
+
+    // lit -- Literal data at data[0..len-1], starting at a byte boundary.
+    void lit(uint8_t const *data, size_t len) { bytes(data, len); }
+
+    // types n -- Coded number of block types in 1..256.
+    void types(unsigned n);
+
+    // len n -- Code length code for n in 0..5.
+    void len(unsigned n);
+
+    // s id t a s s ... -- Simple prefix code of type t 1..5 with alphabet
+    // bits a in 1..10 for the symbols symbol[0..k-1], where k is t, or 4 if t
+    // is 5.  The symbols must be distinct and less than 1 << a.  symbol[] is
+    // reordered.
+    void simple(long id, unsigned type, unsigned abits,
+                unsigned short *symbol);
+
+    // c id b s b s ... -- Complex prefix code for the length and symbol
+    // pairs in desc, which must be a complete code with lengths in 1..15 and
+    // distinct symbols.  desc is reordered.
+    void complex(long id, desc_t& desc);
+
+    // Return true if there is a prefix code with id.
+    bool defined(long id) const { return codes.count(id) != 0; }
+
+    // p id s -- Encode sym using the prefix code id.  Return false without
+    // writing anything if there is no such code or sym is not in it.
+    bool prefix(long id, long sym);
+
+private:
+    std::map<long, prefix_t> codes;     // saved prefix codes
+    int islast;                         // true for the last meta-block
+    bool packed;                        // true to use pack() in complex()
+    std::vector<std::pair<unsigned char, unsigned char> > inst;
+                                        // complex() instructions, reused
+};
+
+#endif
@@ -0,0 +1,61 @@
+// brseek.c
+// Copyright (C) 2016 Mark Adler
+// For conditions of distribution and use, see the accompanying LICENSE file.
+//
+// Write a range of the uncompressed content of a .br file to stdout, decoding
+// only the chunks that overlap the range.  Usage:
+//
+//     brseek [-v] file.br start [end]
+//
+// start and end are offsets in the uncompressed content, where end is not
+// included.  If end is omitted, then the content from start to the end is
+// written.  The chunk index is saved in file.br.idx for later use.  -v writes
+// the total uncompressed length to stderr.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "brindex.h"
+
+// Convert s to an offset, or return -1 if it is not a valid number.
+static int offset(char const *s, uintmax_t *off) {
+    char *end;
+    if (*s < '0' || *s > '9')
+        return -1;
+    *off = strtoumax(s, &end, 0);
+    return *end ? -1 : 0;
+}
+
+int main(int argc, char **argv) {
+    int verbose = 0;
+    if (argc > 1 && argv[1][0] == '-' && argv[1][1] == 'v' &&
+        argv[1][2] == 0) {
+        verbose = 1;
+        argc--;
+        argv++;
+    }
+    uintmax_t start, end = UINTMAX_MAX;
+    if (argc < 3 || argc > 4 || offset(argv[2], &start) ||
+        (argc == 4 && offset(argv[3], &end))) {
+        fputs("usage: brseek [-v] file.br start [end]\n", stderr);
+        return 1;
+    }
+    int ret;
+    brindex_t *idx = brindex_open(argv[1], &ret);
+    if (idx == NULL) {
+        fprintf(stderr, "brseek: could not index %s (error %d)\n",
+                argv[1], ret);
+        return 1;
+    }
+    if (verbose)
+        fprintf(stderr, "%s: %ju uncompressed bytes\n", argv[1],
+                brindex_total(idx));
+    ret = brindex_read(idx, start, end, stdout);
+    brindex_close(idx);
+    if (ret) {
+        fprintf(stderr, "brseek: could not read %s (error %d)\n",
+                argv[1], ret);
+        return 1;
+    }
+    return 0;
+}
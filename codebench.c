@@ -0,0 +1,241 @@
+/* Compare the two ways of making length-limited prefix codes, huffman()
+   followed by the greedy flatten(), and the optimal package-merge pack(), on
+   the files named on the command line.  For each file, the byte histogram of
+   each MASH_BLOCK block of the file is made into a code limited to 15, 10,
+   and 8 bits by both methods.  Shown for each limit are the total bits to
+   code the blocks using each method's codes, how much smaller pack() made
+   them, and the median time in nanoseconds to build one code over a series of
+   samples.  Both methods start from the same sorted histogram.  As in mash,
+   the counts for huffman() are scaled down to fit its 16-bit frequencies,
+   with the scaling included in its time, whereas pack() uses the counts as
+   is.  The bits are always computed with the actual counts.
+
+   Then each file is compressed by mash at the default level both ways, to
+   show the effect on the compressed size and on the compression time, which
+   includes the literal, insert and copy, distance, and code length codes of
+   every meta-block.
+
+   The number of samples is 15, or as given by the -n option.  Each sample
+   builds the codes for all of the blocks repeatedly for about a millisecond.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "load.h"
+#include "huff.h"
+#include "flatten.h"
+#include "pack.h"
+#include "mash.h"
+#include "try.h"
+
+#define local static
+
+#define SAMPLES 15              // default number of samples
+#define SAMPLE 1e-3             // target seconds per sample
+
+// Sorted non-zero counts of the bytes in one block.
+typedef struct {
+    uint32_t freq[256];         // counts, in non-decreasing order
+    size_t n;                   // number of counts
+} hist_t;
+
+// Compare uint32_t's for qsort().
+local int by_freq(void const *a, void const *b)
+{
+    uint32_t x = *(uint32_t const *)a, y = *(uint32_t const *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Return the time in seconds from a monotonic clock.
+local double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Make a code in bits[0..h->n-1] for h limited to limit bits, using huffman()
+// and flatten() if optimal is false, or pack() if true.
+local void code(unsigned short *bits, hist_t const *h, unsigned limit,
+                int optimal)
+{
+    if (optimal) {
+        if (pack(bits, h->freq, h->n, limit)) {
+            fputs("codebench: out of memory\n", stderr);
+            exit(1);
+        }
+        return;
+    }
+    uint64_t total = 0;
+    for (size_t i = 0; i < h->n; i++)
+        total += h->freq[i];
+    for (size_t i = 0; i < h->n; i++)
+        bits[i] = total > 65535 ?
+                  1 + h->freq[i] * (uint64_t)(65535 - h->n) / total :
+                  h->freq[i];
+    huffman(bits, bits, h->n);
+    flatten(bits, h->n, limit);
+}
+
+// Compare doubles for qsort().
+local int by_double(void const *a, void const *b)
+{
+    double x = *(double const *)a, y = *(double const *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Return the total bits to code the blocks in hist[0..blocks-1] with codes
+// limited to limit built by the optimal or greedy method, and set *ns to the
+// median nanoseconds per code over samples samples.
+local uint64_t build(hist_t const *hist, size_t blocks, unsigned limit,
+                     int optimal, int samples, double *ns)
+{
+    unsigned short bits[256];
+    uint64_t total = 0;
+    for (size_t b = 0; b < blocks; b++) {
+        code(bits, hist + b, limit, optimal);
+        for (size_t i = 0; i < hist[b].n; i++)
+            total += (uint64_t)hist[b].freq[i] * bits[i];
+    }
+
+    double *time = malloc(samples * sizeof(double));
+    if (time == NULL) {
+        fputs("codebench: out of memory\n", stderr);
+        exit(1);
+    }
+    for (int s = 0; s < samples; s++) {
+        size_t reps = 0;
+        double start = now(), secs;
+        do {
+            for (size_t b = 0; b < blocks; b++)
+                code(bits, hist + b, limit, optimal);
+            reps += blocks;
+        } while ((secs = now() - start) < SAMPLE);
+        time[s] = secs * 1e9 / reps;
+    }
+    qsort(time, samples, sizeof(double), by_double);
+    *ns = time[samples >> 1];
+    free(time);
+    return total;
+}
+
+// Compress in[0..len-1] with mash using the optimal or greedy codes, and
+// return the compressed length, setting *secs to the compression time.
+local size_t squash(void const *in, size_t len, int optimal, double *secs)
+{
+    unsigned char *out = NULL;
+    size_t got = 0;
+    ball_t err;
+    try {
+        double start = now();
+        mash(in, len, MASH_LEVEL, MASH_WBITS, optimal, &out, &got);
+        *secs = now() - start;
+    }
+    catch (err) {
+        fprintf(stderr, "codebench: %s\n", err.why);
+        exit(1);
+    }
+    free(out);
+    return got;
+}
+
+// Benchmark the file at path.
+local void bench(char const *path, int samples)
+{
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        printf("%-28s could not open\n", path);
+        return;
+    }
+    void *dat;
+    size_t len;
+    int mapped;
+    int ret = load_map(in, 0, &dat, &len, &mapped);
+    fclose(in);
+    if (ret) {
+        printf("%-28s could not read\n", path);
+        load_free(dat, len, mapped);
+        return;
+    }
+
+    // make the sorted byte histograms of the blocks, skipping blocks with one
+    // symbol, which need no code
+    size_t blocks = 0;
+    hist_t *hist = malloc((len / MASH_BLOCK + 1) * sizeof(hist_t));
+    if (hist == NULL) {
+        fputs("codebench: out of memory\n", stderr);
+        exit(1);
+    }
+    for (size_t start = 0; start < len; start += MASH_BLOCK) {
+        uint32_t count[256] = {0};
+        unsigned char const *p = (unsigned char const *)dat + start;
+        size_t n = len - start < MASH_BLOCK ? len - start : MASH_BLOCK;
+        for (size_t i = 0; i < n; i++)
+            count[p[i]]++;
+        hist_t *h = hist + blocks;
+        h->n = 0;
+        for (unsigned i = 0; i < 256; i++)
+            if (count[i])
+                h->freq[h->n++] = count[i];
+        if (h->n > 1) {
+            qsort(h->freq, h->n, sizeof(uint32_t), by_freq);
+            blocks++;
+        }
+    }
+
+    // compare the code builds at each limit
+    unsigned const limits[] = {15, 10, 8};
+    for (size_t k = 0; blocks && k < sizeof(limits) / sizeof(limits[0]); k++) {
+        double fns, pns;
+        uint64_t flat = build(hist, blocks, limits[k], 0, samples, &fns);
+        uint64_t opt = build(hist, blocks, limits[k], 1, samples, &pns);
+        printf("%-28s %5u %12llu %12llu %7.3f%% %9.0f %9.0f\n", path,
+               limits[k], (unsigned long long)flat, (unsigned long long)opt,
+               flat ? 100. * (flat - opt) / flat : 0., fns, pns);
+    }
+    free(hist);
+
+    // compare mash compression
+    double fsecs, psecs;
+    size_t flat = squash(dat, len, 0, &fsecs);
+    size_t opt = squash(dat, len, 1, &psecs);
+    printf("%-28s  mash %12zu %12zu %7.3f%% %8.2fm %8.2fm\n", path, flat, opt,
+           flat ? 100. * ((double)flat - opt) / flat : 0., fsecs * 1e3,
+           psecs * 1e3);
+    load_free(dat, len, mapped);
+}
+
+int main(int argc, char **argv)
+{
+    // interpret the options
+    int samples = SAMPLES;
+    while (argc > 1 && argv[1][0] == '-') {
+        if (strcmp(argv[1], "-n") == 0 && argc > 2) {
+            samples = atoi(argv[2]);
+            argc -= 2;
+            argv += 2;
+        }
+        else
+            samples = 0;
+        if (samples < 1) {
+            fputs("usage: codebench [-n samples] file ...\n", stderr);
+            return 1;
+        }
+    }
+
+    // build the dictionary index in mash, so that its time is not charged to
+    // the first file
+    double secs;
+    squash("", 0, 1, &secs);
+
+    // benchmark each file -- the times are nanoseconds per code, or
+    // milliseconds (m) for the mash lines
+    printf("%-28s %5s %12s %12s %8s %9s %9s\n", "file", "limit",
+           "flatten bits", "pack bits", "saved", "flat ns", "pack ns");
+    while (++argv, --argc)
+        bench(*argv, samples);
+    return 0;
+}
@@ -0,0 +1,213 @@
+local command_t const command[MAXIACS] = {
+    /* 0..63: insert codes 0..7, copy codes 0..7, last distance */
+    {0, 2, 0, 0, 1}, {0, 3, 0, 0, 1}, {0, 4, 0, 0, 1}, {0, 5, 0, 0, 1},
+    {0, 6, 0, 0, 1}, {0, 7, 0, 0, 1}, {0, 8, 0, 0, 1}, {0, 9, 0, 0, 1},
+    {1, 2, 0, 0, 1}, {1, 3, 0, 0, 1}, {1, 4, 0, 0, 1}, {1, 5, 0, 0, 1},
+    {1, 6, 0, 0, 1}, {1, 7, 0, 0, 1}, {1, 8, 0, 0, 1}, {1, 9, 0, 0, 1},
+    {2, 2, 0, 0, 1}, {2, 3, 0, 0, 1}, {2, 4, 0, 0, 1}, {2, 5, 0, 0, 1},
+    {2, 6, 0, 0, 1}, {2, 7, 0, 0, 1}, {2, 8, 0, 0, 1}, {2, 9, 0, 0, 1},
+    {3, 2, 0, 0, 1}, {3, 3, 0, 0, 1}, {3, 4, 0, 0, 1}, {3, 5, 0, 0, 1},
+    {3, 6, 0, 0, 1}, {3, 7, 0, 0, 1}, {3, 8, 0, 0, 1}, {3, 9, 0, 0, 1},
+    {4, 2, 0, 0, 1}, {4, 3, 0, 0, 1}, {4, 4, 0, 0, 1}, {4, 5, 0, 0, 1},
+    {4, 6, 0, 0, 1}, {4, 7, 0, 0, 1}, {4, 8, 0, 0, 1}, {4, 9, 0, 0, 1},
+    {5, 2, 0, 0, 1}, {5, 3, 0, 0, 1}, {5, 4, 0, 0, 1}, {5, 5, 0, 0, 1},
+    {5, 6, 0, 0, 1}, {5, 7, 0, 0, 1}, {5, 8, 0, 0, 1}, {5, 9, 0, 0, 1},
+    {6, 2, 1, 0, 1}, {6, 3, 1, 0, 1}, {6, 4, 1, 0, 1}, {6, 5, 1, 0, 1},
+    {6, 6, 1, 0, 1}, {6, 7, 1, 0, 1}, {6, 8, 1, 0, 1}, {6, 9, 1, 0, 1},
+    {8, 2, 1, 0, 1}, {8, 3, 1, 0, 1}, {8, 4, 1, 0, 1}, {8, 5, 1, 0, 1},
+    {8, 6, 1, 0, 1}, {8, 7, 1, 0, 1}, {8, 8, 1, 0, 1}, {8, 9, 1, 0, 1},
+    /* 64..127: insert codes 0..7, copy codes 8..15, last distance */
+    {0, 10, 0, 1, 1}, {0, 12, 0, 1, 1}, {0, 14, 0, 2, 1}, {0, 18, 0, 2, 1},
+    {0, 22, 0, 3, 1}, {0, 30, 0, 3, 1}, {0, 38, 0, 4, 1}, {0, 54, 0, 4, 1},
+    {1, 10, 0, 1, 1}, {1, 12, 0, 1, 1}, {1, 14, 0, 2, 1}, {1, 18, 0, 2, 1},
+    {1, 22, 0, 3, 1}, {1, 30, 0, 3, 1}, {1, 38, 0, 4, 1}, {1, 54, 0, 4, 1},
+    {2, 10, 0, 1, 1}, {2, 12, 0, 1, 1}, {2, 14, 0, 2, 1}, {2, 18, 0, 2, 1},
+    {2, 22, 0, 3, 1}, {2, 30, 0, 3, 1}, {2, 38, 0, 4, 1}, {2, 54, 0, 4, 1},
+    {3, 10, 0, 1, 1}, {3, 12, 0, 1, 1}, {3, 14, 0, 2, 1}, {3, 18, 0, 2, 1},
+    {3, 22, 0, 3, 1}, {3, 30, 0, 3, 1}, {3, 38, 0, 4, 1}, {3, 54, 0, 4, 1},
+    {4, 10, 0, 1, 1}, {4, 12, 0, 1, 1}, {4, 14, 0, 2, 1}, {4, 18, 0, 2, 1},
+    {4, 22, 0, 3, 1}, {4, 30, 0, 3, 1}, {4, 38, 0, 4, 1}, {4, 54, 0, 4, 1},
+    {5, 10, 0, 1, 1}, {5, 12, 0, 1, 1}, {5, 14, 0, 2, 1}, {5, 18, 0, 2, 1},
+    {5, 22, 0, 3, 1}, {5, 30, 0, 3, 1}, {5, 38, 0, 4, 1}, {5, 54, 0, 4, 1},
+    {6, 10, 1, 1, 1}, {6, 12, 1, 1, 1}, {6, 14, 1, 2, 1}, {6, 18, 1, 2, 1},
+    {6, 22, 1, 3, 1}, {6, 30, 1, 3, 1}, {6, 38, 1, 4, 1}, {6, 54, 1, 4, 1},
+    {8, 10, 1, 1, 1}, {8, 12, 1, 1, 1}, {8, 14, 1, 2, 1}, {8, 18, 1, 2, 1},
+    {8, 22, 1, 3, 1}, {8, 30, 1, 3, 1}, {8, 38, 1, 4, 1}, {8, 54, 1, 4, 1},
+    /* 128..191: insert codes 0..7, copy codes 0..7 */
+    {0, 2, 0, 0, 0}, {0, 3, 0, 0, 0}, {0, 4, 0, 0, 0}, {0, 5, 0, 0, 0},
+    {0, 6, 0, 0, 0}, {0, 7, 0, 0, 0}, {0, 8, 0, 0, 0}, {0, 9, 0, 0, 0},
+    {1, 2, 0, 0, 0}, {1, 3, 0, 0, 0}, {1, 4, 0, 0, 0}, {1, 5, 0, 0, 0},
+    {1, 6, 0, 0, 0}, {1, 7, 0, 0, 0}, {1, 8, 0, 0, 0}, {1, 9, 0, 0, 0},
+    {2, 2, 0, 0, 0}, {2, 3, 0, 0, 0}, {2, 4, 0, 0, 0}, {2, 5, 0, 0, 0},
+    {2, 6, 0, 0, 0}, {2, 7, 0, 0, 0}, {2, 8, 0, 0, 0}, {2, 9, 0, 0, 0},
+    {3, 2, 0, 0, 0}, {3, 3, 0, 0, 0}, {3, 4, 0, 0, 0}, {3, 5, 0, 0, 0},
+    {3, 6, 0, 0, 0}, {3, 7, 0, 0, 0}, {3, 8, 0, 0, 0}, {3, 9, 0, 0, 0},
+    {4, 2, 0, 0, 0}, {4, 3, 0, 0, 0}, {4, 4, 0, 0, 0}, {4, 5, 0, 0, 0},
+    {4, 6, 0, 0, 0}, {4, 7, 0, 0, 0}, {4, 8, 0, 0, 0}, {4, 9, 0, 0, 0},
+    {5, 2, 0, 0, 0}, {5, 3, 0, 0, 0}, {5, 4, 0, 0, 0}, {5, 5, 0, 0, 0},
+    {5, 6, 0, 0, 0}, {5, 7, 0, 0, 0}, {5, 8, 0, 0, 0}, {5, 9, 0, 0, 0},
+    {6, 2, 1, 0, 0}, {6, 3, 1, 0, 0}, {6, 4, 1, 0, 0}, {6, 5, 1, 0, 0},
+    {6, 6, 1, 0, 0}, {6, 7, 1, 0, 0}, {6, 8, 1, 0, 0}, {6, 9, 1, 0, 0},
+    {8, 2, 1, 0, 0}, {8, 3, 1, 0, 0}, {8, 4, 1, 0, 0}, {8, 5, 1, 0, 0},
+    {8, 6, 1, 0, 0}, {8, 7, 1, 0, 0}, {8, 8, 1, 0, 0}, {8, 9, 1, 0, 0},
+    /* 192..255: insert codes 0..7, copy codes 8..15 */
+    {0, 10, 0, 1, 0}, {0, 12, 0, 1, 0}, {0, 14, 0, 2, 0}, {0, 18, 0, 2, 0},
+    {0, 22, 0, 3, 0}, {0, 30, 0, 3, 0}, {0, 38, 0, 4, 0}, {0, 54, 0, 4, 0},
+    {1, 10, 0, 1, 0}, {1, 12, 0, 1, 0}, {1, 14, 0, 2, 0}, {1, 18, 0, 2, 0},
+    {1, 22, 0, 3, 0}, {1, 30, 0, 3, 0}, {1, 38, 0, 4, 0}, {1, 54, 0, 4, 0},
+    {2, 10, 0, 1, 0}, {2, 12, 0, 1, 0}, {2, 14, 0, 2, 0}, {2, 18, 0, 2, 0},
+    {2, 22, 0, 3, 0}, {2, 30, 0, 3, 0}, {2, 38, 0, 4, 0}, {2, 54, 0, 4, 0},
+    {3, 10, 0, 1, 0}, {3, 12, 0, 1, 0}, {3, 14, 0, 2, 0}, {3, 18, 0, 2, 0},
+    {3, 22, 0, 3, 0}, {3, 30, 0, 3, 0}, {3, 38, 0, 4, 0}, {3, 54, 0, 4, 0},
+    {4, 10, 0, 1, 0}, {4, 12, 0, 1, 0}, {4, 14, 0, 2, 0}, {4, 18, 0, 2, 0},
+    {4, 22, 0, 3, 0}, {4, 30, 0, 3, 0}, {4, 38, 0, 4, 0}, {4, 54, 0, 4, 0},
+    {5, 10, 0, 1, 0}, {5, 12, 0, 1, 0}, {5, 14, 0, 2, 0}, {5, 18, 0, 2, 0},
+    {5, 22, 0, 3, 0}, {5, 30, 0, 3, 0}, {5, 38, 0, 4, 0}, {5, 54, 0, 4, 0},
+    {6, 10, 1, 1, 0}, {6, 12, 1, 1, 0}, {6, 14, 1, 2, 0}, {6, 18, 1, 2, 0},
+    {6, 22, 1, 3, 0}, {6, 30, 1, 3, 0}, {6, 38, 1, 4, 0}, {6, 54, 1, 4, 0},
+    {8, 10, 1, 1, 0}, {8, 12, 1, 1, 0}, {8, 14, 1, 2, 0}, {8, 18, 1, 2, 0},
+    {8, 22, 1, 3, 0}, {8, 30, 1, 3, 0}, {8, 38, 1, 4, 0}, {8, 54, 1, 4, 0},
+    /* 256..319: insert codes 8..15, copy codes 0..7 */
+    {10, 2, 2, 0, 0}, {10, 3, 2, 0, 0}, {10, 4, 2, 0, 0}, {10, 5, 2, 0, 0},
+    {10, 6, 2, 0, 0}, {10, 7, 2, 0, 0}, {10, 8, 2, 0, 0}, {10, 9, 2, 0, 0},
+    {14, 2, 2, 0, 0}, {14, 3, 2, 0, 0}, {14, 4, 2, 0, 0}, {14, 5, 2, 0, 0},
+    {14, 6, 2, 0, 0}, {14, 7, 2, 0, 0}, {14, 8, 2, 0, 0}, {14, 9, 2, 0, 0},
+    {18, 2, 3, 0, 0}, {18, 3, 3, 0, 0}, {18, 4, 3, 0, 0}, {18, 5, 3, 0, 0},
+    {18, 6, 3, 0, 0}, {18, 7, 3, 0, 0}, {18, 8, 3, 0, 0}, {18, 9, 3, 0, 0},
+    {26, 2, 3, 0, 0}, {26, 3, 3, 0, 0}, {26, 4, 3, 0, 0}, {26, 5, 3, 0, 0},
+    {26, 6, 3, 0, 0}, {26, 7, 3, 0, 0}, {26, 8, 3, 0, 0}, {26, 9, 3, 0, 0},
+    {34, 2, 4, 0, 0}, {34, 3, 4, 0, 0}, {34, 4, 4, 0, 0}, {34, 5, 4, 0, 0},
+    {34, 6, 4, 0, 0}, {34, 7, 4, 0, 0}, {34, 8, 4, 0, 0}, {34, 9, 4, 0, 0},
+    {50, 2, 4, 0, 0}, {50, 3, 4, 0, 0}, {50, 4, 4, 0, 0}, {50, 5, 4, 0, 0},
+    {50, 6, 4, 0, 0}, {50, 7, 4, 0, 0}, {50, 8, 4, 0, 0}, {50, 9, 4, 0, 0},
+    {66, 2, 5, 0, 0}, {66, 3, 5, 0, 0}, {66, 4, 5, 0, 0}, {66, 5, 5, 0, 0},
+    {66, 6, 5, 0, 0}, {66, 7, 5, 0, 0}, {66, 8, 5, 0, 0}, {66, 9, 5, 0, 0},
+    {98, 2, 5, 0, 0}, {98, 3, 5, 0, 0}, {98, 4, 5, 0, 0}, {98, 5, 5, 0, 0},
+    {98, 6, 5, 0, 0}, {98, 7, 5, 0, 0}, {98, 8, 5, 0, 0}, {98, 9, 5, 0, 0},
+    /* 320..383: insert codes 8..15, copy codes 8..15 */
+    {10, 10, 2, 1, 0}, {10, 12, 2, 1, 0}, {10, 14, 2, 2, 0}, {10, 18, 2, 2, 0},
+    {10, 22, 2, 3, 0}, {10, 30, 2, 3, 0}, {10, 38, 2, 4, 0}, {10, 54, 2, 4, 0},
+    {14, 10, 2, 1, 0}, {14, 12, 2, 1, 0}, {14, 14, 2, 2, 0}, {14, 18, 2, 2, 0},
+    {14, 22, 2, 3, 0}, {14, 30, 2, 3, 0}, {14, 38, 2, 4, 0}, {14, 54, 2, 4, 0},
+    {18, 10, 3, 1, 0}, {18, 12, 3, 1, 0}, {18, 14, 3, 2, 0}, {18, 18, 3, 2, 0},
+    {18, 22, 3, 3, 0}, {18, 30, 3, 3, 0}, {18, 38, 3, 4, 0}, {18, 54, 3, 4, 0},
+    {26, 10, 3, 1, 0}, {26, 12, 3, 1, 0}, {26, 14, 3, 2, 0}, {26, 18, 3, 2, 0},
+    {26, 22, 3, 3, 0}, {26, 30, 3, 3, 0}, {26, 38, 3, 4, 0}, {26, 54, 3, 4, 0},
+    {34, 10, 4, 1, 0}, {34, 12, 4, 1, 0}, {34, 14, 4, 2, 0}, {34, 18, 4, 2, 0},
+    {34, 22, 4, 3, 0}, {34, 30, 4, 3, 0}, {34, 38, 4, 4, 0}, {34, 54, 4, 4, 0},
+    {50, 10, 4, 1, 0}, {50, 12, 4, 1, 0}, {50, 14, 4, 2, 0}, {50, 18, 4, 2, 0},
+    {50, 22, 4, 3, 0}, {50, 30, 4, 3, 0}, {50, 38, 4, 4, 0}, {50, 54, 4, 4, 0},
+    {66, 10, 5, 1, 0}, {66, 12, 5, 1, 0}, {66, 14, 5, 2, 0}, {66, 18, 5, 2, 0},
+    {66, 22, 5, 3, 0}, {66, 30, 5, 3, 0}, {66, 38, 5, 4, 0}, {66, 54, 5, 4, 0},
+    {98, 10, 5, 1, 0}, {98, 12, 5, 1, 0}, {98, 14, 5, 2, 0}, {98, 18, 5, 2, 0},
+    {98, 22, 5, 3, 0}, {98, 30, 5, 3, 0}, {98, 38, 5, 4, 0}, {98, 54, 5, 4, 0},
+    /* 384..447: insert codes 0..7, copy codes 16..23 */
+    {0, 70, 0, 5, 0}, {0, 102, 0, 5, 0}, {0, 134, 0, 6, 0}, {0, 198, 0, 7, 0},
+    {0, 326, 0, 8, 0}, {0, 582, 0, 9, 0}, {0, 1094, 0, 10, 0},
+    {0, 2118, 0, 24, 0}, {1, 70, 0, 5, 0}, {1, 102, 0, 5, 0},
+    {1, 134, 0, 6, 0}, {1, 198, 0, 7, 0}, {1, 326, 0, 8, 0}, {1, 582, 0, 9, 0},
+    {1, 1094, 0, 10, 0}, {1, 2118, 0, 24, 0}, {2, 70, 0, 5, 0},
+    {2, 102, 0, 5, 0}, {2, 134, 0, 6, 0}, {2, 198, 0, 7, 0}, {2, 326, 0, 8, 0},
+    {2, 582, 0, 9, 0}, {2, 1094, 0, 10, 0}, {2, 2118, 0, 24, 0},
+    {3, 70, 0, 5, 0}, {3, 102, 0, 5, 0}, {3, 134, 0, 6, 0}, {3, 198, 0, 7, 0},
+    {3, 326, 0, 8, 0}, {3, 582, 0, 9, 0}, {3, 1094, 0, 10, 0},
+    {3, 2118, 0, 24, 0}, {4, 70, 0, 5, 0}, {4, 102, 0, 5, 0},
+    {4, 134, 0, 6, 0}, {4, 198, 0, 7, 0}, {4, 326, 0, 8, 0}, {4, 582, 0, 9, 0},
+    {4, 1094, 0, 10, 0}, {4, 2118, 0, 24, 0}, {5, 70, 0, 5, 0},
+    {5, 102, 0, 5, 0}, {5, 134, 0, 6, 0}, {5, 198, 0, 7, 0}, {5, 326, 0, 8, 0},
+    {5, 582, 0, 9, 0}, {5, 1094, 0, 10, 0}, {5, 2118, 0, 24, 0},
+    {6, 70, 1, 5, 0}, {6, 102, 1, 5, 0}, {6, 134, 1, 6, 0}, {6, 198, 1, 7, 0},
+    {6, 326, 1, 8, 0}, {6, 582, 1, 9, 0}, {6, 1094, 1, 10, 0},
+    {6, 2118, 1, 24, 0}, {8, 70, 1, 5, 0}, {8, 102, 1, 5, 0},
+    {8, 134, 1, 6, 0}, {8, 198, 1, 7, 0}, {8, 326, 1, 8, 0}, {8, 582, 1, 9, 0},
+    {8, 1094, 1, 10, 0}, {8, 2118, 1, 24, 0},
+    /* 448..511: insert codes 16..23, copy codes 0..7 */
+    {130, 2, 6, 0, 0}, {130, 3, 6, 0, 0}, {130, 4, 6, 0, 0}, {130, 5, 6, 0, 0},
+    {130, 6, 6, 0, 0}, {130, 7, 6, 0, 0}, {130, 8, 6, 0, 0}, {130, 9, 6, 0, 0},
+    {194, 2, 7, 0, 0}, {194, 3, 7, 0, 0}, {194, 4, 7, 0, 0}, {194, 5, 7, 0, 0},
+    {194, 6, 7, 0, 0}, {194, 7, 7, 0, 0}, {194, 8, 7, 0, 0}, {194, 9, 7, 0, 0},
+    {322, 2, 8, 0, 0}, {322, 3, 8, 0, 0}, {322, 4, 8, 0, 0}, {322, 5, 8, 0, 0},
+    {322, 6, 8, 0, 0}, {322, 7, 8, 0, 0}, {322, 8, 8, 0, 0}, {322, 9, 8, 0, 0},
+    {578, 2, 9, 0, 0}, {578, 3, 9, 0, 0}, {578, 4, 9, 0, 0}, {578, 5, 9, 0, 0},
+    {578, 6, 9, 0, 0}, {578, 7, 9, 0, 0}, {578, 8, 9, 0, 0}, {578, 9, 9, 0, 0},
+    {1090, 2, 10, 0, 0}, {1090, 3, 10, 0, 0}, {1090, 4, 10, 0, 0},
+    {1090, 5, 10, 0, 0}, {1090, 6, 10, 0, 0}, {1090, 7, 10, 0, 0},
+    {1090, 8, 10, 0, 0}, {1090, 9, 10, 0, 0}, {2114, 2, 12, 0, 0},
+    {2114, 3, 12, 0, 0}, {2114, 4, 12, 0, 0}, {2114, 5, 12, 0, 0},
+    {2114, 6, 12, 0, 0}, {2114, 7, 12, 0, 0}, {2114, 8, 12, 0, 0},
+    {2114, 9, 12, 0, 0}, {6210, 2, 14, 0, 0}, {6210, 3, 14, 0, 0},
+    {6210, 4, 14, 0, 0}, {6210, 5, 14, 0, 0}, {6210, 6, 14, 0, 0},
+    {6210, 7, 14, 0, 0}, {6210, 8, 14, 0, 0}, {6210, 9, 14, 0, 0},
+    {22594, 2, 24, 0, 0}, {22594, 3, 24, 0, 0}, {22594, 4, 24, 0, 0},
+    {22594, 5, 24, 0, 0}, {22594, 6, 24, 0, 0}, {22594, 7, 24, 0, 0},
+    {22594, 8, 24, 0, 0}, {22594, 9, 24, 0, 0},
+    /* 512..575: insert codes 8..15, copy codes 16..23 */
+    {10, 70, 2, 5, 0}, {10, 102, 2, 5, 0}, {10, 134, 2, 6, 0},
+    {10, 198, 2, 7, 0}, {10, 326, 2, 8, 0}, {10, 582, 2, 9, 0},
+    {10, 1094, 2, 10, 0}, {10, 2118, 2, 24, 0}, {14, 70, 2, 5, 0},
+    {14, 102, 2, 5, 0}, {14, 134, 2, 6, 0}, {14, 198, 2, 7, 0},
+    {14, 326, 2, 8, 0}, {14, 582, 2, 9, 0}, {14, 1094, 2, 10, 0},
+    {14, 2118, 2, 24, 0}, {18, 70, 3, 5, 0}, {18, 102, 3, 5, 0},
+    {18, 134, 3, 6, 0}, {18, 198, 3, 7, 0}, {18, 326, 3, 8, 0},
+    {18, 582, 3, 9, 0}, {18, 1094, 3, 10, 0}, {18, 2118, 3, 24, 0},
+    {26, 70, 3, 5, 0}, {26, 102, 3, 5, 0}, {26, 134, 3, 6, 0},
+    {26, 198, 3, 7, 0}, {26, 326, 3, 8, 0}, {26, 582, 3, 9, 0},
+    {26, 1094, 3, 10, 0}, {26, 2118, 3, 24, 0}, {34, 70, 4, 5, 0},
+    {34, 102, 4, 5, 0}, {34, 134, 4, 6, 0}, {34, 198, 4, 7, 0},
+    {34, 326, 4, 8, 0}, {34, 582, 4, 9, 0}, {34, 1094, 4, 10, 0},
+    {34, 2118, 4, 24, 0}, {50, 70, 4, 5, 0}, {50, 102, 4, 5, 0},
+    {50, 134, 4, 6, 0}, {50, 198, 4, 7, 0}, {50, 326, 4, 8, 0},
+    {50, 582, 4, 9, 0}, {50, 1094, 4, 10, 0}, {50, 2118, 4, 24, 0},
+    {66, 70, 5, 5, 0}, {66, 102, 5, 5, 0}, {66, 134, 5, 6, 0},
+    {66, 198, 5, 7, 0}, {66, 326, 5, 8, 0}, {66, 582, 5, 9, 0},
+    {66, 1094, 5, 10, 0}, {66, 2118, 5, 24, 0}, {98, 70, 5, 5, 0},
+    {98, 102, 5, 5, 0}, {98, 134, 5, 6, 0}, {98, 198, 5, 7, 0},
+    {98, 326, 5, 8, 0}, {98, 582, 5, 9, 0}, {98, 1094, 5, 10, 0},
+    {98, 2118, 5, 24, 0},
+    /* 576..639: insert codes 16..23, copy codes 8..15 */
+    {130, 10, 6, 1, 0}, {130, 12, 6, 1, 0}, {130, 14, 6, 2, 0},
+    {130, 18, 6, 2, 0}, {130, 22, 6, 3, 0}, {130, 30, 6, 3, 0},
+    {130, 38, 6, 4, 0}, {130, 54, 6, 4, 0}, {194, 10, 7, 1, 0},
+    {194, 12, 7, 1, 0}, {194, 14, 7, 2, 0}, {194, 18, 7, 2, 0},
+    {194, 22, 7, 3, 0}, {194, 30, 7, 3, 0}, {194, 38, 7, 4, 0},
+    {194, 54, 7, 4, 0}, {322, 10, 8, 1, 0}, {322, 12, 8, 1, 0},
+    {322, 14, 8, 2, 0}, {322, 18, 8, 2, 0}, {322, 22, 8, 3, 0},
+    {322, 30, 8, 3, 0}, {322, 38, 8, 4, 0}, {322, 54, 8, 4, 0},
+    {578, 10, 9, 1, 0}, {578, 12, 9, 1, 0}, {578, 14, 9, 2, 0},
+    {578, 18, 9, 2, 0}, {578, 22, 9, 3, 0}, {578, 30, 9, 3, 0},
+    {578, 38, 9, 4, 0}, {578, 54, 9, 4, 0}, {1090, 10, 10, 1, 0},
+    {1090, 12, 10, 1, 0}, {1090, 14, 10, 2, 0}, {1090, 18, 10, 2, 0},
+    {1090, 22, 10, 3, 0}, {1090, 30, 10, 3, 0}, {1090, 38, 10, 4, 0},
+    {1090, 54, 10, 4, 0}, {2114, 10, 12, 1, 0}, {2114, 12, 12, 1, 0},
+    {2114, 14, 12, 2, 0}, {2114, 18, 12, 2, 0}, {2114, 22, 12, 3, 0},
+    {2114, 30, 12, 3, 0}, {2114, 38, 12, 4, 0}, {2114, 54, 12, 4, 0},
+    {6210, 10, 14, 1, 0}, {6210, 12, 14, 1, 0}, {6210, 14, 14, 2, 0},
+    {6210, 18, 14, 2, 0}, {6210, 22, 14, 3, 0}, {6210, 30, 14, 3, 0},
+    {6210, 38, 14, 4, 0}, {6210, 54, 14, 4, 0}, {22594, 10, 24, 1, 0},
+    {22594, 12, 24, 1, 0}, {22594, 14, 24, 2, 0}, {22594, 18, 24, 2, 0},
+    {22594, 22, 24, 3, 0}, {22594, 30, 24, 3, 0}, {22594, 38, 24, 4, 0},
+    {22594, 54, 24, 4, 0},
+    /* 640..703: insert codes 16..23, copy codes 16..23 */
+    {130, 70, 6, 5, 0}, {130, 102, 6, 5, 0}, {130, 134, 6, 6, 0},
+    {130, 198, 6, 7, 0}, {130, 326, 6, 8, 0}, {130, 582, 6, 9, 0},
+    {130, 1094, 6, 10, 0}, {130, 2118, 6, 24, 0}, {194, 70, 7, 5, 0},
+    {194, 102, 7, 5, 0}, {194, 134, 7, 6, 0}, {194, 198, 7, 7, 0},
+    {194, 326, 7, 8, 0}, {194, 582, 7, 9, 0}, {194, 1094, 7, 10, 0},
+    {194, 2118, 7, 24, 0}, {322, 70, 8, 5, 0}, {322, 102, 8, 5, 0},
+    {322, 134, 8, 6, 0}, {322, 198, 8, 7, 0}, {322, 326, 8, 8, 0},
+    {322, 582, 8, 9, 0}, {322, 1094, 8, 10, 0}, {322, 2118, 8, 24, 0},
+    {578, 70, 9, 5, 0}, {578, 102, 9, 5, 0}, {578, 134, 9, 6, 0},
+    {578, 198, 9, 7, 0}, {578, 326, 9, 8, 0}, {578, 582, 9, 9, 0},
+    {578, 1094, 9, 10, 0}, {578, 2118, 9, 24, 0}, {1090, 70, 10, 5, 0},
+    {1090, 102, 10, 5, 0}, {1090, 134, 10, 6, 0}, {1090, 198, 10, 7, 0},
+    {1090, 326, 10, 8, 0}, {1090, 582, 10, 9, 0}, {1090, 1094, 10, 10, 0},
+    {1090, 2118, 10, 24, 0}, {2114, 70, 12, 5, 0}, {2114, 102, 12, 5, 0},
+    {2114, 134, 12, 6, 0}, {2114, 198, 12, 7, 0}, {2114, 326, 12, 8, 0},
+    {2114, 582, 12, 9, 0}, {2114, 1094, 12, 10, 0}, {2114, 2118, 12, 24, 0},
+    {6210, 70, 14, 5, 0}, {6210, 102, 14, 5, 0}, {6210, 134, 14, 6, 0},
+    {6210, 198, 14, 7, 0}, {6210, 326, 14, 8, 0}, {6210, 582, 14, 9, 0},
+    {6210, 1094, 14, 10, 0}, {6210, 2118, 14, 24, 0}, {22594, 70, 24, 5, 0},
+    {22594, 102, 24, 5, 0}, {22594, 134, 24, 6, 0}, {22594, 198, 24, 7, 0},
+    {22594, 326, 24, 8, 0}, {22594, 582, 24, 9, 0}, {22594, 1094, 24, 10, 0},
+    {22594, 2118, 24, 24, 0}
+};
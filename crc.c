@@ -0,0 +1,75 @@
+/* Measure the speed of the CRC-32C implementations on the data from stdin.
+   Each implementation supported by this processor is run on all of the input
+   repeatedly for about a second, and the CRC-32C and the speed in GB/s are
+   shown.  If there is a numeric argument, then the input is processed in
+   pieces of that many bytes, to see the speed for shorter buffers.  All of
+   the input is loaded into memory for speed testing of the implementations. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "load.h"
+#include "crc32c.h"
+
+// Return the current time in seconds.
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+    // interpret the argument
+    if (argc > 2) {
+        fputs("only one argument permitted\n", stderr);
+        return 1;
+    }
+    long piece = argc == 1 ? 0 : strtol(argv[1], NULL, 10);
+    if (piece < 0) {
+        fputs("usage: crc [nnn] < data\n"
+              "  where nnn is the size of the pieces to compute the crc on\n",
+              stderr);
+        return 0;
+    }
+
+    // load the input data
+    void *dat = NULL;
+    size_t len, size;
+    int ret = load(stdin, 0, &dat, &size, &len);
+    if (ret) {
+        fprintf(stderr, "load() returned %d\n", ret);
+        fputs("error reading from stdin\n", stderr);
+        return 1;
+    }
+    if (len == 0) {
+        fputs("no input\n", stderr);
+        free(dat);
+        return 1;
+    }
+    size_t step = piece == 0 || (size_t)piece > len ? len : (size_t)piece;
+
+    // time each implementation
+    char const *name;
+    crc32c_func *crc32c_k;
+    for (unsigned k = 0; (crc32c_k = crc32c_impl(k, &name)) != NULL; k++) {
+        uint32_t crc = 0;
+        double start = now(), elapsed;
+        unsigned long rep = 0;
+        do {
+            crc = 0;
+            for (size_t at = 0; at < len; at += step)
+                crc = crc32c_k(crc, (unsigned char *)dat + at,
+                               len - at < step ? len - at : step);
+            rep++;
+            elapsed = now() - start;
+        } while (elapsed < 1);
+        printf("%-10s 0x%08x %7.2f GB/s\n", name, crc,
+               rep * (double)len / elapsed * 1e-9);
+    }
+
+    // clean up
+    free(dat);
+    return 0;
+}
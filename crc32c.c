@@ -1,6 +1,6 @@
-/* crc32c.c -- compute CRC-32C using the Intel crc32 instruction
+/* crc32c.c -- compute CRC-32C using hardware instructions
  * Copyright (C) 2013, 2015, 2021, 2023 Mark Adler
- * Version 1.5  7 Dec 2023  Mark Adler
+ * Version 1.6  14 Oct 2026  Mark Adler
  */
 
 /*
@@ -25,8 +25,10 @@
  */
 
 /* Use hardware CRC instruction on Intel SSE 4.2 processors.  This computes a
-   CRC-32C, *not* the CRC-32 used by Ethernet and zip, gzip, etc.  A software
-   version is provided as a fall-back, as well as for speed comparisons. */
+   CRC-32C, *not* the CRC-32 used by Ethernet and zip, gzip, etc.  Carry-less
+   multiplication (PCLMULQDQ) is used to fold the data down to 128 bits, if
+   available, which is faster for all but short buffers.  A software version
+   is provided as a fall-back, as well as for speed comparisons. */
 
 /* Version history:
    1.0  10 Feb 2013  First version
@@ -40,8 +42,12 @@
                      Add header for external use
    1.4  31 May 2021  Correct register constraints on assembly instructions
    1.5   7 Dec 2023  Improve register constraints for optimization
+   1.6  14 Oct 2026  Select the implementation once, using pthread_once()
+                     Add carry-less multiply folding
+                     Provide the implementations for speed comparisons
  */
 
+#include <string.h>
 #include <pthread.h>
 #include "crc32c.h"
 
@@ -50,7 +56,7 @@
 
 #ifdef __x86_64__
 
-/* Hardware CRC-32C for Intel and compatible processors. */
+/* Shifting of crc's, for combining the crc's of parallel streams. */
 
 /* Multiply a matrix times a vector over the Galois field of two elements,
    GF(2).  Each element is a bit in an unsigned integer.  mat must have at
@@ -149,6 +155,27 @@ static void crc32c_init_hw(void) {
     crc32c_zeros(crc32c_short, SHORT);
 }
 
+/* Constants for folding 128-bit pieces of the data forward by distance d bits
+   with carry-less multiplication, for the bit-reflected CRC.  The low 64 bits
+   of a piece are multiplied by FOLD(d + 32), and the high 64 bits by
+   FOLD(d - 32), where FOLD(n) is x^n modulo the CRC-32C polynomial, bit
+   reversed and shifted up one bit.  The products are exclusive-or'ed into the
+   piece d bits later.  d is 512 for folding four pieces in parallel, and 128
+   for folding one piece into the next. */
+#define FOLD544 0x740eef02
+#define FOLD480 0x9e4addf8
+#define FOLD160 0xf20c0dfe
+#define FOLD96 0x14cd00bd6
+
+#endif
+
+#ifdef __x86_64__
+
+/* Hardware CRC-32C for Intel and compatible processors. */
+
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+
 /* Compute CRC-32C using the Intel hardware instruction. */
 static uint32_t crc32c_hw(uint32_t crc, void const *buf, size_t len) {
     /* populate shift tables the first time through */
@@ -237,38 +264,170 @@ static uint32_t crc32c_hw(uint32_t crc, void const *buf, size_t len) {
     return ~crc0;
 }
 
-/* Check for SSE 4.2.  SSE 4.2 was first supported in Nehalem processors
-   introduced in November, 2008.  This does not check for the existence of the
-   cpuid instruction itself, which was introduced on the 486SL in 1992, so this
-   will fail on earlier x86 processors.  cpuid works on all Pentium and later
-   processors. */
-#define SSE42(have) \
-    do { \
-        uint32_t eax, ecx; \
-        eax = 1; \
-        __asm__("cpuid" \
-                : "=c"(ecx) \
-                : "a"(eax) \
-                : "%ebx", "%edx"); \
-        (have) = (ecx >> 20) & 1; \
-    } while (0)
+/* Fold the 128-bit piece x forward, with the multipliers in k, onto next. */
+__attribute__((target("sse4.2,pclmul")))
+static inline __m128i crc32c_fold_one(__m128i x, __m128i k, __m128i next) {
+    return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00),
+                                       _mm_clmulepi64_si128(x, k, 0x11)),
+                         next);
+}
 
-/* Compute a CRC-32C.  If the crc32 instruction is available, use the hardware
-   version.  Otherwise, use the software version. */
-uint32_t crc32c(uint32_t crc, void const *buf, size_t len) {
-    int sse42;
-    
-    SSE42(sse42);
-    return sse42 ? crc32c_hw(crc, buf, len) : crc32c_sw(crc, buf, len);
+/* Compute CRC-32C using the PCLMULQDQ carry-less multiply instruction to fold
+   the data, four 128-bit pieces at a time, down to 128 bits, which is then
+   reduced to the crc with the crc32 instruction.  The crc is linear, so the
+   crc of the folded 128 bits is the crc of the data it replaced. */
+__attribute__((target("sse4.2,pclmul")))
+static uint32_t crc32c_fold(uint32_t crc, void const *buf, size_t len) {
+    unsigned char const *next = buf;
+    uint64_t crc0 = ~crc;
+
+    if (len >= 64) {
+        /* load the first 64 bytes, with the crc applied to the start */
+        __m128i x0 = _mm_loadu_si128((__m128i const *)next);
+        __m128i x1 = _mm_loadu_si128((__m128i const *)(next + 16));
+        __m128i x2 = _mm_loadu_si128((__m128i const *)(next + 32));
+        __m128i x3 = _mm_loadu_si128((__m128i const *)(next + 48));
+        x0 = _mm_xor_si128(x0, _mm_cvtsi32_si128((int)crc0));
+        next += 64;
+        len -= 64;
+
+        /* fold 64 bytes at a time onto the next 64 bytes */
+        __m128i k = _mm_set_epi64x(FOLD480, FOLD544);
+        while (len >= 64) {
+            x0 = crc32c_fold_one(x0, k,
+                                 _mm_loadu_si128((__m128i const *)next));
+            x1 = crc32c_fold_one(x1, k, _mm_loadu_si128(
+                                     (__m128i const *)(next + 16)));
+            x2 = crc32c_fold_one(x2, k, _mm_loadu_si128(
+                                     (__m128i const *)(next + 32)));
+            x3 = crc32c_fold_one(x3, k, _mm_loadu_si128(
+                                     (__m128i const *)(next + 48)));
+            next += 64;
+            len -= 64;
+        }
+
+        /* fold the four pieces into one, then fold 16 bytes at a time */
+        k = _mm_set_epi64x(FOLD96, FOLD160);
+        x0 = crc32c_fold_one(x0, k, x1);
+        x0 = crc32c_fold_one(x0, k, x2);
+        x0 = crc32c_fold_one(x0, k, x3);
+        while (len >= 16) {
+            x0 = crc32c_fold_one(x0, k,
+                                 _mm_loadu_si128((__m128i const *)next));
+            next += 16;
+            len -= 16;
+        }
+
+        /* the crc of the remaining 128 bits is the crc so far */
+        crc0 = _mm_crc32_u64(0, (uint64_t)_mm_cvtsi128_si64(x0));
+        crc0 = _mm_crc32_u64(crc0, (uint64_t)_mm_extract_epi64(x0, 1));
+    }
+
+    /* compute the crc for the remaining bytes */
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, next, 8);
+        crc0 = _mm_crc32_u64(crc0, word);
+        next += 8;
+        len -= 8;
+    }
+    while (len) {
+        crc0 = _mm_crc32_u8((uint32_t)crc0, *next++);
+        len--;
+    }
+    return ~(uint32_t)crc0;
+}
+
+/* Check for SSE 4.2 and PCLMULQDQ.  SSE 4.2 was first supported in Nehalem
+   processors introduced in November, 2008, and PCLMULQDQ in Westmere in 2010.
+   This does not check for the existence of the cpuid instruction itself,
+   which was introduced on the 486SL in 1992, so this will fail on earlier x86
+   processors.  cpuid works on all Pentium and later processors. */
+static void crc32c_features(int *crc, int *clmul) {
+    uint32_t eax, ecx;
+    eax = 1;
+    __asm__("cpuid"
+            : "=c"(ecx)
+            : "a"(eax)
+            : "%ebx", "%edx");
+    *crc = (ecx >> 20) & 1;
+    *clmul = *crc && ((ecx >> 1) & 1);
 }
 
-#else /* !__x86_64__ */
+#define HAVE_HW
+#define HAVE_FOLD
+#define HW_NAME "sse4.2"
+#define FOLD_NAME "pclmulqdq"
 
+#endif
+
+/* Buffers at least this long use folding, if available.  Folding runs four
+   independent streams on any buffer of 64 bytes or more, where the crc
+   instructions need SHORT*3 bytes to run three streams, so folding is faster
+   for all but the shortest buffers.  For long buffers the two are about the
+   same, limited by the memory bandwidth. */
+#define FOLD_MIN 64
+
+/* The implementations chosen by crc32c_pick() for short and long buffers. */
+static pthread_once_t crc32c_once_pick = PTHREAD_ONCE_INIT;
+static crc32c_func *crc32c_short_impl = crc32c_sw;
+static crc32c_func *crc32c_long_impl = crc32c_sw;
+
+/* Choose the fastest implementations available on this processor. */
+static void crc32c_pick(void) {
+#ifdef HAVE_HW
+    int crc, clmul;
+    crc32c_features(&crc, &clmul);
+    if (crc)
+        crc32c_short_impl = crc32c_long_impl = crc32c_hw;
+#  ifdef HAVE_FOLD
+    if (clmul)
+        crc32c_long_impl = crc32c_fold;
+#  endif
+#endif
+}
+
+/* Compute a CRC-32C.  If the crc32 instruction is available, use the hardware
+   version, with folding for long buffers if available.  Otherwise, use the
+   software version.  Which is available is determined only once. */
 uint32_t crc32c(uint32_t crc, void const *buf, size_t len) {
-    return crc32c_sw(crc, buf, len);
+    pthread_once(&crc32c_once_pick, crc32c_pick);
+    return len >= FOLD_MIN ? crc32c_long_impl(crc, buf, len) :
+                             crc32c_short_impl(crc, buf, len);
 }
 
+/* Return the k'th implementation supported by this processor. */
+crc32c_func *crc32c_impl(unsigned k, char const **name) {
+    struct {
+        char const *name;
+        crc32c_func *func;
+        int have;
+    } impl[] = {
+        {"software", crc32c_sw, 1},
+#ifdef HAVE_HW
+        {HW_NAME, crc32c_hw, 0},
+#  ifdef HAVE_FOLD
+        {FOLD_NAME, crc32c_fold, 0},
+#  endif
+#endif
+        {"crc32c", crc32c, 1}
+    };
+#ifdef HAVE_HW
+    int crc, clmul;
+    crc32c_features(&crc, &clmul);
+    impl[1].have = crc;
+#  ifdef HAVE_FOLD
+    impl[2].have = clmul;
+#  endif
 #endif
+    unsigned n = sizeof(impl) / sizeof(impl[0]);
+    for (unsigned i = 0; i < n; i++)
+        if (impl[i].have && k-- == 0) {
+            *name = impl[i].name;
+            return impl[i].func;
+        }
+    return NULL;
+}
 
 /* Construct table for software CRC-32C little-endian calculation. */
 static pthread_once_t crc32c_once_little = PTHREAD_ONCE_INIT;
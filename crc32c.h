@@ -7,9 +7,19 @@
 // Return the CRC-32C of buf[0..len-1] given the starting CRC crc.  This can be
 // used to calculate the CRC of a sequence of bytes a chunk at a time, using
 // the previously returned crc in the next call.  The first call must be with
-// crc == 0.  crc32c() uses the Intel crc32 hardware instruction if available.
+// crc == 0.  crc32c() uses the Intel crc32 hardware instruction if available,
+// and carry-less multiplication if available.
 uint32_t crc32c(uint32_t crc, void const *buf, size_t len);
 
 // crc32c_sw() is the same, but does not use the hardware instruction, even if
 // available.
 uint32_t crc32c_sw(uint32_t crc, void const *buf, size_t len);
+
+// Type of the implementations of crc32c().
+typedef uint32_t crc32c_func(uint32_t crc, void const *buf, size_t len);
+
+// crc32c_impl() returns the implementations supported by this processor, for
+// speed comparisons.  crc32c_impl(k, &name) returns the k'th one, or NULL if
+// there are no more, with a description in name.  The first is crc32c_sw(),
+// and the last is crc32c() itself.
+crc32c_func *crc32c_impl(unsigned k, char const **name);
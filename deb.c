@@ -1,12 +1,21 @@
 /* Decompress brotli streams on the command line or from stdin using yeast.
    The compressed output is written to the same name with the suffix ".bro" or
    ".compressed" removed and ".out" added, or to "deb.out" when reading from
-   stdin. */
+   stdin.  With the -j N option, the files on the command line are distributed
+   over N threads, each with its own reused decoding state, and the results
+   are reported in the order of the files, with the time for each and the
+   total time at the end.
+
+   When compiled with YEAST_STATS, the -s option writes the decoding
+   statistics for each stream to stdout as one line of JSON, with the counts
+   for each meta-block and the totals for the stream.  -s cannot be used with
+   -j. */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "load.h"
+#include <time.h>
+#include <pthread.h>
 #include "yeast.h"
 
 #if defined(MSDOS) || defined(OS2) || defined(WIN32) || defined(__CYGWIN__)
@@ -21,8 +30,12 @@
 #define SUFFIX2 ".bro"
 #define OUT ".out"
 
-/* Write decompressed output to a derived file name with extension ".out". */
-static void deliver(char *in, void *data, size_t len)
+/* Size of the input chunks fed to the decoder. */
+#define CHUNK 65536
+
+/* Create the output file with a derived file name with extension ".out".
+   Return NULL on failure, leaving the message to the caller. */
+static FILE *create(char *in)
 {
     char *out;
     FILE *file;
@@ -30,10 +43,8 @@ static void deliver(char *in, void *data, size_t len)
 
     inlen = strlen(in);
     out = malloc(inlen + strlen(OUT) + 1);
-    if (out == NULL) {
-        fprintf(stderr, "out of memory");
-        return;
-    }
+    if (out == NULL)
+        return NULL;
     suf = strlen(SUFFIX1);
     if (inlen >= suf && strcmp(in + inlen - suf, SUFFIX1) == 0)
         inlen -= suf;
@@ -45,14 +56,269 @@ static void deliver(char *in, void *data, size_t len)
     memcpy(out, in, inlen);
     strcpy(out + inlen, OUT);
     file = fopen(out, "wb");
-    if (file == NULL) {
-        fprintf(stderr, "could not create %s", out);
-        free(out);
-        return;
-    }
-    fwrite(data, 1, len, file);
-    fclose(file);
     free(out);
+    return file;
+}
+
+/* Decompress from in to out with the decoding state y, a chunk at a time
+   using buf[0..CHUNK-1], writing the output as it is generated.  The number
+   of uncompressed bytes is returned in *total.  Return the last yeast_feed()
+   return value, which is 0 on success, or -2 if there was a read error. */
+static int decode(yeast_t *y, FILE *in, FILE *out, size_t *total,
+                  unsigned char *buf)
+{
+    int ret = -1;
+    size_t len, got;
+    void const *data;
+
+    *total = 0;
+    do {
+        len = fread(buf, 1, CHUNK, in);
+        if (ferror(in))
+            return -2;
+        do {
+            ret = yeast_feed(y, buf, len, feof(in), &data, &got);
+            fwrite(data, 1, got, out);
+            *total += got;
+            len = 0;
+        } while (ret == -1 && got);
+    } while (ret == -1 && !feof(in));
+    return ret;
+}
+
+#ifdef YEAST_STATS
+/* True to write the decoding statistics as JSON (-s). */
+static int stats = 0;
+
+/* Write the string str to out as a JSON string. */
+static void json_string(FILE *out, char const *str)
+{
+    putc('"', out);
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\')
+            fprintf(out, "\\%c", *str);
+        else if ((unsigned char)*str < 0x20)
+            fprintf(out, "\\u%04x", *str);
+        else
+            putc(*str, out);
+    }
+    putc('"', out);
+}
+
+/* Write the statistics for a meta-block to stdout as the next element of a
+   JSON array, where *arg is the number of elements so far. */
+static void block_stats(void *arg, yeast_stats_t const *st)
+{
+    size_t *num = arg;
+
+    if ((*num)++)
+        putchar(',');
+    yeast_stats_json(stdout, st);
+}
+#endif
+
+/* Decompress from in to the output file derived from name, a chunk at a time,
+   writing the output as it is generated.  Return 0 on success, or 1 if out of
+   memory. */
+static int decompress(FILE *in, char *name)
+{
+    int ret;
+    yeast_t *y;
+    FILE *out;
+    size_t total;
+    static unsigned char buf[CHUNK];
+#ifdef YEAST_STATS
+    size_t blocks = 0;
+#endif
+
+    out = create(name);
+    if (out == NULL) {
+        fprintf(stderr, "could not create output for %s\n", name);
+        return 0;
+    }
+    y = yeast_init(NULL, 0);
+    if (y == NULL) {
+        fclose(out);
+        fputs("out of memory\n", stderr);
+        return 1;
+    }
+#ifdef YEAST_STATS
+    if (stats) {
+        fputs("{\"file\":", stdout);
+        json_string(stdout, name);
+        fputs(",\"metablocks\":[", stdout);
+        yeast_stats(y, block_stats, &blocks);
+    }
+#endif
+    ret = decode(y, in, out, &total, buf);
+#ifdef YEAST_STATS
+    if (stats) {
+        fputs("],\"stream\":", stdout);
+        yeast_stats_json(stdout, yeast_totals(y));
+        printf(",\"return\":%d}\n", ret);
+    }
+#endif
+    if (ret == -2)
+        fprintf(stderr, "error reading %s\n", name);
+    fprintf(stderr, "uncompressed length = %zu\n", total);
+    if (ret)
+        fprintf(stderr, "yeast_feed() returned %d\n", ret);
+    yeast_end(y);
+    fclose(out);
+    return ret == 1;
+}
+
+/* Return the current time in seconds. */
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* A file to be decompressed by a worker thread, and the results. */
+typedef struct {
+    char *path;             /* name of the compressed file */
+    int ret;                /* decode() return value, or 2 or 3 if the input
+                               could not be opened or the output created */
+    size_t total;           /* uncompressed length */
+    double secs;            /* time to decompress and write */
+    int done;               /* true when the file has been processed */
+} job_t;
+
+/* Work shared by the worker threads and the thread reporting the results. */
+typedef struct {
+    pthread_mutex_t lock;   /* lock for next and done's */
+    pthread_cond_t cond;    /* signaled when a job is done */
+    job_t *job;             /* the jobs, in order */
+    size_t num;             /* number of jobs */
+    size_t next;            /* next job to take */
+} pool_t;
+
+#define NOOPEN 2
+#define NOCREATE 3
+
+/* Worker thread: take jobs in order and decompress each one, reusing the
+   decoding state and input buffer across jobs. */
+static void *worker(void *arg)
+{
+    pool_t *pool = arg;
+    yeast_t *y = yeast_init(NULL, 0);
+    unsigned char *buf = malloc(CHUNK);
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        if (pool->next == pool->num) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        job_t *job = pool->job + pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+
+        double start = now();
+        FILE *in = NULL, *out = NULL;
+        if (y == NULL || buf == NULL)
+            job->ret = 1;
+        else if ((in = fopen(job->path, "rb")) == NULL)
+            job->ret = NOOPEN;
+        else if ((out = create(job->path)) == NULL)
+            job->ret = NOCREATE;
+        else {
+            yeast_reset(y, NULL, 0);
+            job->ret = decode(y, in, out, &job->total, buf);
+        }
+        if (out != NULL)
+            fclose(out);
+        if (in != NULL)
+            fclose(in);
+        job->secs = now() - start;
+
+        pthread_mutex_lock(&pool->lock);
+        job->done = 1;
+        pthread_cond_broadcast(&pool->cond);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    free(buf);
+    if (y != NULL)
+        yeast_end(y);
+    return NULL;
+}
+
+/* Decompress the num files in path[] on jobs threads, reporting the results
+   in order as they become available.  Return 0 on success, or 1 if out of
+   memory. */
+static int batch(char **path, size_t num, int jobs)
+{
+    pool_t pool;
+    pthread_t *tid;
+    int threads = 0, ret = 0;
+    size_t i, total = 0;
+    double start = now();
+
+    pool.job = calloc(num ? num : 1, sizeof(job_t));
+    tid = malloc(jobs * sizeof(pthread_t));
+    if (pool.job == NULL || tid == NULL) {
+        free(tid);
+        free(pool.job);
+        fputs("out of memory\n", stderr);
+        return 1;
+    }
+    for (i = 0; i < num; i++)
+        pool.job[i].path = path[i];
+    pool.num = num;
+    pool.next = 0;
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.cond, NULL);
+    while (threads < jobs &&
+           pthread_create(tid + threads, NULL, worker, &pool) == 0)
+        threads++;
+    if (threads == 0) {
+        fputs("could not start threads\n", stderr);
+        pool.num = 0;
+        ret = 1;
+    }
+
+    /* report the results in order */
+    for (i = 0; i < pool.num; i++) {
+        job_t *job = pool.job + i;
+        pthread_mutex_lock(&pool.lock);
+        while (!job->done)
+            pthread_cond_wait(&pool.cond, &pool.lock);
+        pthread_mutex_unlock(&pool.lock);
+        fputs(job->path, stderr);
+        fputs(":\n", stderr);
+        if (job->ret == NOOPEN)
+            fprintf(stderr, "error opening %s\n", job->path);
+        else if (job->ret == NOCREATE)
+            fprintf(stderr, "could not create output for %s\n", job->path);
+        else {
+            if (job->ret == -2)
+                fprintf(stderr, "error reading %s\n", job->path);
+            fprintf(stderr, "uncompressed length = %zu in %.3f ms\n",
+                    job->total, job->secs * 1e3);
+            if (job->ret)
+                fprintf(stderr, "yeast_feed() returned %d\n", job->ret);
+            total += job->total;
+        }
+        if (job->ret == 1)
+            ret = 1;
+        if (i + 1 < pool.num)
+            putc('\n', stderr);
+    }
+    double secs = now() - start;
+    if (pool.num)
+        fprintf(stderr, "\n%zu files on %d threads: %zu bytes in %.3f s "
+                "(%.1f MB/s)\n", pool.num, threads, total, secs,
+                total / secs * 1e-6);
+
+    /* clean up */
+    for (i = 0; i < (size_t)threads; i++)
+        pthread_join(tid[i], NULL);
+    pthread_cond_destroy(&pool.cond);
+    pthread_mutex_destroy(&pool.lock);
+    free(pool.job);
+    free(tid);
+    return ret;
 }
 
 /* Decompress all of the files on the command line, or from stdin if no
@@ -60,28 +326,52 @@ static void deliver(char *in, void *data, size_t len)
 int main(int argc, char **argv)
 {
     FILE *in;
-    int ret;
-    void *source = NULL;
-    void *dest;
-    size_t size, len, got;
+    int jobs = 0;
 
-#ifdef DEBUG
-    /* process verbosity option */
+    /* process thread, statistics, and verbosity options */
     if (argc > 1 && argv[1][0] == '-') {
         char *opt;
 
         --argc;
         opt = *++argv;
         while (*++opt) {
-            if (*opt == 'v')
+            if (*opt == 'j') {
+                /* -jN, or -j N */
+                if (opt[1] == 0 && argc > 1) {
+                    --argc;
+                    opt = *++argv - 1;
+                }
+                jobs = (int)strtol(opt + 1, &opt, 10);
+                opt--;
+                if (jobs < 1) {
+                    fputs("deb: -j needs a positive number\n", stderr);
+                    return 1;
+                }
+            }
+#ifdef DEBUG
+            else if (*opt == 'v')
                 yeast_verbosity++;
+#endif
+#ifdef YEAST_STATS
+            else if (*opt == 's')
+                stats = 1;
+#endif
             else {
                 fprintf(stderr, "deb: invalid option %s\n", opt);
                 return 1;
             }
         }
     }
+
+    /* decompress the files on a pool of threads */
+#ifdef YEAST_STATS
+    if (jobs && stats) {
+        fputs("deb: -s and -j cannot be used together\n", stderr);
+        return 1;
+    }
 #endif
+    if (jobs && argc > 1)
+        return batch(argv + 1, argc - 1, jobs);
 
     /* decompress each file on the remaining command line */
     if (--argc) {
@@ -91,24 +381,13 @@ int main(int argc, char **argv)
                 fprintf(stderr, "error opening %s\n", *argv);
                 continue;
             }
-            ret = load(in, 0, &source, &size, &len);
-            fclose(in);
-            if (ret < 0) {
-                fprintf(stderr, "error reading %s\n", *argv);
-                continue;
-            }
-            if (ret > 0) {
-                fputs("out of memory\n", stderr);
-                return 1;
-            }
             fputs(*argv, stderr);
             fputs(":\n", stderr);
-            ret = yeast(&dest, &got, source, &len, 0);
-            fprintf(stderr, "uncompressed length = %zu\n", got);
-            if (ret)
-                fprintf(stderr, "yeast() returned %d\n", ret);
-            deliver(*argv, dest, got);
-            free(dest);
+            if (decompress(in, *argv)) {
+                fclose(in);
+                return 1;
+            }
+            fclose(in);
             if (--argc == 0)
                 break;
             putc('\n', stderr);
@@ -118,19 +397,8 @@ int main(int argc, char **argv)
     /* or if no names on the remaining command line, decompress from stdin */
     else {
         SET_BINARY_MODE(stdin);
-        ret = load(stdin, 0, &source, &size, &len);
-        if (ret) {
-            fputs(ret > 0 ? "out of memory\n" : "error reading stdin\n",
-                  stderr);
+        if (decompress(stdin, "deb"))
             return 1;
-        }
-        ret = yeast(&dest, &got, source, &len, 0);
-        fprintf(stderr, "uncompressed length = %zu\n", got);
-        if (ret)
-            fprintf(stderr, "yeast() returned %d\n", ret);
-        deliver("deb", dest, got);
-        free(dest);
     }
-    free(source);
     return 0;
 }
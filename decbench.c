@@ -0,0 +1,275 @@
+/* Benchmark yeast decoding of the brotli streams named on the command line.
+   Each stream is loaded into memory and decompressed with yeast() in a
+   sequence of samples, and the median speed in MB/s of uncompressed data
+   over the samples is shown, along with the median time stamp counter cycles
+   per uncompressed byte where available, the peak resident memory, and the
+   number of allocations done by one decompression.  The return value of
+   yeast(), the uncompressed length, and the XXH64 of the uncompressed data
+   are shown as well, so that the results from different decoders linked with
+   this, notably yeast.c and yeast-02.c, can be compared for the same
+   behavior.  Each stream is done in its own process, so that the peak memory
+   is for that stream alone.
+
+   The number of samples is 15, or as given by the -n option.  Each sample
+   decompresses the stream repeatedly for about a millisecond, so that short
+   streams can be timed.  If compiled with BROTLIDEC and linked with the
+   reference brotli decoder, then the median speed of that decoder is also
+   shown, or "differs" if its output does not match.
+
+   The allocations counted are those of the decoder, which is compiled for
+   this benchmark with malloc(), realloc(), and free() renamed to
+   count_malloc(), count_realloc(), and count_free() below. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "load.h"
+#include "yeast.h"
+#include "xxhash.h"
+#ifdef BROTLIDEC
+#  include <brotli/decode.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#  include <x86intrin.h>
+#  define CYCLES() __rdtsc()
+#endif
+
+#define local static
+
+#define SAMPLES 15              // default number of samples
+#define SAMPLE 1e-3             // target seconds per sample
+
+// Number of allocations by the decoder, counted by count_malloc() and
+// count_realloc().
+local size_t allocs;
+
+void *count_malloc(size_t size)
+{
+    allocs++;
+    return malloc(size);
+}
+
+void *count_realloc(void *ptr, size_t size)
+{
+    allocs++;
+    return realloc(ptr, size);
+}
+
+void count_free(void *ptr)
+{
+    free(ptr);
+}
+
+// Return the current time in seconds.
+local double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Compare doubles for qsort().
+local int by_value(void const *a, void const *b)
+{
+    double x = *(double const *)a, y = *(double const *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Return the median of val[0..n-1], reordering val[].
+local double median(double *val, int n)
+{
+    qsort(val, n, sizeof(double), by_value);
+    return n & 1 ? val[n >> 1] : (val[(n >> 1) - 1] + val[n >> 1]) / 2;
+}
+
+// Decompress comp[0..len-1] with yeast() reps times, discarding the output.
+local void yeast_reps(void const *comp, size_t len, unsigned long reps)
+{
+    while (reps--) {
+        void *dest = NULL;
+        size_t got = 0, used = len;
+        yeast(&dest, &got, comp, &used, 0);
+        free(dest);
+    }
+}
+
+#ifdef BROTLIDEC
+// Decompress comp[0..len-1] with the reference decoder reps times into
+// dest[0..size-1].  Return false if any fails or the output is not size bytes.
+local int ref_reps(void const *comp, size_t len, unsigned char *dest,
+                   size_t size, unsigned long reps)
+{
+    while (reps--) {
+        size_t got = size;
+        if (BrotliDecoderDecompress(len, comp, &got, dest) !=
+                BROTLI_DECODER_RESULT_SUCCESS || got != size)
+            return 0;
+    }
+    return 1;
+}
+#endif
+
+// Return the number of repetitions of decompressing comp[0..len-1] with
+// yeast() that take about SAMPLE seconds.
+local unsigned long calibrate(void const *comp, size_t len)
+{
+    unsigned long reps = 1;
+    for (;;) {
+        double start = now();
+        yeast_reps(comp, len, reps);
+        double secs = now() - start;
+        if (secs >= SAMPLE / 4 || reps >= 1UL << 30)
+            return secs >= SAMPLE ? reps :
+                   (unsigned long)(reps * SAMPLE / (secs > 0 ? secs : 1e-9));
+        reps <<= 2;
+    }
+}
+
+// Benchmark the stream in the file at path with samples samples, and show the
+// results on one line.
+local void bench(char const *path, int samples)
+{
+    // load the stream
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        printf("%-40s could not open\n", path);
+        return;
+    }
+    void *comp = NULL;
+    size_t size, len;
+    int ret = load(in, 0, &comp, &size, &len);
+    fclose(in);
+    if (ret) {
+        printf("%-40s could not load\n", path);
+        free(comp);
+        return;
+    }
+
+    // decompress once to get the behavior and the allocations
+    void *dest = NULL;
+    size_t got = 0, used = len;
+    allocs = 0;
+    ret = yeast(&dest, &got, comp, &used, 0);
+    size_t count = allocs;
+    printf("%-40s %3d %9zu %016llx", path, ret, got,
+           (unsigned long long)XXH64(dest, got, 0));
+    if (ret || got == 0) {
+        // don't time a failure or an empty stream
+        printf(" %9s %7s", "-", "-");
+#ifdef BROTLIDEC
+        printf(" %9s", "-");
+#endif
+    }
+    else {
+        // time the samples
+        unsigned long reps = calibrate(comp, len);
+        double *speed = malloc(2 * samples * sizeof(double));
+        if (speed == NULL) {
+            puts(" out of memory");
+            free(dest);
+            free(comp);
+            return;
+        }
+        double *cycles = speed + samples;
+        for (int i = 0; i < samples; i++) {
+#ifdef CYCLES
+            uint64_t tick = CYCLES();
+#endif
+            double start = now();
+            yeast_reps(comp, len, reps);
+            double secs = now() - start;
+#ifdef CYCLES
+            tick = CYCLES() - tick;
+            cycles[i] = (double)tick / ((double)reps * got);
+#else
+            cycles[i] = 0;
+#endif
+            speed[i] = (double)reps * got / secs * 1e-6;
+        }
+        printf(" %9.2f", median(speed, samples));
+#ifdef CYCLES
+        printf(" %7.2f", median(cycles, samples));
+#else
+        printf(" %7s", "-");
+#endif
+
+#ifdef BROTLIDEC
+        // time the reference decoder, first checking its output
+        unsigned char *ref = malloc(got);
+        size_t out = got;
+        if (ref == NULL)
+            printf(" %9s", "-");
+        else if (BrotliDecoderDecompress(len, comp, &out, ref) !=
+                     BROTLI_DECODER_RESULT_SUCCESS ||
+                 out != got || memcmp(ref, dest, got))
+            printf(" %9s", "differs");
+        else {
+            for (int i = 0; i < samples; i++) {
+                double start = now();
+                ref_reps(comp, len, ref, got, reps);
+                speed[i] = (double)reps * got / (now() - start) * 1e-6;
+            }
+            printf(" %9.2f", median(speed, samples));
+        }
+        free(ref);
+#endif
+        free(speed);
+    }
+
+    // show the peak memory and the allocations (ru_maxrss is in kilobytes
+    // on Linux and in bytes on macOS)
+    struct rusage use;
+    getrusage(RUSAGE_SELF, &use);
+#ifdef __APPLE__
+    use.ru_maxrss >>= 10;
+#endif
+    printf(" %9ld %6zu\n", (long)use.ru_maxrss, count);
+    free(dest);
+    free(comp);
+}
+
+int main(int argc, char **argv)
+{
+    // interpret the options
+    int samples = SAMPLES;
+    while (argc > 1 && argv[1][0] == '-') {
+        if (strcmp(argv[1], "-n") == 0 && argc > 2) {
+            samples = atoi(argv[2]);
+            argc -= 2;
+            argv += 2;
+        }
+        else
+            samples = 0;
+        if (samples < 1) {
+            fputs("usage: decbench [-n samples] file ...\n", stderr);
+            return 1;
+        }
+    }
+
+    // benchmark each file, each in its own process
+    printf("%-40s %3s %9s %16s %9s %7s", "stream", "ret", "bytes", "xxh64",
+           "MB/s", "cyc/B");
+#ifdef BROTLIDEC
+    printf(" %9s", "ref MB/s");
+#endif
+    printf(" %9s %6s\n", "peak KB", "allocs");
+    while (++argv, --argc) {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            bench(*argv, samples);
+            fflush(stdout);
+            _exit(0);
+        }
+        if (pid == -1)
+            bench(*argv, samples);
+        else
+            waitpid(pid, NULL, 0);
+    }
+    return 0;
+}
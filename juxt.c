@@ -3,27 +3,79 @@
    period and characters that follow the period, and that same name with no
    extension is the associated original file.  This compares the decompressed
    bytes as they are generated, and so catches and reports the error as soon as
-   possible. */
+   possible.
+
+   With the -b option, each stream is instead decompressed and compared BENCH
+   times in memory, first with yeast() and then with yeast_with() on one
+   reused context, and the time per decompression is reported for each.  This
+   is intended for small streams, to show the cost of the per-call setup.
+
+   With the -i option, each stream is instead decompressed in memory with
+   yeast_into() into a buffer that is exactly the size of the original, and
+   then into one that is one byte short, which must return 5 with the data up
+   to the last meta-block that fit, and nothing written past the end.
+
+   With the -m option, each stream is instead measured with yeast_measure(),
+   and the measured length and meta-blocks are checked against the original.
+   Then the stream is decompressed with yeast_into() into a buffer of exactly
+   the measured length, and compared.
+
+   With the -c option, each stream is instead decompressed in memory with a
+   checkpoint requested at every meta-block boundary by yeast_points().  Then
+   decoding is resumed from each of the checkpoints with yeast_resume() and
+   run to the end of the stream, twice: once comparing to the original, and
+   once delivering the data given the original up to the checkpoint as the
+   window, comparing what is delivered.  The checkpoints are distributed over
+   N threads, given by -j N with -c, or RESUMERS threads by default.
+
+   Otherwise with the -j N option, the files are instead distributed over N
+   threads, each of which loads and decompresses a whole stream in memory with
+   its own reused context and load buffers.  The results are reported in the
+   order of the files on the command line, with the decompression time for
+   each, and the total time and speed at the end.
+
+   When compiled with YEAST_STATS, the -s option writes the decoding
+   statistics for each stream to stdout as one line of JSON, with the counts
+   for each meta-block and the totals for the stream.  -s cannot be used
+   with -b, -c, -i, -m, or -j.
+
+   juxt exits with status 1 if any stream did not decompress to its original.
+ */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
+#include <pthread.h>
 #include "load.h"
 #include "yeast.h"
 
-/* Load the file at path into memory, allocating new memory if *dat is NULL, or
-   reusing the allocation at *dat of size *size.  The length of the read data
-   is returned in *len.  load_file() returns zero on success, non-zero on
-   failure. */
-static int load_file(char *path, void **dat, size_t *size, size_t *len)
+/* Size of the input chunks fed to the decoder. */
+#define CHUNK 65536
+
+/* Number of decompressions for each stream with -b. */
+#define BENCH 1000000
+
+/* Default number of threads resuming from checkpoints with -c. */
+#define RESUMERS 4
+
+/* Map or load the file at path into memory, first releasing the previous
+   contents of *dat, if any, which were *len bytes and mapped if *mapped is
+   true.  The data is returned in *dat and *len, with *mapped set as for
+   load_map().  load_file() returns zero on success, non-zero on failure. */
+static int load_file(char *path, void **dat, size_t *len, int *mapped)
 {
     int ret = 0;
+    load_free(*dat, *len, *mapped);
+    *dat = NULL;
+    *len = 0;
+    *mapped = 0;
     FILE *in = fopen(path, "rb");
     if (in == NULL)
         ret = -1;
     else {
-        ret = load(in, 0, dat, size, len);
+        ret = load_map(in, 0, dat, len, mapped);
         fclose(in);
     }
     if (ret)
@@ -47,51 +99,733 @@ static int strip(char *path, int cut)
     return 0;
 }
 
+#ifdef YEAST_STATS
+/* True to write the decoding statistics as JSON (-s). */
+static int stats = 0;
+
+/* Write the string str to out as a JSON string. */
+static void json_string(FILE *out, char const *str)
+{
+    putc('"', out);
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\')
+            fprintf(out, "\\%c", *str);
+        else if ((unsigned char)*str < 0x20)
+            fprintf(out, "\\u%04x", *str);
+        else
+            putc(*str, out);
+    }
+    putc('"', out);
+}
+
+/* Write the statistics for a meta-block to stdout as the next element of a
+   JSON array, where *arg is the number of elements so far. */
+static void block_stats(void *arg, yeast_stats_t const *st)
+{
+    size_t *num = arg;
+
+    if ((*num)++)
+        putchar(',');
+    yeast_stats_json(stdout, st);
+}
+#endif
+
+/* Decompress the brotli stream from in a chunk at a time, comparing to the
+   len bytes at orig, the contents of the file name.  Return the yeast_feed()
+   return value, or -2 on a read error. */
+static int compare(FILE *in, void *orig, size_t len, char const *name)
+{
+    int ret = -1;
+    yeast_t *y;
+    size_t got, total = 0;
+    void const *data;
+    static unsigned char buf[CHUNK];
+
+    y = yeast_init(orig, len);
+    if (y == NULL)
+        return 1;
+#ifdef YEAST_STATS
+    size_t blocks = 0;
+    if (stats) {
+        fputs("{\"file\":", stdout);
+        json_string(stdout, name);
+        fputs(",\"metablocks\":[", stdout);
+        yeast_stats(y, block_stats, &blocks);
+    }
+#else
+    (void)name;
+#endif
+    do {
+        size_t n = fread(buf, 1, CHUNK, in);
+        if (ferror(in)) {
+            ret = -2;
+            break;
+        }
+        do {
+            ret = yeast_feed(y, buf, n, feof(in), &data, &got);
+            total += got;
+            n = 0;
+        } while (ret == -1 && got);
+    } while (ret == -1 && !feof(in));
+#ifdef YEAST_STATS
+    if (stats) {
+        fputs("],\"stream\":", stdout);
+        yeast_stats_json(stdout, yeast_totals(y));
+        printf(",\"return\":%d}\n", ret);
+    }
+#endif
+    yeast_end(y);
+    if (ret == 0 && total != len)
+        fprintf(stderr, "uncompressed length %zu, expected %zu\n",
+                total, len);
+    return ret;
+}
+
+/* Decompress and compare the len bytes at comp to the ulen bytes at orig
+   BENCH times, with and without a reused context, and report the average time
+   for each.  Return the first non-zero yeast() return value, or 1 if out of
+   memory. */
+static int bench(void *comp, size_t len, void *orig, size_t ulen)
+{
+    int ret = 0;
+    long n;
+    clock_t start;
+    double one, ctx;
+    yeast_ctx *y;
+    size_t clen, got;
+
+    y = yeast_ctx_new();
+    if (y == NULL)
+        return 1;
+    start = clock();
+    for (n = 0; n < BENCH && ret == 0; n++) {
+        clen = len;
+        got = ulen;
+        ret = yeast(&orig, &got, comp, &clen, 1);
+    }
+    one = (double)(clock() - start) / CLOCKS_PER_SEC;
+    start = clock();
+    for (n = 0; n < BENCH && ret == 0; n++) {
+        clen = len;
+        got = ulen;
+        ret = yeast_with(y, &orig, &got, comp, &clen, 1);
+    }
+    ctx = (double)(clock() - start) / CLOCKS_PER_SEC;
+    yeast_ctx_free(y);
+    if (ret == 0)
+        fprintf(stderr, "%d x %zu -> %zu bytes: yeast() %.3f us, "
+                "yeast_with() %.3f us per decompression\n",
+                BENCH, len, ulen, one * 1e6 / BENCH, ctx * 1e6 / BENCH);
+    return ret;
+}
+
+/* Decompress the len bytes at comp with yeast_into() into a buffer the size
+   of the ulen bytes at orig, and compare.  Then decompress again into a buffer
+   one byte short, which must return 5, with *got at the end of a meta-block
+   that fit, and nothing written past the end of the buffer.  Return 0 if both
+   behave as expected, or 1 if not or if out of memory. */
+static int into(void *comp, size_t len, void *orig, size_t ulen)
+{
+    int ret;
+    yeast_ctx *y;
+    unsigned char *buf, *want = orig;
+    size_t clen, got;
+
+    y = yeast_ctx_new();
+    buf = malloc(ulen ? ulen : 1);
+    if (y == NULL || buf == NULL) {
+        free(buf);
+        yeast_ctx_free(y);
+        fputs("out of memory\n", stderr);
+        return 1;
+    }
+    clen = len;
+    got = ulen;
+    ret = yeast_into(y, buf, &got, comp, &clen);
+    if (ret)
+        fprintf(stderr, "yeast_into() returned %d\n", ret);
+    else if (got != ulen)
+        fprintf(stderr, "uncompressed length %zu, expected %zu\n",
+                got, ulen);
+    else if (memcmp(buf, orig, ulen)) {
+        fputs("yeast_into() output does not match\n", stderr);
+        ret = 1;
+    }
+    else if (ulen) {
+        buf[ulen - 1] = ~want[ulen - 1];
+        clen = len;
+        got = ulen - 1;
+        ret = yeast_into(y, buf, &got, comp, &clen);
+        if (ret != 5)
+            fprintf(stderr, "yeast_into() one byte short returned %d, "
+                    "expected 5\n", ret);
+        else if (got >= ulen || memcmp(buf, orig, got)) {
+            fputs("yeast_into() one byte short output does not match\n",
+                  stderr);
+            ret = 1;
+        }
+        else if (buf[ulen - 1] != (unsigned char)~want[ulen - 1]) {
+            fputs("yeast_into() wrote past the end of the buffer\n",
+                  stderr);
+            ret = 1;
+        }
+        else {
+            fprintf(stderr, "%zu -> %zu bytes, %zu in one byte short\n",
+                    len, ulen, got);
+            ret = 0;
+        }
+    }
+    else
+        fprintf(stderr, "%zu -> 0 bytes\n", len);
+    free(buf);
+    yeast_ctx_free(y);
+    return ret != 0;
+}
+
+/* Measure the len bytes at comp with yeast_measure(), check the measurement
+   against the ulen bytes at orig, and then decompress with yeast_into() into
+   a buffer of the measured length and compare.  Return 0 if they all agree,
+   or 1 if not or if out of memory. */
+static int measure(void *comp, size_t len, void *orig, size_t ulen)
+{
+    int ret;
+    yeast_ctx *y;
+    yeast_measure_t m;
+    unsigned char *buf = NULL;
+    size_t clen, got, n, at = 0;
+
+    y = yeast_ctx_new();
+    if (y == NULL) {
+        fputs("out of memory\n", stderr);
+        return 1;
+    }
+    clen = len;
+    ret = yeast_measure(y, comp, &clen, &m);
+    if (ret)
+        fprintf(stderr, "yeast_measure() returned %d\n", ret);
+    else if (m.total != ulen) {
+        fprintf(stderr, "measured length %zu, expected %zu\n",
+                m.total, ulen);
+        ret = 1;
+    }
+    for (n = 0; ret == 0 && n < m.num; n++) {
+        yeast_block_t const *b = m.block + n;
+        if (b->start != at || b->len > ulen - at ||
+            (n && b->bit <= m.block[n - 1].bit) ||
+            (b->kind == YEAST_STORED && (b->stored > len - b->len ||
+             memcmp((char *)comp + b->stored, (char *)orig + at, b->len)))) {
+            fprintf(stderr, "meta-block %zu measure does not match\n", n);
+            ret = 1;
+        }
+        at += b->len;
+    }
+    if (ret == 0 && at != ulen) {
+        fprintf(stderr, "meta-blocks total %zu, expected %zu\n", at, ulen);
+        ret = 1;
+    }
+    if (ret == 0 && (buf = malloc(m.total ? m.total : 1)) == NULL) {
+        fputs("out of memory\n", stderr);
+        ret = 1;
+    }
+    if (ret == 0) {
+        clen = len;
+        got = m.total;
+        ret = yeast_into(y, buf, &got, comp, &clen);
+        if (ret)
+            fprintf(stderr, "yeast_into() returned %d\n", ret);
+        else if (got != ulen || memcmp(buf, orig, ulen)) {
+            fputs("yeast_into() output does not match\n", stderr);
+            ret = 1;
+        }
+        else
+            fprintf(stderr, "%zu -> %zu bytes in %zu meta-block%s, %u window"
+                    "%s\n", len, m.total, m.num, m.num == 1 ? "" : "s",
+                    m.wsize, m.window ? " (decoded)" : "");
+    }
+    free(buf);
+    free(m.block);
+    yeast_ctx_free(y);
+    return ret != 0;
+}
+
+/* Checkpoints from a stream, and the work shared by the threads resuming
+   from them. */
+typedef struct {
+    pthread_mutex_t lock;   /* lock for next and bad */
+    unsigned char *comp;    /* compressed stream */
+    size_t len;             /* length of the compressed stream */
+    void *orig;             /* original data */
+    size_t ulen;            /* length of the original data */
+    yeast_point_t *pt;      /* checkpoints, in stream order */
+    size_t num;             /* number of checkpoints */
+    size_t size;            /* allocated checkpoints, or 0 if out of memory */
+    size_t next;            /* next checkpoint to resume from */
+    size_t bad;             /* number of failed resumes */
+} resume_t;
+
+/* yeast_points() callback: append the checkpoint pt to the list in *arg. */
+static void collect(void *arg, yeast_point_t const *pt)
+{
+    resume_t *r = arg;
+
+    if (r->size == 0)
+        return;
+    if (r->num == r->size) {
+        yeast_point_t *mem = realloc(r->pt, 2 * r->size * sizeof(*mem));
+        if (mem == NULL) {
+            r->size = 0;
+            return;
+        }
+        r->pt = mem;
+        r->size <<= 1;
+    }
+    r->pt[r->num++] = *pt;
+}
+
+/* Resume decoding with y from the checkpoint pt in r, comparing to the
+   original if cmp is true, or else delivering the data given the window
+   before the checkpoint and comparing that.  Return 0 if the rest of the
+   stream decodes correctly, or the yeast_resume() or yeast_feed() return
+   value, or 4 if the data delivered does not match, as for a compare. */
+static int resume_one(yeast_t *y, resume_t *r, yeast_point_t const *pt,
+                      int cmp)
+{
+    int ret;
+    size_t skip = pt->bit >> 3, at = pt->offset, got;
+    void const *data;
+
+    ret = cmp ? yeast_resume(y, pt, r->orig, r->ulen, NULL, 0) :
+                yeast_resume(y, pt, NULL, 0, r->orig, at);
+    if (ret)
+        return ret;
+    ret = yeast_feed(y, r->comp + skip, r->len - skip, 1, &data, &got);
+    for (;;) {
+        if (!cmp && (got > r->ulen - at ||
+                     memcmp(data, (char *)r->orig + at, got)))
+            return 4;
+        at += got;
+        if (ret != -1 || got == 0)
+            break;
+        ret = yeast_feed(y, NULL, 0, 1, &data, &got);
+    }
+    return ret ? ret : at == r->ulen ? 0 : 4;
+}
+
+/* Resumer thread: take the checkpoints in order, and resume decoding from
+   each one to the end of the stream, both comparing and delivering. */
+static void *resumer(void *arg)
+{
+    resume_t *r = arg;
+    yeast_t *y = yeast_init(NULL, 0);
+
+    for (;;) {
+        pthread_mutex_lock(&r->lock);
+        if (r->next == r->num) {
+            pthread_mutex_unlock(&r->lock);
+            break;
+        }
+        yeast_point_t const *pt = r->pt + r->next++;
+        pthread_mutex_unlock(&r->lock);
+
+        int cmp = y == NULL ? 1 : resume_one(y, r, pt, 1);
+        int out = y == NULL ? 1 : resume_one(y, r, pt, 0);
+        if (cmp || out) {
+            pthread_mutex_lock(&r->lock);
+            fprintf(stderr, "resume at bit %llu, offset %llu returned %d "
+                    "comparing, %d delivering\n", (unsigned long long)pt->bit,
+                    (unsigned long long)pt->offset, cmp, out);
+            r->bad++;
+            pthread_mutex_unlock(&r->lock);
+        }
+    }
+    if (y != NULL)
+        yeast_end(y);
+    return NULL;
+}
+
+/* Decompress the len bytes at comp, comparing to the ulen bytes at orig, and
+   get a checkpoint at every meta-block boundary.  Then resume from each
+   checkpoint on jobs threads.  Return 0 if the stream and all of the resumes
+   decode correctly, or 1 if not or if out of memory. */
+static int resume(void *comp, size_t len, void *orig, size_t ulen, int jobs)
+{
+    int ret, threads = 0;
+    resume_t r;
+    yeast_t *y;
+    pthread_t *tid;
+    size_t got, total = 0;
+    void const *data;
+
+    r.comp = comp;
+    r.len = len;
+    r.orig = orig;
+    r.ulen = ulen;
+    r.num = 0;
+    r.size = 16;
+    r.next = 0;
+    r.bad = 0;
+    r.pt = malloc(r.size * sizeof(yeast_point_t));
+    y = yeast_init(orig, ulen);
+    tid = malloc(jobs * sizeof(pthread_t));
+    if (r.pt == NULL || y == NULL || tid == NULL) {
+        free(tid);
+        if (y != NULL)
+            yeast_end(y);
+        free(r.pt);
+        fputs("out of memory\n", stderr);
+        return 1;
+    }
+
+    /* decode the whole stream, collecting the checkpoints */
+    yeast_points(y, 0, collect, &r);
+    ret = yeast_feed(y, comp, len, 1, &data, &got);
+    total += got;
+    while (ret == -1 && got) {
+        ret = yeast_feed(y, NULL, 0, 1, &data, &got);
+        total += got;
+    }
+    yeast_end(y);
+    if (ret)
+        fprintf(stderr, "yeast_feed() returned %d\n", ret);
+    else if (total != ulen) {
+        fprintf(stderr, "uncompressed length %zu, expected %zu\n",
+                total, ulen);
+        ret = 1;
+    }
+    else if (r.size == 0) {
+        fputs("out of memory\n", stderr);
+        ret = 1;
+    }
+
+    /* resume from each checkpoint on a pool of threads */
+    if (ret == 0) {
+        pthread_mutex_init(&r.lock, NULL);
+        while (threads < jobs &&
+               pthread_create(tid + threads, NULL, resumer, &r) == 0)
+            threads++;
+        if (threads == 0) {
+            fputs("could not start threads\n", stderr);
+            ret = 1;
+        }
+        while (threads)
+            pthread_join(tid[--threads], NULL);
+        pthread_mutex_destroy(&r.lock);
+        if (ret == 0 && r.bad) {
+            fprintf(stderr, "%zu of %zu resumes failed\n", r.bad, r.num);
+            ret = 1;
+        }
+        else if (ret == 0)
+            fprintf(stderr, "%zu -> %zu bytes, resumed from %zu "
+                    "checkpoint%s\n", len, ulen, r.num, r.num == 1 ? "" : "s");
+    }
+    free(tid);
+    free(r.pt);
+    return ret != 0;
+}
+
+/* Return the current time in seconds. */
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* A file to be checked by a worker thread, and the results. */
+typedef struct {
+    char *path;             /* name of the compressed file */
+    char *orig;             /* name of the original file (allocated) */
+    int ret;                /* yeast_with() return value, or -1 if no load */
+    size_t clen;            /* length of the compressed data */
+    size_t ulen;            /* length of the original data */
+    size_t got;             /* length of the data that matched */
+    double secs;            /* time to decompress and compare */
+    int done;               /* true when the file has been processed */
+} job_t;
+
+/* Work shared by the worker threads and the thread reporting the results. */
+typedef struct {
+    pthread_mutex_t lock;   /* lock for next and done's */
+    pthread_cond_t cond;    /* signaled when a job is done */
+    job_t *job;             /* the jobs, in order */
+    size_t num;             /* number of jobs */
+    size_t next;            /* next job to take */
+} pool_t;
+
+/* Worker thread: take jobs in order, and load, decompress, and compare each
+   one, reusing the decoding context and the load buffers across jobs. */
+static void *worker(void *arg)
+{
+    pool_t *pool = arg;
+    yeast_ctx *y = yeast_ctx_new();
+    void *comp = NULL, *orig = NULL;
+    size_t csize = 0, osize = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        if (pool->next == pool->num) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        job_t *job = pool->job + pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+
+        job->ret = -1;
+        FILE *in = fopen(job->path, "rb");
+        int bad = in == NULL || load(in, 0, &comp, &csize, &job->clen);
+        if (in != NULL)
+            fclose(in);
+        if (!bad) {
+            in = fopen(job->orig, "rb");
+            bad = in == NULL || load(in, 0, &orig, &osize, &job->ulen);
+            if (in != NULL)
+                fclose(in);
+        }
+        if (!bad) {
+            size_t len = job->clen;
+            double start = now();
+            job->got = job->ulen;
+            job->ret = y == NULL ? 1 :
+                       yeast_with(y, &orig, &job->got, comp, &len, 1);
+            job->secs = now() - start;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        job->done = 1;
+        pthread_cond_broadcast(&pool->cond);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    free(orig);
+    free(comp);
+    yeast_ctx_free(y);
+    return NULL;
+}
+
+/* Check the num compressed files in path[] on jobs threads, reporting the
+   results in order as they become available.  Return 0 if all of the files
+   were checked successfully, 1 otherwise. */
+static int batch(char **path, size_t num, int jobs)
+{
+    pool_t pool;
+    pthread_t *tid;
+    int threads = 0, fail = 0;
+    size_t i, clen = 0, ulen = 0;
+    double start = now();
+
+    pool.job = calloc(num ? num : 1, sizeof(job_t));
+    tid = malloc(jobs * sizeof(pthread_t));
+    if (pool.job == NULL || tid == NULL) {
+        free(tid);
+        free(pool.job);
+        fputs("out of memory\n", stderr);
+        return 1;
+    }
+    pool.num = 0;
+    for (i = 0; i < num; i++) {
+        if (strip(path[i], 0)) {
+            fprintf(stderr, "%s has no extension\n", path[i]);
+            fail = 1;
+            continue;
+        }
+        job_t *job = pool.job + pool.num;
+        job->path = path[i];
+        job->orig = malloc(strlen(path[i]) + 1);
+        if (job->orig == NULL)
+            break;
+        strcpy(job->orig, path[i]);
+        strip(job->orig, 1);
+        pool.num++;
+    }
+    pool.next = 0;
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.cond, NULL);
+    if (i == num)
+        while (threads < jobs &&
+               pthread_create(tid + threads, NULL, worker, &pool) == 0)
+            threads++;
+    if (threads == 0) {
+        fputs(i == num ? "could not start threads\n" : "out of memory\n",
+              stderr);
+        pool.num = 0;
+        fail = 1;
+    }
+
+    /* report the results in order */
+    for (i = 0; i < pool.num; i++) {
+        job_t *job = pool.job + i;
+        pthread_mutex_lock(&pool.lock);
+        while (!job->done)
+            pthread_cond_wait(&pool.cond, &pool.lock);
+        pthread_mutex_unlock(&pool.lock);
+        fprintf(stderr, "%s:\n", job->orig);
+        if (job->ret == -1)
+            fprintf(stderr, "could not load %s\n", job->orig);
+        else if (job->ret)
+            fprintf(stderr, "yeast_with() returned %d\n", job->ret);
+        else if (job->got != job->ulen)
+            fprintf(stderr, "uncompressed length %zu, expected %zu\n",
+                    job->got, job->ulen);
+        else {
+            fprintf(stderr, "%zu -> %zu bytes in %.3f ms\n",
+                    job->clen, job->ulen, job->secs * 1e3);
+            clen += job->clen;
+            ulen += job->ulen;
+        }
+        fail |= job->ret != 0 || job->got != job->ulen;
+        if (i + 1 < pool.num)
+            putc('\n', stderr);
+    }
+    double secs = now() - start;
+    if (pool.num)
+        fprintf(stderr, "\n%zu files on %d threads: %zu -> %zu bytes in "
+                "%.3f s (%.1f MB/s uncompressed)\n", pool.num, threads, clen,
+                ulen, secs, ulen / secs * 1e-6);
+
+    /* clean up */
+    for (i = 0; i < (size_t)threads; i++)
+        pthread_join(tid[i], NULL);
+    pthread_cond_destroy(&pool.cond);
+    pthread_mutex_destroy(&pool.lock);
+    for (i = 0; i < num; i++)
+        free(pool.job[i].orig);
+    free(pool.job);
+    free(tid);
+    return fail;
+}
+
 /* Decompress and check all of the compressed files on the command line. */
 int main(int argc, char **argv)
 {
-    int ret;
+    int ret, timed = 0, fill = 0, size = 0, points = 0, jobs = 0, fail = 0;
+    FILE *in;
     void *compressed = NULL;
     void *uncompressed = NULL;
-    size_t csize, clen, usize, ulen;
+    size_t clen = 0, ulen = 0;
+    int cmap = 0, umap = 0;
 
-#ifdef DEBUG
-    /* process verbosity option */
+    /* process the mode, thread, statistics, and verbosity options */
     if (argc > 1 && argv[1][0] == '-') {
         char *opt;
 
         --argc;
         opt = *++argv;
         while (*++opt) {
-            if (*opt == 'v')
+            if (*opt == 'b')
+                timed = 1;
+            else if (*opt == 'c')
+                points = 1;
+            else if (*opt == 'i')
+                fill = 1;
+            else if (*opt == 'm')
+                size = 1;
+            else if (*opt == 'j') {
+                /* -jN, or -j N */
+                if (opt[1] == 0 && argc > 1) {
+                    --argc;
+                    opt = *++argv - 1;
+                }
+                jobs = (int)strtol(opt + 1, &opt, 10);
+                opt--;
+                if (jobs < 1) {
+                    fputs("juxt: -j needs a positive number\n", stderr);
+                    return 1;
+                }
+            }
+#ifdef DEBUG
+            else if (*opt == 'v')
                 yeast_verbosity++;
+#endif
+#ifdef YEAST_STATS
+            else if (*opt == 's')
+                stats = 1;
+#endif
             else {
                 fprintf(stderr, "juxt: invalid option %s\n", opt);
                 return 1;
             }
         }
     }
+
+#ifdef YEAST_STATS
+    if (stats && (timed || points || fill || size || jobs)) {
+        fputs("juxt: -s cannot be used with -b, -c, -i, -m, or -j\n",
+              stderr);
+        return 1;
+    }
 #endif
 
+    /* test the files on a pool of threads */
+    if (timed + points + fill + size > 1) {
+        fputs("juxt: only one of -b, -c, -i, or -m can be used\n", stderr);
+        return 1;
+    }
+    if (jobs && !points) {
+        if (timed || fill || size) {
+            fputs("juxt: -b, -i, or -m cannot be used with -j\n", stderr);
+            return 1;
+        }
+        return batch(argv + 1, argc - 1, jobs);
+    }
+
     /* test each name in the command line remaining */
     while (++argv, --argc) {
         if (strip(*argv, 0)) {
             fprintf(stderr, "%s has no extension\n", *argv);
+            fail = 1;
             continue;
         }
-        if (load_file(*argv, &compressed, &csize, &clen))
+        if (timed || points || fill || size) {
+            if (load_file(*argv, &compressed, &clen, &cmap)) {
+                fail = 1;
+                continue;
+            }
+            strip(*argv, 1);
+            if (load_file(*argv, &uncompressed, &ulen, &umap)) {
+                fail = 1;
+                continue;
+            }
+            fprintf(stderr, "%s:\n", *argv);
+            if (fill)
+                ret = into(compressed, clen, uncompressed, ulen);
+            else if (size)
+                ret = measure(compressed, clen, uncompressed, ulen);
+            else if (points)
+                ret = resume(compressed, clen, uncompressed, ulen,
+                             jobs ? jobs : RESUMERS);
+            else {
+                ret = bench(compressed, clen, uncompressed, ulen);
+                if (ret)
+                    fprintf(stderr, "yeast() returned %d\n", ret);
+            }
+            fail |= ret != 0;
+            if (!timed && argc > 1)
+                putc('\n', stderr);
             continue;
+        }
+        in = fopen(*argv, "rb");
+        if (in == NULL) {
+            fprintf(stderr, "could not open %s\n", *argv);
+            fail = 1;
+            continue;
+        }
         strip(*argv, 1);
-        if (load_file(*argv, &uncompressed, &usize, &ulen))
+        if (load_file(*argv, &uncompressed, &ulen, &umap)) {
+            fclose(in);
+            fail = 1;
             continue;
+        }
         fprintf(stderr, "%s:\n", *argv);
-        ret = yeast(&uncompressed, &ulen, compressed, &clen, 1);
-        if (ret)
-            fprintf(stderr, "yeast() returned %d\n", ret);
+        ret = compare(in, uncompressed, ulen, *argv);
+        fclose(in);
+        if (ret == -2)
+            fprintf(stderr, "read error\n");
+        else if (ret)
+            fprintf(stderr, "yeast_feed() returned %d\n", ret);
+        fail |= ret != 0;
         if (argc > 1)
             putchar('\n');
     }
-    free(uncompressed);
-    free(compressed);
-    return 0;
+    load_free(uncompressed, ulen, umap);
+    load_free(compressed, clen, cmap);
+    return fail;
 }
@@ -1,5 +1,17 @@
+#if defined(__unix__) || defined(__APPLE__)
+#  define _FILE_OFFSET_BITS 64
+#  define _DEFAULT_SOURCE
+#endif
 #include <stdlib.h>
 #include <stddef.h>
+#include <stdint.h>
+#if defined(__unix__) || defined(__APPLE__)
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#  define MMAP
+#endif
 #include "load.h"
 
 // Return true if there is more to read from in. This function is used only if
@@ -68,3 +80,57 @@ int load(FILE *in, size_t limit, void **dat, size_t *size, size_t *len) {
         *size = have;
     return *len == limit && more(in) ? 1 : 0;
 }
+
+// See load.h for description.
+int load_map(FILE *in, size_t limit, void **dat, size_t *len, int *mapped) {
+    *dat = NULL;
+    *len = 0;
+    *mapped = 0;
+#ifdef MMAP
+    // map a regular file from the current position to the end, or to limit
+    struct stat st;
+    off_t pos = ftello(in);
+    if (pos != -1 && fstat(fileno(in), &st) == 0 && S_ISREG(st.st_mode) &&
+        st.st_size > pos) {
+        if (limit == 0)
+            limit = (size_t)-1 >> 1;
+        uintmax_t left = (uintmax_t)(st.st_size - pos);
+        size_t want = left > limit ? limit : (size_t)left;
+
+        // mmap() needs an offset that is a multiple of the page size, so map
+        // from the page that pos is in
+        off_t base = pos - pos % sysconf(_SC_PAGESIZE);
+        size_t skip = (size_t)(pos - base);
+        if (want <= (size_t)-1 - skip) {
+            void *map = mmap(NULL, skip + want, PROT_READ, MAP_PRIVATE,
+                             fileno(in), base);
+            if (map != MAP_FAILED) {
+                madvise(map, skip + want, MADV_SEQUENTIAL);
+                fseeko(in, pos + (off_t)want, SEEK_SET);
+                *dat = (char *)map + skip;
+                *len = want;
+                *mapped = 1;
+                return want < left ? 1 : 0;
+            }
+        }
+    }
+#endif
+
+    // not a regular file, or could not map it -- read it instead
+    return load(in, limit, dat, NULL, len);
+}
+
+// See load.h for description.
+void load_free(void *dat, size_t len, int mapped) {
+#ifdef MMAP
+    if (mapped) {
+        // the mapping starts at the page that dat is in
+        size_t skip = (uintptr_t)dat % sysconf(_SC_PAGESIZE);
+        munmap((char *)dat - skip, skip + len);
+        return;
+    }
+#endif
+    (void)len;
+    (void)mapped;
+    free(dat);
+}
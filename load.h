@@ -27,3 +27,18 @@
 #include <stddef.h>
 
 int load(FILE *in, size_t limit, void **dat, size_t *size, size_t *len);
+
+/* Map the input from in into memory if it is a regular file, or else load it
+   with load() into a new allocation.  On return *dat points to the *len bytes
+   of data from the current position of in, and *mapped is true if the data is
+   a read-only mapping of the file, or false if it was loaded.  The data must
+   not be modified in either case.  Mapping avoids copying the data and growing
+   an allocation to hold it, which can be a large part of the time and memory
+   used for big files.  The mapping is advised to be read sequentially.  Files
+   reported to have no length, such as those in /proc, are loaded.  limit, the
+   file position, and the return values are as for load(), as is the content
+   of *dat and *len on failure.  load_free() releases *dat, whether mapped or
+   loaded, and *dat may be NULL.
+ */
+int load_map(FILE *in, size_t limit, void **dat, size_t *len, int *mapped);
+void load_free(void *dat, size_t len, int mapped);
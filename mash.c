@@ -0,0 +1,974 @@
+// mash.c
+// Copyright (C) 2016 Mark Adler
+// For conditions of distribution and use, see the accompanying LICENSE file.
+//
+// Brotli compressor -- see mash.h for the interface.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "mash.h"
+#include "huff.h"
+#include "flatten.h"
+#include "pack.h"
+#include "try.h"
+
+#define local static
+
+// Elementary transforms and transform descriptions, as in yeast.c.
+#define IDENTITY 0
+#define OMITFIRST 1
+#define OMITLAST 2
+#define UPPERFIRST 3
+#define UPPERALL 4
+typedef struct {
+    unsigned char kind;     // elementary transform
+    unsigned char omit;     // bytes to omit for OMITFIRST and OMITLAST
+    unsigned char plen;     // length of prefix (0..5)
+    unsigned char slen;     // length of suffix (0..8)
+    char prefix[6];         // prefix string
+    char suffix[9];         // suffix string
+} transform_t;
+#include "transform.h"
+#define NTRANSFORMS (sizeof(transform) / sizeof(transform_t))
+
+// Brotli static dictionary, its offsets for each word length, and the number
+// of bits in the index of the words of each length.
+#include "dict.h"
+local uint32_t const doffset[] = {
+    0, 0, 0, 0, 0, 4096, 9216, 21504, 35840, 44032, 53248, 63488, 74752,
+    87040, 93696, 100864, 104704, 106752, 108928, 113536, 115968, 118528,
+    119872, 121280, 122016
+};
+local unsigned char const ndbits[] = {
+    0, 0, 0, 0, 10, 10, 11, 11, 10, 10, 10, 10, 10, 9, 9, 8, 7, 7, 8, 7, 7,
+    6, 6, 5, 5
+};
+#define NWORDS 13504            // number of dictionary words
+
+// Insert and copy length codes.
+local unsigned const ins_base[] = {
+    0, 1, 2, 3, 4, 5, 6, 8, 10, 14, 18, 26, 34, 50, 66, 98, 130, 194, 322,
+    578, 1090, 2114, 6210, 22594};
+local unsigned char const ins_extra[] = {
+    0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 7, 8, 9, 10, 12, 14, 24};
+local unsigned const copy_base[] = {
+    2, 3, 4, 5, 6, 7, 8, 9, 10, 12, 14, 18, 22, 30, 38, 54, 70, 102, 134, 198,
+    326, 582, 1094, 2118};
+local unsigned char const copy_extra[] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 7, 8, 9, 10, 24};
+
+// Insert and copy cell with an explicit distance for each insert code range
+// (0..7, 8..15, 16..23) and copy code range, indexed by 3 * (insert >> 3) +
+// (copy >> 3).
+local unsigned char const cell[] = {2, 3, 6, 4, 5, 8, 7, 9, 10};
+
+// Alphabet sizes.
+#define NLIT 256
+#define NIAC 704
+#define NDIST 64                // 16 + NDIRECT + (48 << NPOSTFIX), both zero
+#define MAXSYM NIAC
+
+// Compression parameters for each level.
+local struct {
+    unsigned short depth;   // maximum hash chain links to follow
+    unsigned short nice;    // match length that ends the search
+    unsigned char lazy;     // true to try for a longer match one byte later
+    unsigned char dict;     // true to look for static dictionary words
+    unsigned char full;     // true to hash every position in a match
+} const levels[] = {
+    {1, 16, 0, 0, 0},       // 0
+    {4, 24, 0, 0, 1},       // 1
+    {8, 32, 0, 1, 1},       // 2
+    {16, 48, 0, 1, 1},      // 3
+    {16, 64, 1, 1, 1},      // 4
+    {32, 96, 1, 1, 1},      // 5
+    {64, 128, 1, 1, 1},     // 6
+    {256, 256, 1, 1, 1},    // 7
+    {1024, 1024, 1, 1, 1},  // 8
+    {4096, 4096, 1, 1, 1}   // 9
+};
+
+#define MINMATCH 4              // shortest match sought in the window
+#define FAR 65536               // a match of MINMATCH must be closer than this
+#define MINWORD 6               // shortest transformed word worth coding
+#define HBITS 16                // number of bits in the window hash
+#define DBITS 15                // number of bits in the dictionary hash
+#define NONE 0xffff             // end of a dictionary hash chain
+
+// ----- Static dictionary index -----
+
+// Dictionary words hashed on their first four bytes in each of their three
+// case forms: as is, first character uppercased, and all uppercased.  An
+// entry is the form in bits 24..25, the word length in bits 16..20, and the
+// word index in the low bits.  The transforms other than OMITFIRST are
+// grouped by their prefix, and within a group by kind: IDENTITY, OMITLAST,
+// UPPERFIRST, UPPERALL.  The transform numbers of kind k in group i are in
+// xorder[group[i][k]..group[i][k + 1] - 1], in order of decreasing length
+// added.
+#define NGROUPS 16              // more than the number of distinct prefixes
+local unsigned short dhead[1 << DBITS];
+local unsigned short dnext[3 * NWORDS];
+local uint32_t dentry[3 * NWORDS];
+local unsigned char xorder[NTRANSFORMS];
+local unsigned char group[NGROUPS][5];
+local unsigned groups;
+
+// Return the kind order within a group for transform t.
+#define KIND(t) (transform[t].kind ? transform[t].kind - 1U : 0U)
+local pthread_once_t indexed = PTHREAD_ONCE_INIT;
+
+// Hash the four bytes at p.
+local inline unsigned dhash(unsigned char const *p) {
+    uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    return (v * 0x1e35a7bd) >> (32 - DBITS);
+}
+
+// Copy word[0..len-1] to dest[0..len-1], converting the first character to
+// uppercase, or all of the characters if all is true, per the brotli spec.
+local void upper(unsigned char *dest, unsigned char const *word, size_t len,
+                 int all) {
+    do {
+        unsigned ch = *word++;
+        len--;
+        if (ch < 192)
+            *dest++ = ch ^ (ch >= 97 && ch <= 122 ? 32 : 0);
+        else {
+            *dest++ = ch;
+            if (len == 0)
+                break;
+            if (ch < 224)
+                *dest++ = *word++ ^ 32;
+            else {
+                *dest++ = *word++;
+                if (--len == 0)
+                    break;
+                *dest++ = *word++ ^ 5;
+            }
+            len--;
+        }
+    } while (len && all);
+    memcpy(dest, word, len);
+}
+
+// Put the case form of the word at word[0..len-1] in dest[0..len-1].  Return
+// dest, or word itself for form zero.
+local inline unsigned char const *form(unsigned char *dest,
+                                       unsigned char const *word, size_t len,
+                                       unsigned kind) {
+    if (kind == 0)
+        return word;
+    upper(dest, word, len, kind == 2);
+    return dest;
+}
+
+// Compare the transforms numbered a and b by prefix, then kind, then by
+// decreasing net length added by the suffix and omission, then by number.
+local int by_prefix(void const *a, void const *b) {
+    unsigned i = *(unsigned char const *)a, j = *(unsigned char const *)b;
+    transform_t const *x = transform + i, *y = transform + j;
+    int cmp = strcmp(x->prefix, y->prefix);
+    if (cmp == 0)
+        cmp = (int)KIND(i) - (int)KIND(j);
+    if (cmp == 0)
+        cmp = (y->slen - y->omit) - (x->slen - x->omit);
+    return cmp ? cmp : (int)i - (int)j;
+}
+
+// Build the static dictionary index.  Words whose uppercase forms are the
+// same as a lesser form are not entered again.
+local void dict_index(void) {
+    memset(dhead, 0xff, sizeof(dhead));
+    unsigned n = 0;
+    for (unsigned len = 4; len <= 24; len++)
+        for (unsigned i = 0; i < 1U << ndbits[len]; i++) {
+            unsigned char const *word = dict + doffset[len] + i * len;
+            unsigned char first[24], all[24];
+            upper(first, word, len, 0);
+            upper(all, word, len, 1);
+            unsigned char const *forms[3] = {word, first, all};
+            for (unsigned k = 0; k < 3; k++) {
+                if ((k && memcmp(forms[k], forms[k - 1], len) == 0) ||
+                    (k == 2 && memcmp(all, word, len) == 0))
+                    continue;
+                unsigned h = dhash(forms[k]);
+                dnext[n] = dhead[h];
+                dentry[n] = ((uint32_t)k << 24) | (len << 16) | i;
+                dhead[h] = n++;
+            }
+        }
+
+    // group the transforms by prefix
+    unsigned k = 0;
+    for (unsigned i = 0; i < NTRANSFORMS; i++)
+        if (transform[i].kind != OMITFIRST)
+            xorder[k++] = i;
+    qsort(xorder, k, 1, by_prefix);
+    groups = 0;
+    for (unsigned i = 0, kind = 0; i <= k; i++) {
+        if (i == k || i == 0 || strcmp(transform[xorder[i]].prefix,
+                                       transform[xorder[i - 1]].prefix)) {
+            if (i) {
+                while (kind < 4)
+                    group[groups - 1][++kind] = i;
+            }
+            if (i == k)
+                break;
+            group[groups++][0] = i;
+            kind = 0;
+        }
+        while (kind < KIND(xorder[i]))
+            group[groups - 1][++kind] = i;
+    }
+}
+
+// ----- Bit output -----
+
+// Bits being written to an allocated buffer, least significant bit first.
+typedef struct {
+    unsigned char *buf;     // destination (allocated)
+    size_t size;            // allocated size of buf
+    size_t len;             // number of bytes written to buf
+    uint64_t bits;          // bits not yet written
+    unsigned left;          // number of bits in bits (less than 8)
+} out_t;
+
+// Make sure that there is room for at least n more bytes in o->buf.
+local void room(out_t *o, size_t n) {
+    if (o->size - o->len >= n)
+        return;
+    size_t size = o->size;
+    do {
+        size <<= 1;
+    } while (size - o->len < n);
+    unsigned char *buf = realloc(o->buf, size);
+    if (buf == NULL)
+        throw(1, "out of memory");
+    o->buf = buf;
+    o->size = size;
+}
+
+// Write the low n bits of val, where n is at most 56, and val has no bits set
+// above those.  There must be room for the bytes written.
+local inline void put(out_t *o, uint64_t val, unsigned n) {
+    o->bits |= val << o->left;
+    o->left += n;
+    while (o->left >= 8) {
+        o->buf[o->len++] = o->bits;
+        o->bits >>= 8;
+        o->left -= 8;
+    }
+}
+
+// Fill out the last byte with zero bits, if it is partially written.
+local inline void align(out_t *o) {
+    if (o->left)
+        put(o, 0, 8 - o->left);
+}
+
+// ----- Prefix codes -----
+
+// A prefix code, with the code for each symbol bit-reversed for writing.
+typedef struct {
+    unsigned short code[MAXSYM];    // codes, reversed
+    unsigned char len[MAXSYM];      // code lengths, zero if not coded
+} prefix_t;
+
+// Symbol count for sorting.
+typedef struct {
+    uint32_t freq;          // number of occurrences
+    unsigned short sym;     // symbol
+} count_t;
+
+// Compare counts by frequency, then by symbol.
+local int by_count(void const *a, void const *b) {
+    count_t const *x = a, *y = b;
+    return x->freq != y->freq ? (x->freq < y->freq ? -1 : 1) :
+           (int)x->sym - (int)y->sym;
+}
+
+// Set the code lengths in len[0..n-1] for a prefix code for the symbol
+// frequencies in freq[0..n-1], with no code longer than limit.  Return the
+// number of symbols with non-zero frequencies.  If optimal is true, then the
+// code is made by pack(), which gives the optimal length-limited code.
+// Otherwise huffman() followed by flatten() is used, which is faster but can
+// be a little worse when the limit is reached.  freq_t for huffman() has 16
+// bits, so then large counts are scaled down to fit, keeping each non-zero
+// count non-zero.
+local unsigned lengths(unsigned char *len, uint32_t const *freq, unsigned n,
+                       unsigned limit, int optimal) {
+    count_t use[MAXSYM];
+    unsigned k = 0;
+    uint64_t total = 0;
+    for (unsigned i = 0; i < n; i++)
+        if (freq[i]) {
+            use[k].freq = freq[i];
+            use[k++].sym = i;
+            total += freq[i];
+        }
+    memset(len, 0, n);
+    if (k < 2)
+        return k;
+    if (optimal) {
+        qsort(use, k, sizeof(count_t), by_count);
+        uint32_t weight[MAXSYM];
+        unsigned short bits[MAXSYM];
+        for (unsigned i = 0; i < k; i++)
+            weight[i] = use[i].freq;
+        if (pack(bits, weight, k, limit))   // limit is large enough for k
+            throw(1, "out of memory");
+        for (unsigned i = 0; i < k; i++)
+            len[use[i].sym] = bits[i];
+        return k;
+    }
+    if (total > 65535)
+        for (unsigned i = 0; i < k; i++)
+            use[i].freq = 1 + use[i].freq * (uint64_t)(65535 - k) / total;
+    qsort(use, k, sizeof(count_t), by_count);
+    freq_t bits[MAXSYM];
+    for (unsigned i = 0; i < k; i++)
+        bits[i] = use[i].freq;
+    huffman(bits, bits, k);                 // in place, frequency -> length
+    flatten(bits, k, limit);                // cannot fail, since k <= 704
+    for (unsigned i = 0; i < k; i++)
+        len[use[i].sym] = bits[i];
+    return k;
+}
+
+// Make the canonical codes in p for the code lengths in p->len[0..n-1].
+local void canonical(prefix_t *p, unsigned n) {
+    unsigned short count[16] = {0}, next[16];
+    for (unsigned i = 0; i < n; i++)
+        count[p->len[i]]++;
+    count[0] = 0;
+    unsigned code = 0;
+    for (unsigned b = 1; b < 16; b++) {
+        code = (code + count[b - 1]) << 1;
+        next[b] = code;
+    }
+    for (unsigned i = 0; i < n; i++) {
+        unsigned c = p->len[i] ? next[p->len[i]]++ : 0, rev = 0;
+        for (unsigned b = 0; b < p->len[i]; b++, c >>= 1)
+            rev = (rev << 1) | (c & 1);
+        p->code[i] = rev;           // zero bits for a single symbol
+    }
+}
+
+// Append to inst[] and extra[] at *k the code length instructions for rep
+// copies of the non-zero length len, where *last is the last non-zero length
+// written.  Runs use the nested repeat coding of code 16.
+local void runs(unsigned char *inst, unsigned char *extra, unsigned *k,
+                unsigned len, unsigned rep, unsigned *last) {
+    while (rep) {
+        if (rep < 3 || len != *last) {
+            inst[*k] = len;
+            extra[(*k)++] = 0;
+            *last = len;
+            rep--;
+        }
+        if (rep >= 3) {
+            unsigned char dig[8];           // enough for 15-bit codes
+            unsigned num = 0;
+            rep -= 2;
+            do {
+                dig[num++] = --rep & 3;
+                rep >>= 2;
+            } while (rep);
+            do {
+                inst[*k] = 16;
+                extra[(*k)++] = dig[--num];
+            } while (num);
+        }
+    }
+}
+
+// Code length code symbol positions in the stream, and the fixed code for
+// the code length code lengths 0..5, with the values in the low byte and the
+// number of bits in the high byte.
+local unsigned char const order[] = {
+    1, 2, 3, 4, 0, 5, 17, 6, 16, 7, 8, 9, 10, 11, 12, 13, 14, 15
+};
+local unsigned short const fixed[] = {
+    0x200, 0x407, 0x303, 0x202, 0x201, 0x40f
+};
+
+// Write a complex prefix code description for the code lengths in
+// p->len[0..n-1], which must have at least two non-zero lengths.  optimal is
+// passed to lengths() for the code length code.
+local void complex(out_t *o, prefix_t const *p, unsigned n, int optimal) {
+    // make the list of code length instructions, using runs of lengths and
+    // zeros where possible
+    unsigned char inst[MAXSYM], extra[MAXSYM];
+    unsigned k = 0, rep = 0, run = 0, last = 8, next = 0;
+    for (unsigned i = 0; i < n; i++) {
+        if (p->len[i] == 0)
+            continue;
+        if (next < i) {
+            runs(inst, extra, &k, run, rep, &last);
+            rep = 0;
+            unsigned zeros = i - next;
+            if (zeros < 3)
+                do {
+                    inst[k] = 0;
+                    extra[k++] = 0;
+                } while (--zeros);
+            else {
+                unsigned char dig[5];       // enough for 704 symbols
+                unsigned num = 0;
+                zeros -= 2;
+                do {
+                    dig[num++] = --zeros & 7;
+                    zeros >>= 3;
+                } while (zeros);
+                do {
+                    inst[k] = 17;
+                    extra[k++] = dig[--num];
+                } while (num);
+            }
+        }
+        if (rep && run != p->len[i]) {
+            runs(inst, extra, &k, run, rep, &last);
+            rep = 0;
+        }
+        run = p->len[i];
+        rep++;
+        next = i + 1;
+    }
+    runs(inst, extra, &k, run, rep, &last);
+
+    // make the code length code, limited to five bits
+    uint32_t freq[18] = {0};
+    for (unsigned i = 0; i < k; i++)
+        freq[inst[i]]++;
+    prefix_t clc;
+    unsigned syms = lengths(clc.len, freq, 18, 5, optimal);
+    if (syms == 1)
+        for (unsigned i = 0; i < 18; i++)
+            if (freq[i])
+                clc.len[i] = 3;     // a single code is coded with zero bits
+    canonical(&clc, 18);
+
+    // write the code length code lengths, skipping the leading zeros that
+    // can be skipped, and the trailing zeros unless there is only one code
+    unsigned start = clc.len[order[0]] || clc.len[order[1]] ? 0 :
+                     clc.len[order[2]] ? 2 : 3;
+    unsigned end = 17;
+    if (syms > 1)
+        while (clc.len[order[end]] == 0)
+            end--;
+    room(o, 16 + k * 2);
+    put(o, start, 2);
+    for (unsigned i = start; i <= end; i++) {
+        unsigned f = fixed[clc.len[order[i]]];
+        put(o, f & 0xff, f >> 8);
+    }
+
+    // write the code length instructions
+    for (unsigned i = 0; i < k; i++) {
+        if (syms > 1)
+            put(o, clc.code[inst[i]], clc.len[inst[i]]);
+        if (inst[i] == 16)
+            put(o, extra[i], 2);
+        else if (inst[i] == 17)
+            put(o, extra[i], 3);
+    }
+}
+
+// Make a prefix code in p for the frequencies freq[0..n-1], and write its
+// description, where abits is the number of bits in a symbol.  If there are
+// no symbols, then a code with only symbol zero is written.  optimal selects
+// how the code is made (see lengths()).
+local void prefix(out_t *o, prefix_t *p, uint32_t const *freq, unsigned n,
+                  unsigned abits, int optimal) {
+    unsigned k = lengths(p->len, freq, n, 15, optimal);
+    canonical(p, n);
+    if (k > 4) {
+        complex(o, p, n, optimal);
+        return;
+    }
+
+    // simple code: write the symbols in order of increasing length
+    unsigned short sym[4] = {0};
+    unsigned j = 0;
+    for (unsigned b = 0; b < 4; b++)
+        for (unsigned i = 0; i < n; i++)
+            if (freq[i] && p->len[i] == b)
+                sym[j++] = i;
+    if (k == 0)
+        k = 1;
+    room(o, 8);
+    put(o, 1, 2);
+    put(o, k - 1, 2);
+    for (unsigned i = 0; i < k; i++)
+        put(o, sym[i], abits);
+    if (k == 4)
+        put(o, p->len[sym[0]] == 1, 1);
+}
+
+// ----- Matching -----
+
+// A command: literals to insert, followed by a copy from the window or from
+// the static dictionary.  The last command of a meta-block may have no copy.
+typedef struct {
+    uint32_t ins;           // number of literals
+    uint32_t copy;          // copy length, or zero for none
+    uint32_t out;           // bytes copied (differs from copy for a word)
+    uint32_t extra;         // distance extra bits
+    unsigned short dist;    // distance symbol
+    unsigned short iac;     // insert and copy symbol
+    unsigned char dbits;    // number of distance extra bits
+} cmd_t;
+
+// A match: output length, copy length, distance, and whether it is a static
+// dictionary reference (the output length if so may differ from the copy
+// length, and the distance is the word id).
+typedef struct {
+    size_t out;
+    size_t copy;
+    size_t dist;
+    int word;
+} match_t;
+
+// Compression state.
+typedef struct {
+    unsigned char const *in;    // input
+    size_t len;                 // length of the input
+    size_t wmax;                // maximum copy distance for the window
+    unsigned depth, nice;       // chain depth limit, good enough length
+    int lazy, dict, full;       // level options
+    int optimal;                // true to make the codes with pack()
+    uint32_t *head;             // hash chain heads (allocated)
+    uint32_t *prev;             // hash chain links (allocated)
+    size_t mask;                // mask for positions in prev[]
+    size_t base;                // position of chain entry one
+    size_t hashed;              // next position to enter in the chains
+    size_t ring[4];             // last distances, most recent first
+    cmd_t *cmd;                 // commands for the meta-block (allocated)
+    size_t cmds;                // number of commands in cmd[]
+    out_t out;                  // the brotli stream
+} mash_t;
+
+// Hash the four bytes at p for the window hash chains.
+local inline uint32_t whash(unsigned char const *p) {
+    uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    return (v * 0x1e35a7bd) >> (32 - HBITS);
+}
+
+// Enter the positions up to pos in the hash chains.
+local inline void hash_to(mash_t *s, size_t pos) {
+    for (; s->hashed < pos && s->hashed + 4 <= s->len; s->hashed++) {
+        uint32_t h = whash(s->in + s->hashed);
+        s->prev[s->hashed & s->mask] = s->head[h];
+        s->head[h] = s->hashed - s->base + 1;
+    }
+    if (s->hashed < pos)
+        s->hashed = pos;
+}
+
+// Return the number of equal bytes at a and b, up to max.
+local inline size_t same(unsigned char const *a, unsigned char const *b,
+                         size_t max) {
+    size_t n = 0;
+    while (n + 8 <= max) {
+        uint64_t x, y;
+        memcpy(&x, a + n, 8);
+        memcpy(&y, b + n, 8);
+        if (x != y)
+            break;
+        n += 8;
+    }
+    while (n < max && a[n] == b[n])
+        n++;
+    return n;
+}
+
+// Look for the longest transformed static dictionary word at p, up to limit
+// bytes, and longer than best bytes.  Update *m and return true if found.
+// Transforms that omit leading bytes of the word are not tried.
+local int lookup(unsigned char const *p, size_t limit, size_t best,
+               match_t *m) {
+    int found = 0;
+    for (unsigned g = 0; g < groups; g++) {
+        transform_t const *pre = transform + xorder[group[g][0]];
+        if (pre->plen + 4U > limit || memcmp(p, pre->prefix, pre->plen))
+            continue;
+        unsigned char const *q = p + pre->plen;
+        size_t avail = limit - pre->plen;
+        for (unsigned e = dhead[dhash(q)]; e != NONE; e = dnext[e]) {
+            unsigned kind = dentry[e] >> 24, len = (dentry[e] >> 16) & 0x1f,
+                     index = dentry[e] & 0xffff;
+            if (pre->plen + len + 8 <= best)
+                continue;                   // can't be longer
+            unsigned char buf[24];
+            unsigned char const *w = form(buf, dict + doffset[len] +
+                                          index * len, len, kind);
+            size_t have = same(w, q, len < avail ? len : avail);
+            if (have < 4 || (have < len && (kind || len - have > 9)))
+                continue;                   // no transform can use it
+
+            // try the transforms that apply, where an uppercase form needs
+            // the whole word, and a partial word needs an OMITLAST
+            unsigned from = kind ? group[g][kind + 1] :
+                            have < len ? group[g][1] : group[g][0];
+            unsigned to = group[g][kind ? kind + 2 : 2];
+            for (unsigned i = from; i < to; i++) {
+                transform_t const *xf = transform + xorder[i];
+                size_t used = len - xf->omit;
+                size_t out = xf->plen + used + xf->slen;
+                if (used > have || out <= best || out > limit ||
+                    memcmp(q + used, xf->suffix, xf->slen))
+                    continue;
+                best = out;
+                m->out = out;
+                m->copy = len;
+                m->dist = index | ((size_t)xorder[i] << ndbits[len]);
+                m->word = 1;
+                found = 1;
+                if (i < group[g][1])
+                    i = group[g][1] - 1;    // rest of IDENTITY no longer
+                else
+                    break;                  // rest no longer
+            }
+        }
+    }
+    return found;
+}
+
+// Find the longest match at pos, up to limit bytes, looking at the last
+// distances first, and then the hash chain.  Enter pos in the hash chain.
+// Return the match in *m, with m->out zero if there is none.
+local void find(mash_t *s, size_t pos, size_t limit, match_t *m) {
+    unsigned char const *p = s->in + pos;
+    size_t maxd = pos < s->wmax ? pos : s->wmax;
+    size_t best = MINMATCH - 1;
+    m->out = 0;
+    if (limit >= MINMATCH) {
+        // try the last distances
+        for (unsigned i = 0; i < 4; i++) {
+            size_t d = s->ring[i];
+            if (d <= maxd && best < limit && p[best] == p[best - d]) {
+                size_t n = same(p, p - d, limit);
+                if (n > best) {
+                    best = n;
+                    m->dist = d;
+                }
+            }
+        }
+
+        // follow the hash chain
+        if (pos + 4 <= s->len && best < s->nice) {
+            uint32_t c = s->head[whash(p)];
+            unsigned depth = s->depth;
+            while (c && depth--) {
+                size_t at = s->base + c - 1;
+                size_t d = pos - at;
+                if (d > maxd)
+                    break;
+                if (best < limit && s->in[at + best] == p[best]) {
+                    size_t n = same(s->in + at, p, limit);
+                    if (n > best && (n > MINMATCH || d < FAR)) {
+                        best = n;
+                        m->dist = d;
+                        if (n >= s->nice)
+                            break;
+                    }
+                }
+                c = s->prev[at & s->mask];
+            }
+        }
+        if (best >= MINMATCH) {
+            m->out = m->copy = best;
+            m->word = 0;
+        }
+
+        // try the static dictionary
+        if (s->dict && best < 24)
+            lookup(p, limit, best < MINWORD - 1 ? MINWORD - 1 : best, m);
+    }
+    hash_to(s, pos + 1);
+}
+
+// Set the distance symbol and extra bits in c for distance d, using no
+// postfix bits or direct codes.
+local void distance(cmd_t *c, size_t d) {
+    d += 3;
+    unsigned bits = 0;
+    while (d >> (bits + 2))
+        bits++;
+    c->dist = 16 + 2 * (bits - 1) + ((d >> bits) & 1);
+    c->dbits = bits;
+    c->extra = d & (((size_t)1 << bits) - 1);
+}
+
+// Add a command with ins literals and the match m, if m->out is not zero.
+// Update the last distances.
+local void command(mash_t *s, size_t pos, size_t ins, match_t const *m) {
+    cmd_t *c = s->cmd + s->cmds++;
+    c->ins = ins;
+    c->copy = m->out ? m->copy : 0;
+    c->out = m->out;
+    c->dist = 0;
+    c->dbits = 0;
+    c->extra = 0;
+    if (m->out == 0)
+        return;
+    if (m->word) {
+        size_t maxd = pos < s->wmax ? pos : s->wmax;
+        distance(c, maxd + 1 + m->dist);
+        return;
+    }
+    unsigned i = 0;
+    while (i < 4 && s->ring[i] != m->dist)
+        i++;
+    if (i == 0)
+        return;
+    if (i < 4)
+        c->dist = i;
+    else
+        distance(c, m->dist);
+    memmove(s->ring + 1, s->ring, 3 * sizeof(size_t));
+    s->ring[0] = m->dist;
+}
+
+// Parse in[start..end-1] into commands in s->cmd[].
+local void parse(mash_t *s, size_t start, size_t end) {
+    s->cmds = 0;
+    size_t lit = start, pos = start;
+    match_t m, next;
+    while (pos < end) {
+        find(s, pos, end - pos, &m);
+        if (m.out == 0) {
+            pos++;
+            continue;
+        }
+        while (s->lazy && m.out < s->nice && pos + 1 < end) {
+            find(s, pos + 1, end - pos - 1, &next);
+            if (next.out <= m.out)
+                break;
+            m = next;
+            pos++;
+        }
+        command(s, pos, pos - lit, &m);
+        pos += m.out;
+        lit = pos;
+        if (s->full)
+            hash_to(s, pos);
+        else
+            s->hashed = pos;
+    }
+    if (lit < end) {
+        m.out = 0;
+        command(s, end, end - lit, &m);
+    }
+}
+
+// ----- Meta-blocks -----
+
+// Return the insert length code for n.
+local inline unsigned ins_code(size_t n) {
+    unsigned c = 0;
+    while (c < 23 && ins_base[c + 1] <= n)
+        c++;
+    return c;
+}
+
+// Return the copy length code for n, which is at least two.
+local inline unsigned copy_code(size_t n) {
+    unsigned c = 0;
+    while (c < 23 && copy_base[c + 1] <= n)
+        c++;
+    return c;
+}
+
+// Write the meta-block header for a meta-block of n bytes, 1..1 << 24.
+local void header(out_t *o, size_t n, int last, int stored) {
+    unsigned nibs = n - 1 < (1 << 16) ? 4 : n - 1 < (1 << 20) ? 5 : 6;
+    room(o, 16);
+    put(o, last, 1);                    // ISLAST
+    if (last)
+        put(o, 0, 1);                   // ISLASTEMPTY = 0
+    put(o, nibs - 4, 2);                // MNIBBLES
+    put(o, n - 1, nibs << 2);           // MLEN - 1
+    if (!last)
+        put(o, stored, 1);              // ISUNCOMPRESSED
+}
+
+// Write in[start..end-1] as a compressed meta-block from the commands in
+// s->cmd[].
+local void compressed(mash_t *s, size_t start, size_t end, int last) {
+    out_t *o = &s->out;
+    header(o, end - start, last, 0);
+    put(o, 0, 3);                       // NBLTYPESL, NBLTYPESI, NBLTYPESD = 1
+    put(o, 0, 6);                       // NPOSTFIX, NDIRECT = 0
+    put(o, 0, 2);                       // context mode LSB6
+    put(o, 0, 2);                       // NTREESL, NTREESD = 1
+
+    // determine the insert and copy symbols and count the symbols
+    uint32_t lit[NLIT] = {0}, iac[NIAC] = {0}, dist[NDIST] = {0};
+    unsigned char const *p = s->in + start;
+    for (size_t i = 0; i < s->cmds; i++) {
+        cmd_t *c = s->cmd + i;
+        unsigned ic = ins_code(c->ins), cc = c->copy ? copy_code(c->copy) : 0;
+        if (c->dist == 0 && ic < 8 && cc < 16)
+            c->iac = ((cc >> 3) << 6) | ((ic & 7) << 3) | (cc & 7);
+        else {
+            c->iac = (cell[3 * (ic >> 3) + (cc >> 3)] << 6) |
+                     ((ic & 7) << 3) | (cc & 7);
+            if (c->copy)
+                dist[c->dist]++;
+        }
+        iac[c->iac]++;
+        for (size_t j = 0; j < c->ins; j++)
+            lit[*p++]++;
+        p += c->out;
+    }
+
+    // make and write the prefix codes
+    prefix_t lcode, icode, dcode;
+    prefix(o, &lcode, lit, NLIT, 8, s->optimal);
+    prefix(o, &icode, iac, NIAC, 10, s->optimal);
+    prefix(o, &dcode, dist, NDIST, 6, s->optimal);
+
+    // write the commands
+    p = s->in + start;
+    for (size_t i = 0; i < s->cmds; i++) {
+        cmd_t const *c = s->cmd + i;
+        unsigned ic = ins_code(c->ins), cc = c->copy ? copy_code(c->copy) : 0;
+        room(o, 24 + 2 * (size_t)c->ins);
+        put(o, icode.code[c->iac], icode.len[c->iac]);
+        put(o, c->ins - ins_base[ic], ins_extra[ic]);
+        put(o, c->copy ? c->copy - copy_base[cc] : 0, copy_extra[cc]);
+        for (size_t j = 0; j < c->ins; j++, p++)
+            put(o, lcode.code[*p], lcode.len[*p]);
+        if (c->copy && c->iac >= 128) {
+            put(o, dcode.code[c->dist], dcode.len[c->dist]);
+            put(o, c->extra, c->dbits);
+        }
+        p += c->out;
+    }
+}
+
+// Write in[start..end-1] as a stored meta-block.
+local void stored(mash_t *s, size_t start, size_t end) {
+    out_t *o = &s->out;
+    header(o, end - start, 0, 1);
+    align(o);
+    room(o, end - start);
+    memcpy(o->buf + o->len, s->in + start, end - start);
+    o->len += end - start;
+}
+
+// Write in[start..end-1] as a meta-block, compressed if that is smaller, or
+// stored.  Return true if stored.
+local int block(mash_t *s, size_t start, size_t end, int last) {
+    out_t save = s->out;
+    size_t ring[4];
+    memcpy(ring, s->ring, sizeof(ring));
+    parse(s, start, end);
+    compressed(s, start, end, last);
+    if (s->out.len - save.len <= end - start + 4)
+        return 0;
+    save.buf = s->out.buf;
+    save.size = s->out.size;
+    s->out = save;
+    memcpy(s->ring, ring, sizeof(ring));
+    stored(s, start, end);
+    return 1;
+}
+
+// Write the WBITS code for a window of 1 << w bytes, where w is in 10..24.
+local void wbits(out_t *o, unsigned w) {
+    if (w == 16)
+        put(o, 0, 1);
+    else {
+        put(o, 1, 1);
+        put(o, w < 18 ? 0 : w - 17, 3);
+        if (w < 18)
+            put(o, w == 17 ? 0 : w - 8, 3);
+    }
+}
+
+// Write the brotli stream for s->in[0..s->len-1] with a window of 1 << w
+// bytes.
+local void stream(mash_t *s, unsigned w) {
+    wbits(&s->out, w);
+    int store = 1;
+    if (s->len == 0)
+        put(&s->out, 3, 2);             // ISLAST, ISLASTEMPTY
+    for (size_t start = 0; start < s->len; start += MASH_BLOCK) {
+        // restart the hash chains before the positions overflow
+        if (start - s->base > 0xf0000000) {
+            memset(s->head, 0, (1 << HBITS) * sizeof(uint32_t));
+            s->base = start;
+            s->hashed = start;
+        }
+        size_t end = s->len - start > MASH_BLOCK ? start + MASH_BLOCK : s->len;
+        store = block(s, start, end, end == s->len);
+    }
+    if (s->len && store) {
+        room(&s->out, 2);
+        put(&s->out, 3, 2);             // ISLAST, ISLASTEMPTY
+    }
+    room(&s->out, 1);
+    align(&s->out);
+}
+
+// See mash.h.
+void mash(void const *in, size_t len, int level, int wbits, int optimal,
+          unsigned char **out, size_t *got) {
+    level = level < 0 ? 0 : level > 9 ? 9 : level;
+    if (levels[level].dict)
+        pthread_once(&indexed, dict_index);
+    unsigned w = wbits < 10 ? 10 : wbits > 24 ? 24 : wbits;
+    while (w > 10 && len <= ((size_t)1 << (w - 1)) - 16)
+        w--;
+
+    mash_t s;
+    s.in = in;
+    s.len = len;
+    s.wmax = ((size_t)1 << w) - 16;
+    s.depth = levels[level].depth;
+    s.nice = levels[level].nice;
+    s.lazy = levels[level].lazy;
+    s.dict = levels[level].dict;
+    s.full = levels[level].full;
+    s.optimal = optimal;
+    s.mask = 1;
+    while (s.mask < len && s.mask < (size_t)1 << w)
+        s.mask <<= 1;
+    s.mask--;
+    s.base = 0;
+    s.hashed = 0;
+    s.ring[0] = 4;
+    s.ring[1] = 11;
+    s.ring[2] = 15;
+    s.ring[3] = 16;
+    s.head = calloc(1 << HBITS, sizeof(uint32_t));
+    s.prev = malloc((s.mask + 1) * sizeof(uint32_t));
+    s.cmd = malloc((MASH_BLOCK / MINMATCH + 2) * sizeof(cmd_t));
+    s.out.size = len / 2 + 64;
+    s.out.buf = malloc(s.out.size);
+    s.out.len = 0;
+    s.out.bits = 0;
+    s.out.left = 0;
+
+    ball_t err;
+    try {
+        if (s.head == NULL || s.prev == NULL || s.cmd == NULL ||
+            s.out.buf == NULL)
+            throw(1, "out of memory");
+        stream(&s, w);
+    }
+    always {
+        free(s.cmd);
+        free(s.prev);
+        free(s.head);
+    }
+    catch (err) {
+        free(s.out.buf);
+        punt(err);
+    }
+    *out = s.out.buf;
+    *got = s.out.len;
+}
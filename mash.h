@@ -0,0 +1,28 @@
+// mash.h -- header for mash.c
+// Copyright (C) 2016 Mark Adler
+// For conditions of distribution and use, see the accompanying LICENSE file.
+
+#include <stddef.h>
+
+// A small, fast brotli compressor.  The input is parsed into commands using
+// hash chains over the window, with matches also sought in the static
+// dictionary through an index of its words built on first use.  The level
+// trades speed for compression: level 0 is the fastest, and level 9 the
+// smallest.  The commands are coded in meta-blocks of up to MASH_BLOCK bytes,
+// each with a single literal, insert and copy, and distance prefix code
+// limited to 15 bits.  The codes are either optimal for that limit, made with
+// pack(), or made with huffman() and then limited with flatten(), which is
+// faster.  A meta-block that does not compress is stored instead.
+
+#define MASH_LEVEL 6            // default compression level (0..9)
+#define MASH_WBITS 22           // default maximum window bits (10..24)
+#define MASH_BLOCK ((size_t)1 << 18)    // maximum meta-block length
+
+// Compress in[0..len-1] at level to a complete brotli stream in the allocated
+// buffer *out, with its length in *got.  A level outside of 0..9 is clamped
+// to that range.  wbits is the log base 2 of the largest window to use, in
+// 10..24, which is reduced if a smaller window can reach all of the input.
+// If optimal is true, then the prefix codes are made with pack().  Throw an
+// error (see try.h) if out of memory.  mash() is thread-safe.
+void mash(void const *in, size_t len, int level, int wbits, int optimal,
+          unsigned char **out, size_t *got);
@@ -0,0 +1,104 @@
+// pack.c
+// Copyright (C) 2016 Mark Adler
+// For conditions of distribution and use, see the accompanying LICENSE file.
+//
+// Optimal length-limited prefix codes using the package-merge algorithm of
+// Lawrence Larmore and Daniel Hirschberg, "A fast algorithm for optimal
+// length-limited Huffman codes", 1990.
+//
+// Each symbol is a coin with a face value of two to the minus its length, and
+// a numismatic value of its frequency.  The code is the least valuable set of
+// coins, at most one of each symbol for each length 1..limit, with a total
+// face value of n - 1.  The lists are made from the longest length up.  The
+// list for a length has the n leaves, merged in order of weight with the
+// packages made by pairing consecutive items of the list for the next longer
+// length.  The first 2n - 2 items of the list for length one, and recursively
+// the items of the longer lists that make up the packages selected, are the
+// solution.  The length of each symbol is the number of lists in which its
+// leaf is selected.
+//
+// Only the weights of the current and previous lists are kept.  For each
+// list, whether each item is a leaf or a package is saved in a bit vector, so
+// that the selection can be made going back down the lists.  Since the leaves
+// in each list are in order, the number of them taken from the front of a
+// list determines which symbols they are.
+
+#include <stdlib.h>
+#include "pack.h"
+
+// See pack.h.
+int pack(unsigned short *bits, uint32_t const *freq, size_t n,
+         unsigned limit) {
+    // handle trivial and invalid cases
+    if (n == 0)
+        return 0;
+    if (limit < sizeof(size_t) << 3 && ((size_t)1 << limit) < n)
+        return 1;
+    if (n == 1) {
+        bits[0] = 0;
+        return 0;
+    }
+
+    // no code needs to be longer than n - 1 bits
+    unsigned max = limit < n - 1 ? limit : (unsigned)(n - 1);
+
+    // allocate the two lists of weights, and the package flags for all of the
+    // lists -- each list has less than 2n items
+    size_t room = n << 1;
+    uint64_t *list = malloc(room * 2 * sizeof(uint64_t));
+    unsigned char *pkg = calloc((room * max + 7) >> 3, 1);
+    if (list == NULL || pkg == NULL) {
+        free(pkg);
+        free(list);
+        return 1;
+    }
+    uint64_t *prev = list, *cur = list + room;
+
+    // the list for the longest length is just the leaves
+    size_t len = n;
+    for (size_t i = 0; i < n; i++)
+        prev[i] = freq[i];
+
+    // make the lists for the shorter lengths, merging the leaves with the
+    // packages from the previous list, with the leaves first on ties
+    for (unsigned j = max - 1; j; j--) {
+        size_t leaf = 0, pair = 0, pairs = len >> 1, k = 0;
+        size_t flag = (size_t)(j - 1) * room;
+        while (leaf < n || pair < pairs) {
+            uint64_t sum = pair < pairs ?
+                           prev[pair << 1] + prev[(pair << 1) + 1] : 0;
+            if (pair == pairs || (leaf < n && freq[leaf] <= sum))
+                cur[k++] = freq[leaf++];
+            else {
+                pkg[(flag + k) >> 3] |= 1 << ((flag + k) & 7);
+                cur[k++] = sum;
+                pair++;
+            }
+        }
+        len = k;
+        uint64_t *tmp = prev;
+        prev = cur;
+        cur = tmp;
+    }
+    free(list);
+
+    // select the first 2n - 2 items of the list for length one, and then the
+    // items of each longer list that were packaged into the selected packages,
+    // adding a bit to the length of each selected leaf
+    for (size_t i = 0; i < n; i++)
+        bits[i] = 0;
+    size_t take = (n - 1) << 1;
+    for (unsigned j = 1; j <= max && take; j++) {
+        size_t flag = (size_t)(j - 1) * room, leaves = take, pkgs = 0;
+        if (j < max)
+            for (size_t k = 0; k < take; k++)
+                if (pkg[(flag + k) >> 3] & (1 << ((flag + k) & 7)))
+                    pkgs++;
+        leaves -= pkgs;
+        for (size_t i = 0; i < leaves; i++)
+            bits[i]++;
+        take = pkgs << 1;
+    }
+    free(pkg);
+    return 0;
+}
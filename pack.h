@@ -0,0 +1,26 @@
+// pack.h -- header for pack.c
+// Copyright (C) 2016 Mark Adler
+// For conditions of distribution and use, see the accompanying LICENSE file.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Set bits[0..n-1] to the lengths of an optimal prefix code for the
+// frequencies freq[0..n-1], with no length greater than limit, using the
+// package-merge algorithm.  freq[] must be positive and in non-decreasing
+// order, and the resulting lengths are in non-increasing order.  Unlike
+// huffman() followed by flatten(), the result is the minimum total number of
+// bits for codes limited to limit bits, and the frequencies are not limited to
+// 16 bits.  pack() takes O(n * limit) time, and allocates about 32 * n bytes
+// for the lists plus n * limit / 4 bytes for the package flags.  1 << limit
+// must be greater than or equal to n.  pack() returns true on failure, which
+// is either a limit that is too small, or out of memory.
+int pack(unsigned short *bits, uint32_t const *freq, size_t n,
+         unsigned limit);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,170 @@
+/* Measure the speed of the check value computations that can be used in a .br
+   stream, for buffer sizes from 64 bytes to 64 MB.  Each implementation of
+   XXH32, XXH64, XXH3-64, CRC-32C, and SHA-256 that is supported by this
+   processor is timed on each size, both warm, computing the check value of the
+   same buffer repeatedly so that it stays in the cache, and cold, computing it
+   on successive buffers taken from a region much larger than the cache.  The
+   speeds are shown in GB/s.  If there is a numeric argument, then it is the
+   number of seconds to spend on each measurement (default 0.05).  The data is
+   pseudo-random, which makes no difference to the speed of these. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <openssl/sha.h>
+#include "xxhash.h"
+#include "xxh3.h"
+#include "crc32c.h"
+
+#define local static
+
+#define SMALL 64                // smallest buffer size
+#define LARGE (64 << 20)        // largest buffer size
+#define COLD (256 << 20)        // size of the region for cold measurements
+
+// Return the current time in seconds.
+local double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Check value computations with a common signature.
+typedef uint64_t sum_func(void const *buf, size_t len);
+
+local uint64_t sum_xxh32(void const *buf, size_t len)
+{
+    return XXH32(buf, len, 0);
+}
+
+local uint64_t sum_xxh64(void const *buf, size_t len)
+{
+    return XXH64(buf, len, 0);
+}
+
+local uint64_t sum_xxh3(void const *buf, size_t len)
+{
+    return xxh3(buf, len);
+}
+
+local crc32c_func *crc;         // CRC-32C implementation for sum_crc()
+
+local uint64_t sum_crc(void const *buf, size_t len)
+{
+    return crc(0, buf, len);
+}
+
+local uint64_t sum_sha256(void const *buf, size_t len)
+{
+    unsigned char sha[SHA256_DIGEST_LENGTH];
+    SHA256(buf, len, sha);
+    return sha[0] | ((uint64_t)sha[1] << 8);
+}
+
+// Accumulated results, so that the computations are not optimized away.
+local volatile uint64_t sink;
+
+// Return the speed in GB/s of sum() on buffers of size bytes for about secs
+// seconds.  If cold is false, the same buffer at region is used every time.
+// If cold is true, then successive buffers are taken from region[0..COLD-1],
+// wrapping around to the start, so that each is not in the cache.  The time
+// is checked after each batch of about a megabyte, so that reading the clock
+// does not distort the speed for small buffers.
+local double speed(sum_func *sum, unsigned char const *region, size_t size,
+                   int cold, double secs)
+{
+    size_t batch = 1 + (1 << 20) / size;
+    size_t at = 0;
+    uint64_t acc = 0;
+    unsigned long reps = 0;
+    double start = now(), elapsed;
+    do {
+        for (size_t i = 0; i < batch; i++) {
+            acc ^= sum(region + at, size);
+            if (cold) {
+                at += size;
+                if (at > COLD - size)
+                    at = 0;
+            }
+        }
+        reps += batch;
+        elapsed = now() - start;
+    } while (elapsed < secs);
+    sink ^= acc;
+    return reps * (double)size / elapsed * 1e-9;
+}
+
+// Show one row of speeds for sum() across the buffer sizes.
+local void row(char const *name, sum_func *sum, unsigned char const *region,
+               int cold, double secs)
+{
+    printf("%-17s %s", name, cold ? "cold" : "warm");
+    for (size_t size = SMALL; size <= LARGE; size <<= 2)
+        printf(" %6.2f", speed(sum, region, size, cold, secs));
+    putchar('\n');
+    fflush(stdout);
+}
+
+// Show the warm and cold rows for sum().
+local void rows(char const *name, sum_func *sum, unsigned char const *region,
+                double secs)
+{
+    row(name, sum, region, 0, secs);
+    row(name, sum, region, 1, secs);
+}
+
+int main(int argc, char **argv)
+{
+    // interpret the argument
+    if (argc > 2) {
+        fputs("only one argument permitted\n", stderr);
+        return 1;
+    }
+    double secs = argc == 1 ? 0.05 : strtod(argv[1], NULL);
+    if (secs <= 0) {
+        fputs("usage: sums [secs]\n"
+              "  where secs is the time to spend on each measurement\n",
+              stderr);
+        return 0;
+    }
+
+    // fill the region with pseudo-random data
+    unsigned char *region = malloc(COLD);
+    if (region == NULL) {
+        fputs("out of memory\n", stderr);
+        return 1;
+    }
+    uint64_t x = 1;
+    for (size_t i = 0; i < COLD; i++) {
+        x = x * 6364136223846793005 + 1442695040888963407;
+        region[i] = x >> 56;
+    }
+
+    // time each check value and implementation
+    printf("GB/s              size");
+    for (size_t size = SMALL; size <= LARGE; size <<= 2)
+        printf(" %5zu%c", size < 1024 ? size : size < 1 << 20 ? size >> 10 :
+                                                                size >> 20,
+               size < 1024 ? ' ' : size < 1 << 20 ? 'K' : 'M');
+    putchar('\n');
+    rows("XXH32", sum_xxh32, region, secs);
+    rows("XXH64", sum_xxh64, region, secs);
+    char const *name;
+    for (unsigned k = 0; (name = xxh3_impl(k)) != NULL; k++) {
+        char label[32];
+        snprintf(label, sizeof(label), "XXH3-64 %s", name);
+        rows(label, sum_xxh3, region, secs);
+    }
+    for (unsigned k = 0; (crc = crc32c_impl(k, &name)) != NULL; k++) {
+        char label[32];
+        snprintf(label, sizeof(label), "CRC-32C %s", name);
+        rows(label, sum_crc, region, secs);
+    }
+    rows("SHA-256", sum_sha256, region, secs);
+
+    // clean up
+    free(region);
+    return 0;
+}
@@ -0,0 +1,123 @@
+local transform_t const transform[] = {
+    /*   0 */ {IDENTITY,  0, 0, 0,         "", ""},
+    /*   1 */ {IDENTITY,  0, 0, 1,         "", " "},
+    /*   2 */ {IDENTITY,  0, 1, 1,        " ", " "},
+    /*   3 */ {OMITFIRST, 1, 0, 0,         "", ""},
+    /*   4 */ {UPPERFIRST, 0, 0, 1,         "", " "},
+    /*   5 */ {IDENTITY,  0, 0, 5,         "", " the "},
+    /*   6 */ {IDENTITY,  0, 1, 0,        " ", ""},
+    /*   7 */ {IDENTITY,  0, 2, 1,       "s ", " "},
+    /*   8 */ {IDENTITY,  0, 0, 4,         "", " of "},
+    /*   9 */ {UPPERFIRST, 0, 0, 0,         "", ""},
+    /*  10 */ {IDENTITY,  0, 0, 5,         "", " and "},
+    /*  11 */ {OMITFIRST, 2, 0, 0,         "", ""},
+    /*  12 */ {OMITLAST,  1, 0, 0,         "", ""},
+    /*  13 */ {IDENTITY,  0, 2, 1,       ", ", " "},
+    /*  14 */ {IDENTITY,  0, 0, 2,         "", ", "},
+    /*  15 */ {UPPERFIRST, 0, 1, 1,        " ", " "},
+    /*  16 */ {IDENTITY,  0, 0, 4,         "", " in "},
+    /*  17 */ {IDENTITY,  0, 0, 4,         "", " to "},
+    /*  18 */ {IDENTITY,  0, 2, 1,       "e ", " "},
+    /*  19 */ {IDENTITY,  0, 0, 1,         "", "\""},
+    /*  20 */ {IDENTITY,  0, 0, 1,         "", "."},
+    /*  21 */ {IDENTITY,  0, 0, 2,         "", "\">"},
+    /*  22 */ {IDENTITY,  0, 0, 1,         "", "\n"},
+    /*  23 */ {OMITLAST,  3, 0, 0,         "", ""},
+    /*  24 */ {IDENTITY,  0, 0, 1,         "", "]"},
+    /*  25 */ {IDENTITY,  0, 0, 5,         "", " for "},
+    /*  26 */ {OMITFIRST, 3, 0, 0,         "", ""},
+    /*  27 */ {OMITLAST,  2, 0, 0,         "", ""},
+    /*  28 */ {IDENTITY,  0, 0, 3,         "", " a "},
+    /*  29 */ {IDENTITY,  0, 0, 6,         "", " that "},
+    /*  30 */ {UPPERFIRST, 0, 1, 0,        " ", ""},
+    /*  31 */ {IDENTITY,  0, 0, 2,         "", ". "},
+    /*  32 */ {IDENTITY,  0, 1, 0,        ".", ""},
+    /*  33 */ {IDENTITY,  0, 1, 2,        " ", ", "},
+    /*  34 */ {OMITFIRST, 4, 0, 0,         "", ""},
+    /*  35 */ {IDENTITY,  0, 0, 6,         "", " with "},
+    /*  36 */ {IDENTITY,  0, 0, 1,         "", "'"},
+    /*  37 */ {IDENTITY,  0, 0, 6,         "", " from "},
+    /*  38 */ {IDENTITY,  0, 0, 4,         "", " by "},
+    /*  39 */ {OMITFIRST, 5, 0, 0,         "", ""},
+    /*  40 */ {OMITFIRST, 6, 0, 0,         "", ""},
+    /*  41 */ {IDENTITY,  0, 5, 0,    " the ", ""},
+    /*  42 */ {OMITLAST,  4, 0, 0,         "", ""},
+    /*  43 */ {IDENTITY,  0, 0, 6,         "", ". The "},
+    /*  44 */ {UPPERALL,  0, 0, 0,         "", ""},
+    /*  45 */ {IDENTITY,  0, 0, 4,         "", " on "},
+    /*  46 */ {IDENTITY,  0, 0, 4,         "", " as "},
+    /*  47 */ {IDENTITY,  0, 0, 4,         "", " is "},
+    /*  48 */ {OMITLAST,  7, 0, 0,         "", ""},
+    /*  49 */ {OMITLAST,  1, 0, 4,         "", "ing "},
+    /*  50 */ {IDENTITY,  0, 0, 2,         "", "\n\t"},
+    /*  51 */ {IDENTITY,  0, 0, 1,         "", ":"},
+    /*  52 */ {IDENTITY,  0, 1, 2,        " ", ". "},
+    /*  53 */ {IDENTITY,  0, 0, 3,         "", "ed "},
+    /*  54 */ {OMITFIRST, 9, 0, 0,         "", ""},
+    /*  55 */ {OMITFIRST, 7, 0, 0,         "", ""},
+    /*  56 */ {OMITLAST,  6, 0, 0,         "", ""},
+    /*  57 */ {IDENTITY,  0, 0, 1,         "", "("},
+    /*  58 */ {UPPERFIRST, 0, 0, 2,         "", ", "},
+    /*  59 */ {OMITLAST,  8, 0, 0,         "", ""},
+    /*  60 */ {IDENTITY,  0, 0, 4,         "", " at "},
+    /*  61 */ {IDENTITY,  0, 0, 3,         "", "ly "},
+    /*  62 */ {IDENTITY,  0, 5, 4,    " the ", " of "},
+    /*  63 */ {OMITLAST,  5, 0, 0,         "", ""},
+    /*  64 */ {OMITLAST,  9, 0, 0,         "", ""},
+    /*  65 */ {UPPERFIRST, 0, 1, 2,        " ", ", "},
+    /*  66 */ {UPPERFIRST, 0, 0, 1,         "", "\""},
+    /*  67 */ {IDENTITY,  0, 1, 1,        ".", "("},
+    /*  68 */ {UPPERALL,  0, 0, 1,         "", " "},
+    /*  69 */ {UPPERFIRST, 0, 0, 2,         "", "\">"},
+    /*  70 */ {IDENTITY,  0, 0, 2,         "", "=\""},
+    /*  71 */ {IDENTITY,  0, 1, 1,        " ", "."},
+    /*  72 */ {IDENTITY,  0, 5, 0,    ".com/", ""},
+    /*  73 */ {IDENTITY,  0, 5, 8,    " the ", " of the "},
+    /*  74 */ {UPPERFIRST, 0, 0, 1,         "", "'"},
+    /*  75 */ {IDENTITY,  0, 0, 7,         "", ". This "},
+    /*  76 */ {IDENTITY,  0, 0, 1,         "", ","},
+    /*  77 */ {IDENTITY,  0, 1, 1,        ".", " "},
+    /*  78 */ {UPPERFIRST, 0, 0, 1,         "", "("},
+    /*  79 */ {UPPERFIRST, 0, 0, 1,         "", "."},
+    /*  80 */ {IDENTITY,  0, 0, 5,         "", " not "},
+    /*  81 */ {IDENTITY,  0, 1, 2,        " ", "=\""},
+    /*  82 */ {IDENTITY,  0, 0, 3,         "", "er "},
+    /*  83 */ {UPPERALL,  0, 1, 1,        " ", " "},
+    /*  84 */ {IDENTITY,  0, 0, 3,         "", "al "},
+    /*  85 */ {UPPERALL,  0, 1, 0,        " ", ""},
+    /*  86 */ {IDENTITY,  0, 0, 2,         "", "='"},
+    /*  87 */ {UPPERALL,  0, 0, 1,         "", "\""},
+    /*  88 */ {UPPERFIRST, 0, 0, 2,         "", ". "},
+    /*  89 */ {IDENTITY,  0, 1, 1,        " ", "("},
+    /*  90 */ {IDENTITY,  0, 0, 4,         "", "ful "},
+    /*  91 */ {UPPERFIRST, 0, 1, 2,        " ", ". "},
+    /*  92 */ {IDENTITY,  0, 0, 4,         "", "ive "},
+    /*  93 */ {IDENTITY,  0, 0, 5,         "", "less "},
+    /*  94 */ {UPPERALL,  0, 0, 1,         "", "'"},
+    /*  95 */ {IDENTITY,  0, 0, 4,         "", "est "},
+    /*  96 */ {UPPERFIRST, 0, 1, 1,        " ", "."},
+    /*  97 */ {UPPERALL,  0, 0, 2,         "", "\">"},
+    /*  98 */ {IDENTITY,  0, 1, 2,        " ", "='"},
+    /*  99 */ {UPPERFIRST, 0, 0, 1,         "", ","},
+    /* 100 */ {IDENTITY,  0, 0, 4,         "", "ize "},
+    /* 101 */ {UPPERALL,  0, 0, 1,         "", "."},
+    /* 102 */ {IDENTITY,  0, 2, 0, "\xc2\xa0", ""},
+    /* 103 */ {IDENTITY,  0, 1, 1,        " ", ","},
+    /* 104 */ {UPPERFIRST, 0, 0, 2,         "", "=\""},
+    /* 105 */ {UPPERALL,  0, 0, 2,         "", "=\""},
+    /* 106 */ {IDENTITY,  0, 0, 4,         "", "ous "},
+    /* 107 */ {UPPERALL,  0, 0, 2,         "", ", "},
+    /* 108 */ {UPPERFIRST, 0, 0, 2,         "", "='"},
+    /* 109 */ {UPPERFIRST, 0, 1, 1,        " ", ","},
+    /* 110 */ {UPPERALL,  0, 1, 2,        " ", "=\""},
+    /* 111 */ {UPPERALL,  0, 1, 2,        " ", ", "},
+    /* 112 */ {UPPERALL,  0, 0, 1,         "", ","},
+    /* 113 */ {UPPERALL,  0, 0, 1,         "", "("},
+    /* 114 */ {UPPERALL,  0, 0, 2,         "", ". "},
+    /* 115 */ {UPPERALL,  0, 1, 1,        " ", "."},
+    /* 116 */ {UPPERALL,  0, 0, 2,         "", "='"},
+    /* 117 */ {UPPERALL,  0, 1, 2,        " ", ". "},
+    /* 118 */ {UPPERFIRST, 0, 1, 2,        " ", "=\""},
+    /* 119 */ {UPPERALL,  0, 1, 2,        " ", "='"},
+    /* 120 */ {UPPERFIRST, 0, 1, 2,        " ", "='"}
+};
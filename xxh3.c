@@ -0,0 +1,445 @@
+// xxh3.c -- compute the 64-bit XXH3 hash
+// Copyright (C) 2016 Mark Adler
+// For conditions of distribution and use, see the accompanying LICENSE file.
+
+/* This is the 64-bit XXH3 hash of xxHash 0.8 by Yann Collet, with seed zero
+   and the default secret.  Short inputs of up to 240 bytes are hashed
+   directly.  Longer inputs are processed in 64-byte stripes, each of which
+   updates eight 64-bit accumulators, with the accumulators scrambled after
+   every 16 stripes, i.e. every 1024-byte block.  The stripes are where all of
+   the time goes for long inputs, and they are done with SSE2 or AVX2
+   instructions when available, selected once at run time. */
+
+#include <string.h>
+#include <pthread.h>
+#include "xxh3.h"
+
+#define PRIME32_1 0x9e3779b1
+#define PRIME32_2 0x85ebca77
+#define PRIME32_3 0xc2b2ae3d
+#define PRIME64_1 0x9e3779b185ebca87
+#define PRIME64_2 0xc2b2ae3d27d4eb4f
+#define PRIME64_3 0x165667b19e3779f9
+#define PRIME64_4 0x85ebca77c2b2ae63
+#define PRIME64_5 0x27d4eb2f165667c5
+#define PRIME_MX1 0x165667919e3779f9
+#define PRIME_MX2 0x9fb21c651e98df25
+
+#define STRIPE 64                   /* bytes in a stripe */
+#define SECRET 192                  /* bytes in the secret */
+#define STRIPES ((SECRET - STRIPE) / 8)     /* stripes in a block (16) */
+#define BLOCK (STRIPE * STRIPES)    /* bytes in a block (1024) */
+
+/* The default secret. */
+static unsigned char const secret[SECRET] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c,
+    0xf7, 0x21, 0xad, 0x1c, 0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb,
+    0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f, 0xcb, 0x79, 0xe6, 0x4e,
+    0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6,
+    0x81, 0x3a, 0x26, 0x4c, 0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb,
+    0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3, 0x71, 0x64, 0x48, 0x97,
+    0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7,
+    0xc7, 0x0b, 0x4f, 0x1d, 0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31,
+    0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64, 0xea, 0xc5, 0xac, 0x83,
+    0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26,
+    0x29, 0xd4, 0x68, 0x9e, 0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc,
+    0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce, 0x45, 0xcb, 0x3a, 0x8f,
+    0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e
+};
+
+/* Load little-endian integers from p, which need not be aligned. */
+static inline uint32_t get32(unsigned char const *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+static inline uint64_t get64(unsigned char const *p) {
+    return get32(p) | ((uint64_t)get32(p + 4) << 32);
+}
+
+static inline uint64_t rotl64(uint64_t x, unsigned n) {
+    return (x << n) | (x >> (64 - n));
+}
+
+static inline uint64_t swap64(uint64_t x) {
+    x = ((x << 8) & 0xff00ff00ff00ff00) | ((x >> 8) & 0xff00ff00ff00ff);
+    x = ((x << 16) & 0xffff0000ffff0000) | ((x >> 16) & 0xffff0000ffff);
+    return (x << 32) | (x >> 32);
+}
+
+/* Return the exclusive-or of the high and low halves of the 128-bit product
+   of a and b. */
+static inline uint64_t fold64(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+    __extension__ typedef unsigned __int128 u128;
+    u128 p = (u128)a * b;
+    return (uint64_t)p ^ (uint64_t)(p >> 64);
+#else
+    uint64_t lo_lo = (a & 0xffffffff) * (b & 0xffffffff);
+    uint64_t hi_lo = (a >> 32) * (b & 0xffffffff);
+    uint64_t lo_hi = (a & 0xffffffff) * (b >> 32);
+    uint64_t hi_hi = (a >> 32) * (b >> 32);
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+    uint64_t hi = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    uint64_t lo = (cross << 32) | (lo_lo & 0xffffffff);
+    return lo ^ hi;
+#endif
+}
+
+/* Final mixes. */
+static inline uint64_t avalanche64(uint64_t h) {
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    return h ^ (h >> 32);
+}
+static inline uint64_t avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= PRIME_MX1;
+    return h ^ (h >> 32);
+}
+static inline uint64_t rrmxmx(uint64_t h, uint64_t len) {
+    h ^= rotl64(h, 49) ^ rotl64(h, 24);
+    h *= PRIME_MX2;
+    h ^= (h >> 35) + len;
+    h *= PRIME_MX2;
+    return h ^ (h >> 28);
+}
+
+/* Mix 16 bytes of input with 16 bytes of the secret. */
+static inline uint64_t mix16(unsigned char const *in, unsigned char const *key) {
+    return fold64(get64(in) ^ get64(key), get64(in + 8) ^ get64(key + 8));
+}
+
+/* Hash inputs of 0 to 16 bytes. */
+static uint64_t hash16(unsigned char const *in, size_t len) {
+    if (len > 8) {
+        uint64_t lo = get64(in) ^ (get64(secret + 24) ^ get64(secret + 32));
+        uint64_t hi = get64(in + len - 8) ^
+                      (get64(secret + 40) ^ get64(secret + 48));
+        return avalanche(len + swap64(lo) + hi + fold64(lo, hi));
+    }
+    if (len >= 4) {
+        uint64_t word = get32(in + len - 4) + ((uint64_t)get32(in) << 32);
+        return rrmxmx(word ^ (get64(secret + 8) ^ get64(secret + 16)), len);
+    }
+    if (len) {
+        uint32_t word = ((uint32_t)in[0] << 16) | ((uint32_t)in[len >> 1] << 24) |
+                        in[len - 1] | ((uint32_t)len << 8);
+        return avalanche64(word ^ (get32(secret) ^ get32(secret + 4)));
+    }
+    return avalanche64(get64(secret + 56) ^ get64(secret + 64));
+}
+
+/* Hash inputs of 17 to 240 bytes. */
+static uint64_t hash240(unsigned char const *in, size_t len) {
+    uint64_t acc = len * PRIME64_1;
+    if (len <= 128) {
+        if (len > 32) {
+            if (len > 64) {
+                if (len > 96) {
+                    acc += mix16(in + 48, secret + 96);
+                    acc += mix16(in + len - 64, secret + 112);
+                }
+                acc += mix16(in + 32, secret + 64);
+                acc += mix16(in + len - 48, secret + 80);
+            }
+            acc += mix16(in + 16, secret + 32);
+            acc += mix16(in + len - 32, secret + 48);
+        }
+        acc += mix16(in, secret);
+        acc += mix16(in + len - 16, secret + 16);
+        return avalanche(acc);
+    }
+    unsigned rounds = len >> 4;
+    for (unsigned i = 0; i < 8; i++)
+        acc += mix16(in + 16 * i, secret + 16 * i);
+    acc = avalanche(acc);
+    for (unsigned i = 8; i < rounds; i++)
+        acc += mix16(in + 16 * i, secret + 16 * (i - 8) + 3);
+    acc += mix16(in + len - 16, secret + 136 - 17);
+    return avalanche(acc);
+}
+
+/* Process n stripes at in with the secret starting at key, advancing eight
+   bytes in the secret for each stripe. */
+static void stripes_c(uint64_t *acc, unsigned char const *in,
+                      unsigned char const *key, size_t n) {
+    while (n--) {
+        for (unsigned i = 0; i < 8; i++) {
+            uint64_t val = get64(in + 8 * i);
+            uint64_t mix = val ^ get64(key + 8 * i);
+            acc[i ^ 1] += val;
+            acc[i] += (mix & 0xffffffff) * (mix >> 32);
+        }
+        in += STRIPE;
+        key += 8;
+    }
+}
+
+/* Scramble the accumulators at the end of a block. */
+static void scramble_c(uint64_t *acc, unsigned char const *key) {
+    for (unsigned i = 0; i < 8; i++) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= get64(key + 8 * i);
+        acc[i] = a * PRIME32_1;
+    }
+}
+
+#ifdef __x86_64__
+
+#include <immintrin.h>
+
+/* SSE2 versions, which are always available on x86-64.  Each 128-bit register
+   holds two of the accumulators.  The 32x32 multiplies of the low and high
+   halves of each lane are done by pmuludq. */
+static void stripes_sse2(uint64_t *acc, unsigned char const *in,
+                         unsigned char const *key, size_t n) {
+    __m128i a[4];
+    for (unsigned i = 0; i < 4; i++)
+        a[i] = _mm_loadu_si128((__m128i const *)acc + i);
+    while (n--) {
+        for (unsigned i = 0; i < 4; i++) {
+            __m128i val = _mm_loadu_si128((__m128i const *)in + i);
+            __m128i mix = _mm_xor_si128(val,
+                            _mm_loadu_si128((__m128i const *)key + i));
+            __m128i prod = _mm_mul_epu32(mix, _mm_shuffle_epi32(mix, 0x31));
+            a[i] = _mm_add_epi64(a[i], _mm_shuffle_epi32(val, 0x4e));
+            a[i] = _mm_add_epi64(a[i], prod);
+        }
+        in += STRIPE;
+        key += 8;
+    }
+    for (unsigned i = 0; i < 4; i++)
+        _mm_storeu_si128((__m128i *)acc + i, a[i]);
+}
+
+static void scramble_sse2(uint64_t *acc, unsigned char const *key) {
+    __m128i const prime = _mm_set1_epi32(PRIME32_1);
+    for (unsigned i = 0; i < 4; i++) {
+        __m128i a = _mm_loadu_si128((__m128i const *)acc + i);
+        a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+        a = _mm_xor_si128(a, _mm_loadu_si128((__m128i const *)key + i));
+        __m128i lo = _mm_mul_epu32(a, prime);
+        __m128i hi = _mm_mul_epu32(_mm_shuffle_epi32(a, 0x31), prime);
+        _mm_storeu_si128((__m128i *)acc + i,
+                         _mm_add_epi64(lo, _mm_slli_epi64(hi, 32)));
+    }
+}
+
+/* AVX2 versions, with four accumulators in each 256-bit register. */
+__attribute__((target("avx2")))
+static void stripes_avx2(uint64_t *acc, unsigned char const *in,
+                         unsigned char const *key, size_t n) {
+    __m256i a0 = _mm256_loadu_si256((__m256i const *)acc);
+    __m256i a1 = _mm256_loadu_si256((__m256i const *)acc + 1);
+    while (n--) {
+        __m256i val = _mm256_loadu_si256((__m256i const *)in);
+        __m256i mix = _mm256_xor_si256(val,
+                        _mm256_loadu_si256((__m256i const *)key));
+        a0 = _mm256_add_epi64(a0, _mm256_shuffle_epi32(val, 0x4e));
+        a0 = _mm256_add_epi64(a0, _mm256_mul_epu32(mix,
+                                    _mm256_shuffle_epi32(mix, 0x31)));
+        val = _mm256_loadu_si256((__m256i const *)in + 1);
+        mix = _mm256_xor_si256(val,
+                _mm256_loadu_si256((__m256i const *)key + 1));
+        a1 = _mm256_add_epi64(a1, _mm256_shuffle_epi32(val, 0x4e));
+        a1 = _mm256_add_epi64(a1, _mm256_mul_epu32(mix,
+                                    _mm256_shuffle_epi32(mix, 0x31)));
+        in += STRIPE;
+        key += 8;
+    }
+    _mm256_storeu_si256((__m256i *)acc, a0);
+    _mm256_storeu_si256((__m256i *)acc + 1, a1);
+}
+
+__attribute__((target("avx2")))
+static void scramble_avx2(uint64_t *acc, unsigned char const *key) {
+    __m256i const prime = _mm256_set1_epi32(PRIME32_1);
+    for (unsigned i = 0; i < 2; i++) {
+        __m256i a = _mm256_loadu_si256((__m256i const *)acc + i);
+        a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+        a = _mm256_xor_si256(a, _mm256_loadu_si256((__m256i const *)key + i));
+        __m256i lo = _mm256_mul_epu32(a, prime);
+        __m256i hi = _mm256_mul_epu32(_mm256_shuffle_epi32(a, 0x31), prime);
+        _mm256_storeu_si256((__m256i *)acc + i,
+                            _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32)));
+    }
+}
+
+#endif
+
+/* The implementations of the stripe processing, in order of preference. */
+static struct {
+    char const *name;
+    void (*stripes)(uint64_t *, unsigned char const *, unsigned char const *,
+                    size_t);
+    void (*scramble)(uint64_t *, unsigned char const *);
+    int (*have)(void);
+} const impls[] = {
+#ifdef __x86_64__
+    {"avx2", stripes_avx2, scramble_avx2, NULL},
+    {"sse2", stripes_sse2, scramble_sse2, NULL},
+#endif
+    {"scalar", stripes_c, scramble_c, NULL}
+};
+#define IMPLS (sizeof(impls) / sizeof(impls[0]))
+
+/* Return true if implementation k can be run on this processor. */
+static int have(unsigned k) {
+#ifdef __x86_64__
+    if (impls[k].stripes == stripes_avx2) {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+    (void)k;
+    return 1;
+}
+
+/* The selected implementation. */
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static unsigned use = IMPLS - 1;
+
+static void pick(void) {
+    for (use = 0; use < IMPLS - 1 && !have(use); use++)
+        ;
+}
+
+/* Select an implementation.  See xxh3.h for description. */
+char const *xxh3_impl(unsigned k) {
+    pthread_once(&once, pick);
+    for (unsigned i = 0; i < IMPLS; i++)
+        if (have(i) && k-- == 0) {
+            use = i;
+            return impls[i].name;
+        }
+    return NULL;
+}
+
+/* Process n stripes at in, continuing the current block that has *done
+   stripes in it to this point, scrambling when a block is completed. */
+static void stripes(uint64_t *acc, size_t *done, unsigned char const *in,
+                    size_t n) {
+    while (n) {
+        size_t k = STRIPES - *done;
+        if (k > n)
+            k = n;
+        impls[use].stripes(acc, in, secret + 8 * *done, k);
+        in += k * STRIPE;
+        n -= k;
+        *done += k;
+        if (*done == STRIPES) {
+            impls[use].scramble(acc, secret + SECRET - STRIPE);
+            *done = 0;
+        }
+    }
+}
+
+/* Initial accumulators. */
+static void acc_init(uint64_t *acc) {
+    acc[0] = PRIME32_3;
+    acc[1] = PRIME64_1;
+    acc[2] = PRIME64_2;
+    acc[3] = PRIME64_3;
+    acc[4] = PRIME64_4;
+    acc[5] = PRIME32_2;
+    acc[6] = PRIME64_5;
+    acc[7] = PRIME32_1;
+}
+
+/* Process the last stripe, which ends at the end of the input, and merge the
+   accumulators into the hash. */
+static uint64_t merge(uint64_t *acc, unsigned char const *last,
+                      uint64_t total) {
+    impls[use].stripes(acc, last, secret + SECRET - STRIPE - 7, 1);
+    uint64_t h = total * PRIME64_1;
+    for (unsigned i = 0; i < 4; i++)
+        h += fold64(acc[2 * i] ^ get64(secret + 11 + 16 * i),
+                    acc[2 * i + 1] ^ get64(secret + 11 + 16 * i + 8));
+    return avalanche(h);
+}
+
+/* Compute the XXH3 hash.  See xxh3.h for description. */
+uint64_t xxh3(void const *buf, size_t len) {
+    unsigned char const *in = buf;
+    if (len <= 16)
+        return hash16(in, len);
+    if (len <= 240)
+        return hash240(in, len);
+    pthread_once(&once, pick);
+    uint64_t acc[8];
+    acc_init(acc);
+    size_t done = 0;
+    stripes(acc, &done, in, (len - 1) / STRIPE);
+    return merge(acc, in + len - STRIPE, len);
+}
+
+/* Initialize an XXH3 state.  See xxh3.h for description. */
+void xxh3_init(xxh3_t *state) {
+    pthread_once(&once, pick);
+    acc_init(state->acc);
+    state->have = 0;
+    state->stripes = 0;
+    state->total = 0;
+}
+
+/* Update an XXH3 state.  See xxh3.h for description.  The stripes are only
+   processed once it is known that there is input after them, since the last
+   stripe is processed differently.  At least one byte is always left in the
+   buffer.  When input is processed directly, its last 64 bytes are saved at
+   the end of the buffer, since the last stripe may reach back into them. */
+void xxh3_update(xxh3_t *state, void const *buf, size_t len) {
+    unsigned char const *in = buf;
+    state->total += len;
+    if (len <= sizeof(state->buf) - state->have) {
+        memcpy(state->buf + state->have, in, len);
+        state->have += len;
+        return;
+    }
+    if (state->have) {
+        size_t fill = sizeof(state->buf) - state->have;
+        memcpy(state->buf + state->have, in, fill);
+        in += fill;
+        len -= fill;
+        stripes(state->acc, &state->stripes, state->buf,
+                sizeof(state->buf) / STRIPE);
+        state->have = 0;
+    }
+    if (len > sizeof(state->buf)) {
+        size_t n = (len - 1) / STRIPE;
+        stripes(state->acc, &state->stripes, in, n);
+        in += n * STRIPE;
+        len -= n * STRIPE;
+        memcpy(state->buf + sizeof(state->buf) - STRIPE, in - STRIPE, STRIPE);
+    }
+    memcpy(state->buf, in, len);
+    state->have = len;
+}
+
+/* Return the hash of the data so far.  See xxh3.h for description. */
+uint64_t xxh3_digest(xxh3_t const *state) {
+    if (state->total <= 240)
+        return state->total <= 16 ? hash16(state->buf, state->total) :
+                                    hash240(state->buf, state->total);
+    uint64_t acc[8];
+    memcpy(acc, state->acc, sizeof(acc));
+    size_t done = state->stripes;
+    unsigned char last[STRIPE];
+    unsigned char const *end;
+    if (state->have >= STRIPE) {
+        size_t n = (state->have - 1) / STRIPE;
+        stripes(acc, &done, state->buf, n);
+        end = state->buf + state->have - STRIPE;
+    }
+    else {
+        size_t back = STRIPE - state->have;
+        memcpy(last, state->buf + sizeof(state->buf) - back, back);
+        memcpy(last + back, state->buf, state->have);
+        end = last;
+    }
+    return merge(acc, end, state->total);
+}
@@ -0,0 +1,35 @@
+// xxh3.h -- header for xxh3.c
+// Copyright (C) 2016 Mark Adler
+// For conditions of distribution and use, see the accompanying LICENSE file.
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Return the 64-bit XXH3 hash of buf[0..len-1], with seed zero and the default
+// secret.  This is the same as XXH3_64bits() in xxHash 0.8.  XXH3 processes
+// long inputs in eight 64-bit lanes, which is done with SSE2 or AVX2
+// instructions if available.
+uint64_t xxh3(void const *buf, size_t len);
+
+// The XXH3 hash can be computed a piece at a time with a state that is
+// initialized by xxh3_init(), then updated with xxh3_update() for each piece,
+// in order, and finally the hash returned by xxh3_digest().  The result
+// does not depend on how the data is divided into pieces.  xxh3_digest() does
+// not change the state, so more can be added after it.
+typedef struct {
+    uint64_t acc[8];            // accumulators
+    unsigned char buf[256];     // buffered input (the last 64 bytes of which
+                                // retain previous input after it is used)
+    size_t have;                // number of bytes of new input at buf
+    size_t stripes;             // number of stripes in the current block
+    uint64_t total;             // total number of bytes provided
+} xxh3_t;
+void xxh3_init(xxh3_t *state);
+void xxh3_update(xxh3_t *state, void const *buf, size_t len);
+uint64_t xxh3_digest(xxh3_t const *state);
+
+// xxh3_impl(k) selects the k'th implementation of the lane processing that is
+// supported by this processor, returning its name, or NULL if there are no
+// more.  This is for speed comparisons, and is not thread-safe.  Otherwise the
+// fastest available is selected the first time a hash is computed.
+char const *xxh3_impl(unsigned k);
@@ -30,22 +30,66 @@
 /* local for functions not linked outside of this module. */
 #define local static
 
-/* trace() macro for debugging. */
+/* Inline a function even when it is large, if the compiler can be told to. */
+#ifdef __GNUC__
+#  define FORCE_INLINE inline __attribute__((always_inline))
+#else
+#  define FORCE_INLINE inline
+#endif
+
+/*
+ * trace() macro for debugging, used where the state is s.  s->traced counts
+ * the trace lines since the last save().  When yeast_feed() goes back to the
+ * mark to decode a meta-block again, the lines already shown are counted off
+ * in s->quiet and not shown again, so that the trace is the same however the
+ * input is fed.
+ */
 #ifdef DEBUG
 #  include <stdio.h>
    int yeast_verbosity = 0;
 #  define trace(level, ...) \
     do { \
         if ((level) <= yeast_verbosity) { \
-            fputs("yeast: ", stderr); \
-            fprintf(stderr, __VA_ARGS__); \
-            putc('\n', stderr); \
+            s->traced++; \
+            if (s->quiet) \
+                s->quiet--; \
+            else { \
+                fputs("yeast: ", stderr); \
+                fprintf(stderr, __VA_ARGS__); \
+                putc('\n', stderr); \
+            } \
         } \
     } while (0)
 #else
 #  define trace(level, ...)
 #endif
 
+/*
+ * tally() and timed() macros for statistics.  tally() does its argument only
+ * when compiled with YEAST_STATS.  timed() always does its argument, and adds
+ * the time it took to the current meta-block's table building time when
+ * compiled with YEAST_STATS.  UNREAD() is the number of input bits not yet
+ * used, the difference of which before and after decoding something being
+ * the number of bits it took.
+ */
+#ifdef YEAST_STATS
+#  include <time.h>
+#  define tally(...) \
+    do { \
+        __VA_ARGS__; \
+    } while (0)
+#  define timed(s, ...) \
+    do { \
+        double start_ = seconds(); \
+        __VA_ARGS__; \
+        (s)->block.table_secs += seconds() - start_; \
+    } while (0)
+#  define UNREAD(s) (((uint64_t)(s)->len << 3) + (s)->left)
+#else
+#  define tally(...)
+#  define timed(s, ...) __VA_ARGS__
+#endif
+
 /*
  * Assured memory allocation.
  */
@@ -69,13 +113,37 @@ local void *alloc(void *mem, size_t size)
 #define MAXDISTS 520        /* 16 + (15 << 3) + (48 << 3) */
 #define MAXSYMS MAXIACS     /* maximum over all alphabets */
 
+/*
+ * Number of bits used to index the first-level decoding lookup table, and the
+ * maximum number of entries needed for the first-level and all second-level
+ * lookup tables.  ENOUGH is the value for the largest alphabet (704 symbols)
+ * with 15-bit codes and an eight-bit first-level table, as computed by
+ * enough.c in the zlib distribution.  Smaller alphabets need fewer entries.
+ */
+#define ROOTBITS 8
+#define ENOUGH 1080
+
+/*
+ * Lookup table entry.  If sub is zero, then val is the symbol and bits is the
+ * total number of bits in its code.  If sub is not zero, then this is a
+ * first-level entry for codes longer than ROOTBITS, where val is the offset in
+ * the table of a second-level table indexed by the sub bits after the first
+ * ROOTBITS bits.
+ */
+typedef struct {
+    unsigned short val;     /* symbol, or offset of the second-level table */
+    unsigned char bits;     /* number of bits in the code */
+    unsigned char sub;      /* number of bits to index second-level table */
+} entry_t;
+
 /*
  * Prefix code decoding table type.  count[0..MAXBITS] are the number of
  * symbols of each length, from which a canonical code is generated.
  * symbol[0..n-1] are the symbol values corresponding in order to the codes
- * from short to long.  n is the sum of the counts in count[].  The decoding
- * process can be seen in the function decode() below. count[] must represent a
- * complete code, and so must satisfy:
+ * from short to long.  n is the sum of the counts in count[].  The canonical
+ * code is then expanded into table[], which is what decode() below uses to
+ * decode symbols.  count[] must represent a complete code, and so must
+ * satisfy:
  *
  *     sum(count[i] * (1 << (MAXBITS - i)), i=0..MAXBITS) == 1 << MAXBITS
  *
@@ -85,18 +153,58 @@ local void *alloc(void *mem, size_t size)
 typedef struct {
     unsigned short count[MAXBITS+1];    /* number of symbols of each length */
     unsigned short symbol[MAXSYMS];     /* canonically ordered symbols */
+    entry_t table[ENOUGH];              /* lookup tables made from the above */
 } prefix_t;
 
 /*
- * Brotli decoding state.  About 26K bytes (assuming 64-bit size_t and pointer
- * types and 16-bit shorts), plus allocated prefix codes.  The allocated prefix
- * codes can in principle be as large as 3 * 256 * 1440 = 1,105,920 bytes.
+ * Number of bits used to index a joint literal table, which decodes two
+ * literals at once when both of their codes fit in PAIRBITS bits.
+ */
+#define PAIRBITS 11
+
+/*
+ * Joint literal table entry.  If bits is not NOPAIR, then lit[0] and lit[1]
+ * are the next two literals, first is the number of bits in the code for
+ * lit[0], and bits is the total number of bits in the two codes.  If bits is
+ * NOPAIR, then the literals are decoded one at a time with decode().
+ */
+#define NOPAIR 255
+typedef struct {
+    unsigned char lit[2];   /* two literals */
+    unsigned char first;    /* number of bits in the code for lit[0] */
+    unsigned char bits;     /* total bits in the two codes, or NOPAIR */
+} pair_t;
+
+/*
+ * Saved position in the stream at the start of a meta-block, from which
+ * yeast_feed() can restart decoding when the input ran out part way through
+ * the meta-block.  Everything else that a meta-block depends on is either
+ * constant for the stream or is read anew from the meta-block header.
  */
 typedef struct {
+    size_t pos;                     /* offset of next input byte in s->in */
+    uint64_t bits;                  /* bit buffer */
+    unsigned char left;             /* number of bits in bit buffer */
+    size_t got;                     /* number of bytes at s->dest */
+    uint32_t ring[4];               /* ring buffer of previous distances */
+    unsigned short ring_ptr;        /* index of last distance in ring buffer */
+} mark_t;
+
+/*
+ * Brotli decoding state.  About 54K bytes (assuming 64-bit size_t and pointer
+ * types and 16-bit shorts), plus allocated prefix codes and joint literal
+ * tables.  The allocated prefix codes can in principle be as large as
+ * 3 * 256 * 5760 = 4,423,680 bytes, and the joint tables as large as
+ * 256 * 8192 = 2,097,152 bytes.  The prefix codes and joint tables for each
+ * meta-block are carved out of allocations that are kept in the state, grown
+ * as needed, and reused for every meta-block and, through yeast_with(), for
+ * every stream decoded with the same state.
+ */
+typedef struct yeast_s {
     /* input state */
     unsigned char const *next;      /* next bytes to get from input buffer */
     size_t len;                     /* number of bytes at next */
-    unsigned char bits;             /* bit buffer (holds 0..7 bits) */
+    uint64_t bits;                  /* bit buffer (holds 0..64 bits) */
     unsigned char left;             /* number of bits left in bit buffer */
 
     /* sliding window size */
@@ -105,8 +213,39 @@ typedef struct {
 
     /* output/compare state */
     unsigned char *dest;            /* allocated output space */
+    size_t size;                    /* bytes usable at dest (+ SLACK) */
     size_t got;                     /* bytes written to output so far */
     size_t have;                    /* bytes at dest to compare, or zero */
+    int cmp;                        /* true to compare instead of write */
+    int into;                       /* true if dest is the caller's, no SLACK */
+    int measure;                    /* true to measure, with no dest */
+    unsigned char kind;             /* YEAST_COMPRESSED, _STORED, or _EMPTY */
+    unsigned char const *span;      /* start of the last stored data */
+    void (*data)(struct yeast_s *, size_t); /* data_write(), data_cmp(), or
+                                               data_measure() */
+    void (*check)(void *, void const *, size_t);    /* yeast_check() or NULL */
+    void *check_arg;                /* first argument for check() */
+    size_t checked;                 /* bytes at dest given to check() */
+
+    /* streaming state for yeast_feed() */
+    unsigned char *in;              /* buffered input (allocated) */
+    size_t in_size;                 /* bytes allocated at in */
+    size_t in_len;                  /* bytes of input at in */
+    size_t need;                    /* buffered input needed to try again */
+    size_t fed;                     /* total input bytes provided */
+    size_t used;                    /* total input bytes used, when done */
+    size_t out;                     /* offset of output to deliver */
+    int ret;                        /* -1 until done, then return value */
+    mark_t mark;                    /* start of the current meta-block */
+    uint64_t base;                  /* output dropped from before dest */
+    uint64_t skipped;               /* stream bytes before the input fed */
+    unsigned char skip;             /* bits to skip in first byte fed */
+
+    /* checkpoints */
+    void (*point)(void *, yeast_point_t const *);   /* yeast_points() or NULL */
+    void *point_arg;                /* first argument for point() */
+    size_t every;                   /* output between checkpoints */
+    uint64_t pointed;               /* offset of the last checkpoint */
 
     /* codes types state */
     unsigned short lit_num;         /* number of literal types */
@@ -127,13 +266,21 @@ typedef struct {
     unsigned short ring_ptr;        /* index of last distance in ring buffer */
     unsigned char postfix;          /* log2 of # of interleavings (0..3) */
     unsigned char direct;           /* number of direct distance codes */
+    unsigned dist_key;              /* postfix and direct for the tables */
+    uint32_t dist_base[MAXDISTS];   /* distance base for each symbol */
+    unsigned char dist_extra[MAXDISTS]; /* distance extra bits per symbol */
 
     /* codes */
     unsigned short lit_codes;       /* number of literal prefix codes */
     unsigned short dist_codes;      /* number of distance prefix codes */
-    prefix_t *lit_code;             /* lit_codes literal codes (allocated) */
-    prefix_t *iac_code;             /* iac_num insert codes (allocated) */
-    prefix_t *dist_code;            /* dist_codes distance codes (allocated) */
+    prefix_t *codes;                /* space for all codes (allocated) */
+    size_t codes_num;               /* number of prefix_t's at codes */
+    prefix_t *lit_code;             /* lit_codes literal codes (in codes) */
+    prefix_t *iac_code;             /* iac_num insert codes (in codes) */
+    prefix_t *dist_code;            /* dist_codes distance codes (in codes) */
+    pair_t *pairs;                  /* space for joint tables (allocated) */
+    size_t pairs_num;               /* number of joint tables at pairs */
+    pair_t *lit_pair[256];          /* joint table for each literal type */
 
     /* context */
     unsigned char mode[256];        /* modes for lit_num literal types */
@@ -147,11 +294,153 @@ typedef struct {
     prefix_t iac_count;             /* insert and copy block lengths */
     prefix_t dist_types;            /* distance block types */
     prefix_t dist_count;            /* distance block lengths */
+
+#ifdef YEAST_STATS
+    /* statistics */
+    yeast_stats_t stats;            /* totals for the stream */
+    yeast_stats_t block;            /* counts for the current meta-block */
+    void (*report)(void *, yeast_stats_t const *);  /* yeast_stats() or NULL */
+    void *report_arg;               /* first argument for report() */
+#endif
+
+#ifdef DEBUG
+    /* trace */
+    unsigned long traced;           /* trace lines since the last save() */
+    unsigned long quiet;            /* trace lines not to show again */
+#endif
 } state_t;
 
+#ifdef YEAST_STATS
+/*
+ * Return the current time in seconds.
+ */
+local double seconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Return the floor of the log base 2 of x, for x not zero, which is the
+ * histogram bucket for x.
+ */
+local unsigned bucket(size_t x)
+{
+    unsigned k = 0;
+
+    while (x >>= 1)
+        k++;
+    return k < YEAST_HIST ? k : YEAST_HIST - 1;
+}
+
+/*
+ * Finish the counts for a meta-block that started with start bits unread,
+ * add them to the stream totals, and report them.
+ */
+local void block_done(state_t *s, uint64_t start)
+{
+    yeast_stats_t *b = &s->block, *t = &s->stats;
+    unsigned k;
+
+    b->header_bits = start - UNREAD(s) -
+                     (b->prefix_bits + b->map_bits + b->data_bits);
+    t->bytes += b->bytes;
+    t->compressed += b->compressed;
+    t->stored += b->stored;
+    t->empty += b->empty;
+    t->header_bits += b->header_bits;
+    t->prefix_bits += b->prefix_bits;
+    t->map_bits += b->map_bits;
+    t->data_bits += b->data_bits;
+    t->prefix_codes += b->prefix_codes;
+    t->table_secs += b->table_secs;
+    t->header_secs += b->header_secs;
+    t->commands += b->commands;
+    t->literal_bytes += b->literal_bytes;
+    t->stored_bytes += b->stored_bytes;
+    t->copies += b->copies;
+    t->copy_bytes += b->copy_bytes;
+    t->dict_copies += b->dict_copies;
+    t->dict_bytes += b->dict_bytes;
+    t->lit_switches += b->lit_switches;
+    t->iac_switches += b->iac_switches;
+    t->dist_switches += b->dist_switches;
+    for (k = 0; k < YEAST_HIST; k++) {
+        t->dist_hist[k] += b->dist_hist[k];
+        t->len_hist[k] += b->len_hist[k];
+    }
+    if (s->report != NULL)
+        s->report(s->report_arg, b);
+}
+#endif
+
+/*
+ * Load eight bytes from p as a little-endian 64-bit integer.  p need not be
+ * aligned.  The endianess test is resolved at compile time by most compilers,
+ * leaving just the memcpy(), which is then a single unaligned load.
+ */
+local inline uint64_t load64(unsigned char const *p)
+{
+    static int const little = 1;
+    uint64_t word;
+
+    if (*(char const *)&little) {
+        memcpy(&word, p, sizeof(word));
+        return word;
+    }
+    return (uint64_t)p[0] | ((uint64_t)p[1] << 8) |
+           ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+           ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) |
+           ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+/*
+ * Fill the bit buffer with as many whole bytes from the input as will fit,
+ * leaving 57..64 bits in it, or fewer if the input runs out.  s->left must be
+ * less than 64 on entry.
+ *
+ * If at least eight bytes of input remain, then this is the fast path: eight
+ * bytes are loaded at once and as many as fit are kept, with one check of the
+ * amount of input for the whole refill.  The bits above s->left in the buffer
+ * are then the next bytes of the input, which will simply be or'ed in again
+ * at the same positions on the next refill.  Near the end of the input, the
+ * bytes are brought in one at a time, so that exactly the remaining input is
+ * used, and the bits above s->left are zero.
+ */
+local inline void refill(state_t *s)
+{
+    assert(s->left < 64);
+    if (s->len >= 8) {
+        unsigned n = (63 - s->left) >> 3;   /* bytes that fit in buffer */
+
+        s->bits |= load64(s->next) << s->left;
+        s->next += n;
+        s->len -= n;
+        s->left += n << 3;
+    }
+    else
+        while (s->left <= 56 && s->len) {
+            s->bits |= (uint64_t)(*(s->next)++) << s->left;
+            s->len--;
+            s->left += 8;
+        }
+}
+
+/*
+ * Throw a premature end of input error.  All of the input has been used at
+ * this point, so the bit buffer is emptied to reflect that.
+ */
+local void premature(state_t *s)
+{
+    s->bits = 0;
+    s->left = 0;
+    throw(2, "premature end of input");
+}
+
 /*
- * Return need bits from the input stream.  need must be in 0..25.  This will
- * leave 0..7 bits in s->bits.
+ * Return need bits from the input stream.  need must be in 0..32.
  *
  * Format note:
  *
@@ -162,20 +451,83 @@ typedef struct {
  */
 local uint32_t bits(state_t *s, unsigned need)
 {
-    uint32_t reg;       /* register in which to accumulate need bits */
+    uint32_t val;       /* need bits from the bottom of the bit buffer */
 
-    assert(need <= 32 - 7);
-    reg = s->bits;
-    while (s->left < need) {
-        if (s->len == 0)
-            throw(2, "premature end of input");
-        reg |= (uint32_t)(*(s->next)++) << s->left;
-        s->len--;
-        s->left += 8;
+    assert(need <= 32);
+    if (s->left < need) {
+        refill(s);
+        if (s->left < need)
+            premature(s);
+    }
+    val = s->bits & (((uint64_t)1 << need) - 1);
+    s->bits >>= need;
+    s->left -= need;
+    return val;
+}
+
+/*
+ * Return need bits from the input stream, where need can be as large as 56.
+ * This is the same as bits(), but takes advantage of refill() leaving at least
+ * 57 bits in the bit buffer when there is enough input, so that two fields of
+ * up to 24 bits each can be read at once.
+ */
+local inline uint64_t wide(state_t *s, unsigned need)
+{
+    uint64_t val;       /* need bits from the bottom of the bit buffer */
+
+    assert(need <= 56);
+    if (s->left < need) {
+        refill(s);
+        if (s->left < need)
+            premature(s);
     }
-    s->bits = reg >> need;
+    val = s->bits & (((uint64_t)1 << need) - 1);
+    s->bits >>= need;
+    s->left -= need;
+    return val;
+}
+
+/*
+ * Return the next need bits from the input stream without consuming them.
+ * need must be in 0..32.  If the input runs out, then the missing bits are
+ * returned as zeros.  It is then up to eat() to report a premature end of
+ * input if any of those missing bits are actually used.
+ */
+local inline unsigned peek(state_t *s, unsigned need)
+{
+    assert(need <= 32);
+    if (s->left < need)
+        refill(s);
+    return s->bits & (((uint64_t)1 << need) - 1);
+}
+
+/*
+ * Consume need bits that were previously obtained with peek().
+ */
+local inline void eat(state_t *s, unsigned need)
+{
+    if (s->left < need)
+        premature(s);
+    s->bits >>= need;
     s->left -= need;
-    return reg & (((uint32_t)1 << need) - 1);
+}
+
+/*
+ * Go to a byte boundary in the input stream, returning any whole bytes still
+ * in the bit buffer back to the input.  Return true if any of the bits
+ * discarded to get to the byte boundary are not zero.
+ */
+local int align(state_t *s)
+{
+    unsigned drop = s->left & 7;    /* number of bits to discard */
+    int ret;
+
+    ret = (s->bits & ((1U << drop) - 1)) != 0;
+    s->next -= s->left >> 3;
+    s->len += s->left >> 3;
+    s->bits = 0;
+    s->left = 0;
+    return ret;
 }
 
 /*
@@ -184,10 +536,9 @@ local uint32_t bits(state_t *s, unsigned need)
  * Format notes:
  *
  * - The codes as stored in the compressed data are bit-reversed relative to a
- *   simple integer ordering of codes of the same lengths.  The bits are pulled
- *   from the compressed data one at a time and used to build the code value
- *   reversed from what is in the stream in order to permit simple integer
- *   comparisons for decoding.
+ *   simple integer ordering of codes of the same lengths.  The lookup tables
+ *   are indexed by the bits as they appear in the stream, so the table
+ *   entries are bit-reversed when the tables are built.
  *
  * - The first code for the shortest non-zero length is all zeros.  Subsequent
  *   codes of the same length are integer increments of the previous code.
@@ -198,24 +549,163 @@ local uint32_t bits(state_t *s, unsigned need)
  *   that symbol is zero.
  *
  * - All codes in the brotli format are complete, so the only error possible
- *   when decoding a prefix code is running out of input bits.  (bits() will
+ *   when decoding a prefix code is running out of input bits.  (eat() will
  *   throw an error in that case.)
  */
 local unsigned decode(state_t *s, prefix_t const *p)
 {
-    unsigned len = 0;       /* current number of bits in code */
-    unsigned first = 0;     /* first code of length len */
-    unsigned index = 0;     /* index of length len codes in symbol table */
-    unsigned code = 0;      /* the len bits being decoded */
-    unsigned count;         /* number of codes of length len */
+    entry_t const *here;    /* table entry for the bits at the input */
+
+    here = p->table + peek(s, ROOTBITS);
+    if (here->sub)
+        here = p->table + here->val +
+               (peek(s, ROOTBITS + here->sub) >> ROOTBITS);
+    eat(s, here->bits);
+    return here->val;
+}
+
+/*
+ * Build the lookup tables in p->table[] from the canonical code in p->count[]
+ * and p->symbol[].  Codes of ROOTBITS or fewer bits are replicated in the
+ * first-level table for all values of the bits that follow the code.  Codes
+ * longer than ROOTBITS go in second-level tables, one for each first-level
+ * index that is a prefix of those codes, sized to hold the longest of them.
+ *
+ * Format note:
+ *
+ * - Since the code is complete and canonical, all of the codes that share the
+ *   same ROOTBITS prefix are adjacent to each other in the symbol[] ordering,
+ *   and those codes exactly fill their second-level table.
+ */
+local void lookup(prefix_t *p)
+{
+    unsigned len;                   /* current code length */
+    unsigned max;                   /* longest code length */
+    unsigned left[MAXBITS+1];       /* codes of each length not yet placed */
+    unsigned code;                  /* current code, bit-reversed */
+    unsigned index;                 /* index of current symbol */
+    unsigned next;                  /* next free entry for second-level */
+    unsigned root;                  /* first-level index of current table */
+    unsigned base = 0;              /* offset of current second-level table */
+    unsigned sub = 0;               /* index bits of current second-level */
+    unsigned n, k, bit;
+    entry_t here;
+
+    /* single symbol with a zero-length code */
+    if (p->count[0]) {
+        here.val = p->symbol[0];
+        here.bits = 0;
+        here.sub = 0;
+        for (n = 0; n < (1U << ROOTBITS); n++)
+            p->table[n] = here;
+        return;
+    }
+
+    /* find the longest length, and copy the counts for tracking */
+    max = 0;
+    for (len = 1; len <= MAXBITS; len++) {
+        left[len] = p->count[len];
+        if (left[len])
+            max = len;
+    }
+
+    /* fill in the tables in canonical code order */
+    code = 0;
+    index = 0;
+    next = 1U << ROOTBITS;
+    root = (unsigned)0 - 1;
+    here.sub = 0;
+    for (len = 1; len <= max; len++)
+        for (k = p->count[len]; k; k--) {
+            here.val = p->symbol[index++];
+            here.bits = len;
+            if (len <= ROOTBITS)
+                /* replicate in the first-level table */
+                for (n = code; n < (1U << ROOTBITS); n += 1U << len)
+                    p->table[n] = here;
+            else {
+                /* start a new second-level table if the prefix changed, with
+                   enough index bits to cover the longest code that shares the
+                   prefix */
+                if ((code & ((1U << ROOTBITS) - 1)) != root) {
+                    int32_t avail;
+
+                    root = code & ((1U << ROOTBITS) - 1);
+                    sub = len - ROOTBITS;
+                    avail = (int32_t)1 << sub;
+                    while (sub + ROOTBITS < max) {
+                        avail -= left[sub + ROOTBITS];
+                        if (avail <= 0)
+                            break;
+                        sub++;
+                        avail <<= 1;
+                    }
+                    base = next;
+                    next += 1U << sub;
+                    assert(next <= ENOUGH);
+                    p->table[root].val = base;
+                    p->table[root].bits = ROOTBITS;
+                    p->table[root].sub = sub;
+                }
+
+                /* replicate in the second-level table */
+                for (n = code >> ROOTBITS; n < (1U << sub);
+                     n += 1U << (len - ROOTBITS))
+                    p->table[base + n] = here;
+            }
+            left[len]--;
+
+            /* increment the bit-reversed code */
+            bit = 1U << len;
+            while (bit >>= 1) {
+                code ^= bit;
+                if (code & bit)
+                    break;
+            }
+        }
+}
+
+/*
+ * Return the lookup table entry in p for code, where only the low bits of
+ * code are known and the rest are zeros.  The entry is valid only if its
+ * bits is no more than the number of known bits.
+ */
+local entry_t const *entry(prefix_t const *p, unsigned code)
+{
+    entry_t const *here;
+
+    here = p->table + (code & ((1U << ROOTBITS) - 1));
+    if (here->sub)
+        here = p->table + here->val +
+               ((code >> ROOTBITS) & ((1U << here->sub) - 1));
+    return here;
+}
 
-    while (code >= first + (count = p->count[len]) && ++len <= MAXBITS) {
-        index += count;                     /* update symbol index for len */
-        first = (first + count) << 1;       /* update first code for len */
-        code = (code << 1) | bits(s, 1);    /* get next bit */
+/*
+ * Build the joint table pair[0..(1 << PAIRBITS) - 1] for the literal code p.
+ * Each entry is indexed by PAIRBITS bits as they appear in the stream, and
+ * holds the two literals that those bits start with, if the codes for both
+ * fit.  This is built from the ordinary lookup tables in p, looking up the
+ * first literal with the index bits, and then the second literal with the
+ * bits that remain after the first code.
+ */
+local void pairs(prefix_t const *p, pair_t *pair)
+{
+    unsigned code;                  /* PAIRBITS bits of input */
+    entry_t const *one, *two;       /* entries for the two literals */
+
+    for (code = 0; code < (1U << PAIRBITS); code++) {
+        one = entry(p, code);
+        two = entry(p, code >> one->bits);
+        if (one->bits + two->bits <= PAIRBITS) {
+            pair[code].lit[0] = one->val;
+            pair[code].lit[1] = two->val;
+            pair[code].first = one->bits;
+            pair[code].bits = one->bits + two->bits;
+        }
+        else
+            pair[code].bits = NOPAIR;
     }
-    assert(len <= MAXBITS);
-    return p->symbol[index + code - first];
 }
 
 /*
@@ -250,7 +740,7 @@ local void construct(prefix_t *p, unsigned char const *length, unsigned n)
     unsigned slen;                  /* number of bits for this symbol */
     unsigned short offs[MAXBITS+1]; /* symbol offsets for each length */
 
-    assert(n < MAXSYMS);
+    assert(n <= MAXSYMS);
 
     /* count the number of codes of each non-zero length */
     for (len = 0; len <= MAXBITS; len++)
@@ -275,6 +765,9 @@ local void construct(prefix_t *p, unsigned char const *length, unsigned n)
         if (slen)
             p->symbol[offs[slen]++] = symbol;
     }
+
+    /* make the lookup tables for decoding */
+    lookup(p);
 }
 
 /*
@@ -345,6 +838,68 @@ local void simple(prefix_t *p, unsigned short const *syms, unsigned type)
             p->count[3] = 2;
             ORDER(p->symbol, 2, 3);
     }
+
+    /* make the lookup tables for decoding */
+    lookup(p);
+}
+
+/*
+ * Order of the code length code lengths in a complex prefix code description.
+ */
+local unsigned char const order[] = {
+    1, 2, 3, 4, 0, 5, 17, 6, 16, 7, 8, 9, 10, 11, 12, 13, 14, 15
+};
+#define CODE_LENGTH_CODES (sizeof(order) / sizeof(order[0]))
+
+/*
+ * Lookup table for the fixed code used to code the code length code lengths,
+ * indexed by the next four bits of input.  This is the code with lengths 2, 4,
+ * 3, 2, 2, 4 for the symbols 0..5.
+ */
+local entry_t const clc[16] = {
+    {0, 2, 0}, {4, 2, 0}, {3, 2, 0}, {2, 3, 0},
+    {0, 2, 0}, {4, 2, 0}, {3, 2, 0}, {1, 4, 0},
+    {0, 2, 0}, {4, 2, 0}, {3, 2, 0}, {2, 3, 0},
+    {0, 2, 0}, {4, 2, 0}, {3, 2, 0}, {5, 4, 0}
+};
+
+/*
+ * Number of bits used to index the lookup table for a code length code, which
+ * is the maximum length of a code length code.
+ */
+#define CLBITS 5
+
+/*
+ * Make the single-level lookup table for the code length code with the code
+ * lengths lens[0..CODE_LENGTH_CODES-1], which must be a complete code with
+ * more than one symbol.  This is much less work than construct() for such a
+ * small code, and is done for every complex prefix code description.
+ */
+local void code_table(entry_t *table, unsigned char const *lens)
+{
+    unsigned len;           /* code length */
+    unsigned sym;           /* symbol */
+    unsigned code;          /* bit-reversed canonical code */
+    unsigned bit;           /* bit to increment in the reversed code */
+    unsigned n;
+
+    code = 0;
+    for (len = 1; len <= CLBITS; len++)
+        for (sym = 0; sym < CODE_LENGTH_CODES; sym++)
+            if (lens[sym] == len) {
+                /* replicate the entry for all of the bits above the code */
+                for (n = code; n < 1 << CLBITS; n += 1 << len) {
+                    table[n].val = sym;
+                    table[n].bits = len;
+                    table[n].sub = 0;
+                }
+
+                /* increment the bit-reversed code of length len */
+                bit = 1 << (len - 1);
+                while (code & bit)
+                    bit >>= 1;
+                code = bit ? (code & (bit - 1)) + bit : 0;
+            }
 }
 
 /*
@@ -367,6 +922,7 @@ local void prefix(state_t *s, prefix_t *p, unsigned num)
 
     /* number of leading code length code lengths to skip, or 1 for simple */
     hskip = bits(s, 2);
+    tally(s->block.prefix_codes++);
 
     /* simple prefix code */
     if (hskip == 1) {
@@ -399,7 +955,7 @@ local void prefix(state_t *s, prefix_t *p, unsigned num)
             nsym += bits(s, 1);
 
         /* generate the simple code */
-        simple(p, syms, nsym);
+        timed(s, simple(p, syms, nsym));
     }
 
     /* complex prefix code */
@@ -411,15 +967,8 @@ local void prefix(state_t *s, prefix_t *p, unsigned num)
         unsigned zeros;         /* number of times to repeat zero */
         unsigned n;
 
-        /* order of code length code lengths */
-        unsigned short const order[] = {
-            1, 2, 3, 4, 0, 5, 17, 6, 16, 7, 8, 9, 10, 11, 12, 13, 14, 15
-        };
-#       define CODE_LENGTH_CODES (sizeof(order) / sizeof(unsigned short))
-
-        /* initially the code for code length code lengths, then reused for
-           the code lengths code */
-        prefix_t code = {{0, 0, 3, 1, 2}, {0, 3, 4, 2, 1, 5}};
+        entry_t const *here;    /* table entry for the next bits */
+        entry_t code[1 << CLBITS];  /* table for the code lengths code */
 
         /* lengths read for the code lengths code, then reused for the code */
         unsigned char lens[num < CODE_LENGTH_CODES ? CODE_LENGTH_CODES : num];
@@ -427,15 +976,17 @@ local void prefix(state_t *s, prefix_t *p, unsigned num)
         trace(4, "  complex prefix code (skip %u)", hskip);
 
         /* read the code length code lengths using the fixed code length code
-           lengths code above, and make the code length code for reading the
-           code lengths (seriously) */
+           lengths code in clc[], and make the code length code for reading
+           the code lengths (seriously) */
         left = 1 << 5;                  /* 5 is the max length (see code) */
         nsym = 0;
         rep = 0;                        /* count of non-zero lengths */
         while (nsym < hskip)
             lens[order[nsym++]] = 0;
         while (nsym < CODE_LENGTH_CODES) {
-            len = decode(s, &code);
+            here = clc + peek(s, 4);
+            eat(s, here->bits);
+            len = here->val;
             n = order[nsym++];
             trace(5, "  (%u,%u)", n, len);
             lens[n] = len;
@@ -453,12 +1004,13 @@ local void prefix(state_t *s, prefix_t *p, unsigned num)
             throw(3, "incomplete code length code");
         while (nsym < CODE_LENGTH_CODES)
             lens[order[nsym++]] = 0;
-        if (left) {                     /* special case for one symbol */
-            code.symbol[0] = last;
-            code.count[0] = 1;
-        }
+        if (left)                       /* special case for one symbol */
+            for (n = 0; n < 1 << CLBITS; n++) {
+                code[n].val = last;
+                code[n].bits = 0;
+            }
         else
-            construct(&code, lens, nsym);
+            timed(s, code_table(code, lens));
 
         /* read the code lengths */
         left = (int32_t)1 << MAXBITS;
@@ -467,7 +1019,9 @@ local void prefix(state_t *s, prefix_t *p, unsigned num)
         zeros = 0;
         nsym = 0;
         do {
-            len = decode(s, &code);
+            here = code + peek(s, CLBITS);
+            eat(s, here->bits);
+            len = here->val;
             if (len < 16) {
                 /* not coded (0), or a code length in 1..15 -- only update last
                    if the length is not zero */
@@ -492,9 +1046,8 @@ local void prefix(state_t *s, prefix_t *p, unsigned num)
                 left -= n * (((int32_t)1 << MAXBITS) >> last);
                 if (left < 0)
                     break;
-                do {
-                    lens[nsym++] = last;
-                } while (--n);
+                memset(lens + nsym, last, n);
+                nsym += n;
                 zeros = 0;
             }
             else {  /* len == 17 */
@@ -506,9 +1059,8 @@ local void prefix(state_t *s, prefix_t *p, unsigned num)
                 n = zeros - n;
                 if (nsym + n > num)
                     throw(3, "too many repeats");
-                do {
-                    lens[nsym++] = 0;
-                } while (--n);
+                memset(lens + nsym, 0, n);
+                nsym += n;
                 rep = 0;
             }
         } while (left > 0 && nsym < num);
@@ -518,8 +1070,7 @@ local void prefix(state_t *s, prefix_t *p, unsigned num)
             throw(3, "oversubscribed code");
 
         /* make the code */
-        construct(p, lens, nsym);
-#       undef CODE_LENGTH_CODES
+        timed(s, construct(p, lens, nsym));
     }
 
 #ifdef DEBUG
@@ -544,6 +1095,20 @@ local void prefix(state_t *s, prefix_t *p, unsigned num)
 /* The number of block length codes. */
 #define BLOCK_LENGTH_CODES 26
 
+/*
+ * Base value and number of extra bits to add to the base value for each block
+ * length code, together so that a code needs one lookup.
+ */
+local struct {
+    unsigned short base;
+    unsigned char extra;
+} const block_code[BLOCK_LENGTH_CODES] = {
+    {1, 2}, {5, 2}, {9, 2}, {13, 2}, {17, 3}, {25, 3}, {33, 3}, {41, 3},
+    {49, 4}, {65, 4}, {81, 4}, {97, 4}, {113, 5}, {145, 5}, {177, 5}, {209, 5},
+    {241, 6}, {305, 6}, {369, 7}, {497, 8}, {753, 9}, {1265, 10}, {2289, 11},
+    {4337, 12}, {8433, 13}, {16625, 24}
+};
+
 /*
  * Get a block length.
  */
@@ -551,19 +1116,9 @@ local size_t block_length(state_t *s, prefix_t *p)
 {
     unsigned sym;               /* block length symbol */
 
-    /* base value and number of extra bits to add to base value */
-    unsigned short const base[] = {
-        1, 5, 9, 13, 17, 25, 33, 41, 49, 65, 81, 97, 113, 145, 177, 209, 241,
-        305, 369, 497, 753, 1265, 2289, 4337, 8433, 16625
-    };
-    unsigned char const extra[] = {
-        2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 7, 8, 9, 10, 11,
-        12, 13, 24
-    };
-
     sym = decode(s, p);
     assert(sym < BLOCK_LENGTH_CODES);
-    return (size_t)base[sym] + bits(s, extra[sym]);
+    return (size_t)block_code[sym].base + bits(s, block_code[sym].extra);
 }
 
 /*
@@ -615,9 +1170,8 @@ local void context_map(state_t *s, unsigned char *map, size_t len,
             if (n + zeros > len)
                 throw(3, "run length too long");
             trace(5, "  %zu 0's (have %zu)", zeros, n + zeros);
-            do {
-                map[n++] = 0;
-            } while (--zeros);
+            memset(map + n, 0, zeros);
+            n += zeros;
         }
         else {
             map[n++] = sym - rlemax;
@@ -625,7 +1179,9 @@ local void context_map(state_t *s, unsigned char *map, size_t len,
         }
     } while (n < len);
 
-    /* do an inverse move-to-front transform if requested */
+    /* do an inverse move-to-front transform if requested -- most of the
+       symbols are usually zero, which leave the table as is, and the others
+       move the front of the table up with a memmove() */
     if (bits(s, 1)) {
         unsigned char table[trees];
 
@@ -635,152 +1191,122 @@ local void context_map(state_t *s, unsigned char *map, size_t len,
         for (n = 0; n < len; n++) {
             sym = map[n];
             assert(sym < trees);
-            map[n] = table[sym];
             if (sym) {
-                do {
-                    table[sym] = table[sym - 1];
-                } while (--sym);
+                map[n] = table[sym];
+                memmove(table + 1, table, sym);
                 table[0] = map[n];
             }
+            else
+                map[n] = table[0];
         }
     }
 }
 
 /*
- * Get an insert length given the insert and copy symbol (0..703).
- */
-local size_t insert_length(state_t *s, unsigned sym)
-{
-    /* map from insert and copy to insert symbol base */
-    unsigned char const map[] = {0, 0, 0, 0, 8, 8, 0, 16, 8, 16, 16};
-
-    /* base value and number of extra bits to add to base value */
-    unsigned short const base[] = {
-        0, 1, 2, 3, 4, 5, 6, 8, 10, 14, 18, 26, 34, 50, 66, 98, 130, 194, 322,
-        578, 1090, 2114, 6210, 22594
-    };
-    unsigned char const extra[] = {
-        0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 7, 8, 9, 10, 12, 14,
-        24
-    };
-
-    assert(sym < MAXIACS);
-    sym = map[sym >> 6] + ((sym >> 3) & 7);
-    return (size_t)base[sym] + bits(s, extra[sym]);
-}
-
-/*
- * Get a copy length given the insert and copy symbol (0..703).
- */
-local size_t copy_length(state_t *s, unsigned sym)
-{
-    /* map from insert and copy to copy symbol base */
-    unsigned char const map[] = {0, 8, 0, 8, 0, 8, 16, 0, 16, 8, 16};
-
-    /* base value and number of extra bits to add to base value */
-    unsigned short const base[] = {
-        2, 3, 4, 5, 6, 7, 8, 9, 10, 12, 14, 18, 22, 30, 38, 54, 70, 102, 134,
-        198, 326, 582, 1094, 2118
-    };
-    unsigned char const extra[] = {
-        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 7, 8, 9, 10,
-        24
-    };
-
-    assert(sym < MAXIACS);
-    sym = map[sym >> 6] + (sym & 7);
-    return (size_t)base[sym] + bits(s, extra[sym]);
-}
-
-/*
- * Return the context ID in 0..63, given the last two bytes and the mode.
- */
-local unsigned context_id(unsigned p1, unsigned p2, unsigned mode)
-{
-    unsigned char const lut0[] = {
-        0,  0,  0,  0,  0,  0,  0,  0,  0,  4,  4,  0,  0,  4,  0,  0, 0,  0,
-        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 8, 12, 16, 12,
-        12, 20, 12, 16, 24, 28, 12, 12, 32, 12, 36, 12, 44, 44, 44, 44, 44, 44,
-        44, 44, 44, 44, 32, 32, 24, 40, 28, 12, 12, 48, 52, 52, 52, 48, 52, 52,
-        52, 48, 52, 52, 52, 52, 52, 48, 52, 52, 52, 52, 52, 48, 52, 52, 52, 52,
-        52, 24, 12, 28, 12, 12, 12, 56, 60, 60, 60, 56, 60, 60, 60, 56, 60, 60,
-        60, 60, 60, 56, 60, 60, 60, 60, 60, 56, 60, 60, 60, 60, 60, 24, 12, 28,
-        12,  0, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0,
-        1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0,
-        1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 3, 2, 3, 2,
-        3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2,
-        3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2,
-        3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3
-    };
-    unsigned char const lut1[] = {
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2,
-        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1,
-        1, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
-        3, 3, 3, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
-        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2
-    };
-    unsigned char const lut2[] = {
-        0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2,
-        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
-        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3,
-        3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
-        3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
-        3, 3, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-        5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
-        5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
-        6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 7
-    };
-
-    assert(p1 < 256 && p2 < 256);
-    switch (mode) {
-        case 0:         /* LSB6 */
-            return p1 & 0x3f;
-        case 1:         /* MSB6 */
-            return p1 >> 2;
-        case 2:         /* UTF8 */
-            return lut0[p1] | lut1[p2];
-        case 3:         /* Signed */
-            return (lut2[p1] << 3) | lut2[p2];
-        default:
-            assert(0);
+ * Insert and copy command table, command_t const command[MAXIACS].  For each
+ * insert and copy symbol, this has the insert length base and number of extra
+ * bits, the copy length base and number of extra bits, and whether the last
+ * distance is used instead of a distance code.  The insert extra bits come
+ * first in the stream, immediately followed by the copy extra bits, so both
+ * are read with one wide() of up to 48 bits.
+ *
+ * Format note:
+ *
+ * - The symbol is split into eleven blocks of 64.  Block k has insert codes
+ *   starting at {0, 0, 0, 0, 8, 8, 0, 16, 8, 16, 16}[k] and copy codes
+ *   starting at {0, 8, 0, 8, 0, 8, 16, 0, 16, 8, 16}[k], with bits 5..3 of the
+ *   symbol added to the insert code and bits 2..0 added to the copy code.  The
+ *   first two blocks use the last distance, with no distance code.
+ *
+ * - The insert codes 0..23 have base values 0, 1, 2, 3, 4, 5, 6, 8, 10, 14,
+ *   18, 26, 34, 50, 66, 98, 130, 194, 322, 578, 1090, 2114, 6210, 22594 with
+ *   extra bits 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 7, 8, 9, 10,
+ *   12, 14, 24.  The copy codes 0..23 have base values 2, 3, 4, 5, 6, 7, 8, 9,
+ *   10, 12, 14, 18, 22, 30, 38, 54, 70, 102, 134, 198, 326, 582, 1094, 2118
+ *   with extra bits 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+ *   7, 8, 9, 10, 24.
+ */
+typedef struct {
+    unsigned short insert;      /* insert length base */
+    unsigned short copy;        /* copy length base */
+    unsigned char ibits;        /* insert length extra bits */
+    unsigned char cbits;        /* copy length extra bits */
+    unsigned char last;         /* true to use the last distance */
+} command_t;
+#include "command.h"
+
+/*
+ * Literal context lookup table, unsigned char const context[4][512].  For
+ * context mode m and the last two bytes p1 and p2, the context ID in 0..63 is
+ * context[m][p1] | context[m][256 + p2].
+ *
+ * Format note:
+ *
+ * - The context modes are LSB6 (p1 & 0x3f), MSB6 (p1 >> 2), UTF8 (lut0[p1] |
+ *   lut1[p2]), and Signed ((lut2[p1] << 3) | lut2[p2]), where lut0, lut1, and
+ *   lut2 are the tables given in the specification.  Each mode is flattened
+ *   into one row, so that the mode is chosen once per literal type, and a
+ *   context ID is then two loads and an or, with no branches.
+ */
+#include "context.h"
+
+/*
+ * Fill in the distance base values and extra bits in s->dist_base[] and
+ * s->dist_extra[] for the distance symbols 16..dists-1, given s->postfix and
+ * s->direct.  The tables are only rebuilt when those parameters change.
+ *
+ * Format note:
+ *
+ * - Symbols 16..15+NDIRECT are the distances 1..NDIRECT with no extra bits.
+ *   The remaining symbols, numbered n from zero, have 1 + (n >> (NPOSTFIX +
+ *   1)) extra bits, and the distance is ((offset + extra) << NPOSTFIX) + (n &
+ *   ((1 << NPOSTFIX) - 1)) + NDIRECT + 1, where offset is ((2 + ((n >>
+ *   NPOSTFIX) & 1)) << bits) - 4.  Since only the extra bits come from the
+ *   stream, everything else is folded into the base.
+ */
+local void distances(state_t *s, unsigned dists)
+{
+    unsigned sym, n, x;
+    unsigned key = (s->postfix << 8) | s->direct;
+
+    if (s->dist_key == key)
+        return;
+    s->dist_key = key;
+    for (sym = 16; sym < 16U + s->direct; sym++) {
+        s->dist_base[sym] = sym - 15;
+        s->dist_extra[sym] = 0;
+    }
+    for (; sym < dists; sym++) {
+        n = sym - s->direct - 16;
+        x = 1 + (n >> (s->postfix + 1));
+        s->dist_base[sym] =
+            ((((2 + ((n >> s->postfix) & 1)) << x) - 4) << s->postfix) +
+            (n & ((1U << s->postfix) - 1)) + s->direct + 1;
+        s->dist_extra[sym] = x;
     }
 }
 
+/* Last distance index back and delta for distance symbols 0..15. */
+local unsigned char const ring_back[] = {
+    0, 1, 2, 3, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1
+};
+local signed char const ring_delta[] = {
+    0, 0, 0, 0, -1, 1, -2, 2, -3, 3, -1, 1, -2, 2, -3, 3
+};
+
 /*
  * Get a distance given the distance symbol.  Do not update ring buffer if the
  * distance is greater than max.
  */
 local size_t distance(state_t *s, unsigned sym, size_t max)
 {
-    size_t dist, off;
-    unsigned n, x;
-    unsigned char const back[] = {
-        0, 1, 2, 3, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1
-    };
-    signed char const delta[] = {
-        0, 0, 0, 0, -1, 1, -2, 2, -3, 3, -1, 1, -2, 2, -3, 3
-    };
+    size_t dist;
 
     if (sym < 16)
-        dist = s->ring[(s->ring_ptr - back[sym]) & 3] + delta[sym];
-    else if (sym < 16 + s->direct)
-        dist = sym - 15;
-    else {
-        n = sym - s->direct - 16;
-        x = 1 + (n >> (s->postfix + 1));
-        off = ((2 + ((n >> s->postfix) & 1)) << x) - 4;
-        dist = ((off + bits(s, x)) << s->postfix) +
-               (n & ((1U << s->postfix) - 1)) +
-               s->direct + 1;
-    }
+        dist = s->ring[(s->ring_ptr - ring_back[sym]) & 3] + ring_delta[sym];
+    else
+        dist = s->dist_base[sym] +
+               ((size_t)bits(s, s->dist_extra[sym]) << s->postfix);
     if (sym && dist <= max) {
         s->ring_ptr = (s->ring_ptr + 1) & 3;
         s->ring[s->ring_ptr] = dist;
@@ -788,22 +1314,6 @@ local size_t distance(state_t *s, unsigned sym, size_t max)
     return dist;
 }
 
-/* Elementary transform function type.  These transform the input
-   word[0..len-1] and put the result at *dest.  The omit functions take the
-   omit parameter as the number of bytes to omit from the front or the back.
-   Otherwise omit must be zero. */
-typedef size_t (*xelem_t)(unsigned char *dest, unsigned char const *word,
-                          size_t len, unsigned omit);
-
-/* Elementary transforms. */
-local size_t identity(unsigned char *dest, unsigned char const *word,
-                      size_t len, unsigned omit)
-{
-    assert(omit == 0);
-    memcpy(dest, word, len);
-    return len;
-}
-
 /* Convert one UTF-8 character at *word to uppercase, per the brotli spec,
    copying to *dest.  Do not use more than len bytes from *word. */
 #define UPPER() \
@@ -826,71 +1336,52 @@ local size_t identity(unsigned char *dest, unsigned char const *word,
         } \
     } while (0)
 
-local size_t uppercasefirst(unsigned char *dest, unsigned char const *word,
-                            size_t len, unsigned omit)
+/* Copy word[0..len-1] to dest[0..len-1], converting the first character to
+   uppercase. */
+local void uppercasefirst(unsigned char *dest, unsigned char const *word,
+                          size_t len)
 {
-    size_t n;
-
-    assert(omit == 0);
     if (len == 0)
-        return 0;
-    n = len;
+        return;
     UPPER();
     memcpy(dest, word, len);
-    return n;
 }
 
-local size_t uppercaseall(unsigned char *dest, unsigned char const *word,
-                          size_t len, unsigned omit)
+/* Copy word[0..len-1] to dest[0..len-1], converting all of the characters to
+   uppercase. */
+local void uppercaseall(unsigned char *dest, unsigned char const *word,
+                        size_t len)
 {
-    size_t n;
-
-    assert(omit == 0);
-    if (len == 0)
-        return 0;
-    n = len;
-    do {
+    while (len)
         UPPER();
-    } while (len);
-    return n;
-}
-
-local size_t omitfirst(unsigned char *dest, unsigned char const *word,
-                       size_t len, unsigned omit)
-{
-    assert(omit > 0);
-    if (len <= omit)
-        return 0;
-    word += omit;
-    len -= omit;
-    memcpy(dest, word, len);
-    return len;
-}
-
-local size_t omitlast(unsigned char *dest, unsigned char const *word,
-                      size_t len, unsigned omit)
-{
-    assert(omit > 0);
-    if (len <= omit)
-        return 0;
-    len -= omit;
-    memcpy(dest, word, len);
-    return len;
 }
 
-/* Transform description. */
+/* Elementary transforms. */
+#define IDENTITY 0
+#define OMITFIRST 1
+#define OMITLAST 2
+#define UPPERFIRST 3
+#define UPPERALL 4
+
+/* Transform description, with the lengths of the prefix and suffix so that
+   they can be copied without looking for the ends of the strings. */
 typedef struct {
-    char *prefix;           /* prefix string */
-    xelem_t xelem;          /* elementary transformation function */
-    unsigned omit;          /* count for omit functions */
-    char *suffix;           /* suffix string */
-} xform_t;
+    unsigned char kind;     /* elementary transform */
+    unsigned char omit;     /* bytes to omit for OMITFIRST and OMITLAST */
+    unsigned char plen;     /* length of prefix (0..5) */
+    unsigned char slen;     /* length of suffix (0..8) */
+    char prefix[6];         /* prefix string */
+    char suffix[9];         /* suffix string */
+} transform_t;
 
-/* Transform descriptions, xform_t xforms[121]. */
-#include "xforms.h"
+/*
+ * Transform descriptions, transform_t const transform[121], generated from the
+ * specification's list in xforms.h.
+ */
+#include "transform.h"
 
 /* Number of possible transforms (should be 121). */
-#define NTRANSFORMS (sizeof(xforms) / sizeof(xform_t))
+#define NTRANSFORMS (sizeof(transform) / sizeof(transform_t))
 
 /* Brotli static dictionary: unsigned char dict[122784]. */
 #include "dict.h"
@@ -900,23 +1391,36 @@ typedef struct {
    length is 8. */
 #define XMAX (5+24+8)
 
+/* Offset of the words of each length in the dictionary, and the number of
+   bits in the index of the words of each length. */
+local uint32_t const doffset[] = {                      /* DOFFSET */
+    0, 0, 0, 0, 0, 4096, 9216, 21504, 35840, 44032, 53248, 63488, 74752,
+    87040, 93696, 100864, 104704, 106752, 108928, 113536, 115968, 118528,
+    119872, 121280, 122016
+};
+local unsigned char const ndbits[] = {                  /* NDBITS */
+    0, 0, 0, 0, 10, 10, 11, 11, 10, 10, 10, 10, 10, 9, 9, 8, 7, 7, 8, 7, 7,
+    6, 6, 5, 5
+};
+
 /*
- * Get and transform a static dictionary word and put the result in
- * dest[0..XMAX-1].  copy is the length, and id is the excess distance. The
- * number of bytes written to dest is returned.
+ * Get and transform a static dictionary word and put the result in dest[].
+ * copy is the length, and id is the excess distance.  room is the number of
+ * bytes permitted in the result, which is checked before anything is written
+ * to dest.  The number of bytes written to dest is returned.  The untransformed
+ * word, the most common case, is copied directly from the dictionary.  s is
+ * the decoding state, used only for tracing.
  */
-local size_t dict_word(unsigned char *dest, size_t copy, size_t id)
+local size_t dict_word(state_t *s, unsigned char *dest, size_t copy,
+                       size_t id, size_t room)
 {
-    size_t index, xform, got;
-    uint32_t const doffset[] = {                        /* DOFFSET */
-        0, 0, 0, 0, 0, 4096, 9216, 21504, 35840, 44032, 53248, 63488, 74752,
-        87040, 93696, 100864, 104704, 106752, 108928, 113536, 115968, 118528,
-        119872, 121280, 122016
-    };
-    unsigned char const ndbits[] = {                    /* NDBITS */
-        0, 0, 0, 0, 10, 10, 11, 11, 10, 10, 10, 10, 10, 9, 9, 8, 7, 7, 8, 7, 7,
-        6, 6, 5, 5
-    };
+    size_t index, xform, len, skip, got;
+    unsigned char const *word;
+    transform_t const *xf;
+
+#ifndef DEBUG
+    (void)s;
+#endif
 
     if (copy > 24)
         throw(3, "static dictionary word length > 24");
@@ -930,58 +1434,508 @@ local size_t dict_word(unsigned char *dest, size_t copy, size_t id)
         throw(3, "static dictionary transform out of range");
     trace(4, "static dictionary index %zu, length %zu, transform %zu",
           index, copy, xform);
-    index = doffset[copy] + index * copy;
-
-    /* prefix */
-    got = identity(dest, (unsigned char *)xforms[xform].prefix,
-                   strlen(xforms[xform].prefix), 0);
-
-    /* transform word from dictionary */
-    got += xforms[xform].xelem(dest + got, dict + index, copy,
-                               xforms[xform].omit);
-
-    /* suffix */
-    got += identity(dest + got, (unsigned char *)xforms[xform].suffix,
-                    strlen(xforms[xform].suffix), 0);
+    word = dict + doffset[copy] + index * copy;
+
+    /* just the word */
+    if (xform == 0) {
+        if (copy > room)
+            throw(3, "mlen exceeded by dictionary word length");
+        memcpy(dest, word, copy);
+        return copy;
+    }
 
-    /* return bytes written to dest */
+    /* get the length of the transformed word */
+    xf = transform + xform;
+    len = copy;
+    if (xf->kind == OMITFIRST) {
+        skip = xf->omit < len ? xf->omit : len;
+        word += skip;
+        len -= skip;
+    }
+    else if (xf->kind == OMITLAST)
+        len -= xf->omit < len ? xf->omit : len;
+    got = xf->plen + len + xf->slen;
+    if (got > room)
+        throw(3, "mlen exceeded by dictionary word length");
+
+    /* write the prefix, transformed word, and suffix */
+    memcpy(dest, xf->prefix, xf->plen);
+    dest += xf->plen;
+    if (xf->kind == UPPERFIRST)
+        uppercasefirst(dest, word, len);
+    else if (xf->kind == UPPERALL)
+        uppercaseall(dest, word, len);
+    else
+        memcpy(dest, word, len);
+    memcpy(dest + len, xf->suffix, xf->slen);
     return got;
 }
 
 /*
- * Decompress one meta-block.  Return true if this is the last meta-block.
- *
- * Format notes:
- *
- * - The meta-block data (what follows the meta-block header) is one or more
- *   sets of: insert and copy lengths, literals to insert, and a distance.
- *   Once the distance is read, output is copied from the previous output or
- *   the static dictionary (possibly transformed).  So for each set, output is
- *   generated from a string of literals and one copy operation.  The
- *   meta-block is deemed complete when the total number of uncompressed bytes
- *   has been generated (MLEN), either at the end of the insertion of the
- *   literals or after the copy operation.  If MLEN is reached after the
- *   insertion of the literals, then a distance is not read, and the copy
- *   length is ignored.
+ * Width in bytes of the pieces used to copy strings from previous output, and
+ * the number of bytes of slack allocated past the end of the output so that
+ * the last piece of a string copy can be written whole, even if it runs past
+ * the end of the string.  Bytes written past the end are overwritten by the
+ * output that follows.
+ */
+#define WIDE 16
+#define SLACK WIDE
+
+/*
+ * Copy len bytes starting dist bytes back from to, where the source and
+ * destination can overlap, i.e. dist can be less than len.  Up to WIDE - 1
+ * bytes past to[len - 1] may be written.
  *
- * - MLEN must be reached exactly at one of those points.  If MLEN is exceeded
- *   during the insertion of literals or during the copy operation, then the
- *   stream is invalid.
+ * When dist is less than WIDE, the dist bytes before to are written out as a
+ * repeating pattern, each time doubling the number of bytes between the
+ * source and destination, until that distance is at least WIDE.  Then the
+ * copy proceeds WIDE bytes at a time, where each piece does not overlap its
+ * source.  The fixed-size memcpy()'s are compiled into single wide loads and
+ * stores.
  */
-local unsigned metablock(state_t *s)
+local inline void back_copy(unsigned char *to, size_t dist, size_t len)
 {
-    unsigned last;              /* true if this is the last meta-block */
-    size_t mlen;                /* number of uncompressed bytes */
-    unsigned dists;             /* number of distance codes */
-    unsigned iac_sym;           /* insert and copy symbol */
-    size_t insert;              /* insertion length */
+    unsigned char const *from = to - dist;
+    unsigned char const *end = to + len;
+
+    if (dist == 0)          /* each byte is copied onto itself */
+        return;
+    while ((size_t)(to - from) < WIDE) {
+        size_t n = (size_t)(to - from);     /* bytes in the pattern */
+
+        memcpy(to, from, n);
+        to += n;
+        if (to >= end)
+            return;
+    }
+    do {
+        memcpy(to, from, WIDE);
+        to += WIDE;
+        from += WIDE;
+    } while (to < end);
+}
+
+/*
+ * Copy len bytes starting dist bytes back from to, one byte at a time, writing
+ * nothing past to[len - 1].  This is used instead of back_copy() when there is
+ * no slack after the output.
+ */
+local void back_exact(unsigned char *to, size_t dist, size_t len)
+{
+    while (len) {
+        *to = *(to - dist);
+        to++;
+        len--;
+    }
+}
+
+/*
+ * Compare the len bytes at to with what back_copy() would have written there,
+ * without writing anything.  Since to[] already holds the expected output,
+ * this is simply a comparison of to[0..len-1] with the bytes dist back, which
+ * memcmp() can do a word or vector at a time.  Return len if they match, or
+ * the offset of the first mismatch.
+ */
+local inline size_t back_cmp(unsigned char const *to, size_t dist, size_t len)
+{
+    size_t n = 0;
+
+    if (memcmp(to, to - dist, len) == 0)
+        return len;
+    while (to[n] == to[n - dist])
+        n++;
+    return n;
+}
+
+/*
+ * Give the output written since the last call to the check callback.  This is
+ * done every CHECKSPAN bytes or so while decoding, so that the callback sees
+ * the data while it is still in the cache.  When a meta-block is decoded
+ * again by yeast_feed(), the output up to s->checked is rewritten exactly as
+ * before, so only the output after that is given to the callback.
+ */
+#define CHECKSPAN 16384
+
+local void flush(state_t *s)
+{
+    if (s->check != NULL && s->got > s->checked) {
+        s->check(s->check_arg, s->dest + s->checked, s->got - s->checked);
+        s->checked = s->got;
+    }
+}
+
+/*
+ * Decode the meta-block data, generating mlen bytes of output, or comparing
+ * mlen bytes of output when cmp is true, or only checking the data and
+ * counting the output when measure is true.  This is written once and
+ * compiled three times, as data_write(), data_cmp(), and data_measure()
+ * below, where cmp and measure are constants in each.  That resolves all of
+ * the write, compare, or measure choices at compile time, leaving each loop
+ * free of branches on the mode.  s->data is set to one of the three at the
+ * start of the stream.
+ *
+ * When measuring, there is no output, so the last two bytes are taken to be
+ * zeros.  That is only correct when no literal type uses the literal context,
+ * which yeast_measure() checks before using data_measure().
+ */
+local FORCE_INLINE void data(state_t *s, size_t mlen, int const cmp,
+                             int const measure)
+{
+    command_t const *cmd;       /* insert and copy command */
+    uint64_t extra;             /* insert and copy extra bits */
+    size_t insert;              /* insertion length */
     size_t copy;                /* copy length */
     size_t dist;                /* copy distance */
     size_t max;                 /* maximum distance within sliding window */
+    size_t safe;                /* end of the output allowed for back_copy() */
     unsigned p1, p2;            /* last and second-to-last output bytes */
+    unsigned char const *lut;   /* context lookup for current literal type */
+    unsigned char const *map;   /* context map row for current literal type */
+    pair_t const *pair;         /* joint table for literal type, or NULL */
     unsigned n;                 /* general counter */
     unsigned char word[XMAX];   /* transformed word from static dictionary */
 
+    /* the last two bytes are kept in p1 and p2, and the context lookup, map
+       row, and joint table for the literal type in lut, map, and pair, from
+       here on */
+    p1 = !measure && s->got ? s->dest[s->got - 1] : 0;
+    p2 = !measure && s->got > 1 ? s->dest[s->got - 2] : 0;
+    lut = context[s->mode[s->lit_type]];
+    map = s->lit_map + (s->lit_type << 6);
+    pair = s->lit_pair[s->lit_type];
+
+    /* back_copy() can write past the end of a copy into the slack after the
+       output, but a caller's buffer has no slack -- copies ending within
+       SLACK of the end of a caller's buffer are done with back_exact() */
+    safe = !s->into ? s->size : s->size > SLACK ? s->size - SLACK : 0;
+    do {
+        /* get insert and copy lengths */
+        if (s->iac_left == 0) {
+            /* change to a new insert and copy type */
+            n = decode(s, &s->iac_types);
+            n = n > 1 ? n - 2 :
+                n ? (s->iac_type + 1) % s->iac_num :
+                s->iac_last;
+            s->iac_last = s->iac_type;
+            s->iac_type = n;
+            s->iac_left = block_length(s, &s->iac_count);
+            tally(s->block.iac_switches++);
+            trace(3, "change to iac type %u (%zu)",
+                  s->iac_type, s->iac_left);
+            assert(s->iac_left > 0);
+        }
+        s->iac_left--;
+        cmd = command + decode(s, s->iac_code + s->iac_type);
+        extra = wide(s, cmd->ibits + cmd->cbits);
+        insert = cmd->insert + (size_t)(extra & ((1U << cmd->ibits) - 1));
+        copy = cmd->copy + (size_t)(extra >> cmd->ibits);
+        tally(s->block.commands++);
+
+        /* insert literals */
+        trace(3, "insert %zu literal%s", PLURAL(insert));
+        if (insert > mlen)
+            throw(3, "mlen exceeded by insert length");
+        mlen -= insert;
+        tally(s->block.literal_bytes += insert);
+        while (insert) {
+            if (s->lit_left == 0) {
+                /* change to a new literal type */
+                n = decode(s, &s->lit_types);
+                n = n > 1 ? n - 2 :
+                    n ? (s->lit_type + 1) % s->lit_num :
+                    s->lit_last;
+                s->lit_last = s->lit_type;
+                s->lit_type = n;
+                s->lit_left = block_length(s, &s->lit_count);
+                tally(s->block.lit_switches++);
+                trace(3, "change to literal type %u (%zu)",
+                      s->lit_type, s->lit_left);
+                assert(s->lit_left > 0);
+                lut = context[s->mode[s->lit_type]];
+                map = s->lit_map + (s->lit_type << 6);
+                pair = s->lit_pair[s->lit_type];
+            }
+            if (pair != NULL && insert > 1 && s->lit_left > 1) {
+                /* try to get two literals with one lookup */
+                pair_t const *two = pair + peek(s, PAIRBITS);
+
+                if (two->bits != NOPAIR && s->left >= two->bits) {
+                    if (cmp) {
+                        eat(s, two->first);
+                        if (s->dest[s->got++] != two->lit[0])
+                            throw(4, "compare mismatch");
+                        eat(s, two->bits - two->first);
+                        if (s->dest[s->got++] != two->lit[1])
+                            throw(4, "compare mismatch");
+                    }
+                    else if (measure) {
+                        eat(s, two->bits);
+                        s->got += 2;
+                    }
+                    else {
+                        eat(s, two->bits);
+                        s->dest[s->got++] = two->lit[0];
+                        s->dest[s->got++] = two->lit[1];
+                    }
+                    p2 = two->lit[0];
+                    p1 = two->lit[1];
+                    s->lit_left -= 2;
+                    insert -= 2;
+                    continue;
+                }
+            }
+            s->lit_left--;
+            if (s->lit_codes > 1) {
+                n = map[lut[p1] | lut[256 + p2]];
+                assert(n < s->lit_codes);
+            }
+            else
+                n = 0;
+            n = decode(s, s->lit_code + n);
+            if (cmp) {
+                if (s->dest[s->got++] != n)
+                    throw(4, "compare mismatch");
+            }
+            else if (measure)
+                s->got++;
+            else
+                s->dest[s->got++] = n;
+            p2 = p1;
+            p1 = n;
+            insert--;
+        }
+
+        /* if reached mlen, then done (ignore copy length, even though it's not
+           zero) */
+        if (mlen == 0) {
+            trace(2, "unused copy length %zu at end of block", copy);
+            break;
+        }
+
+        /* get the copy distance */
+        max = s->got > s->wsize ? s->wsize : s->got;
+        if (cmd->last)
+            /* use the last distance */
+            dist = s->ring[s->ring_ptr];
+        else {
+            /* get the distance from the stream */
+            if (s->dist_left == 0) {
+                /* change to a new distance type */
+                n = decode(s, &s->dist_types);
+                n = n > 1 ? n - 2 :
+                    n ? (s->dist_type + 1) % s->dist_num :
+                    s->dist_last;
+                s->dist_last = s->dist_type;
+                s->dist_type = n;
+                s->dist_left = block_length(s, &s->dist_count);
+                tally(s->block.dist_switches++);
+                trace(3, "change to distance type %u (%zu)",
+                      s->dist_type, s->dist_left);
+                assert(s->dist_left > 0);
+            }
+            s->dist_left--;
+            if (s->dist_codes > 1) {
+                n = copy > 4 ? 3 : copy - 2;
+                n = s->dist_map[(s->dist_type << 2) + n];
+                assert(n < s->dist_codes);
+            }
+            else
+                n = 0;
+            dist = distance(s, decode(s, s->dist_code + n), max);
+        }
+
+        /* copy */
+        if (dist > max) {
+            /* dictionary copy, written directly to the output, or to word[]
+               to compare */
+            copy = dict_word(s, cmp || measure ? word : s->dest + s->got,
+                             copy, dist - max - 1, mlen);
+            trace(3, "copy %zu bytes from static dictionary", copy);
+            if (cmp && memcmp(s->dest + s->got, word, copy))
+                throw(4, "compare mismatch");
+            tally(s->block.dict_copies++, s->block.dict_bytes += copy);
+            s->got += copy;
+            mlen -= copy;
+            if (!measure) {
+                p1 = s->got ? s->dest[s->got - 1] : 0;
+                p2 = s->got > 1 ? s->dest[s->got - 2] : 0;
+            }
+        }
+        else {
+            /* copy from previously decompressed data */
+            trace(3, "copy %zu bytes from distance %zu", copy, dist);
+            if (copy > mlen)
+                throw(3, "mlen exceeded by copy length");
+            mlen -= copy;
+            tally(s->block.copies++, s->block.copy_bytes += copy,
+                  s->block.dist_hist[bucket(dist)]++,
+                  s->block.len_hist[bucket(copy)]++);
+            if (cmp) {
+                size_t n = back_cmp(s->dest + s->got, dist, copy);
+
+                s->got += n;
+                if (n < copy)
+                    throw(4, "compare mismatch");
+            }
+            else if (measure) {
+                /* no output to get the last two bytes from, or to check */
+                s->got += copy;
+                continue;
+            }
+            else {
+                if (s->got + copy <= safe)
+                    back_copy(s->dest + s->got, dist, copy);
+                else
+                    back_exact(s->dest + s->got, dist, copy);
+                s->got += copy;
+            }
+            p1 = s->dest[s->got - 1];       /* copy is at least two */
+            p2 = s->dest[s->got - 2];
+        }
+
+        /* check the output while it's hot */
+        if (!cmp && !measure && s->got - s->checked >= CHECKSPAN &&
+            s->check != NULL)
+            flush(s);
+    } while (mlen);
+}
+
+local void data_write(state_t *s, size_t mlen)
+{
+    data(s, mlen, 0, 0);
+}
+
+local void data_cmp(state_t *s, size_t mlen)
+{
+    data(s, mlen, 1, 0);
+}
+
+local void data_measure(state_t *s, size_t mlen)
+{
+    data(s, mlen, 0, 1);
+}
+
+/*
+ * Internal error code thrown when measuring without output, if a meta-block
+ * needs the output to decode its literals.
+ */
+#define OUTPUT 6
+
+/*
+ * Return true if the literal code for every literal type in the meta-block
+ * does not depend on the literal context, i.e. if there is just one literal
+ * code, or each type's row of the context map selects the same code for every
+ * context.
+ */
+local int context_free(state_t *s)
+{
+    unsigned type, k;
+    unsigned char const *row;
+
+    if (s->lit_codes == 1)
+        return 1;
+    for (type = 0; type < s->lit_num; type++) {
+        row = s->lit_map + (type << 6);
+        for (k = 1; k < 64; k++)
+            if (row[k] != row[0])
+                return 0;
+    }
+    return 1;
+}
+
+/*
+ * Set s->lit_pair[] for each literal type of the meta-block, building a joint
+ * table for each literal code that is the only one used by some literal type.
+ * That is the case for every type when there is just one literal code, or for
+ * a type whose row of the context map selects the same code for every
+ * context.  The next literal code for the other types depends on the literal
+ * just decoded, so their entries are NULL.  The joint tables are not built
+ * for meta-blocks too short to make up the time it takes to build them.
+ */
+local void joint(state_t *s, size_t mlen)
+{
+    unsigned type;                  /* literal type */
+    unsigned n, k;                  /* code, context index */
+    unsigned num = 0;               /* number of joint tables needed */
+    short code[256];                /* code for each type, or -1 */
+    short table[256];               /* joint table for each code, or -1 */
+    unsigned char const *row;       /* context map row for type */
+
+    /* find the types that use a single code, and the codes they use */
+    for (n = 0; n < s->lit_codes; n++)
+        table[n] = -1;
+    for (type = 0; type < s->lit_num; type++) {
+        code[type] = -1;
+        s->lit_pair[type] = NULL;
+        if (mlen < (1U << PAIRBITS))
+            continue;
+        n = 0;
+        if (s->lit_codes > 1) {
+            row = s->lit_map + (type << 6);
+            n = row[0];
+            for (k = 1; k < 64; k++)
+                if (row[k] != n)
+                    break;
+            if (k < 64)
+                continue;
+        }
+        code[type] = n;
+        if (table[n] == -1)
+            table[n] = num++;
+    }
+    if (num == 0)
+        return;
+
+    /* make room for the joint tables and build them */
+    if (num > s->pairs_num) {
+        s->pairs = alloc(s->pairs, (size_t)num * sizeof(pair_t) << PAIRBITS);
+        s->pairs_num = num;
+    }
+    for (n = 0; n < s->lit_codes; n++)
+        if (table[n] != -1)
+            pairs(s->lit_code + n, s->pairs + ((size_t)table[n] << PAIRBITS));
+    for (type = 0; type < s->lit_num; type++)
+        if (code[type] != -1)
+            s->lit_pair[type] = s->pairs +
+                                ((size_t)table[code[type]] << PAIRBITS);
+    trace(2, "%u joint literal table%s", PLURAL(num));
+}
+
+/*
+ * Decompress one meta-block.  Return true if this is the last meta-block.
+ *
+ * Format notes:
+ *
+ * - The meta-block data (what follows the meta-block header) is one or more
+ *   sets of: insert and copy lengths, literals to insert, and a distance.
+ *   Once the distance is read, output is copied from the previous output or
+ *   the static dictionary (possibly transformed).  So for each set, output is
+ *   generated from a string of literals and one copy operation.  The
+ *   meta-block is deemed complete when the total number of uncompressed bytes
+ *   has been generated (MLEN), either at the end of the insertion of the
+ *   literals or after the copy operation.  If MLEN is reached after the
+ *   insertion of the literals, then a distance is not read, and the copy
+ *   length is ignored.
+ *
+ * - MLEN must be reached exactly at one of those points.  If MLEN is exceeded
+ *   during the insertion of literals or during the copy operation, then the
+ *   stream is invalid.
+ */
+local unsigned metablock(state_t *s)
+{
+    unsigned last;              /* true if this is the last meta-block */
+    size_t mlen;                /* number of uncompressed bytes */
+    unsigned dists;             /* number of distance codes */
+    unsigned n;                 /* general counter */
+#ifdef YEAST_STATS
+    uint64_t start = UNREAD(s); /* unread bits at start of meta-block */
+    uint64_t mark;              /* unread bits at start of a section */
+    double began;               /* time at start of meta-block */
+
+    memset(&s->block, 0, sizeof(yeast_stats_t));
+    began = seconds();
+#endif
+
     /* read and process the meta-block header */
 
     /* get last marker, and check for empty block if last -- name changed to
@@ -993,8 +1947,10 @@ local unsigned metablock(state_t *s)
         if (bits(s, 1)) {                               /* ISLASTEMPTY */
             trace(1, "empty meta-block");
             trace(1, "end of last meta-block");
-            if (s->left && s->bits)
+            if (s->bits & ((1U << (s->left & 7)) - 1))
                 throw(3, "discarded bits after end of stream not zero");
+            s->kind = YEAST_EMPTY;
+            tally(s->block.empty = 1, block_done(s, start));
             return last;
         }
     }
@@ -1014,10 +1970,8 @@ local unsigned metablock(state_t *s)
             throw(3, "more metadata length bytes than needed");
 
         /* discard any leftover bits to go to byte boundary */
-        if (s->left && s->bits)
+        if (align(s))
             throw(3, "discarded bits before metadata not zero");
-        s->bits = 0;
-        s->left = 0;
 
         /* skip the metadata */
         if (mlen) {
@@ -1028,6 +1982,9 @@ local unsigned metablock(state_t *s)
         }
         trace(1, "empty meta-block with %zu byte%s of metadata", PLURAL(mlen));
         trace(1, "end of %smeta-block", last ? "last " : "");
+        s->kind = YEAST_EMPTY;
+        tally(s->block.empty = 1, s->block.data_bits = (uint64_t)mlen << 3,
+              block_done(s, start));
         return last;
     }
     mlen = 1 + bits(s, 16);                             /* MLEN low 4 nybs */
@@ -1037,38 +1994,62 @@ local unsigned metablock(state_t *s)
             throw(3, "more meta-block length nybbles than needed");
     }
     trace(1, "%zu byte%s to uncompress", PLURAL(mlen));
+    tally(s->block.bytes = mlen);
     if (s->got + mlen < s->got)
         throw(1, "output too large for size_t");
-    if (s->have || (s->got == 0 && s->dest != NULL)) {
+    if (s->cmp) {
         if (s->got + mlen > s->have)
             throw(4, "compare mismatch: result larger than %zu", s->have);
     }
-    else
-        s->dest = alloc(s->dest, s->got + mlen);
+    else if (!s->measure && s->got + mlen > s->size) {
+        if (s->into)
+            throw(5, "output larger than %zu", s->size);
+        s->size = s->got + mlen;
+        s->dest = alloc(s->dest, s->size + SLACK);
+    }
 
     /* check for and process uncompressed data */
     if (!last && bits(s, 1)) {                          /* ISUNCOMPRESSED */
         /* discard any leftover bits to go to byte boundary */
-        if (s->left && s->bits)
+        if (align(s))
             throw(3, "discarded bits before uncompressed data not zero");
-        s->bits = 0;
-        s->left = 0;
 
         /* check that enough input is available for mlen bytes */
         if (mlen > s->len)
             throw(2, "premature end of input");
 
-        /* write uncompressed data */
-        if (s->have) {
+        /* write uncompressed data, or just skip it when measuring */
+        if (s->measure)
+            ;
+        else if (s->have) {
             if (memcmp(s->dest + s->got, s->next, mlen))
                 throw(4, "compare mismatch");
         }
+        else if (s->check != NULL) {
+            /* copy and check in cache-sized pieces */
+            size_t left = mlen;
+
+            while (left) {
+                size_t n = left > CHECKSPAN ? CHECKSPAN : left;
+
+                memcpy(s->dest + s->got, s->next + (mlen - left), n);
+                s->got += n;
+                left -= n;
+                flush(s);
+            }
+            s->got -= mlen;
+        }
         else
             memcpy(s->dest + s->got, s->next, mlen);
         s->got += mlen;
+        s->span = s->next;
         s->next += mlen;
         s->len -= mlen;
+        s->kind = YEAST_STORED;
         trace(2, "stored block");
+        tally(s->block.stored = 1, s->block.stored_bytes = mlen,
+              s->block.data_bits = (uint64_t)mlen << 3,
+              block_done(s, start));
 
         /* return false (this isn't the last meta-block) */
         trace(1, "end of meta-block");
@@ -1122,6 +2103,7 @@ local unsigned metablock(state_t *s)
     s->direct = bits(s, 4) << s->postfix;               /* NDIRECT */
     dists = 16 + s->direct + (48 << s->postfix);
     trace(2, "%u direct distance codes (%u total)", s->direct, dists);
+    distances(s, dists);
 
     /* get the context modes for each literal type */
     trace(2, "%u literal type context mode%s", PLURAL(s->lit_num));
@@ -1131,207 +2113,194 @@ local unsigned metablock(state_t *s)
     /* get the number of literal prefix codes and literal context map */
     s->lit_codes = block_types(s);                      /* NTREESL */
     trace(2, "%u literal code%s", PLURAL(s->lit_codes));
+    tally(mark = UNREAD(s));
     if (s->lit_codes > 1)                               /* CMAPL */
         context_map(s, s->lit_map, s->lit_num << 6, s->lit_codes);
+    tally(s->block.map_bits += mark - UNREAD(s));
+    if (s->measure && !context_free(s))
+        throw(OUTPUT, "literal contexts need the output to measure");
 
     /* get the number of distance prefix codes and distance context map */
     s->dist_codes = block_types(s);                     /* NTREESD */
     trace(2, "%u distance code%s", PLURAL(s->dist_codes));
+    tally(mark = UNREAD(s));
     if (s->dist_codes > 1)                              /* CMAPD */
         context_map(s, s->dist_map, s->dist_num << 2, s->dist_codes);
+    tally(s->block.map_bits += mark - UNREAD(s));
+
+    /* make room for all of the prefix codes for this meta-block */
+    n = s->lit_codes + s->iac_num + s->dist_codes;
+    if (n > s->codes_num) {
+        s->codes = alloc(s->codes, n * sizeof(prefix_t));
+        s->codes_num = n;
+    }
+    s->lit_code = s->codes;
+    s->iac_code = s->lit_code + s->lit_codes;
+    s->dist_code = s->iac_code + s->iac_num;
 
     /* get lit_codes literal prefix codes */
     trace(2, "%u literal prefix code%s", PLURAL(s->lit_codes));
-    s->lit_code = alloc(NULL, s->lit_codes * sizeof(prefix_t));
+    tally(mark = UNREAD(s));
     for (n = 0; n < s->lit_codes; n++)
         prefix(s, s->lit_code + n, MAXLITS);            /* HTREEL[n] */
 
+    /* build joint tables for the literal types that use only one code */
+    timed(s, joint(s, mlen));
+
     /* get iac_num insert and copy prefix codes */
     trace(2, "%u insert and copy prefix code%s", PLURAL(s->iac_num));
-    s->iac_code = alloc(NULL, s->iac_num * sizeof(prefix_t));
     for (n = 0; n < s->iac_num; n++)
         prefix(s, s->iac_code + n, MAXIACS);            /* HTREEI[n] */
 
     /* get dist_codes distance prefix codes */
     trace(2, "%u distance prefix code%s", PLURAL(s->dist_codes));
-    s->dist_code = alloc(NULL, s->dist_codes * sizeof(prefix_t));
     for (n = 0; n < s->dist_codes; n++)
         prefix(s, s->dist_code + n, dists);             /* HTREED[n] */
+    tally(s->block.prefix_bits = mark - UNREAD(s));
 
     /* done with header */
     trace(2, "end of meta-block header (%u total prefix codes)",
           s->lit_codes + s->iac_num + s->dist_codes);
+    tally(s->block.header_secs = seconds() - began);
 
     /* decode the meta-block data */
-    do {
-        /* get insert and copy lengths */
-        if (s->iac_left == 0) {
-            /* change to a new insert and copy type */
-            n = decode(s, &s->iac_types);
-            n = n > 1 ? n - 2 :
-                n ? (s->iac_type + 1) % s->iac_num :
-                s->iac_last;
-            s->iac_last = s->iac_type;
-            s->iac_type = n;
-            s->iac_left = block_length(s, &s->iac_count);
-            trace(3, "change to iac type %u (%zu)",
-                  s->iac_type, s->iac_left);
-            assert(s->iac_left > 0);
-        }
-        s->iac_left--;
-        iac_sym = decode(s, s->iac_code + s->iac_type);
-        insert = insert_length(s, iac_sym);
-        copy = copy_length(s, iac_sym);
-
-        /* insert literals */
-        trace(3, "insert %zu literal%s", PLURAL(insert));
-        if (insert > mlen)
-            throw(3, "mlen exceeded by insert length");
-        mlen -= insert;
-        while (insert) {
-            if (s->lit_left == 0) {
-                /* change to a new literal type */
-                n = decode(s, &s->lit_types);
-                n = n > 1 ? n - 2 :
-                    n ? (s->lit_type + 1) % s->lit_num :
-                    s->lit_last;
-                s->lit_last = s->lit_type;
-                s->lit_type = n;
-                s->lit_left = block_length(s, &s->lit_count);
-                trace(3, "change to literal type %u (%zu)",
-                      s->lit_type, s->lit_left);
-                assert(s->lit_left > 0);
-            }
-            s->lit_left--;
-            if (s->lit_codes > 1) {
-                p1 = s->got ? s->dest[s->got - 1] : 0;
-                p2 = s->got > 1 ? s->dest[s->got - 2] : 0;
-                n = context_id(p1, p2, s->mode[s->lit_type]);
-                n = s->lit_map[(s->lit_type << 6) + n];
-                assert(n < s->lit_codes);
-            }
-            else
-                n = 0;
-            n = decode(s, s->lit_code + n);
-            if (s->have) {
-                if (s->dest[s->got++] != n)
-                    throw(4, "compare mismatch");
-            }
-            else
-                s->dest[s->got++] = n;
-            insert--;
-        }
-
-        /* if reached mlen, then done (ignore copy length, even though it's not
-           zero) */
-        if (mlen == 0) {
-            trace(2, "unused copy length %zu at end of block", copy);
-            break;
-        }
-
-        /* get the copy distance */
-        max = s->got > s->wsize ? s->wsize : s->got;
-        if (iac_sym < 128)
-            /* use the last distance */
-            dist = s->ring[s->ring_ptr];
-        else {
-            /* get the distance from the stream */
-            if (s->dist_left == 0) {
-                /* change to a new distance type */
-                n = decode(s, &s->dist_types);
-                n = n > 1 ? n - 2 :
-                    n ? (s->dist_type + 1) % s->dist_num :
-                    s->dist_last;
-                s->dist_last = s->dist_type;
-                s->dist_type = n;
-                s->dist_left = block_length(s, &s->dist_count);
-                trace(3, "change to distance type %u (%zu)",
-                      s->dist_type, s->dist_left);
-                assert(s->dist_left > 0);
-            }
-            s->dist_left--;
-            if (s->dist_codes > 1) {
-                n = copy > 4 ? 3 : copy - 2;
-                n = s->dist_map[(s->dist_type << 2) + n];
-                assert(n < s->dist_codes);
-            }
-            else
-                n = 0;
-            dist = distance(s, decode(s, s->dist_code + n), max);
-        }
-
-        /* copy */
-        if (dist > max) {
-            /* dictionary copy */
-            copy = dict_word(word, copy, dist - max - 1);
-            trace(3, "copy %zu bytes from static dictionary", copy);
-            if (copy > mlen)
-                throw(3, "mlen exceeded by dictionary word length");
-            if (s->have) {
-                if (memcmp(s->dest + s->got, word, copy))
-                    throw(4, "compare mismatch");
-            }
-            else
-                memcpy(s->dest + s->got, word, copy);
-            s->got += copy;
-            mlen -= copy;
-        }
-        else {
-            /* copy from previously decompressed data */
-            trace(3, "copy %zu bytes from distance %zu", copy, dist);
-            if (copy > mlen)
-                throw(3, "mlen exceeded by copy length");
-            mlen -= copy;
-            do {
-                if (s->have) {
-                    if (s->dest[s->got] != s->dest[s->got - dist])
-                        throw(4, "compare mismatch");
-                }
-                else
-                    s->dest[s->got] = s->dest[s->got - dist];
-                s->got++;
-            } while (--copy);
-        }
-    } while (mlen);
-    if (s->lit_left && s->lit_left < (((size_t)0 - 1) >> 1))
-        trace(2, "%zu unused literals in last block type", s->lit_left);
-    if (s->iac_left && s->iac_left < (((size_t)0 - 1) >> 1))
-        trace(2, "%zu unused inserts in last block type", s->iac_left);
-    if (s->dist_left && s->dist_left < (((size_t)0 - 1) >> 1))
-        trace(2, "%zu unused distances in last block type", s->dist_left);
+    s->kind = YEAST_COMPRESSED;
+    tally(mark = UNREAD(s), s->block.compressed = 1);
+    s->data(s, mlen);
+    tally(s->block.data_bits = mark - UNREAD(s));
+    if (!s->cmp)
+        flush(s);
+    if (s->lit_left && s->lit_left < (((size_t)0 - 1) >> 1))
+        trace(2, "%zu unused literals in last block type", s->lit_left);
+    if (s->iac_left && s->iac_left < (((size_t)0 - 1) >> 1))
+        trace(2, "%zu unused inserts in last block type", s->iac_left);
+    if (s->dist_left && s->dist_left < (((size_t)0 - 1) >> 1))
+        trace(2, "%zu unused distances in last block type", s->dist_left);
 
     /* return true if this is the last meta-block */
     trace(1, "end of %smeta-block", last ? "last " : "");
-    if (last && s->left && s->bits)
+    if (last && (s->bits & ((1U << (s->left & 7)) - 1)))
         throw(3, "discarded bits after end of stream not zero");
+    tally(block_done(s, start));
     return last;
 }
 
 /*
- * Create a new brotli decoder state.  The brotli stream is comp[0..len-1].
- * The distances ring buffer is only initialized at the start of the stream
- * (not at the start of each meta-block).
+ * Get the sliding window size from the start of the stream.
+ *
+ * Format note:
+ *
+ * - The sliding window size is 1 KiB to 16 MiB.  This was changed in version
+ *   04 of the draft brotli specification to permit smaller windows, going from
+ *   16..24 bits to 10..24 bits.  The change is compatible with previous
+ *   streams, so long as those streams never used a WBITS of 17.
  */
-local state_t *new_state(void const *comp, size_t len)
+local void window(state_t *s)
 {
-    state_t *s;
+#ifdef YEAST_STATS
+    uint64_t start = UNREAD(s); /* unread bits at start of stream */
+#endif
+    unsigned b = bits(s, 1);
+
+    s->wbits =                                          /* WBITS (10..24) */
+        b ? (b = bits(s, 3)) ? b + 17 :
+            (b = bits(s, 3)) ? b + 8 : 17 : 16;
+    if (s->wbits == 9)
+        throw(3, "invalid number of window bits");
+    s->wsize = ((uint32_t)1 << s->wbits) - 16;
+    tally(s->stats.header_bits += start - UNREAD(s));
+    trace(1, "window size = %" PRIu32 " (%u bits)", s->wsize, s->wbits);
+}
+
+/*
+ * Give a checkpoint to the point callback at the boundary between two
+ * meta-blocks, if one is due.  The whole bytes in the bit buffer are counted
+ * as not yet used.
+ */
+local void boundary(state_t *s)
+{
+    uint64_t offset = s->base + s->got;
+    yeast_point_t pt;
+    unsigned n;
+
+    if (s->point == NULL || offset - s->pointed < s->every || offset == 0)
+        return;
+    pt.bit = ((s->skipped + s->fed - s->len) << 3) - s->left;
+    pt.offset = offset;
+    for (n = 0; n < 4; n++)
+        pt.ring[n] = s->ring[(s->ring_ptr - n) & 3];
+    pt.wbits = s->wbits;
+    s->pointed = offset;
+    s->point(s->point_arg, &pt);
+}
 
-    s = alloc(NULL, sizeof(state_t));
+/*
+ * Set up the decoding state for a new brotli stream in comp[0..len-1].  The
+ * allocations in the state are retained for reuse.  The distances ring buffer
+ * is only initialized at the start of the stream (not at the start of each
+ * meta-block).  The rest of the state, including the block type codes, modes,
+ * and context maps, is written by each meta-block header before it is used,
+ * so the 20K or so of those is not touched here.
+ */
+local void reset(state_t *s, void const *comp, size_t len)
+{
     s->next = comp;
     s->len = len;
     s->bits = 0;
     s->left = 0;
-    s->dest = NULL;
+    s->wbits = 0;
+    s->wsize = 0;
     s->got = 0;
     s->have = 0;
+    s->cmp = 0;
+    s->into = 0;
+    s->measure = 0;
+    s->data = data_write;
+    s->checked = 0;
+    s->in_len = 0;
+    s->need = 0;
+    s->fed = 0;
+    s->used = 0;
+    s->ret = -1;
+    s->base = 0;
+    s->skipped = 0;
+    s->skip = 0;
+    s->pointed = 0;
     s->ring[0] = 16;
     s->ring[1] = 15;
     s->ring[2] = 11;
     s->ring[3] = 4;
     s->ring_ptr = 3;
-    s->lit_code = NULL;
-    s->iac_code = NULL;
-    s->dist_code = NULL;
+    tally(memset(&s->stats, 0, sizeof(yeast_stats_t)));
+}
+
+/*
+ * Create a new brotli decoder state for the brotli stream comp[0..len-1].
+ * Return NULL if there is not enough memory.
+ */
+local state_t *new_state(void const *comp, size_t len)
+{
+    state_t *s;
+
+    s = malloc(sizeof(state_t));
+    if (s == NULL)
+        return NULL;
+    s->dest = NULL;
+    s->size = 0;
+    s->in = NULL;
+    s->in_size = 0;
+    s->codes = NULL;
+    s->codes_num = 0;
+    s->pairs = NULL;
+    s->pairs_num = 0;
+    s->check = NULL;
+    s->check_arg = NULL;
+    s->point = NULL;
+    s->point_arg = NULL;
+    s->every = 0;
+    tally(s->report = NULL, s->report_arg = NULL);
+    s->dist_key = (unsigned)-1;
+    reset(s, comp, len);
     return s;
 }
 
@@ -1341,56 +2310,78 @@ local state_t *new_state(void const *comp, size_t len)
  */
 local void free_state(state_t *s)
 {
-    free(s->lit_code);
-    free(s->iac_code);
-    free(s->dist_code);
+    free(s->codes);
+    free(s->pairs);
+    free(s->in);
     free(s);
 }
 
 /*
- * Decompress.  See yeast.h for description.
+ * Let go of the output buffer in the state, freeing it if it was allocated
+ * by the state and not provided by the caller for a compare.
  */
-int yeast(void **dest, size_t *got, void const *source, size_t *len, int cmp)
+local void drop_dest(state_t *s)
+{
+    if (!s->cmp)
+        free(s->dest);
+    s->dest = NULL;
+    s->size = 0;
+}
+
+/*
+ * Decompress the stream source[0..*len-1] using the state s, as described for
+ * yeast() in yeast.h.  The uncompressed data is handed off to the caller, so
+ * that s->dest is not retained in the state.  If into is true, then the data
+ * is written to the caller's buffer *dest instead, which has room for *got
+ * bytes, as described for yeast_into().
+ */
+local int decompress(state_t *s, void **dest, size_t *got,
+                     void const *source, size_t *len, int cmp, int into)
 {
-    state_t *s = NULL;
     ball_t err;
 
     try {
-        /* initialize the decoding state */
-        s = new_state(source, *len);
+        /* initialize the decoding state -- a retained streaming output
+           buffer is used as the start of the output when writing */
+        if (cmp || into || s->cmp)
+            drop_dest(s);
+        reset(s, source, *len);
+        s->fed = *len;
         if (cmp) {
             s->dest = *got ? *dest : got;
             s->have = *got;
+            s->cmp = 1;
+            s->data = data_cmp;
         }
-    }
-    preserve {
-        /* get the sliding window size (1 KiB to 16 MiB) -- this was changed in
-           version 04 of the draft brotli specification to permit smaller
-           windows, going from 16..24 bits to 10..24 bits -- the change is
-           compatible with previous streams, so long as those streams never
-           used a WBITS of 17 */
-        unsigned b = bits(s, 1);
-        s->wbits =                                      /* WBITS (10..24) */
-            b ? (b = bits(s, 3)) ? b + 17 :
-                (b = bits(s, 3)) ? b + 8 : 17 : 16;
-        if (s->wbits == 9)
-            throw(3, "invalid number of window bits");
-        s->wsize = ((uint32_t)1 << s->wbits) - 16;
-        trace(1, "window size = %" PRIu32 " (%u bits)", s->wsize, s->wbits);
+        else if (into) {
+            s->dest = *dest;
+            s->size = *got;
+            s->into = 1;
+        }
+
+        /* get the sliding window size */
+        window(s);
 
         /* decompress meta-blocks until last block */
         while (metablock(s) == 0)
-            ;
-        trace(1, "%zu(%u) bytes(bits) unused", s->len, s->left);
+            boundary(s);
+        trace(1, "%zu(%u) bytes(bits) unused",
+              s->len + (s->left >> 3), s->left & 7);
     }
     always {
-        if (s != NULL) {
-            *len -= s->len;
-            if (!cmp)
-                *dest = s->dest;
-            *got = s->got;
-            free_state(s);
+        *len -= s->len + (s->left >> 3);
+        if (!cmp && !into) {
+            /* no output, so let go of any retained streaming buffer */
+            if (s->got == 0) {
+                free(s->dest);
+                s->dest = NULL;
+            }
+            *dest = s->dest;
         }
+        *got = s->got;
+        s->dest = NULL;
+        s->size = 0;
+        s->into = 0;
     }
     catch (err) {
         trace(1, "error: %s -- aborting", err.why);
@@ -1398,3 +2389,522 @@ int yeast(void **dest, size_t *got, void const *source, size_t *len, int cmp)
     }
     return err.code;
 }
+
+/*
+ * Decompress.  See yeast.h for description.
+ */
+int yeast(void **dest, size_t *got, void const *source, size_t *len, int cmp)
+{
+    state_t *s;
+    int ret;
+
+    s = new_state(NULL, 0);
+    if (s == NULL)
+        return 1;
+    ret = decompress(s, dest, got, source, len, cmp, 0);
+    free_state(s);
+    return ret;
+}
+
+/*
+ * Create a reusable decoding context.  See yeast.h for description.
+ */
+yeast_ctx *yeast_ctx_new(void)
+{
+    return new_state(NULL, 0);
+}
+
+/*
+ * Decompress using a decoding context.  See yeast.h for description.
+ */
+int yeast_with(yeast_ctx *ctx, void **dest, size_t *got, void const *source,
+               size_t *len, int cmp)
+{
+    return decompress(ctx, dest, got, source, len, cmp, 0);
+}
+
+/*
+ * Decompress into the caller's buffer.  See yeast.h for description.
+ */
+int yeast_into(yeast_ctx *ctx, void *dest, size_t *got, void const *source,
+               size_t *len)
+{
+    state_t *s = ctx;
+    int ret;
+
+    if (s == NULL) {
+        s = new_state(NULL, 0);
+        if (s == NULL) {
+            *got = 0;
+            return 1;
+        }
+    }
+    ret = decompress(s, &dest, got, source, len, 0, 1);
+    if (ctx == NULL)
+        free_state(s);
+    return ret;
+}
+
+/*
+ * Measure the stream source[0..len-1] using the state s, as described for
+ * yeast_measure() in yeast.h.  If out is false, then this is done without
+ * output, throwing OUTPUT if the literals of a meta-block depend on the
+ * previous output.  If out is true, then the output is generated, but only the
+ * last s->wsize bytes of it are kept from one meta-block to the next.  *size
+ * is the number of entries allocated at m->block.  Return 0 on success,
+ * OUTPUT if the output is needed, or an error code.
+ */
+local int measure(state_t *s, void const *source, size_t len, int out,
+                  yeast_measure_t *m, size_t *size)
+{
+    size_t base;                /* output discarded from before s->dest */
+    size_t start;               /* offset of meta-block in the output */
+    uint64_t bit;               /* bit offset of meta-block in the stream */
+    unsigned last;              /* true if the last meta-block */
+    yeast_block_t *b;           /* entry for the meta-block */
+    ball_t err;
+
+    try {
+        reset(s, source, len);
+        s->measure = !out;
+        s->data = out ? data_write : data_measure;
+        m->total = 0;
+        m->wsize = 0;
+        m->window = out;
+        m->num = 0;
+        base = 0;
+        window(s);
+        m->wsize = s->wsize;
+        do {
+            bit = ((uint64_t)(s->next - (unsigned char const *)source) << 3) -
+                  s->left;
+            start = base + s->got;
+            last = metablock(s);
+            if (m->num == *size) {
+                *size = *size ? *size << 1 : 16;
+                m->block = alloc(m->block, *size * sizeof(yeast_block_t));
+            }
+            b = m->block + m->num++;
+            b->bit = bit;
+            b->start = start;
+            b->len = base + s->got - start;
+            b->stored = s->kind == YEAST_STORED ?
+                        (size_t)(s->span - (unsigned char const *)source) : 0;
+            b->kind = s->kind;
+            m->total = base + s->got;
+
+            /* keep just the sliding window of the output */
+            if (out && s->got > s->wsize) {
+                memmove(s->dest, s->dest + s->got - s->wsize, s->wsize);
+                base += s->got - s->wsize;
+                s->got = s->wsize;
+            }
+        } while (!last);
+    }
+    catch (err) {
+        trace(1, "error: %s -- %s", err.why,
+              err.code == OUTPUT ? "measuring again" : "aborting");
+        drop(err);
+    }
+    return err.code;
+}
+
+/*
+ * Measure a stream.  See yeast.h for description.  This is first tried with
+ * no output at all, and then if needed with the output.
+ */
+int yeast_measure(yeast_ctx *ctx, void const *source, size_t *len,
+                  yeast_measure_t *m)
+{
+    state_t *s = ctx;
+    void (*check)(void *, void const *, size_t);
+    size_t size = 0;
+    int ret;
+
+    m->block = NULL;
+    m->num = 0;
+    m->total = 0;
+    m->wsize = 0;
+    m->window = 0;
+    if (s == NULL) {
+        s = new_state(NULL, 0);
+        if (s == NULL)
+            return 1;
+    }
+    else if (s->cmp)
+        drop_dest(s);
+    check = s->check;
+    s->check = NULL;
+    ret = measure(s, source, *len, 0, m, &size);
+    if (ret == OUTPUT)
+        ret = measure(s, source, *len, 1, m, &size);
+    *len -= s->len + (s->left >> 3);
+    s->check = check;
+    s->measure = 0;
+    s->got = 0;
+    if (ctx == NULL) {
+        drop_dest(s);
+        free_state(s);
+    }
+    return ret;
+}
+
+/*
+ * Free a decoding context.  See yeast.h for description.
+ */
+void yeast_ctx_free(yeast_ctx *ctx)
+{
+    yeast_end(ctx);
+}
+
+/*
+ * Set the check callback.  See yeast.h for description.
+ */
+void yeast_check(yeast_t *s, void (*check)(void *, void const *, size_t),
+                 void *arg)
+{
+    s->check = check;
+    s->check_arg = arg;
+}
+
+#ifdef YEAST_STATS
+/*
+ * Set the statistics callback.  See yeast.h for description.
+ */
+void yeast_stats(yeast_t *s, void (*block)(void *, yeast_stats_t const *),
+                 void *arg)
+{
+    s->report = block;
+    s->report_arg = arg;
+}
+
+/*
+ * Return the statistics for the stream.  See yeast.h for description.
+ */
+yeast_stats_t const *yeast_totals(yeast_t *s)
+{
+    return &s->stats;
+}
+
+/*
+ * Write a histogram as a JSON array.
+ */
+local void json_hist(FILE *out, uint64_t const *hist)
+{
+    unsigned k;
+
+    putc('[', out);
+    for (k = 0; k < YEAST_HIST; k++)
+        fprintf(out, "%s%" PRIu64, k ? "," : "", hist[k]);
+    putc(']', out);
+}
+
+/*
+ * Write statistics as JSON.  See yeast.h for description.
+ */
+void yeast_stats_json(FILE *out, yeast_stats_t const *st)
+{
+    fprintf(out, "{\"bytes\":%" PRIu64 ",\"compressed\":%" PRIu64
+            ",\"stored\":%" PRIu64 ",\"empty\":%" PRIu64,
+            st->bytes, st->compressed, st->stored, st->empty);
+    fprintf(out, ",\"bits\":{\"header\":%" PRIu64 ",\"prefix\":%" PRIu64
+            ",\"map\":%" PRIu64 ",\"data\":%" PRIu64 "}",
+            st->header_bits, st->prefix_bits, st->map_bits, st->data_bits);
+    fprintf(out, ",\"prefix_codes\":%" PRIu64 ",\"table_secs\":%.9f"
+            ",\"header_secs\":%.9f",
+            st->prefix_codes, st->table_secs, st->header_secs);
+    fprintf(out, ",\"commands\":%" PRIu64 ",\"literal_bytes\":%" PRIu64
+            ",\"stored_bytes\":%" PRIu64 ",\"copies\":%" PRIu64
+            ",\"copy_bytes\":%" PRIu64 ",\"dict_copies\":%" PRIu64
+            ",\"dict_bytes\":%" PRIu64,
+            st->commands, st->literal_bytes, st->stored_bytes, st->copies,
+            st->copy_bytes, st->dict_copies, st->dict_bytes);
+    fprintf(out, ",\"switches\":{\"literal\":%" PRIu64
+            ",\"insert_copy\":%" PRIu64 ",\"distance\":%" PRIu64 "}",
+            st->lit_switches, st->iac_switches, st->dist_switches);
+    fputs(",\"distance_hist\":", out);
+    json_hist(out, st->dist_hist);
+    fputs(",\"length_hist\":", out);
+    json_hist(out, st->len_hist);
+    putc('}', out);
+}
+#endif
+
+/*
+ * Save the current position in the stream as the place to restart from.  This
+ * is only done between meta-blocks.  Whole bytes in the bit buffer are first
+ * returned to the input, so that the input before the mark can be discarded.
+ */
+local void save(state_t *s)
+{
+    s->next -= s->left >> 3;
+    s->len += s->left >> 3;
+    s->left &= 7;
+    s->bits &= (1U << s->left) - 1;
+    s->mark.pos = (size_t)(s->next - s->in);
+    s->mark.bits = s->bits;
+    s->mark.left = s->left;
+    s->mark.got = s->got;
+    memcpy(s->mark.ring, s->ring, sizeof(s->ring));
+    s->mark.ring_ptr = s->ring_ptr;
+#ifdef DEBUG
+    s->traced = 0;
+#endif
+}
+
+/*
+ * Return to the last saved position in the stream, picking up any input that
+ * was added to s->in since then.
+ */
+local void restore(state_t *s)
+{
+    s->next = s->in + s->mark.pos;
+    s->len = s->in_len - s->mark.pos;
+    s->bits = s->mark.bits;
+    s->left = s->mark.left;
+    s->got = s->mark.got;
+    memcpy(s->ring, s->mark.ring, sizeof(s->ring));
+    s->ring_ptr = s->mark.ring_ptr;
+}
+
+/*
+ * Initialize a streaming decode.  See yeast.h for description.
+ */
+yeast_t *yeast_init(void *cmp, size_t len)
+{
+    state_t *s;
+
+    s = new_state(NULL, 0);
+    if (s != NULL)
+        yeast_reset(s, cmp, len);
+    return s;
+}
+
+/*
+ * Start a new streaming decode with an existing state.  See yeast.h for
+ * description.
+ */
+void yeast_reset(yeast_t *s, void *cmp, size_t len)
+{
+    if (cmp != NULL || s->cmp)
+        drop_dest(s);
+    reset(s, s->in, 0);
+    if (cmp != NULL) {
+        s->dest = len ? cmp : (unsigned char *)&s->have;
+        s->have = len;
+        s->cmp = 1;
+        s->data = data_cmp;
+    }
+#ifdef DEBUG
+    s->quiet = 0;
+#endif
+    save(s);
+}
+
+/*
+ * Set the checkpoint callback.  See yeast.h for description.
+ */
+void yeast_points(yeast_t *s, size_t every,
+                  void (*point)(void *, yeast_point_t const *), void *arg)
+{
+    s->every = every;
+    s->point = point;
+    s->point_arg = arg;
+}
+
+/*
+ * Resume streaming decoding from a checkpoint.  See yeast.h for description.
+ */
+int yeast_resume(yeast_t *s, yeast_point_t const *pt, void *cmp, size_t len,
+                 void const *window, size_t wlen)
+{
+    size_t keep;
+    unsigned n;
+    ball_t err;
+
+    yeast_reset(s, cmp, len);
+    try {
+        if (pt->wbits < 10 || pt->wbits > 24)
+            throw(3, "invalid checkpoint window bits");
+        for (n = 0; n < 4; n++)
+            if (pt->ring[n] == 0)
+                throw(3, "invalid checkpoint distance");
+        s->wbits = pt->wbits;
+        s->wsize = ((uint32_t)1 << s->wbits) - 16;
+        for (n = 0; n < 4; n++)
+            s->ring[3 - n] = pt->ring[n];
+        s->ring_ptr = 3;
+        s->skipped = pt->bit >> 3;
+        s->skip = pt->bit & 7;
+        s->pointed = pt->offset;
+        if (cmp != NULL) {
+            /* compare from the offset on */
+            if (pt->offset > s->have)
+                throw(3, "checkpoint past the end of the compare data");
+            s->got = pt->offset;
+        }
+        else {
+            /* start the output with the sliding window */
+            keep = pt->offset < s->wsize ? pt->offset : s->wsize;
+            if (wlen < keep)
+                throw(3, "window too short for checkpoint");
+            if (keep > s->size) {
+                s->dest = alloc(s->dest, keep + SLACK);
+                s->size = keep;
+            }
+            memcpy(s->dest, (unsigned char const *)window + wlen - keep, keep);
+            s->got = keep;
+            s->checked = keep;
+            s->base = pt->offset - keep;
+        }
+        save(s);
+    }
+    catch (err) {
+        trace(1, "error: %s -- not resuming", err.why);
+        s->ret = err.code;
+        drop(err);
+    }
+    return err.code;
+}
+
+/*
+ * Drop the delivered output that is no longer needed for the sliding window,
+ * moving the last s->wsize bytes down to the start of s->dest.  This keeps
+ * the output memory to the window size plus the largest meta-block.  Compare
+ * mode uses the caller's buffer, which is left as is.
+ */
+local void slide(state_t *s)
+{
+    if (!s->cmp && s->got > s->wsize) {
+        memmove(s->dest, s->dest + s->got - s->wsize, s->wsize);
+        s->checked -= s->got - s->wsize;
+        s->base += s->got - s->wsize;
+        s->got = s->wsize;
+        s->mark.got = s->got;
+    }
+}
+
+/*
+ * Add in[0..len-1] to the buffered input, first discarding the input already
+ * used by complete meta-blocks when there isn't room.
+ */
+local void buffer(state_t *s, void const *in, size_t len)
+{
+    if (len == 0)
+        return;
+    if (s->in_len + len > s->in_size && s->mark.pos) {
+        s->in_len -= s->mark.pos;
+        memmove(s->in, s->in + s->mark.pos, s->in_len);
+        s->mark.pos = 0;
+    }
+    if (s->in_len + len > s->in_size) {
+        size_t size = s->in_size << 1;
+
+        if (size < s->in_len + len)
+            size = s->in_len + len;
+        s->in = alloc(s->in, size);
+        s->in_size = size;
+    }
+    memcpy(s->in + s->in_len, in, len);
+    s->in_len += len;
+    s->fed += len;
+}
+
+/*
+ * Decode from the buffered input.  See yeast.h for description.
+ *
+ * Decoding proceeds one meta-block at a time from the mark.  If the input
+ * runs out part way through a meta-block, then the state is returned to the
+ * mark, and the meta-block is decoded again from its start once there is
+ * more input.  The retry waits until the buffered input has doubled, so that
+ * the total work for a meta-block delivered in many small pieces remains
+ * proportional to its size.
+ */
+int yeast_feed(yeast_t *s, void const *in, size_t len, int end,
+               void const **out, size_t *got)
+{
+    ball_t err;
+
+    *out = NULL;
+    *got = 0;
+    if (s->ret != -1)
+        return s->ret;
+    try {
+        buffer(s, in, len);
+        if (s->skip && s->in_len > s->mark.pos) {
+            /* resuming part way into the first byte */
+            s->mark.bits = s->in[s->mark.pos++] >> s->skip;
+            s->mark.left = 8 - s->skip;
+            s->skip = 0;
+        }
+        slide(s);
+        s->out = s->got;
+        if (end || s->in_len - s->mark.pos >= s->need) {
+            restore(s);
+            if (s->wbits == 0) {
+                window(s);
+                save(s);
+            }
+            do {
+                if (metablock(s)) {
+                    trace(1, "%zu(%u) bytes(bits) unused",
+                          s->len + (s->left >> 3), s->left & 7);
+                    s->used = s->fed - s->len - (s->left >> 3);
+                    s->ret = 0;
+                    break;
+                }
+                save(s);
+                s->need = 0;
+                boundary(s);
+            } while (s->got == s->out);
+        }
+    }
+    catch (err) {
+        if (err.code == 2 && !end) {
+            restore(s);
+            s->need = (s->in_len - s->mark.pos) << 1;
+#ifdef DEBUG
+            s->quiet = s->traced;
+            s->traced = 0;
+#endif
+        }
+        else {
+            trace(1, "error: %s -- aborting", err.why);
+            s->used = s->fed - s->len - (s->left >> 3);
+            s->ret = err.code;
+        }
+        drop(err);
+    }
+    *out = s->dest + s->out;
+    *got = s->got - s->out;
+    return s->ret;
+}
+
+/*
+ * Return the number of compressed bytes used.  See yeast.h for description.
+ */
+size_t yeast_used(yeast_t *s)
+{
+    return s->ret == -1 ? 0 : s->used;
+}
+
+/*
+ * Return the input after the end of the stream.  See yeast.h for description.
+ * Those bytes were buffered, but not discarded since they are after the mark.
+ */
+void const *yeast_rest(yeast_t *s, size_t *len)
+{
+    *len = s->ret == 0 ? s->fed - s->used : 0;
+    return *len ? s->in + s->in_len - *len : NULL;
+}
+
+/*
+ * Release the streaming decode resources.  See yeast.h for description.
+ */
+void yeast_end(yeast_t *s)
+{
+    if (s == NULL)
+        return;
+    drop_dest(s);
+    free_state(s);
+}
@@ -24,6 +24,236 @@
  */
 int yeast(void **dest, size_t *got, void const *source, size_t *len, int cmp);
 
+/*
+ * Reusable decoding context.  yeast_with() is the same as yeast(), but uses
+ * the memory in ctx for the decoding state and prefix code tables instead of
+ * allocating and freeing it on every call.  The tables grow with the largest
+ * meta-block header seen and are kept until yeast_ctx_free(), so decoding
+ * many streams with one context does not allocate after the first few.  A
+ * context can only be used by one thread at a time.  yeast_ctx_new() returns
+ * NULL if there is not enough memory.  Setting up for each stream touches
+ * only the small part of the context that depends on the previous stream.
+ */
+typedef struct yeast_s yeast_ctx;
+yeast_ctx *yeast_ctx_new(void);
+int yeast_with(yeast_ctx *ctx, void **dest, size_t *got, void const *source,
+               size_t *len, int cmp);
+void yeast_ctx_free(yeast_ctx *ctx);
+
+/*
+ * Decompress into a buffer provided by the caller.  yeast_into() is the same
+ * as yeast() with cmp false, except that the uncompressed data is written
+ * directly to dest[0..*got-1], where on entry *got is the size of the buffer.
+ * This avoids reallocating the output as it grows, and copying it to where it
+ * is needed.  On return, *got is the number of bytes written.  If the
+ * uncompressed data would not fit in the buffer, then yeast_into() returns 5,
+ * with *got set to the number of bytes up to the end of the last meta-block
+ * that fit.  Nothing is written past dest[*got-1] as given on entry.  If ctx
+ * is not NULL, then it is used as for yeast_with().
+ */
+int yeast_into(yeast_ctx *ctx, void *dest, size_t *got, void const *source,
+               size_t *len);
+
+/*
+ * Measure a brotli stream without keeping its uncompressed data.
+ * yeast_measure() checks the compressed stream in source[0..*len-1], and fills
+ * in *m with the total uncompressed length, the sliding window size, and a
+ * description of each meta-block: the bit offset of its header in the stream,
+ * the offset and length of its data in the uncompressed output, its kind, and
+ * for a stored meta-block the offset in the stream of its uncompressed bytes.
+ * m->block is allocated, and should be freed by the caller with free() when
+ * done.  The return value and *len on return are as for yeast().  On failure,
+ * *m describes the meta-blocks before the failure.  If ctx is not NULL, then
+ * it is used as for yeast_with().
+ *
+ * Stored and metadata meta-blocks are skipped over.  Compressed meta-blocks
+ * are decoded and checked, but with no output written, so long as no literal
+ * type in the stream has a literal code that depends on the preceding bytes,
+ * which is the case for streams from the fastest compression levels.  A
+ * stream that has such a literal type is measured again with the output being
+ * written, but with only the sliding window of it kept.  m->window is then
+ * true.  The check callback of ctx, if any, is not used.
+ */
+#include <stdint.h>
+#define YEAST_COMPRESSED 0
+#define YEAST_STORED 1
+#define YEAST_EMPTY 2           /* empty or metadata meta-block */
+typedef struct {
+    uint64_t bit;               /* offset in bits of the meta-block header */
+    size_t start;               /* offset of its data in the output */
+    size_t len;                 /* uncompressed bytes in the meta-block */
+    size_t stored;              /* offset of the stored bytes in the stream */
+    int kind;                   /* YEAST_COMPRESSED, _STORED, or _EMPTY */
+} yeast_block_t;
+typedef struct {
+    size_t total;               /* total uncompressed bytes */
+    uint32_t wsize;             /* sliding window size in bytes */
+    int window;                 /* true if the output had to be generated */
+    size_t num;                 /* number of meta-blocks */
+    yeast_block_t *block;       /* description of each meta-block */
+} yeast_measure_t;
+int yeast_measure(yeast_ctx *ctx, void const *source, size_t *len,
+                  yeast_measure_t *m);
+
+/*
+ * Streaming decompression.  yeast_init() returns a new decoding state, or NULL
+ * if there was not enough memory.  If cmp is NULL, then the decompressed data
+ * is delivered by yeast_feed().  If cmp is not NULL, then a compare is done
+ * instead against the expected uncompressed data cmp[0..len-1], which must
+ * remain unchanged until yeast_end().
+ *
+ * yeast_feed() provides the next len bytes of the compressed stream at in, all
+ * of which are taken.  end is true if this is the last of the input, in which
+ * case a stream without an end results in a premature end of input error.  On
+ * return, *out and *got are the uncompressed data that was produced, which
+ * remains valid until the next yeast_feed() or yeast_end() call on the state.
+ * (In compare mode, *out points into cmp[], to the data just compared.)  At
+ * most one meta-block of uncompressed data is delivered per call, so the
+ * memory required is the sliding window size plus the largest meta-block, not
+ * the size of the stream.
+ *
+ * yeast_feed() returns -1 if the stream is not complete.  If *got is not zero,
+ * then yeast_feed() should be called again, with or without more input, to
+ * get the data that is ready.  Otherwise more input is needed.  yeast_feed()
+ * returns 0 when the end of the stream has been reached, or one of the error
+ * codes of yeast() above.  Once 0 or an error is returned, then the same is
+ * returned on subsequent calls with nothing more delivered.
+ *
+ * yeast_used() returns the number of compressed bytes provided that were part
+ * of the stream, once yeast_feed() has returned 0 or an error.  Any input
+ * after those bytes was not used.  yeast_rest() returns a pointer to those
+ * unused bytes, setting *len to the number of them, once yeast_feed() has
+ * returned 0.  That is how to get back the input that follows the stream when
+ * it was fed in pieces that went past the end.  The bytes remain valid until
+ * the next yeast_feed(), yeast_reset(), or yeast_end() call on the state.
+ * yeast_end() frees the decoding state.
+ *
+ * yeast_reset() abandons the current stream in y, if any, and starts a new one
+ * with the same arguments as yeast_init(), keeping the memory allocated for
+ * the buffers and prefix codes.  yeast_t and yeast_ctx are the same type, so a
+ * context from yeast_ctx_new() can be used for streaming after yeast_reset(),
+ * and a streaming state can be used with yeast_with().
+ */
+typedef struct yeast_s yeast_t;
+yeast_t *yeast_init(void *cmp, size_t len);
+int yeast_feed(yeast_t *y, void const *in, size_t len, int end,
+               void const **out, size_t *got);
+size_t yeast_used(yeast_t *y);
+void const *yeast_rest(yeast_t *y, size_t *len);
+void yeast_reset(yeast_t *y, void *cmp, size_t len);
+void yeast_end(yeast_t *y);
+
+/*
+ * Checkpoints for resuming decoding part way through a stream.  yeast_points()
+ * sets a function that is given a checkpoint at the end of each meta-block,
+ * other than the last, that ends at least every bytes of uncompressed data
+ * after the previous checkpoint, or after the start of the stream.  If every
+ * is zero, every meta-block boundary gets a checkpoint.  y can be a streaming
+ * state or a decoding context, and the callback applies to subsequent
+ * decoding with y as for yeast_check().  Setting point to NULL turns it off.
+ *
+ * A checkpoint has the offset in bits in the compressed stream of the next
+ * meta-block header, the offset in the uncompressed data of the start of that
+ * meta-block, the window size, and the last four distances, most recent
+ * first.  Along with the up to 2^wbits - 16 bytes of uncompressed data before
+ * the offset, which is the sliding window, that is all that is needed to
+ * continue decoding from there.
+ *
+ * yeast_resume() starts streaming decoding with y from the checkpoint pt, like
+ * yeast_reset(), where the input given to yeast_feed() starts with the byte at
+ * offset pt->bit >> 3 in the compressed stream.  If cmp is NULL, then
+ * window[0..wlen-1] are the uncompressed bytes just before pt->offset, and the
+ * decompressed data after pt->offset is delivered by yeast_feed().  Only the
+ * last 2^wbits - 16 bytes of the window are used.  If cmp is not NULL, then a
+ * compare is done against the expected uncompressed data for the whole
+ * stream, cmp[0..len-1], starting at pt->offset, and window is ignored.
+ * yeast_resume() returns 0 on success, 1 if out of memory, or 3 if the
+ * checkpoint is invalid or the window does not cover distances back to the
+ * start of the stream or the full window size.  yeast_used() and yeast_rest()
+ * then count the input from where it started at pt->bit >> 3.
+ */
+typedef struct {
+    uint64_t bit;               /* bit offset of the next meta-block header */
+    uint64_t offset;            /* uncompressed offset of that meta-block */
+    uint32_t ring[4];           /* last four distances, most recent first */
+    unsigned char wbits;        /* log2(16 + sliding window size) */
+} yeast_point_t;
+void yeast_points(yeast_t *y, size_t every,
+                  void (*point)(void *, yeast_point_t const *), void *arg);
+int yeast_resume(yeast_t *y, yeast_point_t const *pt, void *cmp, size_t len,
+                 void const *window, size_t wlen);
+
+/*
+ * Check value callback.  yeast_check() sets a function that is given the
+ * uncompressed data as it is decoded, while it is still in the cache, so that
+ * a check value can be computed without making a second pass over the data.
+ * check(arg, buf, len) is called with buf[0..len-1] the next len bytes of the
+ * uncompressed data, every 16K or so and at the end of each meta-block.  Each
+ * byte is given to check() exactly once, in order, before it is delivered by
+ * yeast_feed() or returned by yeast_with() or yeast_into().  y can be a
+ * streaming state or a decoding context.  The callback applies to all
+ * subsequent decoding with that state, including after yeast_reset(), until
+ * yeast_check() is called again.  Setting check to NULL turns it off.  The
+ * callback is not used when comparing.  If decoding fails, then the data given
+ * to check() ends at or before the point of failure.
+ */
+void yeast_check(yeast_t *y, void (*check)(void *, void const *, size_t),
+                 void *arg);
+
+/*
+ * Decoding statistics when yeast.c is compiled with #define YEAST_STATS.  The
+ * counts are kept for each meta-block and totaled for the stream, with no
+ * cost to the decoding when YEAST_STATS is not defined.  The bits in the
+ * stream are divided into those in the prefix code descriptions (HTREEL[],
+ * HTREEI[], and HTREED[]), those in the two context maps including their
+ * codes, those in the meta-block data (commands, literals, distances, and
+ * stored or metadata bytes), and everything else, which is the headers.
+ * Bucket k of the distance and length histograms counts the copies from
+ * previous output with distance or length in 2^k..2^(k+1)-1.
+ *
+ * yeast_stats() sets a function that is called with the counts for each
+ * meta-block as it is completed, or NULL for none, in the same way as
+ * yeast_check().  A meta-block that yeast_feed() has to decode again once
+ * it has more input is reported once.  yeast_totals() returns the totals for
+ * the current or last stream decoded with y, which are valid until the next
+ * use of y.  yeast_stats_json() writes the counts in st to out as one JSON
+ * object without a trailing new line.
+ */
+#ifdef YEAST_STATS
+#  include <stdio.h>
+#  define YEAST_HIST 25
+   typedef struct {
+       uint64_t bytes;              /* uncompressed bytes */
+       uint64_t compressed;         /* compressed meta-blocks */
+       uint64_t stored;             /* uncompressed meta-blocks */
+       uint64_t empty;              /* empty and metadata meta-blocks */
+       uint64_t header_bits;        /* bits in headers */
+       uint64_t prefix_bits;        /* bits in prefix code descriptions */
+       uint64_t map_bits;           /* bits in context maps */
+       uint64_t data_bits;          /* bits in meta-block data */
+       uint64_t prefix_codes;       /* number of prefix codes read */
+       double table_secs;           /* time building decoding tables */
+       double header_secs;          /* time decoding compressed meta-block
+                                       headers, including table_secs */
+       uint64_t commands;           /* insert and copy commands */
+       uint64_t literal_bytes;      /* bytes from literals */
+       uint64_t stored_bytes;       /* bytes from stored meta-blocks */
+       uint64_t copies;             /* copies from previous output */
+       uint64_t copy_bytes;         /* bytes from previous output */
+       uint64_t dict_copies;        /* copies from the static dictionary */
+       uint64_t dict_bytes;         /* bytes from the static dictionary */
+       uint64_t lit_switches;       /* literal type switches */
+       uint64_t iac_switches;       /* insert and copy type switches */
+       uint64_t dist_switches;      /* distance type switches */
+       uint64_t dist_hist[YEAST_HIST];  /* copy distance histogram */
+       uint64_t len_hist[YEAST_HIST];   /* copy length histogram */
+   } yeast_stats_t;
+   void yeast_stats(yeast_t *y, void (*block)(void *, yeast_stats_t const *),
+                    void *arg);
+   yeast_stats_t const *yeast_totals(yeast_t *y);
+   void yeast_stats_json(FILE *out, yeast_stats_t const *st);
+#endif
+
 /*
  * Verbosity of trace messages when yeast.c is compiled with #define DEBUG.
  */